@@ -0,0 +1,460 @@
+#include "aaudio_player.h"
+
+#include <android/log.h>
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "pcm_trace.h"
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// Low latency streams keep this many bursts in the device buffer, the
+// smallest that rides out a late callback
+constexpr int32_t kLowLatencyBursts = 2;
+
+// How long Flush waits for the stream to finish pausing
+constexpr int64_t kStateChangeTimeoutNs = 100000000;
+
+#define LOG_TAG "flutter_pcm_sound"
+
+// AAudio's entry points, resolved from libaaudio.so. The NDK only declares
+// them for API 26 and up, and this library loads on older devices too.
+struct AAudioApi {
+  aaudio_result_t (*createStreamBuilder)(AAudioStreamBuilder** builder);
+  void (*setDirection)(AAudioStreamBuilder* builder, aaudio_direction_t direction);
+  void (*setSharingMode)(AAudioStreamBuilder* builder, aaudio_sharing_mode_t mode);
+  void (*setPerformanceMode)(AAudioStreamBuilder* builder, aaudio_performance_mode_t mode);
+  void (*setSampleRate)(AAudioStreamBuilder* builder, int32_t rate);
+  void (*setChannelCount)(AAudioStreamBuilder* builder, int32_t channels);
+  void (*setFormat)(AAudioStreamBuilder* builder, aaudio_format_t format);
+  void (*setDataCallback)(AAudioStreamBuilder* builder, AAudioStream_dataCallback callback, void* user_data);
+  void (*setErrorCallback)(AAudioStreamBuilder* builder, AAudioStream_errorCallback callback, void* user_data);
+  aaudio_result_t (*openStream)(AAudioStreamBuilder* builder, AAudioStream** stream);
+  aaudio_result_t (*deleteBuilder)(AAudioStreamBuilder* builder);
+
+  aaudio_result_t (*requestStart)(AAudioStream* stream);
+  aaudio_result_t (*requestPause)(AAudioStream* stream);
+  aaudio_result_t (*requestFlush)(AAudioStream* stream);
+  aaudio_result_t (*requestStop)(AAudioStream* stream);
+  aaudio_result_t (*close)(AAudioStream* stream);
+  aaudio_result_t (*waitForStateChange)(AAudioStream* stream, aaudio_stream_state_t input,
+                                        aaudio_stream_state_t* next, int64_t timeout_ns);
+  int32_t (*getSampleRate)(AAudioStream* stream);
+  int32_t (*getChannelCount)(AAudioStream* stream);
+  aaudio_format_t (*getFormat)(AAudioStream* stream);
+  aaudio_sharing_mode_t (*getSharingMode)(AAudioStream* stream);
+  aaudio_performance_mode_t (*getPerformanceMode)(AAudioStream* stream);
+  int32_t (*getFramesPerBurst)(AAudioStream* stream);
+  int32_t (*getBufferCapacityInFrames)(AAudioStream* stream);
+  aaudio_result_t (*setBufferSizeInFrames)(AAudioStream* stream, int32_t frames);
+  int32_t (*getBufferSizeInFrames)(AAudioStream* stream);
+  int64_t (*getFramesWritten)(AAudioStream* stream);
+  int64_t (*getFramesRead)(AAudioStream* stream);
+  const char* (*convertResultToText)(aaudio_result_t result);
+
+  bool loaded = false;
+};
+
+template <typename T>
+bool Resolve(void* library, const char* name, T* function) {
+  *function = reinterpret_cast<T>(dlsym(library, name));
+  return *function != nullptr;
+}
+
+// Loaded once; the library stays open for the life of the process.
+const AAudioApi& Api() {
+  static const AAudioApi api = [] {
+    AAudioApi a = {};
+    void* library = dlopen("libaaudio.so", RTLD_NOW);
+    if (!library) {
+      return a;
+    }
+    a.loaded = Resolve(library, "AAudio_createStreamBuilder", &a.createStreamBuilder) &&
+               Resolve(library, "AAudioStreamBuilder_setDirection", &a.setDirection) &&
+               Resolve(library, "AAudioStreamBuilder_setSharingMode", &a.setSharingMode) &&
+               Resolve(library, "AAudioStreamBuilder_setPerformanceMode", &a.setPerformanceMode) &&
+               Resolve(library, "AAudioStreamBuilder_setSampleRate", &a.setSampleRate) &&
+               Resolve(library, "AAudioStreamBuilder_setChannelCount", &a.setChannelCount) &&
+               Resolve(library, "AAudioStreamBuilder_setFormat", &a.setFormat) &&
+               Resolve(library, "AAudioStreamBuilder_setDataCallback", &a.setDataCallback) &&
+               Resolve(library, "AAudioStreamBuilder_setErrorCallback", &a.setErrorCallback) &&
+               Resolve(library, "AAudioStreamBuilder_openStream", &a.openStream) &&
+               Resolve(library, "AAudioStreamBuilder_delete", &a.deleteBuilder) &&
+               Resolve(library, "AAudioStream_requestStart", &a.requestStart) &&
+               Resolve(library, "AAudioStream_requestPause", &a.requestPause) &&
+               Resolve(library, "AAudioStream_requestFlush", &a.requestFlush) &&
+               Resolve(library, "AAudioStream_requestStop", &a.requestStop) &&
+               Resolve(library, "AAudioStream_close", &a.close) &&
+               Resolve(library, "AAudioStream_waitForStateChange", &a.waitForStateChange) &&
+               Resolve(library, "AAudioStream_getSampleRate", &a.getSampleRate) &&
+               Resolve(library, "AAudioStream_getChannelCount", &a.getChannelCount) &&
+               Resolve(library, "AAudioStream_getFormat", &a.getFormat) &&
+               Resolve(library, "AAudioStream_getSharingMode", &a.getSharingMode) &&
+               Resolve(library, "AAudioStream_getPerformanceMode", &a.getPerformanceMode) &&
+               Resolve(library, "AAudioStream_getFramesPerBurst", &a.getFramesPerBurst) &&
+               Resolve(library, "AAudioStream_getBufferCapacityInFrames", &a.getBufferCapacityInFrames) &&
+               Resolve(library, "AAudioStream_setBufferSizeInFrames", &a.setBufferSizeInFrames) &&
+               Resolve(library, "AAudioStream_getBufferSizeInFrames", &a.getBufferSizeInFrames) &&
+               Resolve(library, "AAudioStream_getFramesWritten", &a.getFramesWritten) &&
+               Resolve(library, "AAudioStream_getFramesRead", &a.getFramesRead) &&
+               Resolve(library, "AAudio_convertResultToText", &a.convertResultToText);
+    return a;
+  }();
+  return api;
+}
+
+std::string AAudioError(const char* operation, aaudio_result_t result) {
+  return std::string(operation) + " failed: " + Api().convertResultToText(result);
+}
+
+// AAudio has no 24-in-32 layout, and 32-bit integer streams only arrived
+// in API 31, so both are played as float.
+aaudio_format_t ToAAudioFormat(SampleFormat format) {
+  return format == SampleFormat::kS16 ? AAUDIO_FORMAT_PCM_I16 : AAUDIO_FORMAT_PCM_FLOAT;
+}
+
+}  // namespace
+
+AAudioPlayer::AAudioPlayer(EventCallback on_feed_request, EventCallback on_disconnect)
+    : on_feed_request_(std::move(on_feed_request)), on_disconnect_(std::move(on_disconnect)) {}
+
+AAudioPlayer::~AAudioPlayer() {
+  Close();
+}
+
+// static
+bool AAudioPlayer::IsSupported() {
+  return Api().loaded;
+}
+
+bool AAudioPlayer::Open(const AAudioConfig& config, AAudioStreamInfo* info, std::string* error) {
+  Close();
+  if (!IsSupported()) {
+    *error = "AAudio is not available";
+    return false;
+  }
+
+  config_ = config;
+  sample_rate_ = config.sample_rate;
+  channels_ = config.channels;
+  format_ = config.format;
+  bytes_per_frame_ = BytesPerSample(format_) * channels_;
+  if (sample_rate_ <= 0 || channels_ <= 0) {
+    *error = "sample_rate and num_channels must be positive";
+    return false;
+  }
+  if (!samples_.Reset(QueueBytesFor(config.max_queue_us, sample_rate_, bytes_per_frame_))) {
+    *error = "Failed to allocate sample queue";
+    return false;
+  }
+  did_request_feed_ = false;
+  // Nothing has played yet, so the first empty callbacks aren't an underrun
+  was_starved_ = true;
+  stats_.Reset();
+  flush_to_ = 0;
+  flush_requests_ = 0;
+  flushes_done_ = 0;
+  paused_ = false;
+
+  if (!OpenStream(error)) {
+    samples_.Clear();
+    return false;
+  }
+
+  *info = info_;
+  return true;
+}
+
+bool AAudioPlayer::Reopen(std::string* error) {
+  CloseStream();
+  return OpenStream(error);
+}
+
+bool AAudioPlayer::OpenStream(std::string* error) {
+  const AAudioApi& api = Api();
+  AAudioStreamBuilder* builder = nullptr;
+  aaudio_result_t result = api.createStreamBuilder(&builder);
+  if (result != AAUDIO_OK) {
+    *error = AAudioError("AAudio_createStreamBuilder", result);
+    return false;
+  }
+  api.setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+  api.setSharingMode(builder, config_.exclusive ? AAUDIO_SHARING_MODE_EXCLUSIVE : AAUDIO_SHARING_MODE_SHARED);
+  api.setPerformanceMode(builder,
+                         config_.low_latency ? AAUDIO_PERFORMANCE_MODE_LOW_LATENCY : AAUDIO_PERFORMANCE_MODE_NONE);
+  api.setSampleRate(builder, sample_rate_);
+  api.setChannelCount(builder, channels_);
+  api.setFormat(builder, ToAAudioFormat(format_));
+  api.setDataCallback(builder, DataCallback, this);
+  api.setErrorCallback(builder, ErrorCallback, this);
+  result = api.openStream(builder, &stream_);
+  api.deleteBuilder(builder);
+  if (result != AAUDIO_OK) {
+    stream_ = nullptr;
+    *error = AAudioError("AAudioStreamBuilder_openStream", result);
+    return false;
+  }
+
+  // Whatever the device settled on, which can differ from the request
+  device_rate_ = api.getSampleRate(stream_);
+  device_channels_ = api.getChannelCount(stream_);
+  device_format_ = api.getFormat(stream_) == AAUDIO_FORMAT_PCM_I16 ? SampleFormat::kS16 : SampleFormat::kF32;
+  device_bytes_per_frame_ = BytesPerSample(device_format_) * device_channels_;
+  burst_frames_ = api.getFramesPerBurst(stream_);
+  if (channels_ != device_channels_ && channels_ > 2) {
+    *error = "can't map " + std::to_string(channels_) + " channels onto a " + std::to_string(device_channels_) +
+             " channel stream";
+    CloseStream();
+    return false;
+  }
+  if (config_.low_latency && burst_frames_ > 0) {
+    api.setBufferSizeInFrames(stream_, burst_frames_ * kLowLatencyBursts);
+  }
+
+  // Callback scratch. AAudio asks for at most the buffer capacity at once;
+  // each pass converts at most that much input.
+  converting_ = device_format_ != format_ || device_channels_ != channels_ || device_rate_ != sample_rate_;
+  resampling_ = device_rate_ != sample_rate_;
+  max_callback_frames_ = std::max<size_t>(api.getBufferCapacityInFrames(stream_), burst_frames_);
+  chunk_frames_ = max_callback_frames_ * sample_rate_ / device_rate_ + 1;
+  size_t chunk_out_frames = chunk_frames_;
+  if (resampling_) {
+    if (!resampler_.Configure(sample_rate_, device_rate_, channels_, config_.resample_quality, chunk_frames_)) {
+      *error = "can't resample from " + std::to_string(sample_rate_) + " Hz to " + std::to_string(device_rate_) + " Hz";
+      CloseStream();
+      return false;
+    }
+    chunk_out_frames = resampler_.MaxOutputFrames(chunk_frames_);
+  }
+  chunk_bytes_.assign(chunk_frames_ * bytes_per_frame_, 0);
+  chunk_float_.assign(chunk_frames_ * channels_, 0.0f);
+  resampled_.assign(chunk_out_frames * channels_, 0.0f);
+  fifo_.assign((max_callback_frames_ + chunk_out_frames) * device_channels_, 0.0f);
+  fifo_frames_ = 0;
+
+  if (!paused_) {
+    result = api.requestStart(stream_);
+    if (result != AAUDIO_OK) {
+      *error = AAudioError("AAudioStream_requestStart", result);
+      CloseStream();
+      return false;
+    }
+  }
+  __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "AAudio stream open - rate: %d, channels: %d, burst: %d, %s, %s",
+                      device_rate_, device_channels_, burst_frames_,
+                      api.getSharingMode(stream_) == AAUDIO_SHARING_MODE_EXCLUSIVE ? "exclusive" : "shared",
+                      api.getPerformanceMode(stream_) == AAUDIO_PERFORMANCE_MODE_LOW_LATENCY ? "low latency"
+                                                                                            : "default latency");
+
+  info_.device_format = device_format_;
+  info_.device_channels = device_channels_;
+  info_.device_rate = device_rate_;
+  info_.resampling = resampling_;
+  info_.exclusive = api.getSharingMode(stream_) == AAUDIO_SHARING_MODE_EXCLUSIVE;
+  info_.low_latency = api.getPerformanceMode(stream_) == AAUDIO_PERFORMANCE_MODE_LOW_LATENCY;
+  info_.buffer_frames = static_cast<size_t>(api.getBufferSizeInFrames(stream_)) * sample_rate_ / device_rate_;
+  info_.period_frames = static_cast<size_t>(burst_frames_) * sample_rate_ / device_rate_;
+  return true;
+}
+
+void AAudioPlayer::CloseStream() {
+  if (stream_) {
+    // requestStop returns before the callback has stopped; close waits
+    Api().requestStop(stream_);
+    Api().close(stream_);
+    stream_ = nullptr;
+  }
+}
+
+void AAudioPlayer::Close() {
+  feed_waiter_.Cancel();
+  CloseStream();
+  samples_.Clear();
+  resampler_.Reset();
+  fifo_frames_ = 0;
+}
+
+size_t AAudioPlayer::Write(const uint8_t* data, size_t length, FeedPolicy policy, std::unique_lock<std::mutex>* lock) {
+  PCM_TRACE_SCOPE("feed");
+  // Only whole frames are queued, so the reader never sees a torn frame.
+  // AAudio's callback drains the queue by itself, so a blocked write only
+  // has to wait.
+  size_t written;
+  if (policy != FeedPolicy::kBlock || !lock) {
+    written = FeedQueue(samples_, data, length, bytes_per_frame_, policy);
+    stats_.RecordFeed(written, PlaybackStats::NowNs());
+  } else {
+    size_t whole = length / bytes_per_frame_ * bytes_per_frame_;
+    int64_t timeout_ns = static_cast<int64_t>(whole / bytes_per_frame_) * 1000000000 / sample_rate_;
+    written = feed_waiter_.Block(*lock, whole, timeout_ns, [this, data, whole](size_t* written) {
+      size_t queued = FeedQueue(samples_, data + *written, whole - *written, bytes_per_frame_, FeedPolicy::kPartial);
+      stats_.RecordFeed(queued, PlaybackStats::NowNs());
+      did_request_feed_ = false;
+      *written += queued;
+      return !paused_.load();
+    });
+  }
+  PCM_TRACE_COUNTER("queue_frames", samples_.ReadableBytes() / bytes_per_frame_);
+  did_request_feed_ = false;
+  return written;
+}
+
+void AAudioPlayer::Flush() {
+  flush_to_ = samples_.WritePosition();
+  flush_requests_++;
+  feed_waiter_.Cancel();
+  if (!stream_) {
+    return;
+  }
+  // Flushing the device needs a paused stream. Pausing stops the callback
+  // within a burst, which is what cuts the output off.
+  const AAudioApi& api = Api();
+  if (!paused_) {
+    api.requestPause(stream_);
+    aaudio_stream_state_t next = AAUDIO_STREAM_STATE_UNINITIALIZED;
+    api.waitForStateChange(stream_, AAUDIO_STREAM_STATE_PAUSING, &next, kStateChangeTimeoutNs);
+  }
+  aaudio_result_t result = api.requestFlush(stream_);
+  if (result != AAUDIO_OK) {
+    __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "%s", AAudioError("AAudioStream_requestFlush", result).c_str());
+    stats_.RecordDeviceError();
+  }
+  if (!paused_) {
+    api.requestStart(stream_);
+  }
+}
+
+void AAudioPlayer::Pause() {
+  paused_ = true;
+  feed_waiter_.Cancel();
+  if (stream_) {
+    Api().requestPause(stream_);
+  }
+}
+
+void AAudioPlayer::Resume() {
+  paused_ = false;
+  if (stream_ && Api().requestStart(stream_) != AAUDIO_OK) {
+    stats_.RecordDeviceError();
+  }
+}
+
+// static
+aaudio_data_callback_result_t AAudioPlayer::DataCallback(AAudioStream* stream, void* user_data, void* audio_data,
+                                                          int32_t frames) {
+  PCM_TRACE_SCOPE("render");
+  auto* self = static_cast<AAudioPlayer*>(user_data);
+  self->Render(static_cast<uint8_t*>(audio_data), static_cast<size_t>(frames));
+  return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+// static
+void AAudioPlayer::ErrorCallback(AAudioStream* stream, void* user_data, aaudio_result_t error) {
+  auto* self = static_cast<AAudioPlayer*>(user_data);
+  self->stats_.RecordDeviceError();
+  // The stream can't be closed from here; the platform thread reopens it
+  if (error == AAUDIO_ERROR_DISCONNECTED) {
+    self->on_disconnect_();
+  }
+}
+
+void AAudioPlayer::Render(uint8_t* out, size_t frames) {
+  uint32_t requests = flush_requests_;
+  if (requests != flushes_done_) {
+    stats_.RecordDiscarded(samples_.DiscardTo(flush_to_));
+    fifo_frames_ = 0;
+    if (resampling_) {
+      resampler_.Reset();
+    }
+    flushes_done_ = requests;
+  }
+  size_t queued_frames = samples_.ReadableBytes() / bytes_per_frame_;
+  stats_.RecordDeviceCallback(queued_frames);
+  PCM_TRACE_COUNTER("queue_frames", queued_frames);
+
+  // Fed in the stream's layout: copy straight out of the queue
+  size_t played_frames = 0;
+  if (!converting_) {
+    size_t read = samples_.Read(out, frames * bytes_per_frame_);
+    stats_.RecordPlayed(read, PlaybackStats::NowNs());
+    played_frames = read / bytes_per_frame_;
+  } else {
+    while (played_frames < frames) {
+      size_t want = std::min(frames - played_frames, max_callback_frames_);
+      FillFifo(want);
+      size_t take = std::min(want, fifo_frames_);
+      if (take == 0) {
+        break;
+      }
+      FromFloat(device_format_, fifo_.data(), out + played_frames * device_bytes_per_frame_,
+                take * device_channels_);
+      fifo_frames_ -= take;
+      memmove(fifo_.data(), fifo_.data() + take * device_channels_, fifo_frames_ * device_channels_ * sizeof(float));
+      played_frames += take;
+    }
+  }
+  feed_waiter_.Notify();
+  memset(out + played_frames * device_bytes_per_frame_, 0, (frames - played_frames) * device_bytes_per_frame_);
+  PCM_TRACE_COUNTER("written_frames", played_frames);
+
+  // Only the first short callback counts, and recovery ends when audio
+  // flows again
+  int64_t now = PlaybackStats::NowNs();
+  bool starved = played_frames < frames;
+  if (starved && !was_starved_) {
+    stats_.RecordUnderrun(now);
+    PCM_TRACE_INSTANT("underrun");
+  } else if (!starved) {
+    if (was_starved_) {
+      PCM_TRACE_INSTANT("recover");
+    }
+    stats_.RecordRecovered(now);
+  }
+  was_starved_ = starved;
+
+  size_t remaining = RemainingFrames();
+  size_t threshold = feed_threshold_;
+  if (remaining <= threshold && !did_request_feed_.exchange(true)) {
+    size_t period = std::max<size_t>(static_cast<size_t>(burst_frames_) * sample_rate_ / device_rate_, 1);
+    size_t target = threshold + period;
+    pending_remaining_frames_ = remaining;
+    pending_requested_frames_ = remaining < target ? target - remaining : period;
+    PCM_TRACE_INSTANT("feed_request");
+    on_feed_request_();
+  }
+}
+
+void AAudioPlayer::FillFifo(size_t frames) {
+  while (fifo_frames_ < frames) {
+    size_t read = samples_.Read(chunk_bytes_.data(), chunk_frames_ * bytes_per_frame_) / bytes_per_frame_;
+    if (read == 0) {
+      return;
+    }
+    stats_.RecordPlayed(read * bytes_per_frame_, PlaybackStats::NowNs());
+    ToFloat(format_, chunk_bytes_.data(), chunk_float_.data(), read * channels_);
+    const float* in = chunk_float_.data();
+    if (resampling_) {
+      read = resampler_.Process(in, read, resampled_.data());
+      in = resampled_.data();
+    }
+    RemapChannels(in, channels_, fifo_.data() + fifo_frames_ * device_channels_, device_channels_, read);
+    fifo_frames_ += read;
+  }
+}
+
+size_t AAudioPlayer::RemainingFrames() const {
+  // Written but not yet read by the device, plus what hasn't reached it
+  int64_t device_frames = Api().getFramesWritten(stream_) - Api().getFramesRead(stream_);
+  size_t converted = static_cast<size_t>(std::max<int64_t>(device_frames, 0)) + fifo_frames_;
+  size_t queued = samples_.ReadableBytes() / bytes_per_frame_;
+  if (resampling_) {
+    return queued + converted * sample_rate_ / device_rate_ + resampler_.latency_frames();
+  }
+  return queued + converted;
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,196 @@
+#ifndef FLUTTER_PLUGIN_AAUDIO_PLAYER_H_
+#define FLUTTER_PLUGIN_AAUDIO_PLAYER_H_
+
+#include <aaudio/AAudio.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pcm_convert.h"
+#include "pcm_feed_policy.h"
+#include "pcm_resampler.h"
+#include "pcm_ring_buffer.h"
+#include "pcm_stats.h"
+
+namespace flutter_pcm_sound {
+
+struct AAudioConfig {
+  int sample_rate = 0;
+  int channels = 0;
+  SampleFormat format = SampleFormat::kS16;
+  // PERFORMANCE_MODE_LOW_LATENCY with a two-burst buffer. Otherwise the
+  // default performance mode and the buffer AAudio picks.
+  bool low_latency = true;
+  // SHARING_MODE_EXCLUSIVE (an MMAP stream, where the device offers one).
+  // AAudio falls back to a shared stream by itself when it can't.
+  bool exclusive = true;
+  ResampleQuality resample_quality = ResampleQuality::kMedium;
+  // The sample queue holds this much audio, allocated by Open
+  int64_t max_queue_us = kDefaultMaxQueueMicros;
+};
+
+// What Open negotiated.
+struct AAudioStreamInfo {
+  SampleFormat device_format = SampleFormat::kF32;
+  int device_channels = 0;
+  int device_rate = 0;
+  bool resampling = false;
+  bool exclusive = false;
+  bool low_latency = false;
+  // Device buffer and burst, in frames at the configured sample_rate
+  size_t buffer_frames = 0;
+  size_t period_frames = 0;
+};
+
+// Plays through an AAudio output stream with a data callback.
+//
+// The callback runs on AAudio's real-time thread and pulls from the sample
+// queue; it never locks, allocates or calls into Java. When the stream
+// format differs from what Dart feeds, samples are converted, resampled
+// and remapped with the shared core, as on Windows. The stream runs from
+// Open to Close and plays silence while the queue is empty, so a feed
+// never waits for the device to start.
+//
+// libaaudio.so is loaded at runtime, so the library still loads on API
+// levels below 26; IsSupported says whether this device has it.
+//
+// Everything but the callbacks is called from one thread (the platform
+// thread, serialized with FFI feeds by the JNI layer).
+class AAudioPlayer {
+ public:
+  // Called on the audio thread when the queue drops to the feed threshold,
+  // and on an AAudio thread when the device went away. Both must be cheap:
+  // the JNI layer only signals the main looper.
+  using EventCallback = std::function<void()>;
+
+  AAudioPlayer(EventCallback on_feed_request, EventCallback on_disconnect);
+  ~AAudioPlayer();
+
+  AAudioPlayer(const AAudioPlayer&) = delete;
+  AAudioPlayer& operator=(const AAudioPlayer&) = delete;
+
+  static bool IsSupported();
+
+  // Opens and starts a stream on the default output. On failure returns
+  // false with `error` describing the call that failed.
+  bool Open(const AAudioConfig& config, AAudioStreamInfo* info, std::string* error);
+
+  // Opens the stream again with the same config after a disconnect,
+  // keeping whatever is queued.
+  bool Reopen(std::string* error);
+
+  // Stops and closes the stream. Safe to call twice.
+  void Close();
+
+  bool is_open() const { return stream_ != nullptr; }
+
+  // What the current stream negotiated. Reopen can change it.
+  const AAudioStreamInfo& info() const { return info_; }
+
+  // Queues whole frames in the configured format under `policy` and
+  // returns how many bytes it took. kBlock waits at most as long as the
+  // samples take to play, and not at all while paused; it waits with the
+  // caller's `lock` released, and only when there is one, so the platform
+  // thread passes none and never blocks.
+  size_t Write(const uint8_t* data, size_t length, FeedPolicy policy, std::unique_lock<std::mutex>* lock);
+
+  // Any thread. Ends a blocked Write with what it has queued so far.
+  void CancelWrite() { feed_waiter_.Cancel(); }
+
+  void set_feed_threshold(size_t frames) { feed_threshold_ = frames; }
+
+  // The numbers behind the latest feed request, in frames at the
+  // configured sample rate. See the Linux plugin's feed_source_dispatch.
+  size_t pending_remaining_frames() const { return pending_remaining_frames_; }
+  size_t pending_requested_frames() const { return pending_requested_frames_; }
+
+  // Drops everything queued so far and what the device holds, keeping the
+  // stream open. Later writes play as usual.
+  void Flush();
+
+  // Pauses the stream where it is, keeping everything queued, until
+  // Resume.
+  void Pause();
+  void Resume();
+  bool paused() const { return paused_; }
+
+  // Primary stream telemetry. Open resets it.
+  PlaybackStats& stats() { return stats_; }
+
+ private:
+  bool OpenStream(std::string* error);
+  void CloseStream();
+  static aaudio_data_callback_result_t DataCallback(AAudioStream* stream, void* user_data, void* audio_data,
+                                                    int32_t frames);
+  static void ErrorCallback(AAudioStream* stream, void* user_data, aaudio_result_t error);
+  void Render(uint8_t* out, size_t frames);
+  // Converts queued samples into fifo_ until it holds `frames` frames or
+  // the queue runs dry.
+  void FillFifo(size_t frames);
+  size_t RemainingFrames() const;
+
+  EventCallback on_feed_request_;
+  EventCallback on_disconnect_;
+
+  AAudioStream* stream_ = nullptr;
+  AAudioConfig config_;
+  AAudioStreamInfo info_;
+
+  // What Dart feeds
+  int sample_rate_ = 0;
+  int channels_ = 0;
+  SampleFormat format_ = SampleFormat::kS16;
+  size_t bytes_per_frame_ = 0;
+
+  // What the stream runs
+  SampleFormat device_format_ = SampleFormat::kF32;
+  int device_channels_ = 0;
+  int device_rate_ = 0;
+  size_t device_bytes_per_frame_ = 0;
+  int32_t burst_frames_ = 0;
+  bool converting_ = false;
+
+  RingBuffer samples_;
+  Resampler resampler_;
+  bool resampling_ = false;
+
+  // Callback scratch, sized by OpenStream for `max_callback_frames_` at a
+  // time. fifo_ holds converted frames that didn't fit the last callback,
+  // in the device layout.
+  size_t max_callback_frames_ = 0;
+  size_t chunk_frames_ = 0;
+  std::vector<uint8_t> chunk_bytes_;
+  std::vector<float> chunk_float_;
+  std::vector<float> resampled_;
+  std::vector<float> fifo_;
+  size_t fifo_frames_ = 0;
+  // The last callback came up short (audio thread only)
+  bool was_starved_ = false;
+
+  std::atomic<size_t> feed_threshold_{0};
+  std::atomic<bool> did_request_feed_{false};
+  std::atomic<size_t> pending_remaining_frames_{0};
+  std::atomic<size_t> pending_requested_frames_{0};
+
+  // Flush notes how far the queue reaches in flush_to_ and bumps
+  // flush_requests_; the callback drops the queue up to there along with
+  // its own scratch, and counts flushes_done_ (audio thread only).
+  std::atomic<uint64_t> flush_to_{0};
+  std::atomic<uint32_t> flush_requests_{0};
+  uint32_t flushes_done_ = 0;
+  std::atomic<bool> paused_{false};
+
+  PlaybackStats stats_;
+  // A blocked Write sleeps here until the callback has taken samples out,
+  // or Flush, Pause, Close or CancelWrite ends the wait
+  FeedWaiter feed_waiter_;
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_AAUDIO_PLAYER_H_
@@ -0,0 +1,493 @@
+#include <android/log.h>
+#include <android/looper.h>
+#include <fcntl.h>
+#include <jni.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "aaudio_player.h"
+#include "media_codec_source.h"
+#include "pcm_file_player.h"
+#include "pcm_file_source.h"
+#include "pcm_trace.h"
+
+#define FFI_EXPORT extern "C" __attribute__((visibility("default"))) __attribute__((used))
+
+FFI_EXPORT int64_t flutter_pcm_sound_ffi_feed(const uint8_t* data, int64_t length);
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+#define LOG_TAG "flutter_pcm_sound"
+
+constexpr const char* kPluginClass = "com/lib/flutter_pcm_sound/FlutterPcmSoundPlugin";
+
+// Bits the audio threads set in Engine::events before waking the looper
+constexpr uint32_t kEventFeed = 1u << 0;
+constexpr uint32_t kEventDisconnect = 1u << 1;
+constexpr uint32_t kEventFileDone = 1u << 2;
+
+JavaVM* java_vm = nullptr;
+jmethodID on_native_feed_request = nullptr;
+jmethodID on_native_file_done = nullptr;
+
+// Native side of one plugin instance.
+//
+// The audio threads can't call into Java, so they set a bit in `events`
+// and write the eventfd; the main looper wakes up and handles them on the
+// platform thread, like the Linux plugin's feed source.
+struct Engine {
+  // Serializes the player between method calls on the platform thread and
+  // flutter_pcm_sound_ffi_feed on whatever thread Dart calls it from
+  std::mutex mutex;
+  jobject plugin = nullptr;  // global ref
+  ALooper* looper = nullptr;
+  int event_fd = -1;
+  std::atomic<uint32_t> events{0};
+  std::unique_ptr<AAudioPlayer> player;
+  bool did_setup = false;
+  AAudioConfig config;  // what setup opened the stream with
+  FeedPolicy feed_policy = FeedPolicy::kPartial;
+
+  // playFile: queues a file into the sample queue from its own thread.
+  // file_path is what it is playing and file_info what it is; both only
+  // change while it is stopped.
+  std::unique_ptr<FilePlayer> file_player;
+  std::string file_path;
+  SourceInfo file_info;
+  // Finished files (path, error) waiting for kEventFileDone
+  std::mutex file_done_mutex;
+  std::vector<std::pair<std::string, std::string>> files_done;
+
+  void Signal(uint32_t event) {
+    events.fetch_or(event);
+    uint64_t one = 1;
+    // Can only fail when the counter is about to overflow, and then the
+    // looper is already due to wake
+    (void)write(event_fd, &one, sizeof(one));
+  }
+};
+
+// flutter_pcm_sound_ffi_feed has no handle, so it feeds the newest engine
+Engine* ffi_engine = nullptr;
+std::mutex ffi_engine_mutex;
+
+Engine* FromHandle(jlong handle) {
+  return reinterpret_cast<Engine*>(handle);
+}
+
+int OnLooperEvent(int fd, int looper_events, void* data) {
+  auto* engine = static_cast<Engine*>(data);
+  uint64_t count;
+  (void)read(fd, &count, sizeof(count));
+  uint32_t events = engine->events.exchange(0);
+
+  JNIEnv* env = nullptr;
+  if (java_vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+    return 1;
+  }
+
+  if (events & kEventDisconnect) {
+    // The stream is dead once AAudio reports a disconnect; open a new one
+    // on whatever the default output is now
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    if (engine->did_setup) {
+      std::string error;
+      if (!engine->player->Reopen(&error)) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "reopen after disconnect: %s", error.c_str());
+      }
+    }
+  }
+
+  if (events & kEventFileDone) {
+    std::vector<std::pair<std::string, std::string>> done;
+    {
+      std::lock_guard<std::mutex> lock(engine->file_done_mutex);
+      done.swap(engine->files_done);
+    }
+    for (const auto& file : done) {
+      jstring path = env->NewStringUTF(file.first.c_str());
+      jstring error = file.second.empty() ? nullptr : env->NewStringUTF(file.second.c_str());
+      env->CallVoidMethod(engine->plugin, on_native_file_done, path, error);
+      if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+      }
+      env->DeleteLocalRef(path);
+      if (error) {
+        env->DeleteLocalRef(error);
+      }
+    }
+  }
+
+  if (events & kEventFeed) {
+    PCM_TRACE_SCOPE("feed_callback");
+    jlong remaining = 0;
+    jlong requested = 0;
+    {
+      std::lock_guard<std::mutex> lock(engine->mutex);
+      if (!engine->did_setup) {
+        return 1;
+      }
+      engine->player->stats().RecordFeedCallback();
+      remaining = static_cast<jlong>(engine->player->pending_remaining_frames());
+      requested = static_cast<jlong>(engine->player->pending_requested_frames());
+    }
+    // Outside the lock: Dart may feed over FFI from inside the callback
+    env->CallVoidMethod(engine->plugin, on_native_feed_request, remaining, requested);
+    if (env->ExceptionCheck()) {
+      env->ExceptionDescribe();
+      env->ExceptionClear();
+    }
+  }
+  return 1;  // keep the fd registered
+}
+
+jboolean NativeIsSupported(JNIEnv* env, jclass clazz) {
+  return AAudioPlayer::IsSupported() ? JNI_TRUE : JNI_FALSE;
+}
+
+// Called on the platform thread, whose looper delivers the events
+jlong NativeCreate(JNIEnv* env, jobject thiz) {
+  ALooper* looper = ALooper_forThread();
+  if (!looper) {
+    return 0;
+  }
+  int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (event_fd < 0) {
+    return 0;
+  }
+  auto* engine = new Engine();
+  engine->plugin = env->NewGlobalRef(thiz);
+  engine->looper = looper;
+  engine->event_fd = event_fd;
+  ALooper_acquire(looper);
+  ALooper_addFd(looper, event_fd, ALOOPER_POLL_CALLBACK, ALOOPER_EVENT_INPUT, OnLooperEvent, engine);
+  engine->player = std::make_unique<AAudioPlayer>([engine]() { engine->Signal(kEventFeed); },
+                                                  [engine]() { engine->Signal(kEventDisconnect); });
+  engine->file_player = std::make_unique<FilePlayer>(
+      [engine](const uint8_t* data, size_t length) -> size_t {
+        // Never wait for the mutex: Stop is called with it held
+        std::unique_lock<std::mutex> lock(engine->mutex, std::try_to_lock);
+        if (!lock.owns_lock() || !engine->did_setup) {
+          return 0;
+        }
+        return engine->player->Write(data, length, FeedPolicy::kPartial, nullptr);
+      },
+      [engine](const std::string& error) {
+        {
+          std::lock_guard<std::mutex> lock(engine->file_done_mutex);
+          engine->files_done.emplace_back(engine->file_path, error);
+        }
+        engine->Signal(kEventFileDone);
+      });
+
+  std::lock_guard<std::mutex> lock(ffi_engine_mutex);
+  ffi_engine = engine;
+  return reinterpret_cast<jlong>(engine);
+}
+
+void NativeDestroy(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  // A blocked FFI feed holds ffi_engine_mutex until it returns
+  engine->player->CancelWrite();
+  {
+    std::lock_guard<std::mutex> lock(ffi_engine_mutex);
+    if (ffi_engine == engine) {
+      ffi_engine = nullptr;
+    }
+  }
+  {
+    // Closing the stream waits for the last callback, so nothing signals
+    // the eventfd once it is gone
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    engine->file_player.reset();
+    engine->player.reset();
+    engine->did_setup = false;
+  }
+  ALooper_removeFd(engine->looper, engine->event_fd);
+  ALooper_release(engine->looper);
+  close(engine->event_fd);
+  env->DeleteGlobalRef(engine->plugin);
+  delete engine;
+}
+
+// Returns null on success, otherwise what went wrong
+jstring NativeSetup(JNIEnv* env, jobject thiz, jlong handle, jint sample_rate, jint channels, jint format,
+                    jboolean low_latency, jboolean exclusive, jint resample_quality, jlong max_queue_us,
+                    jint feed_policy) {
+  Engine* engine = FromHandle(handle);
+  AAudioConfig config;
+  config.sample_rate = sample_rate;
+  config.channels = channels;
+  // Dart's PcmFormat and PcmResampleQuality indices match the core enums
+  config.format = static_cast<SampleFormat>(format);
+  config.low_latency = low_latency == JNI_TRUE;
+  config.exclusive = exclusive == JNI_TRUE;
+  config.resample_quality = static_cast<ResampleQuality>(resample_quality);
+  config.max_queue_us = max_queue_us;
+
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  engine->file_player->Stop();
+  engine->did_setup = false;
+  AAudioStreamInfo info;
+  std::string error;
+  if (!engine->player->Open(config, &info, &error)) {
+    return env->NewStringUTF(error.c_str());
+  }
+  engine->config = config;
+  // PcmFeedPolicy's indices match the core enum too
+  engine->feed_policy = static_cast<FeedPolicy>(feed_policy);
+  engine->did_setup = true;
+  return nullptr;
+}
+
+// What setup negotiated: device format, channels and rate, exclusive, low
+// latency, buffer frames and period frames
+jlongArray NativeStreamInfo(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  jlong values[7] = {};
+  {
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    const AAudioStreamInfo& info = engine->player->info();
+    values[0] = static_cast<jlong>(info.device_format);
+    values[1] = info.device_channels;
+    values[2] = info.device_rate;
+    values[3] = info.exclusive ? 1 : 0;
+    values[4] = info.low_latency ? 1 : 0;
+    values[5] = static_cast<jlong>(info.buffer_frames);
+    values[6] = static_cast<jlong>(info.period_frames);
+  }
+  jlongArray array = env->NewLongArray(7);
+  env->SetLongArrayRegion(array, 0, 7, values);
+  return array;
+}
+
+// Returns the number of bytes queued, or -1 if setup hasn't been called
+jint NativeFeed(JNIEnv* env, jobject thiz, jlong handle, jbyteArray buffer) {
+  Engine* engine = FromHandle(handle);
+  jsize length = env->GetArrayLength(buffer);
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  if (!engine->did_setup) {
+    return -1;
+  }
+  // Copied straight into the queue. This is the platform thread, so even
+  // a blocking feed only takes what fits, and the array is never held
+  // critical for long.
+  void* data = env->GetPrimitiveArrayCritical(buffer, nullptr);
+  if (!data) {
+    return -1;
+  }
+  size_t written = engine->player->Write(static_cast<const uint8_t*>(data), static_cast<size_t>(length),
+                                         engine->feed_policy, nullptr);
+  env->ReleasePrimitiveArrayCritical(buffer, data, JNI_ABORT);
+  return static_cast<jint>(written);
+}
+
+// Takes ownership of `fd`. WAV and raw PCM play straight from a mapping of
+// it; anything else goes to the platform decoder. `raw_format` is a
+// PcmFormat index, or negative when the file isn't raw.
+std::unique_ptr<PcmSource> OpenFileSource(int fd, int64_t offset, int64_t length, jint raw_rate, jint raw_channels,
+                                          jint raw_format, std::string* error) {
+  auto file = std::make_unique<MappedFile>();
+  if (!file->OpenFd(fd, offset, length, error)) {
+    close(fd);
+    return nullptr;
+  }
+  if (raw_format >= 0) {
+    close(fd);
+    return OpenRawSource(std::move(file), static_cast<SampleFormat>(raw_format), raw_rate, raw_channels, error);
+  }
+  if (IsWav(file->data(), file->size())) {
+    close(fd);
+    return OpenWavSource(std::move(file), error);
+  }
+  file.reset();
+  return OpenMediaCodecSource(fd, offset, length, error);
+}
+
+// Opens and starts playing `fd`, which it takes ownership of, as `path`.
+// Returns null on success, otherwise what went wrong.
+jstring PlayFd(JNIEnv* env, Engine* engine, const std::string& path, int fd, int64_t offset, int64_t length,
+               jint raw_rate, jint raw_channels, jint raw_format) {
+  // Opening a compressed file starts its decoder; FFI feeds needn't
+  // wait for that
+  std::string error;
+  std::unique_ptr<PcmSource> source =
+      OpenFileSource(fd, offset, length, raw_rate, raw_channels, raw_format, &error);
+  if (!source) {
+    return env->NewStringUTF(error.c_str());
+  }
+
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  engine->file_player->Stop();
+  if (!engine->did_setup) {
+    return env->NewStringUTF("must call setup first");
+  }
+  engine->file_path = path;
+  engine->file_info = source->info();
+  const AAudioConfig& config = engine->config;
+  if (!engine->file_player->Start(std::move(source), config.sample_rate, config.channels, config.format,
+                                  config.resample_quality, &error)) {
+    return env->NewStringUTF(error.c_str());
+  }
+  return nullptr;
+}
+
+jstring NativePlayFile(JNIEnv* env, jobject thiz, jlong handle, jstring path, jint raw_rate, jint raw_channels,
+                       jint raw_format) {
+  const char* chars = env->GetStringUTFChars(path, nullptr);
+  std::string file_path = chars;
+  env->ReleaseStringUTFChars(path, chars);
+  int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::string error = file_path + ": " + strerror(errno);
+    return env->NewStringUTF(error.c_str());
+  }
+  return PlayFd(env, FromHandle(handle), file_path, fd, 0, -1, raw_rate, raw_channels, raw_format);
+}
+
+// For content URIs: `fd` is detached from the ParcelFileDescriptor Java
+// opened, and `length` is negative when the provider didn't say
+jstring NativePlayFd(JNIEnv* env, jobject thiz, jlong handle, jstring uri, jint fd, jlong offset, jlong length) {
+  const char* chars = env->GetStringUTFChars(uri, nullptr);
+  std::string name = chars;
+  env->ReleaseStringUTFChars(uri, chars);
+  return PlayFd(env, FromHandle(handle), name, fd, offset, length, 0, 0, -1);
+}
+
+// The file playFile last opened: sample rate, channels and frames (-1
+// when unknown)
+jlongArray NativeFileInfo(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  jlong values[3] = {};
+  {
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    values[0] = engine->file_info.sample_rate;
+    values[1] = engine->file_info.channels;
+    values[2] = static_cast<jlong>(engine->file_info.frames);
+  }
+  jlongArray array = env->NewLongArray(3);
+  env->SetLongArrayRegion(array, 0, 3, values);
+  return array;
+}
+
+void NativeStopFile(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  engine->file_player->Stop();
+}
+
+void NativeSetFeedThreshold(JNIEnv* env, jobject thiz, jlong handle, jlong frames) {
+  Engine* engine = FromHandle(handle);
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  engine->player->set_feed_threshold(frames > 0 ? static_cast<size_t>(frames) : 0);
+}
+
+void NativeFlush(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  // A file still being queued is cut off along with what it queued
+  engine->file_player->Stop();
+  if (engine->did_setup) {
+    engine->player->Flush();
+  }
+}
+
+void NativePause(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  if (engine->did_setup) {
+    engine->player->Pause();
+  }
+}
+
+void NativeResume(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  if (engine->did_setup) {
+    engine->player->Resume();
+  }
+}
+
+void NativeRelease(JNIEnv* env, jobject thiz, jlong handle) {
+  Engine* engine = FromHandle(handle);
+  std::lock_guard<std::mutex> lock(engine->mutex);
+  engine->file_player->Stop();
+  engine->did_setup = false;
+  engine->player->Close();
+}
+
+const JNINativeMethod kNativeMethods[] = {
+    {"nativeIsSupported", "()Z", reinterpret_cast<void*>(NativeIsSupported)},
+    {"nativeCreate", "()J", reinterpret_cast<void*>(NativeCreate)},
+    {"nativeDestroy", "(J)V", reinterpret_cast<void*>(NativeDestroy)},
+    {"nativeSetup", "(JIIIZZIJI)Ljava/lang/String;", reinterpret_cast<void*>(NativeSetup)},
+    {"nativeStreamInfo", "(J)[J", reinterpret_cast<void*>(NativeStreamInfo)},
+    {"nativeFeed", "(J[B)I", reinterpret_cast<void*>(NativeFeed)},
+    {"nativePlayFile", "(JLjava/lang/String;III)Ljava/lang/String;", reinterpret_cast<void*>(NativePlayFile)},
+    {"nativePlayFd", "(JLjava/lang/String;IJJ)Ljava/lang/String;", reinterpret_cast<void*>(NativePlayFd)},
+    {"nativeFileInfo", "(J)[J", reinterpret_cast<void*>(NativeFileInfo)},
+    {"nativeStopFile", "(J)V", reinterpret_cast<void*>(NativeStopFile)},
+    {"nativeSetFeedThreshold", "(JJ)V", reinterpret_cast<void*>(NativeSetFeedThreshold)},
+    {"nativeFlush", "(J)V", reinterpret_cast<void*>(NativeFlush)},
+    {"nativePause", "(J)V", reinterpret_cast<void*>(NativePause)},
+    {"nativeResume", "(J)V", reinterpret_cast<void*>(NativeResume)},
+    {"nativeRelease", "(J)V", reinterpret_cast<void*>(NativeRelease)},
+};
+
+}  // namespace
+
+}  // namespace flutter_pcm_sound
+
+using flutter_pcm_sound::Engine;
+
+FFI_EXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+  JNIEnv* env = nullptr;
+  if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+    return JNI_ERR;
+  }
+  jclass clazz = env->FindClass(flutter_pcm_sound::kPluginClass);
+  if (!clazz) {
+    return JNI_ERR;
+  }
+  flutter_pcm_sound::on_native_feed_request = env->GetMethodID(clazz, "onNativeFeedRequest", "(JJ)V");
+  flutter_pcm_sound::on_native_file_done =
+      env->GetMethodID(clazz, "onNativeFileDone", "(Ljava/lang/String;Ljava/lang/String;)V");
+  if (!flutter_pcm_sound::on_native_feed_request || !flutter_pcm_sound::on_native_file_done ||
+      env->RegisterNatives(clazz, flutter_pcm_sound::kNativeMethods,
+                           sizeof(flutter_pcm_sound::kNativeMethods) / sizeof(JNINativeMethod)) != JNI_OK) {
+    return JNI_ERR;
+  }
+  env->DeleteLocalRef(clazz);
+  flutter_pcm_sound::java_vm = vm;
+  return JNI_VERSION_1_6;
+}
+
+int64_t flutter_pcm_sound_ffi_feed(const uint8_t* data, int64_t length) {
+  std::lock_guard<std::mutex> engine_lock(flutter_pcm_sound::ffi_engine_mutex);
+  Engine* engine = flutter_pcm_sound::ffi_engine;
+  if (!engine || length < 0) {
+    return -1;
+  }
+  std::unique_lock<std::mutex> lock(engine->mutex);
+  if (!engine->did_setup) {
+    return -1;
+  }
+  // A blocked feed on the platform thread would hold off the calls that
+  // end it
+  bool can_block = ALooper_forThread() != engine->looper;
+  return static_cast<int64_t>(
+      engine->player->Write(data, static_cast<size_t>(length), engine->feed_policy, can_block ? &lock : nullptr));
+}
@@ -0,0 +1,351 @@
+#include "media_codec_source.h"
+
+#include <dlfcn.h>
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaExtractor.h>
+#include <media/NdkMediaFormat.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "pcm_convert.h"
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// How long a dequeue may wait for the codec. The file thread has nothing
+// else to do, so this only bounds how long Read takes to notice a stall.
+constexpr int64_t kDequeueTimeoutUs = 10000;
+
+// Dequeues that may come back empty in a row before the decoder is taken
+// to be stuck
+constexpr int kMaxIdlePasses = 500;
+
+// AudioFormat.ENCODING_PCM_FLOAT, for the "pcm-encoding" key. Decoders
+// produce 16-bit samples unless they say otherwise.
+constexpr int32_t kEncodingPcmFloat = 4;
+
+// The media NDK's entry points, resolved from libmediandk.so, which API
+// levels below 21 don't have. The format keys are passed as their string
+// values, rather than the library's exported constants, for the same reason.
+struct MediaApi {
+  AMediaExtractor* (*newExtractor)();
+  media_status_t (*deleteExtractor)(AMediaExtractor* extractor);
+  media_status_t (*setDataSourceFd)(AMediaExtractor* extractor, int fd, off64_t offset, off64_t length);
+  size_t (*getTrackCount)(AMediaExtractor* extractor);
+  AMediaFormat* (*getTrackFormat)(AMediaExtractor* extractor, size_t index);
+  media_status_t (*selectTrack)(AMediaExtractor* extractor, size_t index);
+  ssize_t (*readSampleData)(AMediaExtractor* extractor, uint8_t* buffer, size_t capacity);
+  int64_t (*getSampleTime)(AMediaExtractor* extractor);
+  bool (*advance)(AMediaExtractor* extractor);
+
+  bool (*getString)(AMediaFormat* format, const char* name, const char** out);
+  bool (*getInt32)(AMediaFormat* format, const char* name, int32_t* out);
+  bool (*getInt64)(AMediaFormat* format, const char* name, int64_t* out);
+  media_status_t (*deleteFormat)(AMediaFormat* format);
+
+  AMediaCodec* (*createDecoderByType)(const char* mime);
+  media_status_t (*configure)(AMediaCodec* codec, const AMediaFormat* format, ANativeWindow* surface,
+                              AMediaCrypto* crypto, uint32_t flags);
+  media_status_t (*start)(AMediaCodec* codec);
+  media_status_t (*stop)(AMediaCodec* codec);
+  media_status_t (*deleteCodec)(AMediaCodec* codec);
+  ssize_t (*dequeueInputBuffer)(AMediaCodec* codec, int64_t timeout_us);
+  uint8_t* (*getInputBuffer)(AMediaCodec* codec, size_t index, size_t* size);
+  media_status_t (*queueInputBuffer)(AMediaCodec* codec, size_t index, off_t offset, size_t size, uint64_t time_us,
+                                     uint32_t flags);
+  ssize_t (*dequeueOutputBuffer)(AMediaCodec* codec, AMediaCodecBufferInfo* info, int64_t timeout_us);
+  uint8_t* (*getOutputBuffer)(AMediaCodec* codec, size_t index, size_t* size);
+  AMediaFormat* (*getOutputFormat)(AMediaCodec* codec);
+  media_status_t (*releaseOutputBuffer)(AMediaCodec* codec, size_t index, bool render);
+
+  bool loaded = false;
+};
+
+template <typename T>
+bool Resolve(void* library, const char* name, T* function) {
+  *function = reinterpret_cast<T>(dlsym(library, name));
+  return *function != nullptr;
+}
+
+// Loaded once; the library stays open for the life of the process.
+const MediaApi& Api() {
+  static const MediaApi api = [] {
+    MediaApi a = {};
+    void* library = dlopen("libmediandk.so", RTLD_NOW);
+    if (!library) {
+      return a;
+    }
+    a.loaded = Resolve(library, "AMediaExtractor_new", &a.newExtractor) &&
+               Resolve(library, "AMediaExtractor_delete", &a.deleteExtractor) &&
+               Resolve(library, "AMediaExtractor_setDataSourceFd", &a.setDataSourceFd) &&
+               Resolve(library, "AMediaExtractor_getTrackCount", &a.getTrackCount) &&
+               Resolve(library, "AMediaExtractor_getTrackFormat", &a.getTrackFormat) &&
+               Resolve(library, "AMediaExtractor_selectTrack", &a.selectTrack) &&
+               Resolve(library, "AMediaExtractor_readSampleData", &a.readSampleData) &&
+               Resolve(library, "AMediaExtractor_getSampleTime", &a.getSampleTime) &&
+               Resolve(library, "AMediaExtractor_advance", &a.advance) &&
+               Resolve(library, "AMediaFormat_getString", &a.getString) &&
+               Resolve(library, "AMediaFormat_getInt32", &a.getInt32) &&
+               Resolve(library, "AMediaFormat_getInt64", &a.getInt64) &&
+               Resolve(library, "AMediaFormat_delete", &a.deleteFormat) &&
+               Resolve(library, "AMediaCodec_createDecoderByType", &a.createDecoderByType) &&
+               Resolve(library, "AMediaCodec_configure", &a.configure) &&
+               Resolve(library, "AMediaCodec_start", &a.start) &&
+               Resolve(library, "AMediaCodec_stop", &a.stop) &&
+               Resolve(library, "AMediaCodec_delete", &a.deleteCodec) &&
+               Resolve(library, "AMediaCodec_dequeueInputBuffer", &a.dequeueInputBuffer) &&
+               Resolve(library, "AMediaCodec_getInputBuffer", &a.getInputBuffer) &&
+               Resolve(library, "AMediaCodec_queueInputBuffer", &a.queueInputBuffer) &&
+               Resolve(library, "AMediaCodec_dequeueOutputBuffer", &a.dequeueOutputBuffer) &&
+               Resolve(library, "AMediaCodec_getOutputBuffer", &a.getOutputBuffer) &&
+               Resolve(library, "AMediaCodec_getOutputFormat", &a.getOutputFormat) &&
+               Resolve(library, "AMediaCodec_releaseOutputBuffer", &a.releaseOutputBuffer);
+    return a;
+  }();
+  return api;
+}
+
+class MediaCodecSource : public PcmSource {
+ public:
+  explicit MediaCodecSource(int fd) : fd_(fd) {}
+
+  ~MediaCodecSource() override {
+    const MediaApi& api = Api();
+    if (codec_) {
+      if (started_) {
+        api.stop(codec_);
+      }
+      api.deleteCodec(codec_);
+    }
+    if (extractor_) {
+      api.deleteExtractor(extractor_);
+    }
+    close(fd_);
+  }
+
+  bool Open(int64_t offset, int64_t length, std::string* error) {
+    const MediaApi& api = Api();
+    if (length < 0) {
+      struct stat st;
+      if (fstat(fd_, &st) != 0 || st.st_size < offset) {
+        *error = "can't tell how long the file is";
+        return false;
+      }
+      length = st.st_size - offset;
+    }
+    extractor_ = api.newExtractor();
+    if (!extractor_ || api.setDataSourceFd(extractor_, fd_, offset, length) != AMEDIA_OK) {
+      *error = "not a container this device can read";
+      return false;
+    }
+
+    // The first audio track
+    AMediaFormat* format = nullptr;
+    const char* mime = nullptr;
+    size_t tracks = api.getTrackCount(extractor_);
+    for (size_t i = 0; i < tracks; i++) {
+      format = api.getTrackFormat(extractor_, i);
+      if (api.getString(format, "mime", &mime) && strncmp(mime, "audio/", 6) == 0) {
+        api.selectTrack(extractor_, i);
+        break;
+      }
+      api.deleteFormat(format);
+      format = nullptr;
+    }
+    if (!format) {
+      *error = "the file has no audio track";
+      return false;
+    }
+    int32_t rate = 0;
+    int32_t channels = 0;
+    int64_t duration_us = -1;
+    api.getInt32(format, "sample-rate", &rate);
+    api.getInt32(format, "channel-count", &channels);
+    api.getInt64(format, "durationUs", &duration_us);
+    codec_ = api.createDecoderByType(mime);
+    bool configured = codec_ && api.configure(codec_, format, nullptr, nullptr, 0) == AMEDIA_OK;
+    if (!codec_) {
+      *error = std::string("no decoder for ") + mime;
+    }
+    api.deleteFormat(format);
+    if (!configured) {
+      if (error->empty()) {
+        *error = "the decoder rejected the track";
+      }
+      return false;
+    }
+    if (api.start(codec_) != AMEDIA_OK) {
+      *error = "the decoder failed to start";
+      return false;
+    }
+    started_ = true;
+
+    // The output rate can differ from the track's (HE-AAC doubles it), so
+    // go by what the decoder says once it starts producing
+    info_.sample_rate = rate;
+    info_.channels = channels;
+    while (!output_format_known_ && !output_done_) {
+      if (!Pump()) {
+        *error = error_;
+        return false;
+      }
+    }
+    if (info_.sample_rate <= 0 || info_.channels <= 0) {
+      *error = "the decoder reported no output format";
+      return false;
+    }
+    if (duration_us > 0) {
+      info_.frames = duration_us * info_.sample_rate / 1000000;
+    }
+    return true;
+  }
+
+  size_t Read(float* out, size_t frames) override {
+    const size_t channels = static_cast<size_t>(info_.channels);
+    const size_t bytes_per_frame = BytesPerSample(output_format_) * channels;
+    size_t done = 0;
+    while (done < frames) {
+      size_t available = (pending_.size() - pending_offset_) / bytes_per_frame;
+      if (available > 0) {
+        size_t count = std::min(available, frames - done);
+        ToFloat(output_format_, pending_.data() + pending_offset_, out + done * channels, count * channels);
+        pending_offset_ += count * bytes_per_frame;
+        done += count;
+        continue;
+      }
+      if (output_done_ || !Pump()) {
+        break;
+      }
+    }
+    return done;
+  }
+
+ private:
+  // Moves one input buffer to the codec and takes one output buffer from
+  // it, if either is ready. Returns false on an error, with error_ set.
+  bool Pump() {
+    const MediaApi& api = Api();
+    bool progress = false;
+    if (!input_done_) {
+      ssize_t index = api.dequeueInputBuffer(codec_, kDequeueTimeoutUs);
+      if (index >= 0) {
+        size_t capacity = 0;
+        uint8_t* buffer = api.getInputBuffer(codec_, static_cast<size_t>(index), &capacity);
+        ssize_t size = buffer ? api.readSampleData(extractor_, buffer, capacity) : -1;
+        if (size < 0) {
+          api.queueInputBuffer(codec_, static_cast<size_t>(index), 0, 0, 0, AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+          input_done_ = true;
+        } else {
+          int64_t time_us = std::max<int64_t>(api.getSampleTime(extractor_), 0);
+          api.queueInputBuffer(codec_, static_cast<size_t>(index), 0, static_cast<size_t>(size),
+                               static_cast<uint64_t>(time_us), 0);
+          api.advance(extractor_);
+        }
+        progress = true;
+      }
+    }
+
+    AMediaCodecBufferInfo info;
+    ssize_t index = api.dequeueOutputBuffer(codec_, &info, input_done_ ? kDequeueTimeoutUs : 0);
+    if (index >= 0) {
+      size_t size = 0;
+      uint8_t* buffer = api.getOutputBuffer(codec_, static_cast<size_t>(index), &size);
+      // Keep what the last Read left over
+      pending_.erase(pending_.begin(), pending_.begin() + pending_offset_);
+      pending_offset_ = 0;
+      if (buffer && info.size > 0 && static_cast<size_t>(info.offset) + info.size <= size) {
+        pending_.insert(pending_.end(), buffer + info.offset, buffer + info.offset + info.size);
+      }
+      api.releaseOutputBuffer(codec_, static_cast<size_t>(index), false);
+      if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) {
+        output_done_ = true;
+      }
+      output_format_known_ = true;
+      progress = true;
+    } else if (index == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+      if (!ReadOutputFormat()) {
+        return false;
+      }
+      progress = true;
+    } else if (index == AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED) {
+      progress = true;
+    } else if (index != AMEDIACODEC_INFO_TRY_AGAIN_LATER) {
+      error_ = "decoding failed (" + std::to_string(index) + ")";
+      return false;
+    }
+
+    idle_passes_ = progress ? 0 : idle_passes_ + 1;
+    if (idle_passes_ > kMaxIdlePasses) {
+      error_ = "the decoder stopped producing output";
+      return false;
+    }
+    return true;
+  }
+
+  bool ReadOutputFormat() {
+    const MediaApi& api = Api();
+    AMediaFormat* format = api.getOutputFormat(codec_);
+    if (!format) {
+      return true;
+    }
+    int32_t rate = 0;
+    int32_t channels = 0;
+    int32_t encoding = 0;
+    api.getInt32(format, "sample-rate", &rate);
+    api.getInt32(format, "channel-count", &channels);
+    bool has_encoding = api.getInt32(format, "pcm-encoding", &encoding);
+    api.deleteFormat(format);
+
+    SampleFormat output_format = has_encoding && encoding == kEncodingPcmFloat ? SampleFormat::kF32 : SampleFormat::kS16;
+    if (output_format_known_ &&
+        (rate != info_.sample_rate || channels != info_.channels || output_format != output_format_)) {
+      // The FilePlayer is set up for one format for the whole file
+      error_ = "the decoder changed format mid-stream";
+      return false;
+    }
+    if (rate > 0) {
+      info_.sample_rate = rate;
+    }
+    if (channels > 0) {
+      info_.channels = channels;
+    }
+    output_format_ = output_format;
+    output_format_known_ = true;
+    return true;
+  }
+
+  int fd_;
+  AMediaExtractor* extractor_ = nullptr;
+  AMediaCodec* codec_ = nullptr;
+  bool started_ = false;
+  bool input_done_ = false;
+  bool output_done_ = false;
+  bool output_format_known_ = false;
+  int idle_passes_ = 0;
+  SampleFormat output_format_ = SampleFormat::kS16;
+  // Decoded bytes not read yet, from pending_offset_ on
+  std::vector<uint8_t> pending_;
+  size_t pending_offset_ = 0;
+};
+
+}  // namespace
+
+std::unique_ptr<PcmSource> OpenMediaCodecSource(int fd, int64_t offset, int64_t length, std::string* error) {
+  if (!Api().loaded) {
+    close(fd);
+    *error = "this device has no media decoder API";
+    return nullptr;
+  }
+  auto source = std::make_unique<MediaCodecSource>(fd);
+  if (!source->Open(offset, length, error)) {
+    return nullptr;
+  }
+  return source;
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,24 @@
+#ifndef FLUTTER_PLUGIN_MEDIA_CODEC_SOURCE_H_
+#define FLUTTER_PLUGIN_MEDIA_CODEC_SOURCE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "pcm_file_source.h"
+
+namespace flutter_pcm_sound {
+
+// Decodes the first audio track of a file with the platform's
+// AMediaExtractor and AMediaCodec: MP3, AAC, FLAC, Opus, Vorbis, whatever
+// the device has a decoder for.
+//
+// Takes ownership of `fd` and reads `length` bytes of it from `offset`, or
+// everything after it when `length` is negative, as for an asset file
+// descriptor. Returns null with `error` set when the file can't be decoded
+// or the device has no libmediandk.so (API levels below 21).
+std::unique_ptr<PcmSource> OpenMediaCodecSource(int fd, int64_t offset, int64_t length, std::string* error);
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_MEDIA_CODEC_SOURCE_H_
@@ -1,6 +1,8 @@
 package com.lib.flutter_pcm_sound;
 
 import android.content.Context;
+import android.content.res.AssetFileDescriptor;
+import android.net.Uri;
 import android.media.AudioAttributes;
 import android.media.AudioFormat;
 import android.media.AudioManager;
@@ -10,7 +12,6 @@ import android.os.Build;
 import android.os.Handler;
 import android.os.Looper;
 import android.os.Process;
-import android.os.SystemClock;
 
 import androidx.annotation.NonNull;
 
@@ -19,6 +20,8 @@ import java.util.HashMap;
 import java.util.List;
 import java.util.ArrayList;
 import java.util.concurrent.LinkedBlockingQueue;
+import java.util.concurrent.atomic.AtomicLong;
+import java.io.IOException;
 import java.io.StringWriter;
 import java.io.PrintWriter;
 import java.nio.ByteBuffer;
@@ -31,6 +34,10 @@ import io.flutter.plugin.common.MethodChannel;
 /**
  * FlutterPcmSoundPlugin implements a "one pedal" PCM sound playback mechanism.
  * Playback starts automatically when samples are fed and stops when no more samples are available.
+ *
+ * On Android 8 (API 26) and up, samples go to an AAudio stream in
+ * libflutter_pcm_sound.so, built on the same native core as the desktop
+ * backends. Older devices use an AudioTrack fed from a playback thread.
  */
 public class FlutterPcmSoundPlugin implements
     FlutterPlugin,
@@ -38,6 +45,30 @@ public class FlutterPcmSoundPlugin implements
 {
     private static final String CHANNEL_NAME = "flutter_pcm_sound/methods";
     private static final int MAX_FRAMES_PER_BUFFER = 200;
+    private static final String[] FORMAT_NAMES = {"s16le", "s24le", "s32le", "f32le"};
+    // PcmFeedPolicy, in the order of the native FeedPolicy enum
+    private static final String[] FEED_POLICY_NAMES = {"partial", "reject", "block"};
+    private static final int FEED_PARTIAL = 0;
+    private static final int FEED_REJECT = 1;
+    private static final long DEFAULT_MAX_QUEUE_US = 10000000;
+
+    // false if the native library couldn't be loaded, e.g. on an ABI it
+    // wasn't built for. AudioTrack still works then
+    private static final boolean sNativeLoaded = loadNativeLibrary();
+
+    private static boolean loadNativeLibrary() {
+        try {
+            System.loadLibrary("flutter_pcm_sound");
+            return true;
+        } catch (UnsatisfiedLinkError e) {
+            return false;
+        }
+    }
+
+    // the native engine, or 0 when AudioTrack is used instead
+    private long mNativeHandle = 0;
+    private boolean mUseNative = false;
+    private int mSampleRate;
 
     private MethodChannel mMethodChannel;
     private Handler mainThreadHandler = new Handler(Looper.getMainLooper());
@@ -46,6 +77,7 @@ public class FlutterPcmSoundPlugin implements
 
     private AudioTrack mAudioTrack;
     private int mNumChannels;
+    private int mBytesPerFrame;
     private int mMinBufferSize;
     private boolean mDidSetup = false;
 
@@ -58,8 +90,18 @@ public class FlutterPcmSoundPlugin implements
     private long mFeedThreshold = 8000;
     private volatile boolean mDidInvokeFeedCallback = false;
 
-    // Thread-safe queue for storing audio samples
+    // Thread-safe queue for storing audio samples. mQueuedBytes is what it
+    // holds; feed keeps it under mMaxQueueBytes by mFeedPolicy
     private final LinkedBlockingQueue<ByteBuffer> mSamples = new LinkedBlockingQueue<>();
+    private final AtomicLong mQueuedBytes = new AtomicLong();
+    private long mMaxQueueBytes;
+    private int mFeedPolicy = FEED_PARTIAL;
+
+    // flush bumps the generation so the playback thread drops the chunk it
+    // is writing. while paused, the playback thread waits on mPauseLock
+    private volatile long mFlushGeneration = 0;
+    private volatile boolean mPaused = false;
+    private final Object mPauseLock = new Object();
 
     // Log level enum (kept for potential future use)
     private enum LogLevel {
@@ -79,12 +121,21 @@ public class FlutterPcmSoundPlugin implements
 
         this.context = binding.getApplicationContext();
         this.audioManager = (AudioManager) context.getSystemService(Context.AUDIO_SERVICE);
+
+        // on the main thread, whose looper delivers the engine's feed requests
+        if (Build.VERSION.SDK_INT >= 26 && sNativeLoaded && nativeIsSupported()) {
+            mNativeHandle = nativeCreate();
+        }
     }
 
     @Override
     public void onDetachedFromEngine(@NonNull FlutterPluginBinding binding) {
         mMethodChannel.setMethodCallHandler(null);
         cleanup();
+        if (mNativeHandle != 0) {
+            nativeDestroy(mNativeHandle);
+            mNativeHandle = 0;
+        }
     }
 
     @Override
@@ -106,103 +157,87 @@ public class FlutterPcmSoundPlugin implements
                     }
 
                     int sampleRate = sampleRateObj;
+                    mSampleRate = sampleRate;
                     mNumChannels = numChannelsObj;
+                    String sampleFormat = call.argument("sample_format");
+                    String feedPolicy = call.argument("feed_policy");
+                    int feedPolicyIndex = feedPolicyIndex(feedPolicy);
+                    if (feedPolicyIndex < 0) {
+                        result.error("InvalidArguments", "feed_policy " + feedPolicy + " is not supported.", null);
+                        return;
+                    }
+                    Number maxQueueUsObj = call.argument("max_queue_us");
+                    long maxQueueUs = maxQueueUsObj != null && maxQueueUsObj.longValue() > 0
+                        ? maxQueueUsObj.longValue() : DEFAULT_MAX_QUEUE_US;
 
                     // Cleanup existing resources if any
-                    if (mAudioTrack != null) {
+                    if (mDidSetup || mAudioTrack != null) {
                         cleanup();
                     }
 
-                    int channelConfig = (mNumChannels == 2) ?
-                        AudioFormat.CHANNEL_OUT_STEREO :
-                        AudioFormat.CHANNEL_OUT_MONO;
-
-                    mMinBufferSize = AudioTrack.getMinBufferSize(
-                        sampleRate, channelConfig, AudioFormat.ENCODING_PCM_16BIT);
-
-                    if (mMinBufferSize == AudioTrack.ERROR || mMinBufferSize == AudioTrack.ERROR_BAD_VALUE) {
-                        result.error("AudioTrackError", "Invalid buffer size.", null);
-                        return;
-                    }
-
-                    if (Build.VERSION.SDK_INT >= 23) { // Android 6 (Marshmallow) and above
-                        mAudioTrack = new AudioTrack.Builder()
-                            .setAudioAttributes(new AudioAttributes.Builder()
-                                    .setUsage(AudioAttributes.USAGE_ASSISTANT)
-                                    .setContentType(AudioAttributes.CONTENT_TYPE_SPEECH)
-                                    .build())
-                            .setAudioFormat(new AudioFormat.Builder()
-                                    .setEncoding(AudioFormat.ENCODING_PCM_16BIT)
-                                    .setSampleRate(sampleRate)
-                                    .setChannelMask(channelConfig)
-                                    .build())
-                            .setBufferSizeInBytes(mMinBufferSize)
-                            .setTransferMode(AudioTrack.MODE_STREAM)
-                            .build();
+                    Map<String, Object> response;
+                    if (mNativeHandle != 0) {
+                        int formatIndex = nativeFormatIndex(sampleFormat);
+                        if (formatIndex < 0) {
+                            result.error("InvalidArguments", "sample_format " + sampleFormat + " is not supported.", null);
+                            return;
+                        }
+                        mBytesPerFrame = mNumChannels * (formatIndex == 0 ? 2 : 4);
+                        boolean lowLatency = "lowLatency".equals(call.argument("latency_profile"));
+                        Boolean exclusive = call.argument("exclusive_mode");
+                        String error = nativeSetup(mNativeHandle, sampleRate, mNumChannels, formatIndex,
+                            lowLatency, exclusive != null && exclusive,
+                            resampleQualityIndex(call.argument("resample_quality")), maxQueueUs, feedPolicyIndex);
+                        if (error != null) {
+                            result.error("AAudioError", error, null);
+                            return;
+                        }
+                        mUseNative = true;
+                        response = nativeSetupResponse(sampleFormat);
                     } else {
-                        mAudioTrack = new AudioTrack(
-                            AudioManager.STREAM_MUSIC,
-                            sampleRate,
-                            channelConfig,
-                            AudioFormat.ENCODING_PCM_16BIT,
-                            mMinBufferSize,
-                            AudioTrack.MODE_STREAM);
+                        int encoding = audioTrackEncoding(sampleFormat);
+                        if (encoding < 0) {
+                            result.error("InvalidArguments", "sample_format " + sampleFormat + " is not supported on this device.", null);
+                            return;
+                        }
+                        String error = setupAudioTrack(sampleRate, encoding);
+                        if (error != null) {
+                            result.error("AudioTrackError", error, null);
+                            return;
+                        }
+                        mUseNative = false;
+                        response = new HashMap<>();
+                        response.put("sample_rate", sampleRate);
+                        response.put("num_channels", mNumChannels);
+                        response.put("sample_format", sampleFormat == null ? "s16le" : sampleFormat);
+                        response.put("buffer_frames", mMinBufferSize / mBytesPerFrame);
+                        mMaxQueueBytes = Math.max(maxQueueUs * sampleRate / 1000000, 1) * mBytesPerFrame;
+                        mFeedPolicy = feedPolicyIndex;
+                        response.put("max_queue_frames", mMaxQueueBytes / mBytesPerFrame);
+                        response.put("feed_policy", FEED_POLICY_NAMES[feedPolicyIndex]);
+                        response.put("audio_api", "audioTrack");
+                        response.put("ffi_feed", false);
                     }
 
-                    if (mAudioTrack.getState() != AudioTrack.STATE_INITIALIZED) {
-                        result.error("AudioTrackError", "AudioTrack initialization failed.", null);
-                        mAudioTrack.release();
-                        mAudioTrack = null;
+                    mDidInvokeFeedCallback = false;
+                    mPaused = false;
+
+                    if (!requestAudioFocus()) {
+                        result.error("AudioFocusError", "Could not get audio focus.", null);
                         return;
                     }
 
-                    mSamples.clear();
-                    mDidInvokeFeedCallback = false;
-                    mShouldCleanup = false;
-
-                    // Request audio focus for ducking
-                    if (audioManager != null) {
-                        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
-                            playbackAttributes = new AudioAttributes.Builder()
-                                    .setUsage(AudioAttributes.USAGE_ASSISTANT)
-                                    .setContentType(AudioAttributes.CONTENT_TYPE_SPEECH)
-                                    .build();
-
-                            focusRequest = new AudioFocusRequest.Builder(AudioManager.AUDIOFOCUS_GAIN_TRANSIENT_MAY_DUCK)
-                                    .setAudioAttributes(playbackAttributes)
-                                    .setOnAudioFocusChangeListener(focusChange -> {
-                                        // handle audio focus changes if needed
-                                    })
-                                    .build();
-
-                            int focusResult = audioManager.requestAudioFocus(focusRequest);
-                            if (focusResult != AudioManager.AUDIOFOCUS_REQUEST_GRANTED) {
-                                result.error("AudioFocusError", "Could not get audio focus.", null);
-                                return;
-                            }
-                        } else {
-                            int focusResult = audioManager.requestAudioFocus(
-                                    focusChange -> {
-                                        // handle focus changes if needed
-                                    },
-                                    AudioManager.STREAM_MUSIC,
-                                    AudioManager.AUDIOFOCUS_GAIN_TRANSIENT_MAY_DUCK
-                            );
-                            if (focusResult != AudioManager.AUDIOFOCUS_REQUEST_GRANTED) {
-                                result.error("AudioFocusError", "Could not get audio focus.", null);
-                                return;
-                            }
-                        }
+                    if (!mUseNative) {
+                        // Start playback thread
+                        mShouldCleanup = false;
+                        playbackThread = new Thread(this::playbackThreadLoop, "PCMPlaybackThread");
+                        playbackThread.setPriority(Thread.MAX_PRIORITY);
+                        playbackThread.start();
                     }
 
-                    // Start playback thread
-                    playbackThread = new Thread(this::playbackThreadLoop, "PCMPlaybackThread");
-                    playbackThread.setPriority(Thread.MAX_PRIORITY);
-                    playbackThread.start();
-
                     mDidSetup = true;
 
-                    result.success(true);
+                    result.success(response);
                     break;
                 }
                 case "feed": {
@@ -220,22 +255,154 @@ public class FlutterPcmSoundPlugin implements
                         return;
                     }
 
-                    // Split for better performance
-                    List<ByteBuffer> chunks = split(buffer, MAX_FRAMES_PER_BUFFER);
-
-                    // Push to mSamples
-                    for (ByteBuffer chunk : chunks) {
-                        mSamples.put(chunk);
+                    // both paths answer with how many frames were accepted,
+                    // so producers can back off
+                    if (mUseNative) {
+                        int written = nativeFeed(mNativeHandle, buffer);
+                        if (written < 0) {
+                            result.error("Setup", "must call setup first", null);
+                            return;
+                        }
+                        result.success(written / mBytesPerFrame);
+                        break;
                     }
 
+                    int accepted = queueSamples(buffer);
+
                     // Reset the feed callback flag
                     mDidInvokeFeedCallback = false;
 
+                    result.success(accepted / mBytesPerFrame);
+                    break;
+                }
+                case "flush": {
+                    if (mDidSetup == false) {
+                        result.error("Setup", "must call setup first", null);
+                        return;
+                    }
+                    if (mUseNative) {
+                        nativeFlush(mNativeHandle);
+                    } else {
+                        flush();
+                    }
+                    result.success(true);
+                    break;
+                }
+                case "pause": {
+                    if (mDidSetup == false) {
+                        result.error("Setup", "must call setup first", null);
+                        return;
+                    }
+                    mPaused = true;
+                    if (mUseNative) {
+                        nativePause(mNativeHandle);
+                    } else {
+                        mAudioTrack.pause();
+                    }
+                    result.success(true);
+                    break;
+                }
+                case "resume": {
+                    if (mDidSetup == false) {
+                        result.error("Setup", "must call setup first", null);
+                        return;
+                    }
+                    if (mUseNative) {
+                        mPaused = false;
+                        nativeResume(mNativeHandle);
+                        result.success(true);
+                        break;
+                    }
+                    synchronized (mPauseLock) {
+                        mPaused = false;
+                        mAudioTrack.play();
+                        mPauseLock.notifyAll();
+                    }
+                    result.success(true);
+                    break;
+                }
+                case "playFile": {
+                    if (!mUseNative) {
+                        result.error("Setup", "playFile needs the AAudio backend (Android 8+)", null);
+                        return;
+                    }
+                    String path = call.argument("path");
+                    if (path == null) {
+                        result.error("InvalidArguments", "path required", null);
+                        return;
+                    }
+                    int rawRate = 0;
+                    int rawChannels = 0;
+                    int rawFormat = -1;
+                    Map<String, Object> raw = call.argument("raw");
+                    if (raw != null) {
+                        rawRate = ((Number) raw.get("sample_rate")).intValue();
+                        rawChannels = ((Number) raw.get("num_channels")).intValue();
+                        rawFormat = nativeFormatIndex((String) raw.get("sample_format"));
+                        if (rawFormat < 0) {
+                            result.error("InvalidArguments", "unknown raw sample_format", null);
+                            return;
+                        }
+                    }
+                    String error = nativePlayFile(mNativeHandle, path, rawRate, rawChannels, rawFormat);
+                    if (error != null) {
+                        result.error("FileError", error, null);
+                        return;
+                    }
+                    result.success(nativeFileResponse());
+                    break;
+                }
+                case "playUri": {
+                    if (!mUseNative) {
+                        result.error("Setup", "playUri needs the AAudio backend (Android 8+)", null);
+                        return;
+                    }
+                    String uri = call.argument("uri");
+                    if (uri == null) {
+                        result.error("InvalidArguments", "uri required", null);
+                        return;
+                    }
+                    // content:// and android.resource:// go through the
+                    // resolver; the native side reads the descriptor itself
+                    AssetFileDescriptor afd;
+                    try {
+                        afd = context.getContentResolver().openAssetFileDescriptor(Uri.parse(uri), "r");
+                    } catch (IOException | SecurityException e) {
+                        result.error("FileError", e.getMessage(), null);
+                        return;
+                    }
+                    if (afd == null) {
+                        result.error("FileError", "no provider for " + uri, null);
+                        return;
+                    }
+                    long offset = afd.getStartOffset();
+                    long length = afd.getDeclaredLength();
+                    int fd = afd.getParcelFileDescriptor().detachFd();
+                    try {
+                        afd.close();
+                    } catch (IOException e) {
+                        // the descriptor is detached; nothing left to close
+                    }
+                    String error = nativePlayFd(mNativeHandle, uri, fd, offset, length);
+                    if (error != null) {
+                        result.error("FileError", error, null);
+                        return;
+                    }
+                    result.success(nativeFileResponse());
+                    break;
+                }
+                case "stopFile": {
+                    if (mUseNative) {
+                        nativeStopFile(mNativeHandle);
+                    }
                     result.success(true);
                     break;
                 }
                 case "setFeedThreshold": {
                     mFeedThreshold = ((Number) call.argument("feed_threshold")).longValue();
+                    if (mNativeHandle != 0) {
+                        nativeSetFeedThreshold(mNativeHandle, mFeedThreshold);
+                    }
                     result.success(true);
                     break;
                 }
@@ -260,11 +427,221 @@ public class FlutterPcmSoundPlugin implements
         }
     }
 
+    /**
+     * The AudioTrack encoding for a sample_format, or -1 if this device has
+     * none. Samples are passed to AudioTrack in the format they were fed in.
+     */
+    private static int audioTrackEncoding(String sampleFormat) {
+        if (sampleFormat == null || sampleFormat.equals("s16le")) {
+            return AudioFormat.ENCODING_PCM_16BIT;
+        } else if (sampleFormat.equals("f32le") && Build.VERSION.SDK_INT >= 21) {
+            return AudioFormat.ENCODING_PCM_FLOAT;
+        } else if (sampleFormat.equals("s32le") && Build.VERSION.SDK_INT >= 31) {
+            return AudioFormat.ENCODING_PCM_32BIT;
+        }
+        // s24le (24 bits in a 32-bit container) has no AudioTrack encoding
+        return -1;
+    }
+
+    /**
+     * Creates the AudioTrack for devices without AAudio. Returns null on
+     * success, otherwise what went wrong.
+     */
+    @SuppressWarnings("deprecation") // Needed for compatibility with Android < 23
+    private String setupAudioTrack(int sampleRate, int encoding) {
+        int bytesPerSample = encoding == AudioFormat.ENCODING_PCM_16BIT ? 2 : 4;
+        mBytesPerFrame = mNumChannels * bytesPerSample;
+
+        int channelConfig = (mNumChannels == 2) ?
+            AudioFormat.CHANNEL_OUT_STEREO :
+            AudioFormat.CHANNEL_OUT_MONO;
+
+        mMinBufferSize = AudioTrack.getMinBufferSize(
+            sampleRate, channelConfig, encoding);
+
+        if (mMinBufferSize == AudioTrack.ERROR || mMinBufferSize == AudioTrack.ERROR_BAD_VALUE) {
+            return "Invalid buffer size.";
+        }
+
+        if (Build.VERSION.SDK_INT >= 23) { // Android 6 (Marshmallow) and above
+            mAudioTrack = new AudioTrack.Builder()
+                .setAudioAttributes(new AudioAttributes.Builder()
+                        .setUsage(AudioAttributes.USAGE_ASSISTANT)
+                        .setContentType(AudioAttributes.CONTENT_TYPE_SPEECH)
+                        .build())
+                .setAudioFormat(new AudioFormat.Builder()
+                        .setEncoding(encoding)
+                        .setSampleRate(sampleRate)
+                        .setChannelMask(channelConfig)
+                        .build())
+                .setBufferSizeInBytes(mMinBufferSize)
+                .setTransferMode(AudioTrack.MODE_STREAM)
+                .build();
+        } else {
+            mAudioTrack = new AudioTrack(
+                AudioManager.STREAM_MUSIC,
+                sampleRate,
+                channelConfig,
+                encoding,
+                mMinBufferSize,
+                AudioTrack.MODE_STREAM);
+        }
+
+        if (mAudioTrack.getState() != AudioTrack.STATE_INITIALIZED) {
+            mAudioTrack.release();
+            mAudioTrack = null;
+            return "AudioTrack initialization failed.";
+        }
+
+        mSamples.clear();
+        mQueuedBytes.set(0);
+        return null;
+    }
+
+    /**
+     * Queues the whole frames of `buffer` that the feed policy lets in and
+     * returns how many bytes that was. Feeds come in on the platform thread
+     * here, which must never wait, so block takes what fits like partial.
+     */
+    private int queueSamples(byte[] buffer) {
+        int length = buffer.length / mBytesPerFrame * mBytesPerFrame;
+        long room = (mMaxQueueBytes - mQueuedBytes.get()) / mBytesPerFrame * mBytesPerFrame;
+        if (mFeedPolicy == FEED_REJECT && room < length) {
+            return 0;
+        }
+        int take = (int) Math.min(length, Math.max(room, 0));
+        if (take > 0) {
+            // Split for better performance
+            mQueuedBytes.addAndGet(take);
+            for (ByteBuffer chunk : split(buffer, 0, take, MAX_FRAMES_PER_BUFFER)) {
+                mSamples.put(chunk);
+            }
+        }
+        return take;
+    }
+
+    /**
+     * Request audio focus for ducking.
+     */
+    @SuppressWarnings("deprecation") // Needed for compatibility with Android < 26
+    private boolean requestAudioFocus() {
+        if (audioManager != null) {
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+                playbackAttributes = new AudioAttributes.Builder()
+                        .setUsage(AudioAttributes.USAGE_ASSISTANT)
+                        .setContentType(AudioAttributes.CONTENT_TYPE_SPEECH)
+                        .build();
+
+                focusRequest = new AudioFocusRequest.Builder(AudioManager.AUDIOFOCUS_GAIN_TRANSIENT_MAY_DUCK)
+                        .setAudioAttributes(playbackAttributes)
+                        .setOnAudioFocusChangeListener(focusChange -> {
+                            // handle audio focus changes if needed
+                        })
+                        .build();
+
+                int focusResult = audioManager.requestAudioFocus(focusRequest);
+                if (focusResult != AudioManager.AUDIOFOCUS_REQUEST_GRANTED) {
+                    return false;
+                }
+            } else {
+                int focusResult = audioManager.requestAudioFocus(
+                        focusChange -> {
+                            // handle focus changes if needed
+                        },
+                        AudioManager.STREAM_MUSIC,
+                        AudioManager.AUDIOFOCUS_GAIN_TRANSIENT_MAY_DUCK
+                );
+                if (focusResult != AudioManager.AUDIOFOCUS_REQUEST_GRANTED) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * The native SampleFormat for a sample_format, or -1 if unknown. In the
+     * order of Dart's PcmFormat.
+     */
+    private static int nativeFormatIndex(String sampleFormat) {
+        if (sampleFormat == null) {
+            return 0;
+        }
+        for (int i = 0; i < FORMAT_NAMES.length; i++) {
+            if (FORMAT_NAMES[i].equals(sampleFormat)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    private static int feedPolicyIndex(String policy) {
+        if (policy == null) {
+            return FEED_PARTIAL;
+        }
+        for (int i = 0; i < FEED_POLICY_NAMES.length; i++) {
+            if (FEED_POLICY_NAMES[i].equals(policy)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    private static int resampleQualityIndex(String quality) {
+        if ("low".equals(quality)) {
+            return 0;
+        } else if ("high".equals(quality)) {
+            return 2;
+        }
+        return 1;
+    }
+
+    /**
+     * The result of an AAudio setup, in the keys the desktop backends use.
+     */
+    private Map<String, Object> nativeSetupResponse(String sampleFormat) {
+        long[] info = nativeStreamInfo(mNativeHandle);
+        Map<String, Object> response = new HashMap<>();
+        response.put("stream_id", 0);
+        response.put("sample_rate", mSampleRate);
+        response.put("num_channels", mNumChannels);
+        response.put("sample_format", sampleFormat == null ? "s16le" : sampleFormat);
+        response.put("device_sample_format", FORMAT_NAMES[(int) info[0]]);
+        response.put("device_channels", (int) info[1]);
+        response.put("device_sample_rate", (int) info[2]);
+        response.put("exclusive_mode", info[3] != 0);
+        response.put("latency_profile", info[4] != 0 ? "lowLatency" : "standard");
+        response.put("buffer_frames", (int) info[5]);
+        response.put("period_frames", (int) info[6]);
+        response.put("audio_api", "aaudio");
+        response.put("ffi_feed", true);
+        return response;
+    }
+
+    /**
+     * What playFile or playUri opened, in the keys the other backends use.
+     */
+    private Map<String, Object> nativeFileResponse() {
+        long[] info = nativeFileInfo(mNativeHandle);
+        Map<String, Object> response = new HashMap<>();
+        response.put("sample_rate", (int) info[0]);
+        response.put("num_channels", (int) info[1]);
+        if (info[2] >= 0 && info[0] > 0) {
+            response.put("duration_us", info[2] * 1000000 / info[0]);
+        }
+        return response;
+    }
 
     /**
      * Cleans up resources by stopping the playback thread and releasing AudioTrack.
      */
     private void cleanup() {
+        if (mUseNative) {
+            nativeRelease(mNativeHandle);
+            mUseNative = false;
+            mDidSetup = false;
+        }
+
         // stop playback thread
         if (playbackThread != null) {
             mShouldCleanup = true;
@@ -293,15 +670,33 @@ public class FlutterPcmSoundPlugin implements
         }
     }
 
+    /**
+     * Drops everything queued and what AudioTrack holds, keeping the track
+     * and the playback thread. Pausing first makes a blocked write return.
+     */
+    private void flush() {
+        synchronized (mPauseLock) {
+            mFlushGeneration++;
+            List<ByteBuffer> dropped = new ArrayList<>();
+            mSamples.drainTo(dropped);
+            for (ByteBuffer chunk : dropped) {
+                mQueuedBytes.addAndGet(-chunk.remaining());
+            }
+            mAudioTrack.pause();
+            mAudioTrack.flush();
+            if (!mPaused) {
+                mAudioTrack.play();
+            }
+            // a paused playback thread lets go of its chunk too
+            mPauseLock.notifyAll();
+        }
+    }
+
     /**
      * Calculates the number of remaining frames in the sample buffer.
      */
     private long mRemainingFrames() {
-        long totalBytes = 0;
-        for (ByteBuffer sampleBuffer : mSamples) {
-            totalBytes += sampleBuffer.remaining();
-        }
-        return totalBytes / (2 * mNumChannels); // 16-bit PCM
+        return mQueuedBytes.get() / mBytesPerFrame;
     }
 
     /**
@@ -328,13 +723,33 @@ public class FlutterPcmSoundPlugin implements
             try {
                 // blocks indefinitely until new data
                 data = mSamples.take();
+                mQueuedBytes.addAndGet(-data.remaining());
             } catch (InterruptedException e) {
                 Thread.currentThread().interrupt();
                 continue;
             }
 
-            // write
-            mAudioTrack.write(data, data.remaining(), AudioTrack.WRITE_BLOCKING);
+            // write. a pause cuts a blocking write short, so finish the
+            // chunk after resume unless it was flushed meanwhile
+            long generation = mFlushGeneration;
+            while (data.hasRemaining() && !mShouldCleanup && generation == mFlushGeneration) {
+                if (mPaused) {
+                    synchronized (mPauseLock) {
+                        while (mPaused && !mShouldCleanup && generation == mFlushGeneration) {
+                            try {
+                                mPauseLock.wait();
+                            } catch (InterruptedException e) {
+                                Thread.currentThread().interrupt();
+                                break;
+                            }
+                        }
+                    }
+                    continue;
+                }
+                if (mAudioTrack.write(data, data.remaining(), AudioTrack.WRITE_BLOCKING) < 0) {
+                    break;
+                }
+            }
 
             // invoke feed callback?
             if (mRemainingFrames() <= mFeedThreshold && !mDidInvokeFeedCallback) {
@@ -350,11 +765,59 @@ public class FlutterPcmSoundPlugin implements
     }
 
 
-    private List<ByteBuffer> split(byte[] buffer, int maxSize) {
+    /**
+     * Called by the native engine on the main thread when its queue drops
+     * to the feed threshold. Frame counts are at the setup sample rate.
+     */
+    @SuppressWarnings("unused") // called from JNI
+    private void onNativeFeedRequest(long remainingFrames, long requestedFrames) {
+        if (!mDidSetup) {
+            return;
+        }
+        Map<String, Object> response = new HashMap<>();
+        response.put("remaining_frames", remainingFrames);
+        response.put("remaining_us", mSampleRate > 0 ? remainingFrames * 1000000 / mSampleRate : 0);
+        response.put("requested_frames", requestedFrames);
+        response.put("requested_bytes", requestedFrames * mBytesPerFrame);
+        mMethodChannel.invokeMethod("OnFeedSamples", response);
+    }
+
+    /**
+     * Called by the native engine on the main thread once a file is fully
+     * queued, or failed to decode. error is null on success.
+     */
+    @SuppressWarnings("unused") // called from JNI
+    private void onNativeFileDone(String path, String error) {
+        Map<String, Object> response = new HashMap<>();
+        response.put("path", path);
+        if (error != null) {
+            response.put("error", error);
+        }
+        mMethodChannel.invokeMethod("OnFileDone", response);
+    }
+
+    private static native boolean nativeIsSupported();
+    private native long nativeCreate();
+    private native void nativeDestroy(long handle);
+    private native String nativeSetup(long handle, int sampleRate, int numChannels, int sampleFormat,
+        boolean lowLatency, boolean exclusive, int resampleQuality, long maxQueueUs, int feedPolicy);
+    private native long[] nativeStreamInfo(long handle);
+    private native int nativeFeed(long handle, byte[] buffer);
+    private native String nativePlayFile(long handle, String path, int rawRate, int rawChannels, int rawFormat);
+    private native String nativePlayFd(long handle, String uri, int fd, long offset, long length);
+    private native long[] nativeFileInfo(long handle);
+    private native void nativeStopFile(long handle);
+    private native void nativeSetFeedThreshold(long handle, long frames);
+    private native void nativeFlush(long handle);
+    private native void nativePause(long handle);
+    private native void nativeResume(long handle);
+    private native void nativeRelease(long handle);
+
+    private List<ByteBuffer> split(byte[] buffer, int offset, int size, int maxSize) {
         List<ByteBuffer> chunks = new ArrayList<>();
-        int offset = 0;
-        while (offset < buffer.length) {
-            int length = Math.min(buffer.length - offset, maxSize);
+        int end = offset + size;
+        while (offset < end) {
+            int length = Math.min(end - offset, maxSize);
             ByteBuffer b = ByteBuffer.wrap(buffer, offset, length);
             chunks.add(b);
             offset += length;
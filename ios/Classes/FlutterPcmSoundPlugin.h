@@ -9,3 +9,8 @@
 
 @interface FlutterPcmSoundPlugin : NSObject<FlutterPlugin>
 @end
+
+// Queues `length` bytes of samples, in the format passed to setup,
+// without going through the method channel. Called from Dart via FFI.
+// Returns the number of bytes queued, or -1 if setup hasn't been called.
+FOUNDATION_EXPORT int64_t flutter_pcm_sound_ffi_feed(const uint8_t *data, int64_t length);
@@ -0,0 +1,1536 @@
+#import "FlutterPcmSoundPlugin.h"
+#import <AudioToolbox/AudioToolbox.h>
+#include <mach/mach_time.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "core/pcm_clip_bank.h"
+#include "core/pcm_feed_policy.h"
+#include "core/pcm_file_player.h"
+#include "core/pcm_file_source.h"
+#include "core/pcm_mixer.h"
+#include "core/pcm_ring_buffer.h"
+#include "core/pcm_stats.h"
+#include "core/pcm_trace.h"
+
+#if TARGET_OS_IOS
+#import <AVFoundation/AVFoundation.h>
+#endif
+
+#define kOutputBus 0
+#define NAMESPACE @"flutter_pcm_sound"
+
+// Frames of output converted to float at a time to mix clips into
+#define CLIP_MIX_FRAMES 1024
+
+// Bits the render thread ORs into the render event source
+enum {
+    kRenderEventFeed = 1 << 0,  // the queue is at or below the feed threshold
+    kRenderEventEmpty = 1 << 1, // the queue ran dry
+};
+
+typedef NS_ENUM(NSUInteger, LogLevel) {
+    none = 0,
+    error = 1,
+    standard = 2,
+    verbose = 3,
+};
+
+@interface FlutterPcmSoundPlugin ()
+@property(nonatomic) NSObject<FlutterPluginRegistrar> *registrar;
+@property(nonatomic) FlutterMethodChannel *mMethodChannel;
+@property(nonatomic) LogLevel mLogLevel;
+@property(nonatomic) AudioComponentInstance mAudioUnit;
+@property(nonatomic) int mNumChannels; 
+@property(nonatomic) int mBytesPerFrame; 
+@property(nonatomic) int mSampleRate;
+@property(nonatomic) bool mDidSetup; 
+
+// We’ll track the chosen audio category to know if we should override the speaker
+@property(nonatomic, copy) NSString *chosenCategory;
+
+// The registered instance is output 0. openOutput makes more instances,
+// one per device, each with its own unit and queue; the registered one
+// forwards calls carrying their output_id to them and owns them in
+// mOutputs (nil on the others). What outputs send carries their id.
+@property(nonatomic) int64_t mOutputId;
+@property(nonatomic) NSMutableDictionary<NSNumber *, FlutterPcmSoundPlugin *> *mOutputs;
+@property(nonatomic) int64_t mNextOutputId;
+
+@end
+
+// The registered instance, for the FFI feed entry point
+static __weak FlutterPcmSoundPlugin *sFfiInstance = nil;
+
+static mach_timebase_info_data_t HostTimebase()
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        mach_timebase_info(&timebase);
+    });
+    return timebase;
+}
+
+static uint64_t HostTicksToNs(uint64_t ticks)
+{
+    mach_timebase_info_data_t timebase = HostTimebase();
+    return (uint64_t)((double)ticks * timebase.numer / timebase.denom);
+}
+
+static uint64_t NsToHostTicks(uint64_t ns)
+{
+    mach_timebase_info_data_t timebase = HostTimebase();
+    return (uint64_t)((double)ns * timebase.denom / timebase.numer);
+}
+
+// RingBuffer, PlaybackStats and Mixer are cache line aligned, and aligned operator
+// new needs iOS 11 / macOS 10.13, so they are placed in aligned storage by hand
+template <typename T>
+static T *NewAligned()
+{
+    void *storage = NULL;
+    if (posix_memalign(&storage, alignof(T), sizeof(T)) != 0) {
+        return NULL;
+    }
+    return new (storage) T();
+}
+
+template <typename T>
+static void DeleteAligned(T *object)
+{
+    if (object != NULL) {
+        object->~T();
+        free(object);
+    }
+}
+
+// Devices setup's device_id can name. iOS plays to the current route, so
+// those are its outputs; on macOS they are the CoreAudio devices with
+// output streams, by UID.
+#if !TARGET_OS_IOS
+static NSString *DeviceString(AudioObjectID device, AudioObjectPropertySelector selector)
+{
+    AudioObjectPropertyAddress address = {selector, kAudioObjectPropertyScopeGlobal, 0};
+    CFStringRef value = NULL;
+    UInt32 size = sizeof(value);
+    if (AudioObjectGetPropertyData(device, &address, 0, NULL, &size, &value) != noErr || value == NULL) {
+        return nil;
+    }
+    return (__bridge_transfer NSString *)value;
+}
+
+static std::vector<AudioDeviceID> OutputDeviceIDs()
+{
+    AudioObjectPropertyAddress address = {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, 0};
+    UInt32 size = 0;
+    if (AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &address, 0, NULL, &size) != noErr) {
+        return {};
+    }
+    std::vector<AudioDeviceID> devices(size / sizeof(AudioDeviceID));
+    if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, 0, NULL, &size, devices.data()) != noErr) {
+        return {};
+    }
+    devices.resize(size / sizeof(AudioDeviceID));
+
+    std::vector<AudioDeviceID> outputs;
+    for (AudioDeviceID device : devices) {
+        AudioObjectPropertyAddress streams = {kAudioDevicePropertyStreams, kAudioObjectPropertyScopeOutput, 0};
+        UInt32 streamsSize = 0;
+        if (AudioObjectGetPropertyDataSize(device, &streams, 0, NULL, &streamsSize) == noErr && streamsSize > 0) {
+            outputs.push_back(device);
+        }
+    }
+    return outputs;
+}
+
+// kAudioObjectUnknown when no output device has this UID
+static AudioDeviceID OutputDeviceForUID(NSString *uid)
+{
+    for (AudioDeviceID device : OutputDeviceIDs()) {
+        if ([DeviceString(device, kAudioDevicePropertyDeviceUID) isEqualToString:uid]) {
+            return device;
+        }
+    }
+    return kAudioObjectUnknown;
+}
+#endif
+
+static NSArray<NSDictionary *> *ListOutputDevices()
+{
+    NSMutableArray<NSDictionary *> *devices = [NSMutableArray array];
+#if TARGET_OS_IOS
+    for (AVAudioSessionPortDescription *port in [[AVAudioSession sharedInstance] currentRoute].outputs) {
+        [devices addObject:@{
+            @"id": port.UID,
+            @"name": port.portName,
+            @"description": port.portType,
+            @"is_default": @(true),
+        }];
+    }
+#else
+    AudioObjectPropertyAddress address = {kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, 0};
+    AudioDeviceID defaultDevice = kAudioObjectUnknown;
+    UInt32 size = sizeof(defaultDevice);
+    AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, 0, NULL, &size, &defaultDevice);
+    for (AudioDeviceID device : OutputDeviceIDs()) {
+        NSString *uid = DeviceString(device, kAudioDevicePropertyDeviceUID);
+        if (uid == nil) {
+            continue;
+        }
+        [devices addObject:@{
+            @"id": uid,
+            @"name": DeviceString(device, kAudioObjectPropertyName) ?: uid,
+            @"description": DeviceString(device, kAudioObjectPropertyManufacturer) ?: @"",
+            @"is_default": @(device == defaultDevice),
+        }];
+    }
+#endif
+    return devices;
+}
+
+// The sample_format names feed takes; nil is s16le
+static bool ParseSampleFormat(id name, flutter_pcm_sound::SampleFormat *format)
+{
+    if (name == nil || name == [NSNull null] || [name isEqual:@"s16le"]) {
+        *format = flutter_pcm_sound::SampleFormat::kS16;
+    } else if ([name isEqual:@"s24le"]) {
+        *format = flutter_pcm_sound::SampleFormat::kS24;
+    } else if ([name isEqual:@"s32le"]) {
+        *format = flutter_pcm_sound::SampleFormat::kS32;
+    } else if ([name isEqual:@"f32le"]) {
+        *format = flutter_pcm_sound::SampleFormat::kF32;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Files that aren't WAV, decoded by ExtAudioFile: MP3, AAC, ALAC, FLAC,
+// Opus in CAF, whatever the OS has a decoder for. Read as float at the
+// file's own rate and channel count.
+class ExtAudioFileSource : public flutter_pcm_sound::PcmSource {
+ public:
+    ~ExtAudioFileSource() override
+    {
+        if (file_ != NULL) {
+            ExtAudioFileDispose(file_);
+        }
+    }
+
+    bool Open(NSString *path, std::string *error)
+    {
+        OSStatus status = ExtAudioFileOpenURL((__bridge CFURLRef)[NSURL fileURLWithPath:path], &file_);
+        if (status != noErr) {
+            file_ = NULL;
+            *error = "not a file this device can decode (OSStatus " + std::to_string(status) + ")";
+            return false;
+        }
+        AudioStreamBasicDescription fileFormat;
+        UInt32 size = sizeof(fileFormat);
+        status = ExtAudioFileGetProperty(file_, kExtAudioFileProperty_FileDataFormat, &size, &fileFormat);
+        if (status != noErr || fileFormat.mChannelsPerFrame == 0 || fileFormat.mSampleRate <= 0) {
+            *error = "can't read the file's format (OSStatus " + std::to_string(status) + ")";
+            return false;
+        }
+
+        AudioStreamBasicDescription clientFormat = {};
+        clientFormat.mSampleRate = fileFormat.mSampleRate;
+        clientFormat.mFormatID = kAudioFormatLinearPCM;
+        clientFormat.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
+        clientFormat.mFramesPerPacket = 1;
+        clientFormat.mChannelsPerFrame = fileFormat.mChannelsPerFrame;
+        clientFormat.mBitsPerChannel = 32;
+        clientFormat.mBytesPerFrame = sizeof(float) * fileFormat.mChannelsPerFrame;
+        clientFormat.mBytesPerPacket = clientFormat.mBytesPerFrame;
+        status = ExtAudioFileSetProperty(file_, kExtAudioFileProperty_ClientDataFormat, sizeof(clientFormat), &clientFormat);
+        if (status != noErr) {
+            *error = "can't decode the file to float (OSStatus " + std::to_string(status) + ")";
+            return false;
+        }
+
+        info_.sample_rate = (int)fileFormat.mSampleRate;
+        info_.channels = (int)fileFormat.mChannelsPerFrame;
+        SInt64 frames = 0;
+        size = sizeof(frames);
+        if (ExtAudioFileGetProperty(file_, kExtAudioFileProperty_FileLengthFrames, &size, &frames) == noErr && frames > 0) {
+            info_.frames = frames;
+        }
+        return true;
+    }
+
+    size_t Read(float *out, size_t frames) override
+    {
+        AudioBufferList list;
+        list.mNumberBuffers = 1;
+        list.mBuffers[0].mNumberChannels = info_.channels;
+        list.mBuffers[0].mDataByteSize = (UInt32)(frames * info_.channels * sizeof(float));
+        list.mBuffers[0].mData = out;
+        UInt32 count = (UInt32)frames;
+        OSStatus status = ExtAudioFileRead(file_, &count, &list);
+        if (status != noErr) {
+            error_ = "decoding failed (OSStatus " + std::to_string(status) + ")";
+            return 0;
+        }
+        return count;
+    }
+
+ private:
+    ExtAudioFileRef file_ = NULL;
+};
+
+@implementation FlutterPcmSoundPlugin {
+    // Written by feed, read by the render thread. Everything the render
+    // callback touches is a plain C++ field or an atomic, never a property
+    flutter_pcm_sound::RingBuffer *_samples;
+    std::atomic<int> _feedThreshold;
+    std::atomic<bool> _didInvokeFeedCallback;
+    bool _keepRunningWhenEmpty; // set by setup, before the unit starts
+
+    // The render thread only stores the latest numbers and merges event
+    // bits into this main queue source; libdispatch coalesces them, so
+    // there is at most one pending handler however often it fires
+    dispatch_source_t _renderEvents;
+    std::atomic<NSUInteger> _pendingRemainingFrames;
+    std::atomic<NSUInteger> _pendingRequestedFrames;
+
+    // Telemetry for getStats and the periodic OnStats push
+    flutter_pcm_sound::PlaybackStats *_stats;
+    bool _wasStarved; // render thread only: the last callback came up short
+    dispatch_source_t _statsTimer;
+
+    // Pre-roll: while _startHeld, feed queues samples without starting the
+    // unit. startAt stores the host time (mach_absolute_time ticks) the
+    // first sample should play at, and the render callback pads with
+    // silence up to that frame.
+    std::atomic<bool> _startHeld;
+    std::atomic<uint64_t> _startHostTime; // 0 when no start is scheduled
+    double _framesPerHostTick;             // set by setup
+
+    // Playback position, published by the render thread under a sequence
+    // count: odd while it is being written
+    uint64_t _framesPlayed; // render thread only
+    std::atomic<uint32_t> _positionSeq;
+    std::atomic<uint64_t> _positionFrames;
+    std::atomic<uint64_t> _positionHostTime;
+
+    // pause stops the unit and keeps it stopped until resume; feeds queue
+    // up meanwhile
+    std::atomic<bool> _paused;
+    // queue position the last flush dropped up to
+    std::atomic<uint64_t> _flushTo;
+
+    // Serializes the writers of the queue: feed on the main thread, the
+    // FFI feed on Dart's thread and the file thread
+    std::mutex _feedMutex;
+    // where a blocking FFI feed sleeps, without _feedMutex, until the
+    // render callback has taken samples out. prime, flush, pause and
+    // cleanup end the wait
+    flutter_pcm_sound::FeedWaiter _feedWaiter;
+    // setup sizes the queue for this much audio, and feed handles what
+    // doesn't fit by the policy
+    flutter_pcm_sound::FeedPolicy _feedPolicy;
+    flutter_pcm_sound::SampleFormat _sampleFormat; // set by setup
+
+    // playFile: queues a file into the sample queue from its own thread.
+    // _filePath is what it is playing; only changed while it is stopped.
+    flutter_pcm_sound::FilePlayer *_filePlayer;
+    NSString *_filePath;
+
+    // loadClip's clips, main thread only. The mixer plays them over the
+    // queue from the render callback, reading their samples in place;
+    // _clipMix is its float scratch, sized by setup
+    flutter_pcm_sound::ClipBank *_clips;
+    flutter_pcm_sound::Mixer *_mixer;
+    std::vector<float> _clipMix;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _samples = NewAligned<flutter_pcm_sound::RingBuffer>();
+        _stats = NewAligned<flutter_pcm_sound::PlaybackStats>();
+        _mixer = NewAligned<flutter_pcm_sound::Mixer>();
+        if (_samples == NULL || _stats == NULL || _mixer == NULL) {
+            // dealloc still runs for a nil init, so leave nothing for it twice
+            DeleteAligned(_samples);
+            DeleteAligned(_stats);
+            DeleteAligned(_mixer);
+            _samples = NULL;
+            _stats = NULL;
+            _mixer = NULL;
+            return nil;
+        }
+        _clips = new flutter_pcm_sound::ClipBank();
+        _renderEvents = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR, 0, 0, dispatch_get_main_queue());
+        __weak FlutterPcmSoundPlugin *weakSelf = self;
+        dispatch_source_set_event_handler(_renderEvents, ^{
+            FlutterPcmSoundPlugin *strongSelf = weakSelf;
+            if (strongSelf != nil) {
+                [strongSelf handleRenderEvents:dispatch_source_get_data(strongSelf->_renderEvents)];
+            }
+        });
+        dispatch_resume(_renderEvents);
+
+        // dealloc stops the file thread before anything goes away, and a
+        // strong reference there could make it the one that runs dealloc
+        __unsafe_unretained FlutterPcmSoundPlugin *unretainedSelf = self;
+        _filePlayer = new flutter_pcm_sound::FilePlayer(
+            [unretainedSelf](const uint8_t *data, size_t length) {
+                return [unretainedSelf queueFileSamples:data length:length];
+            },
+            [unretainedSelf, weakSelf](const std::string &error) {
+                NSString *path = unretainedSelf->_filePath;
+                NSString *message = error.empty() ? nil : [NSString stringWithUTF8String:error.c_str()];
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    FlutterPcmSoundPlugin *strongSelf = weakSelf;
+                    if (strongSelf != nil) {
+                        [strongSelf sendFileDone:path error:message];
+                    }
+                });
+            });
+    }
+    return self;
+}
+
++ (void)registerWithRegistrar:(NSObject<FlutterPluginRegistrar> *)registrar
+{
+    FlutterMethodChannel *methodChannel = [FlutterMethodChannel methodChannelWithName:NAMESPACE @"/methods"
+                                                                    binaryMessenger:[registrar messenger]];
+
+    FlutterPcmSoundPlugin *instance = [[FlutterPcmSoundPlugin alloc] init];
+    if (instance == nil) {
+        NSLog(@"flutter_pcm_sound not registered: out of memory");
+        return;
+    }
+    instance.mMethodChannel = methodChannel;
+    instance.mLogLevel = verbose;
+    instance->_feedThreshold.store(8000);
+    instance->_didInvokeFeedCallback.store(false);
+    instance.mDidSetup = false;
+    instance.mOutputs = [NSMutableDictionary dictionary];
+    instance.mNextOutputId = 1;
+
+    [registrar addMethodCallDelegate:instance channel:methodChannel];
+
+    sFfiInstance = instance;
+}
+
+- (void)handleMethodCall:(FlutterMethodCall *)call result:(FlutterResult)result
+{
+    @try
+    {
+        // calls for another output go to its instance
+        NSDictionary *callArgs = [call.arguments isKindOfClass:[NSDictionary class]] ? call.arguments : nil;
+        NSNumber *outputId = callArgs[@"output_id"];
+        if (self.mOutputs != nil && [outputId isKindOfClass:[NSNumber class]] && [outputId longLongValue] != 0) {
+            FlutterPcmSoundPlugin *output = self.mOutputs[outputId];
+            if (output == nil) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"unknown output_id" details:nil]);
+            } else if ([@"closeOutput" isEqualToString:call.method]) {
+                [self.mOutputs removeObjectForKey:outputId];
+                [output cleanup];
+                result(@(true));
+            } else {
+                [output handleMethodCall:call result:result];
+            }
+            return;
+        }
+
+        if ([@"setLogLevel" isEqualToString:call.method])
+        {
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            NSNumber *logLevelNumber  = args[@"log_level"];
+
+            self.mLogLevel = (LogLevel)[logLevelNumber integerValue];
+
+            result(@(true));
+        }
+        else if ([@"setup" isEqualToString:call.method])
+        {
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            NSNumber *sampleRate       = args[@"sample_rate"];
+            NSNumber *numChannels      = args[@"num_channels"];
+            NSString *sampleFormat     = args[@"sample_format"];
+            NSNumber *keepRunning      = args[@"keep_running_when_empty"];
+            NSString *deviceId         = args[@"device_id"];
+            NSNumber *maxQueueUs       = args[@"max_queue_us"];
+            NSString *feedPolicy       = args[@"feed_policy"];
+#if TARGET_OS_IOS
+            NSString *iosAudioCategory = args[@"ios_audio_category"];
+            self.chosenCategory = iosAudioCategory;
+#endif
+
+            self.mNumChannels = [numChannels intValue];
+
+            flutter_pcm_sound::FeedPolicy policy;
+            if (!flutter_pcm_sound::ParseFeedPolicy([feedPolicy isKindOfClass:[NSString class]] ? feedPolicy.UTF8String : NULL,
+                                                    &policy)) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"unknown feed_policy" details:nil]);
+                return;
+            }
+
+#if TARGET_OS_IOS
+	        // handle background audio in iOS
+            // Default to Playback if no matching case is found
+            AVAudioSessionCategory category = AVAudioSessionCategoryPlayback;
+            if ([iosAudioCategory isEqualToString:@"ambient"]) {
+                category = AVAudioSessionCategoryAmbient;
+            } else if ([iosAudioCategory isEqualToString:@"soloAmbient"]) {
+                category = AVAudioSessionCategorySoloAmbient;
+            } else if ([iosAudioCategory isEqualToString:@"playback"]) {
+                category = AVAudioSessionCategoryPlayback;
+            } else if ([iosAudioCategory isEqualToString:@"playAndRecord"]) {
+                category = AVAudioSessionCategoryPlayAndRecord;
+            }
+            else if ([iosAudioCategory isEqualToString:@"playAndRecord"]) {
+                category = AVAudioSessionCategoryPlayAndRecord;
+            }
+            
+            // Set the AVAudioSession category based on the string value
+            NSError *error = nil;
+            [[AVAudioSession sharedInstance] setCategory:category error:&error];
+            if (error) {
+                NSLog(@"Error setting AVAudioSession category: %@", error);
+                result([FlutterError errorWithCode:@"AVAudioSessionError"
+                                           message:@"Error setting AVAudioSession category"
+                                           details:[error localizedDescription]]);
+                return;
+            }
+
+            [[AVAudioSession sharedInstance] setActive:YES error:&error];
+            if (error) {
+                NSLog(@"Error activating AVAudioSession: %@", error);
+                result([FlutterError errorWithCode:@"AVAudioSessionError"
+                                           message:@"Error activating AVAudioSession"
+                                           details:[error localizedDescription]]);
+                return;
+            }
+
+            // If using playAndRecord, ensure we don't use the earpiece:
+            // Check current route. If built-in receiver is present, override to speaker.
+            if ([iosAudioCategory isEqualToString:@"playAndRecord"]) {
+                [self ensureNotEarpiece];
+                
+                // Add observer to handle future route changes
+                [[NSNotificationCenter defaultCenter] addObserver:self
+                                                         selector:@selector(handleRouteChange:)
+                                                             name:AVAudioSessionRouteChangeNotification
+                                                           object:nil];
+            }
+#endif
+
+            // a device from listDevices
+            bool hasDevice = [deviceId isKindOfClass:[NSString class]];
+#if TARGET_OS_IOS
+            if (hasDevice) {
+                bool routed = false;
+                for (AVAudioSessionPortDescription *port in [[AVAudioSession sharedInstance] currentRoute].outputs) {
+                    routed = routed || [port.UID isEqualToString:deviceId];
+                }
+                if (!routed) {
+                    result([FlutterError errorWithCode:@"InvalidArguments"
+                                               message:@"device_id must be an output of the current route"
+                                               details:nil]);
+                    return;
+                }
+            }
+#else
+            AudioDeviceID device = hasDevice ? OutputDeviceForUID(deviceId) : kAudioObjectUnknown;
+            if (hasDevice && device == kAudioObjectUnknown) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"unknown device_id" details:nil]);
+                return;
+            }
+#endif
+
+            // cleanup
+            if (_mAudioUnit != nil) {
+                [self cleanup];
+            }
+
+            _keepRunningWhenEmpty = keepRunning != nil && [keepRunning boolValue];
+            _stats->Reset();
+            _wasStarved = false;
+            _startHeld.store(false);
+            _startHostTime.store(0);
+            _paused.store(false);
+            _flushTo.store(0);
+            _framesPlayed = 0;
+            _positionSeq.store(0);
+            _positionFrames.store(0);
+            _positionHostTime.store(0);
+
+            // create
+            AudioComponentDescription desc;
+            desc.componentType = kAudioUnitType_Output;
+#if TARGET_OS_IOS
+            desc.componentSubType = kAudioUnitSubType_RemoteIO;
+#else // MacOS: a chosen device needs the HAL unit, which doesn't follow the default
+            desc.componentSubType = hasDevice ? kAudioUnitSubType_HALOutput : kAudioUnitSubType_DefaultOutput;
+#endif
+            desc.componentFlags = 0;
+            desc.componentFlagsMask = 0;
+            desc.componentManufacturer = kAudioUnitManufacturer_Apple;
+
+            AudioComponent inputComponent = AudioComponentFindNext(NULL, &desc);
+            OSStatus status = AudioComponentInstanceNew(inputComponent, &_mAudioUnit);
+            if (status != noErr) {
+                NSString* message = [NSString stringWithFormat:@"AudioComponentInstanceNew failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+#if !TARGET_OS_IOS
+            if (hasDevice) {
+                status = AudioUnitSetProperty(_mAudioUnit,
+                                        kAudioOutputUnitProperty_CurrentDevice,
+                                        kAudioUnitScope_Global,
+                                        0,
+                                        &device,
+                                        sizeof(device));
+                if (status != noErr) {
+                    NSString* message = [NSString stringWithFormat:@"AudioUnitSetProperty CurrentDevice failed. OSStatus: %@", @(status)];
+                    result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                    return;
+                }
+            }
+#endif
+
+            // set stream format. samples are passed through in the format
+            // they were fed in; s24le is 24-bit in the low bits of 32
+            UInt32 formatFlags = kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
+            UInt32 bitsPerChannel = 16;
+            UInt32 bytesPerSample = 2;
+            if ([sampleFormat isEqualToString:@"f32le"]) {
+                formatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
+                bitsPerChannel = 32;
+                bytesPerSample = 4;
+            } else if ([sampleFormat isEqualToString:@"s32le"]) {
+                bitsPerChannel = 32;
+                bytesPerSample = 4;
+            } else if ([sampleFormat isEqualToString:@"s24le"]) {
+                formatFlags = kAudioFormatFlagIsSignedInteger; // not packed: low aligned in 4 bytes
+                bitsPerChannel = 24;
+                bytesPerSample = 4;
+            } else if (sampleFormat != nil && ![sampleFormat isEqualToString:@"s16le"]) {
+                NSString* message = [NSString stringWithFormat:@"unsupported sample_format: %@", sampleFormat];
+                result([FlutterError errorWithCode:@"InvalidArguments" message:message details:nil]);
+                return;
+            }
+            ParseSampleFormat(sampleFormat, &_sampleFormat);
+
+            AudioStreamBasicDescription audioFormat;
+            audioFormat.mSampleRate = [sampleRate intValue];
+            audioFormat.mFormatID = kAudioFormatLinearPCM;
+            audioFormat.mFormatFlags = formatFlags;
+            audioFormat.mFramesPerPacket = 1;
+            audioFormat.mChannelsPerFrame = self.mNumChannels;
+            audioFormat.mBitsPerChannel = bitsPerChannel;
+            audioFormat.mBytesPerFrame = self.mNumChannels * bytesPerSample;
+            audioFormat.mBytesPerPacket = audioFormat.mBytesPerFrame * audioFormat.mFramesPerPacket;
+            audioFormat.mReserved = 0;
+            self.mBytesPerFrame = audioFormat.mBytesPerFrame;
+            self.mSampleRate = (int)audioFormat.mSampleRate;
+            _framesPerHostTick = self.mSampleRate / (double)NsToHostTicks(1000000000);
+
+            // the render thread pops from this without locking, so it is
+            // sized once here rather than grown by feed
+            int64_t maxQueueMicros = maxQueueUs != nil ? [maxQueueUs longLongValue] : flutter_pcm_sound::kDefaultMaxQueueMicros;
+            size_t queueBytes = flutter_pcm_sound::QueueBytesFor(maxQueueMicros, self.mSampleRate, self.mBytesPerFrame);
+            _feedPolicy = policy;
+            if (!_samples->Reset(queueBytes)) {
+                result([FlutterError errorWithCode:@"NoMemory" message:@"failed to allocate sample queue" details:nil]);
+                return;
+            }
+
+            // clips only; there are no extra streams here. clips survive a
+            // setup with the same rate and channel count
+            _mixer->Configure(_sampleFormat, self.mNumChannels, 0, 0);
+            _clips->Configure(self.mSampleRate, self.mNumChannels);
+            _clipMix.assign((size_t)CLIP_MIX_FRAMES * self.mNumChannels, 0.0f);
+
+            status = AudioUnitSetProperty(_mAudioUnit,
+                                    kAudioUnitProperty_StreamFormat,
+                                    kAudioUnitScope_Input,
+                                    kOutputBus,
+                                    &audioFormat,
+                                    sizeof(audioFormat));
+            if (status != noErr) {
+                NSString* message = [NSString stringWithFormat:@"AudioUnitSetProperty StreamFormat failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+
+            // set callback
+            AURenderCallbackStruct callback;
+            callback.inputProc = RenderCallback;
+            callback.inputProcRefCon = (__bridge void *)(self);
+
+            status = AudioUnitSetProperty(_mAudioUnit,
+                                kAudioUnitProperty_SetRenderCallback,
+                                kAudioUnitScope_Global,
+                                kOutputBus,
+                                &callback,
+                                sizeof(callback));
+            if (status != noErr) {
+                NSString* message = [NSString stringWithFormat:@"AudioUnitSetProperty SetRenderCallback failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+
+            // initialize
+            status = AudioUnitInitialize(_mAudioUnit);
+            if (status != noErr) {
+                NSString* message = [NSString stringWithFormat:@"AudioUnitInitialize failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+
+            self.mDidSetup = true;
+            
+            result(@(true));
+        }
+        else if ([@"feed" isEqualToString:call.method])
+        {
+            // setup check
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            FlutterStandardTypedData *buffer = args[@"buffer"];
+
+            NSUInteger queued = 0;
+            // never blocks: this is the main thread
+            OSStatus status = [self queueSamples:buffer.data.bytes length:buffer.data.length queued:&queued blocking:NO];
+            if (status != noErr) {
+                NSString* message = [NSString stringWithFormat:@"AudioOutputUnitStart failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+
+            // how many frames were accepted, so producers can back off
+            result(@(queued / self.mBytesPerFrame));
+        }
+        else if ([@"setFeedThreshold" isEqualToString:call.method])
+        {
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            NSNumber *feedThreshold = args[@"feed_threshold"];
+
+            _feedThreshold.store([feedThreshold intValue]);
+
+            result(@(true));
+        }
+        else if ([@"prime" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+            // takes effect the next time the unit starts; a running unit
+            // plays silence from its next render cycle
+            _startHostTime.store(0);
+            _startHeld.store(true);
+            _feedWaiter.Cancel();
+            result(@(true));
+        }
+        else if ([@"startAt" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false || !_startHeld.load()) {
+                result([FlutterError errorWithCode:@"NotPrimed" message:@"call prime before startAt" details:nil]);
+                return;
+            }
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            NSNumber *hostTimeNs = args[@"host_time_ns"];
+            _startHostTime.store(MAX(NsToHostTicks([hostTimeNs unsignedLongLongValue]), (uint64_t)1));
+            _startHeld.store(false);
+            OSStatus status = AudioOutputUnitStart(_mAudioUnit);
+            if (status != noErr) {
+                _stats->RecordDeviceError();
+                NSString* message = [NSString stringWithFormat:@"AudioOutputUnitStart failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+            result(@(true));
+        }
+        else if ([@"flush" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+            [self flush];
+            result(@(true));
+        }
+        else if ([@"pause" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+            _paused.store(true);
+            _feedWaiter.Cancel();
+            // returns once the current render cycle is done
+            OSStatus status = AudioOutputUnitStop(_mAudioUnit);
+            if (status != noErr) {
+                _stats->RecordDeviceError();
+                NSString* message = [NSString stringWithFormat:@"AudioOutputUnitStop failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+            result(@(true));
+        }
+        else if ([@"resume" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+            _paused.store(false);
+            OSStatus status = [self restartAudioUnit];
+            if (status != noErr) {
+                NSString* message = [NSString stringWithFormat:@"AudioOutputUnitStart failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+            result(@(true));
+        }
+        else if ([@"playFile" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            id path = args[@"path"];
+            id raw = args[@"raw"];
+            if (![path isKindOfClass:[NSString class]]) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"path required" details:nil]);
+                return;
+            }
+            [self playFile:path raw:[raw isKindOfClass:[NSDictionary class]] ? raw : nil result:result];
+        }
+        else if ([@"stopFile" isEqualToString:call.method])
+        {
+            _filePlayer->Stop();
+            result(@(true));
+        }
+        else if ([@"loadClip" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+            [self loadClip:(NSDictionary*)call.arguments result:result];
+        }
+        else if ([@"playClip" isEqualToString:call.method])
+        {
+            if (self.mDidSetup == false) {
+                result([FlutterError errorWithCode:@"Setup" message:@"must call setup first" details:nil]);
+                return;
+            }
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            id clipId = args[@"clip_id"];
+            NSNumber *gain = args[@"gain"];
+            NSNumber *pan = args[@"pan"];
+            flutter_pcm_sound::Clip *clip = [clipId isKindOfClass:[NSString class]] ? _clips->Find([clipId UTF8String]) : NULL;
+            if (clip == NULL) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"unknown clip_id" details:nil]);
+                return;
+            }
+            int64_t voiceId = _mixer->PlayClip(clip, gain != nil ? [gain floatValue] : 1.0f, pan != nil ? [pan floatValue] : 0.0f);
+            if (voiceId < 0) {
+                result([FlutterError errorWithCode:@"TooManyClips" message:@"every clip voice is playing" details:nil]);
+                return;
+            }
+            OSStatus status = [self restartAudioUnit];
+            if (status != noErr) {
+                NSString* message = [NSString stringWithFormat:@"AudioOutputUnitStart failed. OSStatus: %@", @(status)];
+                result([FlutterError errorWithCode:@"AudioUnitError" message:message details:nil]);
+                return;
+            }
+            result(@(voiceId));
+        }
+        else if ([@"unloadClip" isEqualToString:call.method])
+        {
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            id clipId = args[@"clip_id"];
+            if (![clipId isKindOfClass:[NSString class]] || !_clips->Unload([clipId UTF8String])) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"unknown clip_id" details:nil]);
+                return;
+            }
+            result(@(true));
+        }
+        else if ([@"setClipCacheLimit" isEqualToString:call.method])
+        {
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            NSNumber *bytes = args[@"bytes"];
+            if (bytes == nil || [bytes longLongValue] < 0) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"bytes required" details:nil]);
+                return;
+            }
+            _clips->SetLimit((size_t)[bytes longLongValue]);
+            result(@(true));
+        }
+        else if ([@"getPlaybackPosition" isEqualToString:call.method])
+        {
+            result([self playbackPosition]);
+        }
+        else if ([@"getStats" isEqualToString:call.method])
+        {
+            result([self statsDictionary]);
+        }
+        else if ([@"setStatsInterval" isEqualToString:call.method])
+        {
+            NSDictionary *args = (NSDictionary*)call.arguments;
+            NSNumber *intervalMs = args[@"interval_ms"];
+            [self setStatsInterval:[intervalMs longLongValue]];
+            result(@(true));
+        }
+        else if ([@"listDevices" isEqualToString:call.method])
+        {
+            result(ListOutputDevices());
+        }
+        else if ([@"openOutput" isEqualToString:call.method])
+        {
+            if (self.mOutputs == nil) {
+                result([FlutterError errorWithCode:@"InvalidArguments" message:@"outputs can't open outputs" details:nil]);
+                return;
+            }
+            FlutterPcmSoundPlugin *output = [[FlutterPcmSoundPlugin alloc] init];
+            if (output == nil) {
+                result([FlutterError errorWithCode:@"NoMemory" message:@"failed to allocate output" details:nil]);
+                return;
+            }
+            output.mMethodChannel = self.mMethodChannel;
+            output.mLogLevel = self.mLogLevel;
+            output->_feedThreshold.store(8000);
+            output->_didInvokeFeedCallback.store(false);
+            output.mDidSetup = false;
+            output.mOutputId = self.mNextOutputId++;
+            self.mOutputs[@(output.mOutputId)] = output;
+            result(@{@"output_id": @(output.mOutputId)});
+        }
+        else if([@"release" isEqualToString:call.method])
+        {
+            [self cleanup];
+            // only an explicit release drops clips; setup keeps them
+            _clips->Clear();
+            result(@(true));
+        }
+        else
+        {
+            result([FlutterError errorWithCode:@"functionNotImplemented" message:call.method details:nil]);
+        }
+    }
+    @catch (NSException *e)
+    {
+        NSString *stackTrace = [[e callStackSymbols] componentsJoinedByString:@"\n"];
+        NSDictionary *details = @{@"stackTrace": stackTrace};
+        result([FlutterError errorWithCode:@"iosException" message:[e reason] details:details]);
+    }
+}
+
+// Appends samples to the queue under the feed policy and makes sure the
+// audio unit is running. Shared by the `feed` method and the FFI entry point.
+// only a `blocking` caller waits for room under the block policy, with
+// _feedMutex let go; the main thread queues what fits
+- (OSStatus)queueSamples:(const void *)bytes length:(NSUInteger)length queued:(NSUInteger *)queued blocking:(BOOL)blocking
+{
+    PCM_TRACE_SCOPE("feed");
+    std::unique_lock<std::mutex> lock(_feedMutex);
+
+    // only whole frames are queued, so the render thread never sees a torn
+    // frame. a blocked feed waits at most as long as it would take to play,
+    // with the unit running, and gives up while pre-roll or pause holds it
+    size_t bytesPerFrame = self.mBytesPerFrame;
+    const uint8_t *data = static_cast<const uint8_t *>(bytes);
+    size_t written;
+    if (_feedPolicy == flutter_pcm_sound::FeedPolicy::kBlock && blocking) {
+        size_t whole = length / bytesPerFrame * bytesPerFrame;
+        int64_t timeoutNs = (int64_t)(whole / bytesPerFrame) * 1000000000 / self.mSampleRate;
+        written = _feedWaiter.Block(lock, whole, timeoutNs, [self, data, whole, bytesPerFrame](size_t *written) {
+            size_t taken = flutter_pcm_sound::FeedQueue(*self->_samples, data + *written, whole - *written, bytesPerFrame,
+                                                        flutter_pcm_sound::FeedPolicy::kPartial);
+            self->_stats->RecordFeed(taken, flutter_pcm_sound::PlaybackStats::NowNs());
+            *written += taken;
+            if (self->_startHeld.load() || self->_paused.load()) {
+                return false;
+            }
+            self->_didInvokeFeedCallback.store(false);
+            return AudioOutputUnitStart(self.mAudioUnit) == noErr;
+        });
+    } else {
+        written = flutter_pcm_sound::FeedQueue(*_samples, data, length, bytesPerFrame, _feedPolicy);
+        _stats->RecordFeed(written, flutter_pcm_sound::PlaybackStats::NowNs());
+    }
+    if (written < length) {
+        NSLog(@"Sample queue full - %@ %lu bytes", _feedPolicy == flutter_pcm_sound::FeedPolicy::kPartial ? @"dropped" : @"rejected",
+              (unsigned long)(length - written));
+    }
+    if (queued != NULL) {
+        *queued = written;
+    }
+    PCM_TRACE_COUNTER("queue_frames", _samples->ReadableBytes() / self.mBytesPerFrame);
+
+    // reset
+    _didInvokeFeedCallback.store(false);
+
+    // pre-roll: startAt starts the unit. paused: resume does
+    if (_startHeld.load() || _paused.load()) {
+        return noErr;
+    }
+
+    // start
+    OSStatus status = AudioOutputUnitStart(_mAudioUnit);
+    if (status != noErr) {
+        _stats->RecordDeviceError();
+    }
+    return status;
+}
+
+// Plays a file, queued behind whatever was fed before it. WAV and raw PCM
+// are read straight from a memory mapping; anything else goes through
+// ExtAudioFile. The file thread converts it to the setup format and queues
+// it, and Dart hears OnFileDone once all of it is queued.
+- (void)playFile:(NSString *)path raw:(NSDictionary *)raw result:(FlutterResult)result
+{
+    _filePlayer->Stop();
+
+    std::string error;
+    std::unique_ptr<flutter_pcm_sound::PcmSource> source;
+    auto file = std::make_unique<flutter_pcm_sound::MappedFile>();
+    if (!file->Open(path.UTF8String, &error)) {
+        result([FlutterError errorWithCode:@"FileError" message:@(error.c_str()) details:nil]);
+        return;
+    }
+    if (raw != nil) {
+        flutter_pcm_sound::SampleFormat rawFormat;
+        if (!ParseSampleFormat(raw[@"sample_format"], &rawFormat)) {
+            result([FlutterError errorWithCode:@"InvalidArguments" message:@"unknown raw sample_format" details:nil]);
+            return;
+        }
+        source = flutter_pcm_sound::OpenRawSource(std::move(file), rawFormat, [raw[@"sample_rate"] intValue],
+                                                  [raw[@"num_channels"] intValue], &error);
+    } else if (flutter_pcm_sound::IsWav(file->data(), file->size())) {
+        source = flutter_pcm_sound::OpenWavSource(std::move(file), &error);
+    } else {
+        file.reset();
+        auto decoded = std::make_unique<ExtAudioFileSource>();
+        if (decoded->Open(path, &error)) {
+            source = std::move(decoded);
+        }
+    }
+    if (!source) {
+        result([FlutterError errorWithCode:@"UnsupportedFormat" message:@(error.c_str()) details:nil]);
+        return;
+    }
+
+    _filePath = [path copy];
+    flutter_pcm_sound::SourceInfo info = source->info();
+    if (!_filePlayer->Start(std::move(source), self.mSampleRate, self.mNumChannels, _sampleFormat,
+                            flutter_pcm_sound::ResampleQuality::kMedium, &error)) {
+        result([FlutterError errorWithCode:@"UnsupportedFormat" message:@(error.c_str()) details:nil]);
+        return;
+    }
+    NSMutableDictionary *response = [@{
+        @"sample_rate": @(info.sample_rate),
+        @"num_channels": @(info.channels),
+    } mutableCopy];
+    if (info.frames >= 0) {
+        response[@"duration_us"] = @(info.frames * 1000000 / info.sample_rate);
+    }
+    result(response);
+}
+
+// File thread. The file player's writer: queues what fits without waiting
+// for a feed in progress, and starts the unit the way feed does.
+- (size_t)queueFileSamples:(const uint8_t *)data length:(size_t)length
+{
+    std::unique_lock<std::mutex> lock(_feedMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return 0;
+    }
+    size_t writable = _samples->WritableBytes() / _mBytesPerFrame * _mBytesPerFrame;
+    size_t written = _samples->Write(data, MIN(length, writable));
+    if (written == 0) {
+        return 0;
+    }
+    _stats->RecordFeed(written, flutter_pcm_sound::PlaybackStats::NowNs());
+    _didInvokeFeedCallback.store(false);
+    if (!_startHeld.load() && !_paused.load() && AudioOutputUnitStart(_mAudioUnit) != noErr) {
+        _stats->RecordDeviceError();
+    }
+    return written;
+}
+
+// Converts a clip to float at the setup rate and channel count once, so
+// playClip costs no copy or conversion. Clips are in the setup format
+// unless the arguments say otherwise.
+- (void)loadClip:(NSDictionary *)args result:(FlutterResult)result
+{
+    id clipId = args[@"clip_id"];
+    FlutterStandardTypedData *buffer = args[@"buffer"];
+    NSNumber *sampleRate = args[@"sample_rate"];
+    NSNumber *numChannels = args[@"num_channels"];
+    if (![clipId isKindOfClass:[NSString class]] || ![buffer isKindOfClass:[FlutterStandardTypedData class]]) {
+        result([FlutterError errorWithCode:@"InvalidArguments" message:@"clip_id and buffer required" details:nil]);
+        return;
+    }
+    flutter_pcm_sound::SampleFormat format = _sampleFormat;
+    id formatName = args[@"sample_format"];
+    if (formatName != nil && formatName != [NSNull null] && !ParseSampleFormat(formatName, &format)) {
+        result([FlutterError errorWithCode:@"InvalidArguments" message:@"unknown sample_format" details:nil]);
+        return;
+    }
+    std::string error;
+    if (!_clips->Load([clipId UTF8String], static_cast<const uint8_t *>(buffer.data.bytes), buffer.data.length, format,
+                      [sampleRate isKindOfClass:[NSNumber class]] ? [sampleRate intValue] : self.mSampleRate,
+                      [numChannels isKindOfClass:[NSNumber class]] ? [numChannels intValue] : self.mNumChannels,
+                      flutter_pcm_sound::ResampleQuality::kMedium, &error)) {
+        result([FlutterError errorWithCode:@"InvalidArguments" message:@(error.c_str()) details:nil]);
+        return;
+    }
+    result(@(true));
+}
+
+- (void)sendFileDone:(NSString *)path error:(NSString *)error
+{
+    NSMutableDictionary *arguments = [@{@"path": path ?: @""} mutableCopy];
+    if (error != nil) {
+        arguments[@"error"] = error;
+    }
+    if (self.mOutputId != 0) {
+        arguments[@"output_id"] = @(self.mOutputId);
+    }
+    [self.mMethodChannel invokeMethod:@"OnFileDone" arguments:arguments];
+}
+
+// Drops everything fed so far. Stopping the unit cuts the output off
+// within the current render cycle, and once it has stopped nothing else
+// reads the queue, so it is emptied here. Feeds after this start the unit
+// again as usual.
+- (void)flush
+{
+    // a file still being queued is cut off along with what it queued
+    _filePlayer->Stop();
+    _feedWaiter.Cancel();
+    uint64_t position = _samples->WritePosition();
+    _flushTo.store(position);
+    _mixer->Flush();
+    OSStatus status = AudioOutputUnitStop(_mAudioUnit);
+    if (status != noErr) {
+        // still rendering: the render callback drops it instead
+        NSLog(@"AudioOutputUnitStop failed. OSStatus: %@", @(status));
+        _stats->RecordDeviceError();
+        return;
+    }
+    // the unit is stopped, so this thread stands in for the render thread
+    _stats->RecordDiscarded(_samples->DiscardTo(position));
+    _mixer->Clear();
+    AudioUnitReset(_mAudioUnit, kAudioUnitScope_Global, 0);
+    [self restartAudioUnit];
+}
+
+// Starts the unit again after flush or resume, if there is something to
+// play or it is meant to keep running.
+- (OSStatus)restartAudioUnit
+{
+    if (_paused.load() || _startHeld.load() ||
+        (_samples->ReadableBytes() == 0 && !_mixer->clips_playing() && !_keepRunningWhenEmpty)) {
+        return noErr;
+    }
+    OSStatus status = AudioOutputUnitStart(_mAudioUnit);
+    if (status != noErr) {
+        _stats->RecordDeviceError();
+    }
+    return status;
+}
+
+// Main thread. Handles everything the render thread signalled since the
+// last time the source fired.
+- (void)handleRenderEvents:(unsigned long)events
+{
+    // stop running, unless samples arrived since the render thread ran dry
+    if ((events & kRenderEventEmpty) && _samples->ReadableBytes() == 0 && !_mixer->clips_playing()) {
+        [self stopAudioUnit];
+    }
+    if (events & kRenderEventFeed) {
+        [self sendFeedRequest];
+    }
+}
+
+// Sends one OnFeedSamples for however many requests the render thread
+// made since the last one.
+- (void)sendFeedRequest
+{
+    PCM_TRACE_SCOPE("feed_callback");
+    NSUInteger remainingFrames = _pendingRemainingFrames.load();
+    NSUInteger requestedFrames = _pendingRequestedFrames.load();
+    long long remainingUs = self.mSampleRate > 0 ? (long long)remainingFrames * 1000000 / self.mSampleRate : 0;
+
+    NSMutableDictionary *response = [@{
+        @"remaining_frames": @(remainingFrames),
+        @"remaining_us": @(remainingUs),
+        @"requested_frames": @(requestedFrames),
+        @"requested_bytes": @(requestedFrames * self.mBytesPerFrame),
+    } mutableCopy];
+    if (self.mOutputId != 0) {
+        response[@"output_id"] = @(self.mOutputId);
+    }
+    [self.mMethodChannel invokeMethod:@"OnFeedSamples" arguments:response];
+    _stats->RecordFeedCallback();
+}
+
+// Frames that have reached the output, and the host time (nanoseconds on
+// mach_absolute_time) they had at. Before the first render, the count is
+// 0 as of now.
+- (NSDictionary *)playbackPosition
+{
+    uint64_t frames = 0;
+    uint64_t hostTime = 0;
+    uint32_t seq;
+    do {
+        seq = _positionSeq.load(std::memory_order_acquire);
+        frames = _positionFrames.load(std::memory_order_relaxed);
+        hostTime = _positionHostTime.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != _positionSeq.load(std::memory_order_relaxed));
+    if (hostTime == 0) {
+        hostTime = mach_absolute_time();
+    }
+
+    UInt32 isRunning = 0;
+    if (_mAudioUnit != nil) {
+        UInt32 size = sizeof(isRunning);
+        AudioUnitGetProperty(_mAudioUnit, kAudioOutputUnitProperty_IsRunning, kAudioUnitScope_Global, 0, &isRunning, &size);
+    }
+    return @{
+        @"frames": @(frames),
+        @"host_time_ns": @(HostTicksToNs(hostTime)),
+        @"running": @(isRunning != 0),
+    };
+}
+
+- (NSDictionary *)statsDictionary
+{
+    flutter_pcm_sound::StatsSnapshot snapshot;
+    _stats->Snapshot(&snapshot);
+    NSMutableArray *histogram = [NSMutableArray arrayWithCapacity:flutter_pcm_sound::kLatencyBuckets];
+    for (int i = 0; i < flutter_pcm_sound::kLatencyBuckets; i++) {
+        [histogram addObject:@(snapshot.latency_histogram[i])];
+    }
+    NSMutableDictionary *stats = [@{
+        @"underruns": @(snapshot.underruns),
+        @"device_errors": @(snapshot.device_errors),
+        @"recoveries": @(snapshot.recoveries),
+        @"recovery_us_total": @(snapshot.recovery_ns_total / 1000),
+        @"recovery_us_max": @(snapshot.recovery_ns_max / 1000),
+        @"queue_high_frames": @(snapshot.queue_high_frames),
+        @"device_callbacks": @(snapshot.device_callbacks),
+        @"feed_callbacks": @(snapshot.feed_callbacks),
+        @"bytes_fed": @(snapshot.bytes_fed),
+        @"bytes_played": @(snapshot.bytes_played),
+        @"latency_histogram": histogram,
+    } mutableCopy];
+    if (snapshot.has_queue_low) {
+        stats[@"queue_low_frames"] = @(snapshot.queue_low_frames);
+    }
+    if (self.mOutputId != 0) {
+        stats[@"output_id"] = @(self.mOutputId);
+    }
+    return stats;
+}
+
+// Pushes OnStats every `intervalMs` from the main queue; 0 stops it.
+- (void)setStatsInterval:(long long)intervalMs
+{
+    if (_statsTimer != nil) {
+        dispatch_source_cancel(_statsTimer);
+        _statsTimer = nil;
+    }
+    if (intervalMs <= 0) {
+        return;
+    }
+    _statsTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+    uint64_t interval = (uint64_t)intervalMs * NSEC_PER_MSEC;
+    dispatch_source_set_timer(_statsTimer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+    __weak FlutterPcmSoundPlugin *weakSelf = self;
+    dispatch_source_set_event_handler(_statsTimer, ^{
+        FlutterPcmSoundPlugin *strongSelf = weakSelf;
+        if (strongSelf != nil) {
+            [strongSelf.mMethodChannel invokeMethod:@"OnStats" arguments:[strongSelf statsDictionary]];
+        }
+    });
+    dispatch_resume(_statsTimer);
+}
+
+- (void)cleanup
+{
+    _filePlayer->Stop();
+    _feedWaiter.Cancel();
+
+#if TARGET_OS_IOS
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:AVAudioSessionRouteChangeNotification object:nil];
+#endif
+
+    if (_mAudioUnit != nil) {
+        [self stopAudioUnit];
+        AudioUnitUninitialize(_mAudioUnit);
+        AudioComponentInstanceDispose(_mAudioUnit);
+        _mAudioUnit = nil;
+        self.mDidSetup = false;
+    }
+    // the render callback is no longer running
+    _samples->Clear();
+    _mixer->Clear();
+}
+
+- (void)dealloc
+{
+    // outputs' units call back into them until stopped
+    for (FlutterPcmSoundPlugin *output in self.mOutputs.allValues) {
+        [output cleanup];
+    }
+    delete _filePlayer;
+    delete _clips;
+    if (_renderEvents != nil) {
+        dispatch_source_cancel(_renderEvents);
+    }
+    if (_statsTimer != nil) {
+        dispatch_source_cancel(_statsTimer);
+    }
+    DeleteAligned(_samples);
+    DeleteAligned(_stats);
+    DeleteAligned(_mixer);
+}
+
+- (void)stopAudioUnit
+{
+    if (_mAudioUnit != nil) {
+        UInt32 isRunning = 0;
+        UInt32 size = sizeof(isRunning);
+        OSStatus status = AudioUnitGetProperty(_mAudioUnit,
+                                            kAudioOutputUnitProperty_IsRunning,
+                                            kAudioUnitScope_Global,
+                                            0,
+                                            &isRunning,
+                                            &size);
+        if (status != noErr) {
+            NSLog(@"AudioUnitGetProperty IsRunning failed. OSStatus: %@", @(status));
+            return;
+        }
+        if (isRunning) {
+            status = AudioOutputUnitStop(_mAudioUnit);
+            if (status != noErr) {
+                NSLog(@"AudioOutputUnitStop failed. OSStatus: %@", @(status));
+            } else {
+                NSLog(@"AudioUnit stopped because no more samples");
+            }
+        }
+    }
+}
+
+#if TARGET_OS_IOS
+- (void)handleRouteChange:(NSNotification *)notification {
+    [self ensureNotEarpiece];
+}
+
+- (void)ensureNotEarpiece {
+    AVAudioSessionRouteDescription *currentRoute = [AVAudioSession sharedInstance].currentRoute;
+    BOOL isEarpiece = NO;
+    for (AVAudioSessionPortDescription *output in currentRoute.outputs) {
+        // Built-in receiver is the "earpiece"
+        if ([output.portType isEqualToString:AVAudioSessionPortBuiltInReceiver]) {
+            isEarpiece = YES;
+            break;
+        }
+    }
+
+    if (isEarpiece) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            NSError *error = nil;
+            [[AVAudioSession sharedInstance] overrideOutputAudioPort:AVAudioSessionPortOverrideSpeaker error:&error];
+            if (error) {
+                NSLog(@"Error overriding to speaker: %@", error);
+            } else {
+                NSLog(@"Earpiece was selected, overriding to speaker.");
+            }
+        });
+    } else {
+        // If not using earpiece, do nothing. Headphones, AirPlay, etc. will remain as is.
+        // Also, if previously overridden, we can revert if desired:
+        // But generally, calling overrideOutputAudioPort(.none) is only needed if we previously forced the speaker.
+        // If we always force speaker only when the earpiece is chosen, we do not need to revert explicitly.
+    }
+}
+#endif
+
+// Render thread. Mixes the playing clips into `frames` frames of output
+// that are already in the setup format, a chunk at a time through float.
+static void MixClips(FlutterPcmSoundPlugin *instance, uint8_t *out, size_t frames)
+{
+    const size_t channels = (size_t)instance->_mNumChannels;
+    const size_t bytesPerFrame = instance->_mBytesPerFrame;
+    float *mix = instance->_clipMix.data();
+    const size_t chunkFrames = instance->_clipMix.size() / channels;
+    for (size_t done = 0; done < frames;) {
+        size_t count = MIN(chunkFrames, frames - done);
+        uint8_t *chunk = out + done * bytesPerFrame;
+        flutter_pcm_sound::ToFloat(instance->_sampleFormat, chunk, mix, count * channels);
+        instance->_mixer->MixVoices(mix, count);
+        flutter_pcm_sound::FromFloat(instance->_sampleFormat, mix, chunk, count * channels);
+        done += count;
+    }
+}
+
+// Runs on the CoreAudio real-time thread: no locks, no allocation and no
+// Objective-C messaging. State is read through ivars and atomics directly,
+// and the main thread is only signalled through the render event source.
+static OSStatus RenderCallback(void *inRefCon,
+                               AudioUnitRenderActionFlags *ioActionFlags,
+                               const AudioTimeStamp *inTimeStamp,
+                               UInt32 inBusNumber,
+                               UInt32 inNumberFrames,
+                               AudioBufferList *ioData)
+{
+    PCM_TRACE_SCOPE("render");
+    __unsafe_unretained FlutterPcmSoundPlugin *instance = (__bridge FlutterPcmSoundPlugin *)(inRefCon);
+    AudioBuffer *buffer = &ioData->mBuffers[0];
+
+    uint8_t *out = static_cast<uint8_t *>(buffer->mData);
+    const size_t bytesPerFrame = instance->_mBytesPerFrame;
+
+    // flush couldn't stop the unit: drop what it asked for here
+    instance->_stats->RecordDiscarded(instance->_samples->DiscardTo(instance->_flushTo.load(std::memory_order_relaxed)));
+
+    // primed but not started: hold the queue back
+    if (instance->_startHeld.load(std::memory_order_relaxed)) {
+        memset(out, 0, buffer->mDataByteSize);
+        return noErr;
+    }
+
+    // scheduled start: silence up to the frame that plays at the start time
+    size_t leadFrames = 0;
+    uint64_t startHostTime = instance->_startHostTime.load(std::memory_order_relaxed);
+    if (startHostTime != 0 && (inTimeStamp->mFlags & kAudioTimeStampHostTimeValid)) {
+        if (startHostTime > inTimeStamp->mHostTime) {
+            double lead = (startHostTime - inTimeStamp->mHostTime) * instance->_framesPerHostTick;
+            leadFrames = (size_t)MIN(lead + 0.5, (double)inNumberFrames);
+        }
+        if (leadFrames == inNumberFrames) {
+            memset(out, 0, buffer->mDataByteSize);
+            return noErr;
+        }
+        instance->_startHostTime.compare_exchange_strong(startHostTime, 0);
+        // the start is an underrun of its own otherwise
+        instance->_wasStarved = false;
+    }
+    size_t leadBytes = leadFrames * bytesPerFrame;
+    memset(out, 0, leadBytes);
+
+    flutter_pcm_sound::PlaybackStats *stats = instance->_stats;
+    size_t queuedFrames = instance->_samples->ReadableBytes() / bytesPerFrame;
+    stats->RecordDeviceCallback(queuedFrames);
+    PCM_TRACE_COUNTER("queue_frames", queuedFrames);
+
+    // provide samples, then pad with silence
+    size_t wantBytes = buffer->mDataByteSize - leadBytes;
+    size_t bytesCopied = instance->_samples->Read(out + leadBytes, wantBytes);
+    instance->_feedWaiter.Notify();
+    memset(out + leadBytes + bytesCopied, 0, wantBytes - bytesCopied);
+    PCM_TRACE_COUNTER("written_frames", bytesCopied / bytesPerFrame);
+
+    // clips play over whatever the queue had, silence included. the
+    // mixer ends finished and flushed clips first
+    bool clipsPlaying = instance->_mixer->clips_playing();
+    if (clipsPlaying) {
+        instance->_mixer->MaxQueuedFrames();
+        MixClips(instance, out + leadBytes, wantBytes / bytesPerFrame);
+    }
+
+    // publish the position as of the end of the samples just rendered
+    if (inTimeStamp->mFlags & kAudioTimeStampHostTimeValid) {
+        size_t copiedFrames = bytesCopied / bytesPerFrame;
+        instance->_framesPlayed += copiedFrames;
+        uint64_t hostTime = inTimeStamp->mHostTime + (uint64_t)((leadFrames + copiedFrames) / instance->_framesPerHostTick);
+        uint32_t seq = instance->_positionSeq.load(std::memory_order_relaxed);
+        instance->_positionSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        instance->_positionFrames.store(instance->_framesPlayed, std::memory_order_relaxed);
+        instance->_positionHostTime.store(hostTime, std::memory_order_relaxed);
+        instance->_positionSeq.store(seq + 2, std::memory_order_release);
+    }
+
+    // an underrun is the first callback that comes up short; the silence
+    // after it, until samples flow again, is the time to recover
+    int64_t now = flutter_pcm_sound::PlaybackStats::NowNs();
+    // a clip playing on its own isn't an underrun of the queue
+    bool starved = bytesCopied < wantBytes && !clipsPlaying;
+    if (starved && !instance->_wasStarved) {
+        stats->RecordUnderrun(now);
+        PCM_TRACE_INSTANT("underrun");
+    } else if (!starved) {
+        if (instance->_wasStarved) {
+            PCM_TRACE_INSTANT("recover");
+        }
+        stats->RecordRecovered(now);
+    }
+    instance->_wasStarved = starved;
+    stats->RecordPlayed(bytesCopied, now);
+
+    size_t remainingFrames = instance->_samples->ReadableBytes() / bytesPerFrame;
+
+    unsigned long events = 0;
+
+    // stop running, if needed. otherwise the unit keeps rendering silence,
+    // so the next feed plays without start-up latency
+    if (remainingFrames == 0 && !instance->_mixer->clips_playing() && !instance->_keepRunningWhenEmpty) {
+        events |= kRenderEventEmpty;
+    }
+
+    // should request more frames?
+    size_t feedThreshold = (size_t)instance->_feedThreshold.load(std::memory_order_relaxed);
+    if (remainingFrames <= feedThreshold && !instance->_didInvokeFeedCallback.exchange(true)) {
+        // ask for enough to stay one render cycle beyond the threshold
+        size_t target = feedThreshold + inNumberFrames;
+        size_t requestedFrames = remainingFrames < target ? target - remainingFrames : inNumberFrames;
+        instance->_pendingRemainingFrames.store(remainingFrames);
+        instance->_pendingRequestedFrames.store(requestedFrames);
+        events |= kRenderEventFeed;
+        PCM_TRACE_INSTANT("feed_request");
+    }
+
+    if (events != 0) {
+        dispatch_source_merge_data(instance->_renderEvents, events);
+    }
+
+    return noErr;
+}
+
+@end
+
+// Looked up by name from Dart, so it must survive dead-stripping and
+// -fvisibility=hidden
+__attribute__((visibility("default"), used))
+int64_t flutter_pcm_sound_ffi_feed(const uint8_t *data, int64_t length)
+{
+    FlutterPcmSoundPlugin *instance = sFfiInstance;
+    if (instance == nil || instance.mDidSetup == false || length < 0) {
+        return -1;
+    }
+    // a blocked feed on the main thread would hold off the calls that end it
+    NSUInteger queued = 0;
+    if ([instance queueSamples:data length:(NSUInteger)length queued:&queued blocking:![NSThread isMainThread]] != noErr) {
+        return -1;
+    }
+    return (int64_t)queued;
+}
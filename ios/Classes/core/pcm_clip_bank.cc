@@ -0,0 +1 @@
+../../../src/pcm_clip_bank.cc
\ No newline at end of file
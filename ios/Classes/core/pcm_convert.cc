@@ -0,0 +1 @@
+../../../src/pcm_convert.cc
\ No newline at end of file
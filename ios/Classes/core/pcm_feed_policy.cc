@@ -0,0 +1 @@
+../../../src/pcm_feed_policy.cc
\ No newline at end of file
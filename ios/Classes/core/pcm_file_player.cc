@@ -0,0 +1 @@
+../../../src/pcm_file_player.cc
\ No newline at end of file
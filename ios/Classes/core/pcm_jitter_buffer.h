@@ -0,0 +1 @@
+../../../src/pcm_jitter_buffer.h
\ No newline at end of file
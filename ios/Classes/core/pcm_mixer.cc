@@ -0,0 +1 @@
+../../../src/pcm_mixer.cc
\ No newline at end of file
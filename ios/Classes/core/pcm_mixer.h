@@ -0,0 +1 @@
+../../../src/pcm_mixer.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_ring_buffer.cc
\ No newline at end of file
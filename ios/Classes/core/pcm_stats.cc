@@ -0,0 +1 @@
+../../../src/pcm_stats.cc
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_time_stretch.cc
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_trace.h
\ No newline at end of file
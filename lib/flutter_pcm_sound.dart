@@ -1,10 +1,9 @@
-import 'dart:io';
 import 'dart:math' as math;
 import 'dart:async';
 import 'dart:typed_data';
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
-import 'package:flutter_pcm_sound/flutter_pcm_sound_windows.dart';
+import 'package:flutter_pcm_sound/flutter_pcm_sound_ffi.dart';
 
 enum LogLevel {
   none,
@@ -21,15 +20,534 @@ enum IosAudioCategory {
   playAndRecord // 
 }
 
+// Sample formats. Samples are passed to the platform as-is, little endian
+enum PcmFormat {
+  s16le, // 16-bit signed integer. use PcmArrayInt16
+  s24le, // 24-bit signed integer, in the low bits of 32. use PcmArrayInt32
+  s32le, // 32-bit signed integer. use PcmArrayInt32
+  f32le, // 32-bit float, -1.0 to 1.0. use PcmArrayFloat32
+}
+
+// Device buffer geometry presets (Linux)
+enum PcmLatencyProfile {
+  standard, // large periods, starts once the device buffer is 75% full
+  lowLatency, // smallest stable period the device supports, starts after one period
+}
+
+// How samples reach the device (Linux)
+enum PcmTransferMode {
+  readWrite, // snd_pcm_writei, works on every device
+  mmap, // fill the DMA area directly. falls back to readWrite if refused
+}
+
+// Real-time scheduling policy for the audio thread (Linux)
+enum PcmRealtimePolicy {
+  fifo, // SCHED_FIFO
+  rr, // SCHED_RR
+}
+
+// Resampler used when the device doesn't run at the requested rate (Linux)
+enum PcmResampleQuality {
+  low, // 16 taps, ~60 dB stopband
+  medium, // 32 taps, ~90 dB stopband
+  high, // 64 taps, ~120 dB stopband
+}
+
+// What feed does with samples that don't fit in the queue, which setup
+// sizes for `maxQueueDuration` and which never grows
+enum PcmFeedPolicy {
+  partial, // queue the frames that fit and drop the rest
+  reject, // queue all of the frames or none of them
+  block, // wait, up to as long as the samples take to play, for room.
+  // only FFI feeds wait, on a helper isolate so the calling isolate keeps
+  // running; method channel feeds queue what fits, as partial. a native
+  // feed on the platform thread never waits either
+}
+
+/// the device configuration negotiated by `setup`.
+/// fields are null when the platform does not report them.
+class PcmSetupResult {
+  final int? streamId; // the primary stream, always 0
+  final int? sampleRate;
+  final int? channelCount;
+  final int? bufferFrames;
+  final int? periodFrames;
+  final int? startThresholdFrames;
+  final PcmTransferMode? transferMode;
+  final bool? realtimeGranted; // did the audio thread get real-time priority?
+  final String? realtimeMethod; // 'pthread', 'rtkit', 'mmcss' or 'none'
+  final bool? cpuAffinityGranted;
+  final PcmFormat? deviceSampleFormat; // what the device plays, if converted natively
+  final int? deviceChannelCount;
+  final int? deviceSampleRate; // differs from sampleRate when resampling natively
+  final bool? exclusiveMode; // Windows, Android: did the stream open in exclusive mode?
+  final String? audioApi; // Android: 'aaudio', or 'audioTrack' below Android 8
+  final String? deviceId; // Linux: the ALSA device opened
+  final int? maxQueueFrames; // how much the sample queue holds
+  final PcmFeedPolicy? feedPolicy;
+
+  PcmSetupResult({
+    this.streamId,
+    this.sampleRate,
+    this.channelCount,
+    this.bufferFrames,
+    this.periodFrames,
+    this.startThresholdFrames,
+    this.transferMode,
+    this.realtimeGranted,
+    this.realtimeMethod,
+    this.cpuAffinityGranted,
+    this.deviceSampleFormat,
+    this.deviceChannelCount,
+    this.deviceSampleRate,
+    this.exclusiveMode,
+    this.audioApi,
+    this.deviceId,
+    this.maxQueueFrames,
+    this.feedPolicy,
+  });
+
+  factory PcmSetupResult.fromMap(dynamic map) {
+    if (map is! Map) {
+      return PcmSetupResult();
+    }
+    return PcmSetupResult(
+      streamId: map['stream_id'],
+      sampleRate: map['sample_rate'],
+      channelCount: map['num_channels'],
+      bufferFrames: map['buffer_frames'],
+      periodFrames: map['period_frames'],
+      startThresholdFrames: map['start_threshold_frames'],
+      transferMode: _enumByName(PcmTransferMode.values, map['transfer_mode']),
+      realtimeGranted: map['realtime_granted'],
+      realtimeMethod: map['realtime_method'],
+      cpuAffinityGranted: map['cpu_affinity_granted'],
+      deviceSampleFormat: _enumByName(PcmFormat.values, map['device_sample_format']),
+      deviceChannelCount: map['device_channels'],
+      deviceSampleRate: map['device_sample_rate'],
+      exclusiveMode: map['exclusive_mode'],
+      audioApi: map['audio_api'],
+      deviceId: map['device_id'],
+      maxQueueFrames: map['max_queue_frames'],
+      feedPolicy: _enumByName(PcmFeedPolicy.values, map['feed_policy']),
+    );
+  }
+
+  @override
+  String toString() {
+    return 'PcmSetupResult(streamId: $streamId, sampleRate: $sampleRate, channelCount: $channelCount, '
+        'bufferFrames: $bufferFrames, periodFrames: $periodFrames, '
+        'startThresholdFrames: $startThresholdFrames, transferMode: $transferMode, '
+        'realtimeGranted: $realtimeGranted, realtimeMethod: $realtimeMethod, '
+        'cpuAffinityGranted: $cpuAffinityGranted, deviceSampleFormat: $deviceSampleFormat, '
+        'deviceChannelCount: $deviceChannelCount, deviceSampleRate: $deviceSampleRate, '
+        'exclusiveMode: $exclusiveMode, audioApi: $audioApi, deviceId: $deviceId, '
+        'maxQueueFrames: $maxQueueFrames, feedPolicy: $feedPolicy)';
+  }
+}
+
+/// an output device, from `listDevices`
+class PcmDevice {
+  // pass to setup's deviceId. an ALSA PCM name on Linux (hw:, plughw:
+  // and the configured plugins), a CoreAudio device UID on macOS, and a
+  // port of the current route on iOS
+  final String id;
+  final String name;
+  final String description;
+  final bool isDefault;
+
+  PcmDevice(
+      {required this.id,
+      required this.name,
+      this.description = '',
+      this.isDefault = false});
+
+  factory PcmDevice.fromMap(dynamic map) {
+    return PcmDevice(
+      id: map['id'],
+      name: map['name'] ?? map['id'],
+      description: map['description'] ?? '',
+      isDefault: map['is_default'] ?? false,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'PcmDevice(id: $id, name: $name, description: $description, isDefault: $isDefault)';
+  }
+}
+
+/// one more device, played at the same time as the main output and
+/// independent of it: its own queue, audio thread and callbacks
+/// (Linux, iOS, macOS). from `FlutterPcmSound.openOutput`
+class PcmOutput {
+  final int id;
+
+  Function(int)? _onFeedSamplesCallback;
+  Function(PcmFeedStatus)? _onFeedStatusCallback;
+  Function(PcmStats)? _onStatsCallback;
+
+  PcmOutput._(this.id);
+
+  Future<T?> _invokeMethod<T>(String method, [Map<String, dynamic>? arguments]) {
+    return FlutterPcmSoundDelegatingToNative._invokeMethod<T>(
+        method, {...?arguments, 'output_id': id});
+  }
+
+  /// like `FlutterPcmSound.setup`, for this output
+  Future<PcmSetupResult> setup(
+      {required int sampleRate,
+      required int channelCount,
+      PcmFormat sampleFormat = PcmFormat.s16le,
+      String? deviceId,
+      PcmLatencyProfile latencyProfile = PcmLatencyProfile.standard,
+      int? bufferFrames,
+      int? periodFrames,
+      int realtimePriority = 0,
+      PcmResampleQuality resampleQuality = PcmResampleQuality.medium,
+      Duration? maxQueueDuration,
+      PcmFeedPolicy feedPolicy = PcmFeedPolicy.partial}) async {
+    var result = await _invokeMethod('setup', {
+      'sample_rate': sampleRate,
+      'num_channels': channelCount,
+      'sample_format': sampleFormat.name,
+      if (deviceId != null) 'device_id': deviceId,
+      'latency_profile': latencyProfile.name,
+      if (bufferFrames != null) 'buffer_frames': bufferFrames,
+      if (periodFrames != null) 'period_frames': periodFrames,
+      'realtime_priority': realtimePriority,
+      'resample_quality': resampleQuality.name,
+      if (maxQueueDuration != null) 'max_queue_us': maxQueueDuration.inMicroseconds,
+      'feed_policy': feedPolicy.name,
+    });
+    return PcmSetupResult.fromMap(result);
+  }
+
+  /// queue samples, in the format passed to this output's `setup`. goes
+  /// through the method channel, not FFI. returns how many frames were
+  /// accepted
+  Future<int> feed(PcmArray buffer) async {
+    return (await _invokeMethod<int>('feed', {
+      'buffer': buffer.bytes.buffer
+          .asUint8List(buffer.bytes.offsetInBytes, buffer.bytes.lengthInBytes),
+    }))!;
+  }
+
+  Future<void> setFeedThreshold(int threshold) async {
+    return await _invokeMethod('setFeedThreshold', {'feed_threshold': threshold});
+  }
+
+  void setFeedCallback(Function(int)? callback) {
+    _onFeedSamplesCallback = callback;
+    FlutterPcmSoundDelegatingToNative._listen();
+  }
+
+  void setFeedStatusCallback(Function(PcmFeedStatus)? callback) {
+    _onFeedStatusCallback = callback;
+    FlutterPcmSoundDelegatingToNative._listen();
+  }
+
+  Future<PcmStats> getStats() async {
+    return PcmStats.fromMap(await _invokeMethod('getStats'));
+  }
+
+  Future<void> setStatsInterval(Duration? interval) async {
+    return await _invokeMethod(
+        'setStatsInterval', {'interval_ms': interval?.inMilliseconds ?? 0});
+  }
+
+  void setStatsCallback(Function(PcmStats)? callback) {
+    _onStatsCallback = callback;
+    FlutterPcmSoundDelegatingToNative._listen();
+  }
+
+  Future<void> flush() async {
+    return await _invokeMethod('flush');
+  }
+
+  Future<void> pause() async {
+    return await _invokeMethod('pause');
+  }
+
+  Future<void> resume() async {
+    return await _invokeMethod('resume');
+  }
+
+  /// play out what is queued, then close the device. the output can't be
+  /// used afterwards
+  Future<void> close() async {
+    FlutterPcmSoundDelegatingToNative._outputs.remove(id);
+    return await _invokeMethod('closeOutput');
+  }
+
+  void _handleCall(MethodCall call) {
+    switch (call.method) {
+      case 'OnFeedSamples':
+        int remainingFrames = call.arguments["remaining_frames"];
+        _onFeedSamplesCallback?.call(remainingFrames);
+        _onFeedStatusCallback?.call(PcmFeedStatus(
+            remainingFrames: remainingFrames,
+            remainingMicros: call.arguments["remaining_us"],
+            requestedFrames: call.arguments["requested_frames"],
+            requestedBytes: call.arguments["requested_bytes"]));
+        break;
+      case 'OnStats':
+        _onStatsCallback?.call(PcmStats.fromMap(call.arguments));
+        break;
+    }
+  }
+}
+
+/// passed to the feed status callback
+class PcmFeedStatus {
+  // frames left to play before the audio runs dry. on Linux this counts
+  // the device buffer as well as the queue
+  final int remainingFrames;
+  // the same, in microseconds. null when the platform does not report it
+  final int? remainingMicros;
+  // how much to feed to stay one period beyond the feed threshold, so a
+  // single correctly sized buffer answers the request. null when the
+  // platform does not report it
+  final int? requestedFrames;
+  final int? requestedBytes;
+
+  PcmFeedStatus(
+      {required this.remainingFrames,
+      this.remainingMicros,
+      this.requestedFrames,
+      this.requestedBytes});
+
+  @override
+  String toString() {
+    return 'PcmFeedStatus(remainingFrames: $remainingFrames, remainingMicros: $remainingMicros, '
+        'requestedFrames: $requestedFrames, requestedBytes: $requestedBytes)';
+  }
+}
+
+/// playback telemetry for the primary stream, counted since `setup`
+/// (Linux, Windows, iOS and macOS)
+class PcmStats {
+  // times the device ran out of samples. this includes the queue running
+  // dry at the end of playback
+  final int underruns;
+  // device calls that failed for other reasons
+  final int deviceErrors;
+  // underruns the device came back from, and how long until fed samples
+  // were playing again
+  final int recoveries;
+  final int recoveryMicrosTotal;
+  final int recoveryMicrosMax;
+  // fewest and most frames queued whenever the device took samples.
+  // queueLowFrames is null until it has
+  final int queueHighFrames;
+  final int? queueLowFrames;
+  // times the device asked for samples, and feed callbacks sent
+  final int deviceCallbacks;
+  final int feedCallbacks;
+  // bytes accepted by `feed`, and handed to the device
+  final int bytesFed;
+  final int bytesPlayed;
+  // feed-to-play latency: how long each feed waited until its first
+  // sample went to the device. bucket i counts feeds that took under
+  // 2^i ms, the last bucket everything slower
+  final List<int> latencyHistogram;
+  // with `setAdaptiveBuffer` on: the queue depth it is aiming for, and the
+  // speed it last played at. null otherwise (Linux)
+  final int? adaptiveTargetFrames;
+  final double? adaptiveSpeed;
+
+  PcmStats(
+      {this.underruns = 0,
+      this.deviceErrors = 0,
+      this.recoveries = 0,
+      this.recoveryMicrosTotal = 0,
+      this.recoveryMicrosMax = 0,
+      this.queueHighFrames = 0,
+      this.queueLowFrames,
+      this.deviceCallbacks = 0,
+      this.feedCallbacks = 0,
+      this.bytesFed = 0,
+      this.bytesPlayed = 0,
+      this.latencyHistogram = const [],
+      this.adaptiveTargetFrames,
+      this.adaptiveSpeed});
+
+  factory PcmStats.fromMap(dynamic map) {
+    if (map is! Map) {
+      return PcmStats();
+    }
+    return PcmStats(
+      underruns: map['underruns'] ?? 0,
+      deviceErrors: map['device_errors'] ?? 0,
+      recoveries: map['recoveries'] ?? 0,
+      recoveryMicrosTotal: map['recovery_us_total'] ?? 0,
+      recoveryMicrosMax: map['recovery_us_max'] ?? 0,
+      queueHighFrames: map['queue_high_frames'] ?? 0,
+      queueLowFrames: map['queue_low_frames'],
+      deviceCallbacks: map['device_callbacks'] ?? 0,
+      feedCallbacks: map['feed_callbacks'] ?? 0,
+      bytesFed: map['bytes_fed'] ?? 0,
+      bytesPlayed: map['bytes_played'] ?? 0,
+      latencyHistogram: List<int>.from(map['latency_histogram'] ?? const []),
+      adaptiveTargetFrames: map['adaptive_target_frames'],
+      adaptiveSpeed: (map['adaptive_speed'] as num?)?.toDouble(),
+    );
+  }
+
+  @override
+  String toString() {
+    return 'PcmStats(underruns: $underruns, deviceErrors: $deviceErrors, recoveries: $recoveries, '
+        'recoveryMicrosTotal: $recoveryMicrosTotal, recoveryMicrosMax: $recoveryMicrosMax, '
+        'queueHighFrames: $queueHighFrames, queueLowFrames: $queueLowFrames, '
+        'deviceCallbacks: $deviceCallbacks, feedCallbacks: $feedCallbacks, '
+        'bytesFed: $bytesFed, bytesPlayed: $bytesPlayed, latencyHistogram: $latencyHistogram, '
+        'adaptiveTargetFrames: $adaptiveTargetFrames, adaptiveSpeed: $adaptiveSpeed)';
+  }
+}
+
+/// how far playback has got, for syncing to other clocks
+/// (Linux, Windows, iOS and macOS)
+class PcmPlaybackPosition {
+  // frames fed that have reached the speaker, at the setup sample rate
+  final int frames;
+  // host time that was true at, on the clock `startAt` takes
+  final int hostTimeNs;
+  // false while primed, or before the device has started
+  final bool running;
+
+  PcmPlaybackPosition(
+      {this.frames = 0, this.hostTimeNs = 0, this.running = false});
+
+  factory PcmPlaybackPosition.fromMap(dynamic map) {
+    if (map is! Map) {
+      return PcmPlaybackPosition();
+    }
+    return PcmPlaybackPosition(
+      frames: map['frames'] ?? 0,
+      hostTimeNs: map['host_time_ns'] ?? 0,
+      running: map['running'] ?? false,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'PcmPlaybackPosition(frames: $frames, hostTimeNs: $hostTimeNs, running: $running)';
+  }
+}
+
+/// the layout of a headerless PCM file for `playFile`
+class PcmRawFormat {
+  final int sampleRate;
+  final int channelCount;
+  final PcmFormat sampleFormat;
+
+  const PcmRawFormat(
+      {required this.sampleRate,
+      required this.channelCount,
+      this.sampleFormat = PcmFormat.s16le});
+
+  Map<String, dynamic> toMap() {
+    return {
+      'sample_rate': sampleRate,
+      'num_channels': channelCount,
+      'sample_format': sampleFormat.name,
+    };
+  }
+}
+
+/// what `playFile` opened. the file is converted to the setup format as
+/// it is queued
+class PcmFileInfo {
+  final int sampleRate;
+  final int channelCount;
+  // null when the file can't tell ahead of time
+  final Duration? duration;
+
+  PcmFileInfo({this.sampleRate = 0, this.channelCount = 0, this.duration});
+
+  factory PcmFileInfo.fromMap(dynamic map) {
+    if (map is! Map) {
+      return PcmFileInfo();
+    }
+    int? durationUs = map['duration_us'];
+    return PcmFileInfo(
+      sampleRate: map['sample_rate'] ?? 0,
+      channelCount: map['num_channels'] ?? 0,
+      duration: durationUs != null ? Duration(microseconds: durationUs) : null,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'PcmFileInfo(sampleRate: $sampleRate, channelCount: $channelCount, duration: $duration)';
+  }
+}
+
+/// sent once a file is fully queued (it is still playing out), or
+/// decoding it failed part way
+class PcmFileDone {
+  final String path;
+  // null on success
+  final String? error;
+
+  PcmFileDone({required this.path, this.error});
+
+  @override
+  String toString() {
+    return 'PcmFileDone(path: $path, error: $error)';
+  }
+}
+
 abstract class FlutterPcmSoundImpl {
   Future<void> setLogLevel(LogLevel level);
-  Future<void> setup(
+  Future<PcmSetupResult> setup(
       {required int sampleRate,
       required int channelCount,
-      IosAudioCategory iosAudioCategory});
-  Future<void> feed(PcmArrayInt16 buffer);
+      IosAudioCategory iosAudioCategory,
+      PcmFormat sampleFormat,
+      PcmLatencyProfile latencyProfile,
+      int? bufferFrames,
+      int? periodFrames,
+      int? startThresholdFrames,
+      PcmTransferMode transferMode,
+      int realtimePriority,
+      PcmRealtimePolicy realtimePolicy,
+      List<int>? cpuAffinity,
+      PcmResampleQuality resampleQuality,
+      bool keepRunningWhenEmpty,
+      bool exclusiveMode,
+      String? deviceId,
+      Duration? maxQueueDuration,
+      PcmFeedPolicy feedPolicy});
+  Future<int> feed(PcmArray buffer, {int streamId});
+  Future<int> addStream({double gain, double pan});
+  Future<void> removeStream(int streamId);
+  Future<void> setStreamGain(int streamId, {double gain, double pan});
   Future<void> setFeedThreshold(int threshold);
   void setFeedCallback(Function(int)? callback);
+  void setFeedStatusCallback(Function(PcmFeedStatus)? callback);
+  Future<PcmStats> getStats();
+  Future<void> setStatsInterval(Duration? interval);
+  Future<void> setAdaptiveBuffer(
+      {required bool enabled, Duration minDepth, Duration maxDepth});
+  Future<List<PcmDevice>> listDevices();
+  Future<PcmOutput> openOutput();
+  void setStatsCallback(Function(PcmStats)? callback);
+  Future<void> prime();
+  Future<void> startAt(int hostTimeNs);
+  Future<PcmPlaybackPosition> getPlaybackPosition();
+  Future<PcmFileInfo> playFile(String path, {PcmRawFormat? raw});
+  Future<PcmFileInfo> playUri(Uri uri);
+  Future<void> stopFile();
+  void setFileDoneCallback(Function(PcmFileDone)? callback);
+  Future<void> loadClip(String clipId, PcmArray buffer,
+      {int? sampleRate, int? channelCount, PcmFormat? sampleFormat});
+  Future<int> playClip(String clipId, {double gain, double pan});
+  Future<void> unloadClip(String clipId);
+  Future<void> setClipCacheLimit(int bytes);
+  Future<void> flush();
+  Future<void> pause();
+  Future<void> resume();
   void start();
   Future<void> release();
 }
@@ -39,6 +557,25 @@ class FlutterPcmSoundDelegatingToNative implements FlutterPcmSoundImpl {
       const MethodChannel('flutter_pcm_sound/methods');
 
   static Function(int)? onFeedSamplesCallback;
+  static Function(PcmFeedStatus)? onFeedStatusCallback;
+  static Function(PcmStats)? onStatsCallback;
+  static Function(PcmFileDone)? onFileDoneCallback;
+
+  // outputs from openOutput, which get the calls tagged with their id
+  static final Map<int, PcmOutput> _outputs = {};
+
+  // null on platforms without the native FFI entry point
+  static final PcmFfiFeeder? _ffiFeeder = PcmFfiFeeder.open();
+
+  // false when setup picked a backend that only takes the method channel
+  // (AudioTrack on Android)
+  static bool _ffiEnabled = true;
+
+  // what setup configured, to count the frames the FFI feed accepted
+  static int _bytesPerFrame = 2;
+
+  // block policy: FFI feeds go through the helper isolate
+  static bool _blockingFeeds = false;
 
   static LogLevel _logLevel = LogLevel.standard;
 
@@ -51,21 +588,113 @@ class FlutterPcmSoundDelegatingToNative implements FlutterPcmSoundImpl {
   /// setup audio
   /// 'avAudioCategory' is for iOS only,
   /// enabled by default on other platforms
-  Future<void> setup(
+  /// 'latencyProfile' is for Linux, Windows and Android (AAudio), and
+  /// 'bufferFrames' for Linux and Windows
+  /// 'periodFrames', 'startThresholdFrames' and 'transferMode' are for
+  /// Linux only
+  /// 'realtimePriority' (1-99, 0 = off), 'realtimePolicy' and
+  /// 'cpuAffinity' apply to the Linux audio thread
+  /// 'resampleQuality' is for Linux, Windows and Android (AAudio), when
+  /// the device runs at another rate
+  /// 'keepRunningWhenEmpty' is for iOS and macOS: the audio unit plays
+  /// silence instead of stopping when the queue runs dry, so the next
+  /// feed starts without start-up latency
+  /// 'exclusiveMode' is for Windows: open the endpoint in WASAPI exclusive
+  /// mode, bypassing the system mixer. setup fails if the device refuses
+  /// every PCM format. On Android it asks AAudio for an exclusive (MMAP)
+  /// stream, falling back to a shared one where the device has none
+  /// 'deviceId' is an id from `listDevices`, for Linux, iOS and macOS
+  /// 'maxQueueDuration' caps how much audio can be queued ahead (10 s by
+  /// default); the queue is allocated up front at that size. 'feedPolicy'
+  /// says what feed does with samples beyond it
+  Future<PcmSetupResult> setup(
       {required int sampleRate,
       required int channelCount,
-      IosAudioCategory iosAudioCategory = IosAudioCategory.playback}) async {
-    return await _invokeMethod('setup', {
+      IosAudioCategory iosAudioCategory = IosAudioCategory.playback,
+      PcmFormat sampleFormat = PcmFormat.s16le,
+      PcmLatencyProfile latencyProfile = PcmLatencyProfile.standard,
+      int? bufferFrames,
+      int? periodFrames,
+      int? startThresholdFrames,
+      PcmTransferMode transferMode = PcmTransferMode.readWrite,
+      int realtimePriority = 0,
+      PcmRealtimePolicy realtimePolicy = PcmRealtimePolicy.fifo,
+      List<int>? cpuAffinity,
+      PcmResampleQuality resampleQuality = PcmResampleQuality.medium,
+      bool keepRunningWhenEmpty = false,
+      bool exclusiveMode = false,
+      String? deviceId,
+      Duration? maxQueueDuration,
+      PcmFeedPolicy feedPolicy = PcmFeedPolicy.partial}) async {
+    var result = await _invokeMethod('setup', {
       'sample_rate': sampleRate,
       'num_channels': channelCount,
       'ios_audio_category': iosAudioCategory.name,
+      'sample_format': sampleFormat.name,
+      'latency_profile': latencyProfile.name,
+      if (bufferFrames != null) 'buffer_frames': bufferFrames,
+      if (periodFrames != null) 'period_frames': periodFrames,
+      if (startThresholdFrames != null) 'start_threshold_frames': startThresholdFrames,
+      'transfer_mode': transferMode.name,
+      'realtime_priority': realtimePriority,
+      'realtime_policy': realtimePolicy.name,
+      if (cpuAffinity != null) 'cpu_affinity': cpuAffinity,
+      'resample_quality': resampleQuality.name,
+      'keep_running_when_empty': keepRunningWhenEmpty,
+      'exclusive_mode': exclusiveMode,
+      if (deviceId != null) 'device_id': deviceId,
+      if (maxQueueDuration != null) 'max_queue_us': maxQueueDuration.inMicroseconds,
+      'feed_policy': feedPolicy.name,
     });
+    _ffiEnabled = !(result is Map && result['ffi_feed'] == false);
+    _bytesPerFrame = (sampleFormat == PcmFormat.s16le ? 2 : 4) * channelCount;
+    _blockingFeeds = feedPolicy == PcmFeedPolicy.block;
+    return PcmSetupResult.fromMap(result);
   }
 
-  /// queue 16-bit samples (little endian)
-  Future<void> feed(PcmArrayInt16 buffer) async {
+  /// queue samples (little endian), in the format passed to `setup`.
+  /// returns how many frames were accepted
+  Future<int> feed(PcmArray buffer, {int streamId = 0}) async {
+    // where the native plugin exports it, skip the codec entirely
+    final ffi = _ffiEnabled ? _ffiFeeder : null;
+    if (ffi != null && (streamId == 0 || ffi.supportsStreams)) {
+      if (_logLevel.index >= LogLevel.standard.index) {
+        print("[PCM] ffi feed: stream $streamId (${buffer.bytes.lengthInBytes} bytes)");
+      }
+      final written = _blockingFeeds
+          ? await ffi.feedInBackground(buffer.bytes, streamId: streamId)
+          : ffi.feed(buffer.bytes, streamId: streamId);
+      if (written < 0) {
+        throw PlatformException(
+            code: 'NOT_INITIALIZED', message: 'must call setup first, with a valid stream');
+      }
+      return written ~/ _bytesPerFrame;
+    }
+    return (await _invokeMethod<int>('feed', {
+      'buffer': buffer.bytes.buffer
+          .asUint8List(buffer.bytes.offsetInBytes, buffer.bytes.lengthInBytes),
+      if (streamId != 0) 'stream_id': streamId,
+    }))!;
+  }
+
+  /// add a stream that is mixed over the primary one (Linux).
+  /// it uses the format and channel count passed to `setup`.
+  /// returns the id to pass to `feed`
+  Future<int> addStream({double gain = 1.0, double pan = 0.0}) async {
+    final result = await _invokeMethod('addStream', {'gain': gain, 'pan': pan});
+    return result['stream_id'];
+  }
+
+  /// stop and drop a stream returned by `addStream`
+  Future<void> removeStream(int streamId) async {
+    return await _invokeMethod('removeStream', {'stream_id': streamId});
+  }
+
+  /// linear gain, and pan from -1 (left) to 1 (right), for
+  /// any stream. 0 is the primary stream
+  Future<void> setStreamGain(int streamId, {double gain = 1.0, double pan = 0.0}) async {
     return await _invokeMethod(
-        'feed', {'buffer': buffer.bytes.buffer.asUint8List()});
+        'setStreamGain', {'stream_id': streamId, 'gain': gain, 'pan': pan});
   }
 
   /// set the threshold at which we call the
@@ -83,6 +712,144 @@ class FlutterPcmSoundDelegatingToNative implements FlutterPcmSoundImpl {
     _channel.setMethodCallHandler(_methodCallHandler);
   }
 
+  /// like the feed callback, but with the remaining time as well
+  void setFeedStatusCallback(Function(PcmFeedStatus)? callback) {
+    onFeedStatusCallback = callback;
+    _channel.setMethodCallHandler(_methodCallHandler);
+  }
+
+  /// playback telemetry since `setup`
+  Future<PcmStats> getStats() async {
+    return PcmStats.fromMap(await _invokeMethod('getStats'));
+  }
+
+  /// push stats to the stats callback every `interval`. null stops it
+  Future<void> setStatsInterval(Duration? interval) async {
+    return await _invokeMethod(
+        'setStatsInterval', {'interval_ms': interval?.inMilliseconds ?? 0});
+  }
+
+  /// play the primary stream through the adaptive jitter buffer
+  Future<void> setAdaptiveBuffer(
+      {required bool enabled,
+      Duration minDepth = const Duration(milliseconds: 40),
+      Duration maxDepth = const Duration(milliseconds: 500)}) async {
+    return await _invokeMethod('setAdaptiveBuffer', {
+      'enabled': enabled,
+      'min_us': minDepth.inMicroseconds,
+      'max_us': maxDepth.inMicroseconds,
+    });
+  }
+
+  /// output devices that setup's `deviceId` can name
+  Future<List<PcmDevice>> listDevices() async {
+    final List<dynamic>? result = await _invokeMethod('listDevices');
+    return (result ?? const []).map((device) => PcmDevice.fromMap(device)).toList();
+  }
+
+  /// another output, set up and fed on its own
+  Future<PcmOutput> openOutput() async {
+    final result = await _invokeMethod('openOutput');
+    final output = PcmOutput._(result['output_id']);
+    _outputs[output.id] = output;
+    return output;
+  }
+
+  static void _listen() {
+    _channel.setMethodCallHandler(_methodCallHandler);
+  }
+
+  /// receives the stats pushed by `setStatsInterval`
+  void setStatsCallback(Function(PcmStats)? callback) {
+    onStatsCallback = callback;
+    _channel.setMethodCallHandler(_methodCallHandler);
+  }
+
+  /// hold the device until `startAt`, so feeds pre-roll the queue
+  Future<void> prime() async {
+    return await _invokeMethod('prime');
+  }
+
+  /// start a primed stream with its first frame at `hostTimeNs`
+  Future<void> startAt(int hostTimeNs) async {
+    return await _invokeMethod('startAt', {'host_time_ns': hostTimeNs});
+  }
+
+  /// frames played, and the host time they were played by
+  Future<PcmPlaybackPosition> getPlaybackPosition() async {
+    return PcmPlaybackPosition.fromMap(
+        await _invokeMethod('getPlaybackPosition'));
+  }
+
+  /// queue a file natively, converted to the setup format
+  Future<PcmFileInfo> playFile(String path, {PcmRawFormat? raw}) async {
+    return PcmFileInfo.fromMap(await _invokeMethod(
+        'playFile', {'path': path, if (raw != null) 'raw': raw.toMap()}));
+  }
+
+  /// file: URIs play as paths; anything else goes to the platform
+  Future<PcmFileInfo> playUri(Uri uri) async {
+    if (uri.scheme == 'file') {
+      return await playFile(uri.toFilePath());
+    }
+    return PcmFileInfo.fromMap(
+        await _invokeMethod('playUri', {'uri': uri.toString()}));
+  }
+
+  /// stop queueing the current file. what is queued still plays
+  Future<void> stopFile() async {
+    return await _invokeMethod('stopFile');
+  }
+
+  /// receives a PcmFileDone once a file is fully queued
+  void setFileDoneCallback(Function(PcmFileDone)? callback) {
+    onFileDoneCallback = callback;
+    _channel.setMethodCallHandler(_methodCallHandler);
+  }
+
+  /// convert a clip natively and keep it, as `clipId`
+  Future<void> loadClip(String clipId, PcmArray buffer,
+      {int? sampleRate, int? channelCount, PcmFormat? sampleFormat}) async {
+    return await _invokeMethod('loadClip', {
+      'clip_id': clipId,
+      'buffer': buffer.bytes.buffer
+          .asUint8List(buffer.bytes.offsetInBytes, buffer.bytes.lengthInBytes),
+      if (sampleRate != null) 'sample_rate': sampleRate,
+      if (channelCount != null) 'num_channels': channelCount,
+      if (sampleFormat != null) 'sample_format': sampleFormat.name,
+    });
+  }
+
+  /// mix a loaded clip over the queue. returns its voice id
+  Future<int> playClip(String clipId, {double gain = 1.0, double pan = 0.0}) async {
+    return await _invokeMethod('playClip', {'clip_id': clipId, 'gain': gain, 'pan': pan});
+  }
+
+  /// drop a clip; voices playing it finish first
+  Future<void> unloadClip(String clipId) async {
+    return await _invokeMethod('unloadClip', {'clip_id': clipId});
+  }
+
+  /// most bytes of clips kept before evicting the least recently played
+  Future<void> setClipCacheLimit(int bytes) async {
+    return await _invokeMethod('setClipCacheLimit', {'bytes': bytes});
+  }
+
+  /// drop everything fed so far, keeping the device open
+  Future<void> flush() async {
+    return await _invokeMethod('flush');
+  }
+
+  /// hold playback where it is, keeping the queue
+  Future<void> pause() async {
+    return await _invokeMethod('pause');
+  }
+
+  /// continue after `pause`
+  Future<void> resume() async {
+    return await _invokeMethod('resume');
+  }
+
   /// convenience function:
   ///   * invokes your feed callback
   void start() {
@@ -102,9 +869,9 @@ class FlutterPcmSoundDelegatingToNative implements FlutterPcmSoundImpl {
         Uint8List data = arguments['buffer'];
         if (data.lengthInBytes > 6) {
           args =
-              '(${data.lengthInBytes ~/ 2} samples) ${data.sublist(0, 6)} ...';
+              '(${data.lengthInBytes} bytes) ${data.sublist(0, 6)} ...';
         } else {
-          args = '(${data.lengthInBytes ~/ 2} samples) $data';
+          args = '(${data.lengthInBytes} bytes) $data';
         }
       } else if (arguments != null) {
         args = arguments.toString();
@@ -120,12 +887,35 @@ class FlutterPcmSoundDelegatingToNative implements FlutterPcmSoundImpl {
       String args = call.arguments.toString();
       print("[PCM] $func $args");
     }
+    final outputId = call.arguments is Map ? call.arguments['output_id'] : null;
+    if (outputId != null) {
+      _outputs[outputId]?._handleCall(call);
+      return;
+    }
     switch (call.method) {
       case 'OnFeedSamples':
         int remainingFrames = call.arguments["remaining_frames"];
         if (onFeedSamplesCallback != null) {
           onFeedSamplesCallback!(remainingFrames);
         }
+        if (onFeedStatusCallback != null) {
+          onFeedStatusCallback!(PcmFeedStatus(
+              remainingFrames: remainingFrames,
+              remainingMicros: call.arguments["remaining_us"],
+              requestedFrames: call.arguments["requested_frames"],
+              requestedBytes: call.arguments["requested_bytes"]));
+        }
+        break;
+      case 'OnStats':
+        if (onStatsCallback != null) {
+          onStatsCallback!(PcmStats.fromMap(call.arguments));
+        }
+        break;
+      case 'OnFileDone':
+        if (onFileDoneCallback != null) {
+          onFileDoneCallback!(PcmFileDone(
+              path: call.arguments['path'], error: call.arguments['error']));
+        }
         break;
       default:
         print('Method not implemented');
@@ -135,13 +925,13 @@ class FlutterPcmSoundDelegatingToNative implements FlutterPcmSoundImpl {
 
 class FlutterPcmSound {
   static const isWeb = bool.fromEnvironment('dart.library.js_util');
-  static final _impl =
-      isWeb || !Platform.isWindows
-          ? FlutterPcmSoundDelegatingToNative()
-      : createWindowsImpl();
+  static final _impl = FlutterPcmSoundDelegatingToNative();
 
 
   static Function(int)? onFeedSamplesCallback;
+  static Function(PcmFeedStatus)? onFeedStatusCallback;
+  static Function(PcmStats)? onStatsCallback;
+  static Function(PcmFileDone)? onFileDoneCallback;
 
 
   /// set log level
@@ -152,25 +942,98 @@ class FlutterPcmSound {
   /// setup audio
   /// 'avAudioCategory' is for iOS only,
   /// enabled by default on other platforms
-  static Future<void> setup(
+  /// 'latencyProfile' is for Linux, Windows and Android (AAudio), and
+  /// 'bufferFrames' for Linux and Windows
+  /// 'periodFrames', 'startThresholdFrames' and 'transferMode' are for
+  /// Linux only
+  /// 'realtimePriority' (1-99, 0 = off), 'realtimePolicy' and
+  /// 'cpuAffinity' apply to the Linux audio thread
+  /// 'resampleQuality' is for Linux, Windows and Android (AAudio), when
+  /// the device runs at another rate
+  /// 'keepRunningWhenEmpty' is for iOS and macOS: the audio unit plays
+  /// silence instead of stopping when the queue runs dry, so the next
+  /// feed starts without start-up latency
+  /// 'exclusiveMode' is for Windows: open the endpoint in WASAPI exclusive
+  /// mode, bypassing the system mixer. setup fails if the device refuses
+  /// every PCM format. On Android it asks AAudio for an exclusive (MMAP)
+  /// stream, falling back to a shared one where the device has none
+  /// 'deviceId' is an id from `listDevices`, for Linux, iOS and macOS
+  /// 'maxQueueDuration' caps how much audio can be queued ahead (10 s by
+  /// default); the queue is allocated up front at that size. 'feedPolicy'
+  /// says what feed does with samples beyond it
+  static Future<PcmSetupResult> setup(
       {required int sampleRate,
       required int channelCount,
-      IosAudioCategory iosAudioCategory = IosAudioCategory.playback}) async {
+      IosAudioCategory iosAudioCategory = IosAudioCategory.playback,
+      PcmFormat sampleFormat = PcmFormat.s16le,
+      PcmLatencyProfile latencyProfile = PcmLatencyProfile.standard,
+      int? bufferFrames,
+      int? periodFrames,
+      int? startThresholdFrames,
+      PcmTransferMode transferMode = PcmTransferMode.readWrite,
+      int realtimePriority = 0,
+      PcmRealtimePolicy realtimePolicy = PcmRealtimePolicy.fifo,
+      List<int>? cpuAffinity,
+      PcmResampleQuality resampleQuality = PcmResampleQuality.medium,
+      bool keepRunningWhenEmpty = false,
+      bool exclusiveMode = false,
+      String? deviceId,
+      Duration? maxQueueDuration,
+      PcmFeedPolicy feedPolicy = PcmFeedPolicy.partial}) async {
     return await _impl.setup(
       sampleRate: sampleRate,
       channelCount: channelCount,
       iosAudioCategory: iosAudioCategory,
+      sampleFormat: sampleFormat,
+      latencyProfile: latencyProfile,
+      bufferFrames: bufferFrames,
+      periodFrames: periodFrames,
+      startThresholdFrames: startThresholdFrames,
+      transferMode: transferMode,
+      realtimePriority: realtimePriority,
+      realtimePolicy: realtimePolicy,
+      cpuAffinity: cpuAffinity,
+      resampleQuality: resampleQuality,
+      keepRunningWhenEmpty: keepRunningWhenEmpty,
+      exclusiveMode: exclusiveMode,
+      deviceId: deviceId,
+      maxQueueDuration: maxQueueDuration,
+      feedPolicy: feedPolicy,
     );
   }
 
-  /// queue 16-bit samples (little endian)
-  static Future<void> feed(PcmArrayInt16 buffer) async {
-    return await _impl.feed(buffer);
+  /// queue samples (little endian), in the format passed to `setup`.
+  /// PcmArrayInt16 for s16le, PcmArrayInt32 for s24le/s32le,
+  /// PcmArrayFloat32 for f32le. returns how many frames were accepted:
+  /// fewer than fed when the queue is full, see `feedPolicy`
+  static Future<int> feed(PcmArray buffer, {int streamId = 0}) async {
+    return await _impl.feed(buffer, streamId: streamId);
+  }
+
+  /// add a stream that is mixed over the primary one, e.g. a UI
+  /// sound over streaming speech (Linux). it uses the format and
+  /// channel count passed to `setup`. returns the id to pass to `feed`.
+  /// feed callbacks are only for the primary stream
+  static Future<int> addStream({double gain = 1.0, double pan = 0.0}) async {
+    return await _impl.addStream(gain: gain, pan: pan);
+  }
+
+  /// stop and drop a stream returned by `addStream`
+  static Future<void> removeStream(int streamId) async {
+    return await _impl.removeStream(streamId);
+  }
+
+  /// linear gain, and pan from -1 (left) to 1 (right), for
+  /// any stream. 0 is the primary stream
+  static Future<void> setStreamGain(int streamId, {double gain = 1.0, double pan = 0.0}) async {
+    return await _impl.setStreamGain(streamId, gain: gain, pan: pan);
   }
 
   /// set the threshold at which we call the
   /// feed callback. i.e. if we have less than X
-  /// queued frames, the feed callback will be invoked
+  /// queued frames, the feed callback will be invoked.
+  /// on Linux, frames already in the device buffer count too,
+  /// so X is how much audio is left before it runs dry
   static Future<void> setFeedThreshold(int threshold) async {
     return await _impl.setFeedThreshold(threshold);
   }
@@ -182,6 +1045,159 @@ class FlutterPcmSound {
     _impl.setFeedCallback(callback);
   }
 
+  /// like the feed callback, but also reports the remaining
+  /// playback time, so a feeder can stay just one period ahead
+  static void setFeedStatusCallback(Function(PcmFeedStatus)? callback) {
+    onFeedStatusCallback = callback;
+    _impl.setFeedStatusCallback(callback);
+  }
+
+  /// playback telemetry since `setup`: underruns, recovery time, queue
+  /// watermarks, feed latency and byte counts (Linux, Windows, iOS, macOS)
+  static Future<PcmStats> getStats() async {
+    return await _impl.getStats();
+  }
+
+  /// push stats to the stats callback every `interval`, from the
+  /// platform side. null stops it
+  static Future<void> setStatsInterval(Duration? interval) async {
+    return await _impl.setStatsInterval(interval);
+  }
+
+  /// for jittery feeds, say from the network: keeps the queue at a depth
+  /// that follows how late feeds arrive and how often playback ran dry,
+  /// between `minDepth` and `maxDepth`, by playing slightly faster or
+  /// slower without changing the pitch. also works before `setup`, and
+  /// carries over to later setups (Linux)
+  static Future<void> setAdaptiveBuffer(
+      {required bool enabled,
+      Duration minDepth = const Duration(milliseconds: 40),
+      Duration maxDepth = const Duration(milliseconds: 500)}) async {
+    return await _impl.setAdaptiveBuffer(
+        enabled: enabled, minDepth: minDepth, maxDepth: maxDepth);
+  }
+
+  /// output devices, for setup's `deviceId`: ALSA PCMs including hw: and
+  /// plughw:, which skip the default chain's mixing and resampling, on
+  /// Linux; CoreAudio devices on macOS; the current route on iOS
+  static Future<List<PcmDevice>> listDevices() async {
+    return await _impl.listDevices();
+  }
+
+  /// opens another output, e.g. a headset next to the loudspeaker the
+  /// main output plays on. set it up with its own `deviceId`; it has its
+  /// own queue, audio thread, callbacks and stats (Linux, iOS, macOS)
+  static Future<PcmOutput> openOutput() async {
+    return await _impl.openOutput();
+  }
+
+  /// receives the stats pushed by `setStatsInterval`
+  static void setStatsCallback(Function(PcmStats)? callback) {
+    onStatsCallback = callback;
+    _impl.setStatsCallback(callback);
+  }
+
+  /// hold the device after `setup` (or while stopped) so feeds can fill
+  /// the queue without anything playing. call `startAt` to go
+  static Future<void> prime() async {
+    return await _impl.prime();
+  }
+
+  /// start a primed stream so its first frame reaches the speaker at
+  /// `hostTimeNs`, padding with silence until then. a time in the past
+  /// starts now. the clock is CLOCK_MONOTONIC on Linux,
+  /// mach_absolute_time in ns on iOS and macOS, and
+  /// QueryPerformanceCounter in ns on Windows; `getPlaybackPosition`
+  /// reports on the same clock
+  static Future<void> startAt(int hostTimeNs) async {
+    return await _impl.startAt(hostTimeNs);
+  }
+
+  /// frames that have reached the speaker, and the host time that was
+  /// true at. extrapolate from it to sync video or other streams
+  static Future<PcmPlaybackPosition> getPlaybackPosition() async {
+    return await _impl.getPlaybackPosition();
+  }
+
+  /// play a file without its samples passing through Dart. it is read on
+  /// a native thread, converted to the setup format and rate, and queued
+  /// behind whatever was fed before it; a file already playing is
+  /// stopped. WAV plays everywhere, straight from a memory mapping, as
+  /// does headerless PCM described by `raw`. iOS and macOS also decode
+  /// whatever ExtAudioFile can (MP3, AAC, FLAC, ALAC, Opus in CAF), and
+  /// Android 8+ whatever MediaCodec can (MP3, AAC, FLAC, Opus, Vorbis).
+  /// not on web
+  static Future<PcmFileInfo> playFile(String path, {PcmRawFormat? raw}) async {
+    return await _impl.playFile(path, raw: raw);
+  }
+
+  /// `playFile` for a URI. file: URIs play everywhere; content: and
+  /// android.resource: URIs on Android
+  static Future<PcmFileInfo> playUri(Uri uri) async {
+    return await _impl.playUri(uri);
+  }
+
+  /// stop queueing the current file. what is already queued still plays;
+  /// `flush` drops it
+  static Future<void> stopFile() async {
+    return await _impl.stopFile();
+  }
+
+  /// called once a file is fully queued, or failed to decode part way.
+  /// not called for files stopped by `stopFile`, `flush` or `release`
+  static void setFileDoneCallback(Function(PcmFileDone)? callback) {
+    onFileDoneCallback = callback;
+    _impl.setFileDoneCallback(callback);
+  }
+
+  /// load a short sound, e.g. a UI click, into native memory once, as
+  /// `clipId`. it is converted to float at the setup rate and channel
+  /// count up front, and is in the setup format unless told otherwise.
+  /// clips are kept until `unloadClip`, a `setup` with another rate or
+  /// channel count, `release`, or eviction by `setClipCacheLimit`.
+  /// loading an id again replaces it (Linux, iOS, macOS)
+  static Future<void> loadClip(String clipId, PcmArray buffer,
+      {int? sampleRate, int? channelCount, PcmFormat? sampleFormat}) async {
+    return await _impl.loadClip(clipId, buffer,
+        sampleRate: sampleRate, channelCount: channelCount, sampleFormat: sampleFormat);
+  }
+
+  /// play a loaded clip over whatever is queued, straight from the clip
+  /// cache: nothing is copied or converted. up to 16 clips play at once,
+  /// a clip can overlap itself, and `flush` stops them. returns the id of
+  /// the voice playing it
+  static Future<int> playClip(String clipId, {double gain = 1.0, double pan = 0.0}) async {
+    return await _impl.playClip(clipId, gain: gain, pan: pan);
+  }
+
+  /// free a clip. voices already playing it finish first
+  static Future<void> unloadClip(String clipId) async {
+    return await _impl.unloadClip(clipId);
+  }
+
+  /// keep at most `bytes` of clips (32 MiB by default), evicting the
+  /// least recently played. clips that are playing are never evicted
+  static Future<void> setClipCacheLimit(int bytes) async {
+    return await _impl.setClipCacheLimit(bytes);
+  }
+
+  /// stop right away and drop everything fed so far, on every stream.
+  /// the device stays open and warm, so the next feed plays with no
+  /// setup cost. feeds sent after this play as usual
+  static Future<void> flush() async {
+    return await _impl.flush();
+  }
+
+  /// stop right away, keeping everything queued. feeds still queue up
+  static Future<void> pause() async {
+    return await _impl.pause();
+  }
+
+  /// continue from where `pause` stopped
+  static Future<void> resume() async {
+    return await _impl.resume();
+  }
+
   /// convenience function:
   ///   * invokes your feed callback
   static void start() {
@@ -195,7 +1211,12 @@ class FlutterPcmSound {
   }
 }
 
-class PcmArrayInt16 {
+// raw sample bytes, in one of the PcmFormat layouts
+abstract class PcmArray {
+  ByteData get bytes;
+}
+
+class PcmArrayInt16 implements PcmArray {
   final ByteData bytes;
 
   PcmArrayInt16({required this.bytes});
@@ -227,6 +1248,70 @@ class PcmArrayInt16 {
   }
 }
 
+// for PcmFormat.s32le, and PcmFormat.s24le (values -8388608 to 8388607)
+class PcmArrayInt32 implements PcmArray {
+  final ByteData bytes;
+
+  PcmArrayInt32({required this.bytes});
+
+  factory PcmArrayInt32.zeros({required int count}) {
+    Uint8List list = Uint8List(count * 4);
+    return PcmArrayInt32(bytes: list.buffer.asByteData());
+  }
+
+  factory PcmArrayInt32.fromList(List<int> list) {
+    return PcmArrayInt32(bytes: Int32List.fromList(list).buffer.asByteData());
+  }
+
+  operator [](int idx) {
+    return bytes.getInt32(idx * 4, Endian.host);
+  }
+
+  operator []=(int idx, int value) {
+    return bytes.setInt32(idx * 4, value, Endian.host);
+  }
+}
+
+// for PcmFormat.f32le
+class PcmArrayFloat32 implements PcmArray {
+  final ByteData bytes;
+
+  PcmArrayFloat32({required this.bytes});
+
+  factory PcmArrayFloat32.zeros({required int count}) {
+    Uint8List list = Uint8List(count * 4);
+    return PcmArrayFloat32(bytes: list.buffer.asByteData());
+  }
+
+  // wraps the list without copying it
+  factory PcmArrayFloat32.fromFloat32List(Float32List list) {
+    return PcmArrayFloat32(
+        bytes: list.buffer.asByteData(list.offsetInBytes, list.lengthInBytes));
+  }
+
+  factory PcmArrayFloat32.fromList(List<double> list) {
+    return PcmArrayFloat32.fromFloat32List(Float32List.fromList(list));
+  }
+
+  operator [](int idx) {
+    return bytes.getFloat32(idx * 4, Endian.host);
+  }
+
+  operator []=(int idx, double value) {
+    return bytes.setFloat32(idx * 4, value, Endian.host);
+  }
+}
+
+// looks up an enum value sent over the channel by its name
+T? _enumByName<T extends Enum>(List<T> values, dynamic name) {
+  for (T value in values) {
+    if (value.name == name) {
+      return value;
+    }
+  }
+  return null;
+}
+
 // for testing
 class MajorScale {
   int _periodCount = 0;
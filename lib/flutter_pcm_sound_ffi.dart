@@ -0,0 +1,3 @@
+// Conditional export based on platform
+export 'flutter_pcm_sound_ffi_stub.dart'
+    if (dart.library.ffi) 'flutter_pcm_sound_ffi_real.dart';
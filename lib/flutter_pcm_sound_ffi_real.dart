@@ -0,0 +1,138 @@
+import 'dart:async';
+import 'dart:collection';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+typedef _FeedNative = Int64 Function(Pointer<Uint8> data, Int64 length);
+typedef _FeedDart = int Function(Pointer<Uint8> data, int length);
+typedef _FeedStreamNative = Int64 Function(Int64 streamId, Pointer<Uint8> data, Int64 length);
+typedef _FeedStreamDart = int Function(int streamId, Pointer<Uint8> data, int length);
+
+// Pushes samples straight into the native queue (Linux, iOS, macOS,
+// Windows, and Android with AAudio), skipping the method channel codec
+// and the async round trip.
+class PcmFfiFeeder {
+  final _FeedDart _feed;
+  final _FeedStreamDart? _feedStream; // only where the mixer exists
+
+  // Reused between calls, and only ever grows
+  Pointer<Uint8> _staging = nullptr;
+  int _stagingLength = 0;
+
+  // Started by the first feedInBackground
+  _PcmFfiWorker? _worker;
+
+  PcmFfiFeeder._(this._feed, this._feedStream);
+
+  bool get supportsStreams => _feedStream != null;
+
+  // Returns null when the native plugin doesn't export the entry point
+  static PcmFfiFeeder? open() {
+    if (!(Platform.isLinux || Platform.isIOS || Platform.isMacOS || Platform.isWindows || Platform.isAndroid)) {
+      return null;
+    }
+    final DynamicLibrary process;
+    try {
+      // Windows doesn't search loaded DLLs for process symbols, and
+      // Android loads plugin libraries with RTLD_LOCAL
+      if (Platform.isWindows) {
+        process = DynamicLibrary.open('flutter_pcm_sound_plugin.dll');
+      } else if (Platform.isAndroid) {
+        process = DynamicLibrary.open('libflutter_pcm_sound.so');
+      } else {
+        process = DynamicLibrary.process();
+      }
+    } catch (e) {
+      return null;
+    }
+    _FeedDart feed;
+    try {
+      feed = process.lookupFunction<_FeedNative, _FeedDart>('flutter_pcm_sound_ffi_feed');
+    } catch (e) {
+      return null;
+    }
+    _FeedStreamDart? feedStream;
+    try {
+      feedStream = process.lookupFunction<_FeedStreamNative, _FeedStreamDart>(
+          'flutter_pcm_sound_ffi_feed_stream');
+    } catch (e) {
+      feedStream = null;
+    }
+    return PcmFfiFeeder._(feed, feedStream);
+  }
+
+  // Returns the number of bytes queued, or -1 if setup hasn't been called
+  // or the stream doesn't exist
+  int feed(ByteData bytes, {int streamId = 0}) {
+    final length = bytes.lengthInBytes;
+    if (length > _stagingLength) {
+      if (_staging != nullptr) {
+        malloc.free(_staging);
+      }
+      _staging = malloc<Uint8>(length);
+      _stagingLength = length;
+    }
+    _staging
+        .asTypedList(length)
+        .setAll(0, bytes.buffer.asUint8List(bytes.offsetInBytes, length));
+    if (streamId != 0) {
+      return _feedStream!(streamId, _staging, length);
+    }
+    return _feed(_staging, length);
+  }
+
+  // As feed, on a helper isolate. For the block policy: a feed waiting for
+  // room there leaves this isolate, and the platform thread, free
+  Future<int> feedInBackground(ByteData bytes, {int streamId = 0}) {
+    return (_worker ??= _PcmFfiWorker()).feed(bytes, streamId);
+  }
+}
+
+// The helper isolate behind feedInBackground, with its own PcmFfiFeeder.
+// It feeds one request at a time, so replies come back in request order
+class _PcmFfiWorker {
+  final ReceivePort _replies = ReceivePort();
+  final Queue<Completer<int>> _pending = Queue();
+  late final Future<SendPort> _requests;
+
+  _PcmFfiWorker() {
+    final ready = Completer<SendPort>();
+    _requests = ready.future;
+    _replies.listen((message) {
+      if (message is SendPort) {
+        ready.complete(message);
+      } else {
+        _pending.removeFirst().complete(message as int);
+      }
+    });
+    Isolate.spawn(_serve, _replies.sendPort).then((_) {}, onError: (Object e, StackTrace s) {
+      ready.completeError(e, s);
+    });
+  }
+
+  Future<int> feed(ByteData bytes, int streamId) async {
+    final requests = await _requests;
+    final reply = Completer<int>();
+    _pending.add(reply);
+    requests.send([
+      streamId,
+      TransferableTypedData.fromList([bytes.buffer.asUint8List(bytes.offsetInBytes, bytes.lengthInBytes)]),
+    ]);
+    return reply.future;
+  }
+
+  static void _serve(SendPort replies) {
+    final feeder = PcmFfiFeeder.open();
+    final requests = ReceivePort();
+    replies.send(requests.sendPort);
+    requests.listen((message) {
+      final request = message as List<Object?>;
+      final bytes = (request[1] as TransferableTypedData).materialize().asByteData();
+      replies.send(feeder?.feed(bytes, streamId: request[0] as int) ?? -1);
+    });
+  }
+}
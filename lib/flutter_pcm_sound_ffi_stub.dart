@@ -0,0 +1,16 @@
+import 'dart:typed_data';
+
+// No FFI on this platform: feed always goes through the method channel
+class PcmFfiFeeder {
+  static PcmFfiFeeder? open() => null;
+
+  bool get supportsStreams => false;
+
+  int feed(ByteData bytes, {int streamId = 0}) {
+    throw UnsupportedError('FFI feed is not available on this platform.');
+  }
+
+  Future<int> feedInBackground(ByteData bytes, {int streamId = 0}) {
+    throw UnsupportedError('FFI feed is not available on this platform.');
+  }
+}
@@ -1,5 +0,0 @@
-import 'flutter_pcm_sound.dart';
-
-FlutterPcmSoundImpl createWindowsImpl() {
-  throw UnsupportedError('Windows implementation is not available on web platform.');
-}
\ No newline at end of file
@@ -1,5 +1,6 @@
 import 'dart:async';
 import 'dart:js_interop';
+import 'dart:js_interop_unsafe';
 import 'package:flutter/services.dart';
 import 'package:flutter_web_plugins/flutter_web_plugins.dart';
 import 'package:web/web.dart';
@@ -21,7 +22,11 @@ class FlutterPcmSoundPlugin {
   bool _didSetup = false;
   int _numChannels = 1;
   int _sampleRate = 44100;
+  String _sampleFormat = 's16le';
   int _feedThreshold = 8000;
+  // set when the page is cross-origin isolated: feed writes straight into
+  // memory shared with the worklet instead of posting each buffer
+  _SampleRing? _ring;
 
   FlutterPcmSoundPlugin._(this._channel);
 
@@ -33,6 +38,7 @@ class FlutterPcmSoundPlugin {
         final args = call.arguments as Map;
         _sampleRate = args['sample_rate'] ?? _sampleRate;
         _numChannels = args['num_channels'] ?? _numChannels;
+        _sampleFormat = args['sample_format'] ?? _sampleFormat;
         await _initializeAudioWorklet();
         _didSetup = true;
         return true;
@@ -42,13 +48,24 @@ class FlutterPcmSoundPlugin {
         }
         final args = call.arguments as Map;
         final Uint8List buffer = args['buffer'];
+        // like the other platforms, answer with how many frames were
+        // accepted
+        final int bytesPerFrame = _numChannels * _bytesPerSample(_sampleFormat);
         if (buffer.isEmpty) {
           print("[PCM][ERROR] Received empty buffer.");
-          return true;
+          return 0;
         }
+        if (_ring != null) {
+          final int written = _ring!.write(buffer);
+          if (written < buffer.length) {
+            print("[PCM][ERROR] Sample queue full, dropped samples.");
+          }
+          return written ~/ bytesPerFrame;
+        }
+        // the worklet queues everything it is posted
         _workletNode?.port
             .postMessage({'type': 'samples', 'samples': buffer}.jsify());
-        return true;
+        return buffer.length ~/ bytesPerFrame;
       case 'setFeedThreshold':
         final args = call.arguments as Map;
         _feedThreshold = args['feed_threshold'];
@@ -82,10 +99,24 @@ class FlutterPcmSoundPlugin {
     }
     _workletNode = AudioWorkletNode(_audioContext!, 'pcm-processor');
 
-    _workletNode!.port
-        .postMessage({'type': 'config', 'numChannels': _numChannels}.toJSBox);
+    _workletNode!.port.postMessage({
+      'type': 'config',
+      'numChannels': _numChannels,
+      'sampleFormat': _sampleFormat
+    }.jsify());
     _workletNode!.port.postMessage(
-        {'type': 'configThreshold', 'feedThreshold': _feedThreshold}.toJSBox);
+        {'type': 'configThreshold', 'feedThreshold': _feedThreshold}.jsify());
+
+    _ring = _SampleRing.create(
+        _queueCapacitySeconds * _sampleRate * _numChannels * _bytesPerSample(_sampleFormat),
+        _numChannels * _bytesPerSample(_sampleFormat));
+    if (_ring != null) {
+      // posting a SharedArrayBuffer shares it rather than copying it
+      final message = JSObject();
+      message['type'] = 'ring'.toJS;
+      message['buffer'] = _ring!.buffer;
+      _workletNode!.port.postMessage(message);
+    }
 
     _workletNode!.port.onmessage =
         ((MessageEvent event) => _onMessage(event)).toJS;
@@ -108,6 +139,7 @@ class FlutterPcmSoundPlugin {
   }
 
   void _cleanup() {
+    _ring = null;
     if (_workletNode != null) {
       _workletNode!.disconnect();
       _workletNode = null;
@@ -121,6 +153,100 @@ class FlutterPcmSoundPlugin {
   }
 }
 
+// how much audio the sample queue can hold before feed starts dropping
+const _queueCapacitySeconds = 10;
+
+int _bytesPerSample(String sampleFormat) => sampleFormat == 's16le' ? 2 : 4;
+
+@JS('crossOriginIsolated')
+external bool? get _crossOriginIsolated;
+
+@JS('SharedArrayBuffer')
+external JSFunction? get _sharedArrayBufferClass;
+
+@JS('SharedArrayBuffer')
+extension type _SharedArrayBuffer._(JSObject _) implements JSObject {
+  external _SharedArrayBuffer(int length);
+}
+
+@JS('Int32Array')
+extension type _Int32Array._(JSObject _) implements JSObject {
+  external _Int32Array(JSObject buffer, int byteOffset, int length);
+}
+
+@JS('Uint8Array')
+extension type _Uint8Array._(JSObject _) implements JSObject {
+  external _Uint8Array(JSObject buffer, int byteOffset, int length);
+  @JS('set')
+  external void setFrom(JSUint8Array source, int offset);
+}
+
+@JS('Atomics.load')
+external int _atomicsLoad(_Int32Array array, int index);
+
+@JS('Atomics.store')
+external int _atomicsStore(_Int32Array array, int index, int value);
+
+// Single-producer/single-consumer byte queue shared with the worklet, with
+// the same semantics as the native RingBuffer: this side only writes, the
+// worklet's process() only reads, and neither locks or allocates.
+//
+// The buffer holds two Int32 counters, then `capacity` bytes of samples in
+// the setup format. The counters are free-running byte positions that wrap
+// at 2^32, published with Atomics: [0] is the next byte to write, [1] the
+// next byte to read. The capacity is a power of two, so a position maps to
+// a byte with a mask and every sample sits whole in the buffer.
+class _SampleRing {
+  static const _headerBytes = 8;
+  static const _writeIndex = 0;
+  static const _readIndex = 1;
+
+  final _SharedArrayBuffer buffer;
+  final _Int32Array _control;
+  final _Uint8Array _data;
+  final int _capacity;
+  final int _bytesPerFrame;
+
+  _SampleRing._(this.buffer, this._capacity, this._bytesPerFrame)
+      : _control = _Int32Array(buffer, 0, 2),
+        _data = _Uint8Array(buffer, _headerBytes, _capacity);
+
+  // null when SharedArrayBuffer isn't available, i.e. the page isn't
+  // served with COOP and COEP headers
+  static _SampleRing? create(int minCapacity, int bytesPerFrame) {
+    if (_crossOriginIsolated != true || _sharedArrayBufferClass == null) {
+      return null;
+    }
+    int capacity = 1;
+    while (capacity < minCapacity) {
+      capacity <<= 1;
+    }
+    return _SampleRing._(_SharedArrayBuffer(_headerBytes + capacity), capacity, bytesPerFrame);
+  }
+
+  // Copies the whole frames of `bytes` that fit and returns how many bytes
+  // that was.
+  int write(Uint8List bytes) {
+    final int write = _atomicsLoad(_control, _writeIndex);
+    final int read = _atomicsLoad(_control, _readIndex);
+    final int free = _capacity - ((write - read) & 0xFFFFFFFF);
+    int length = bytes.length < free ? bytes.length : free;
+    length -= length % _bytesPerFrame;
+    if (length == 0) {
+      return 0;
+    }
+    final int offset = write & (_capacity - 1);
+    final int first = length < _capacity - offset ? length : _capacity - offset;
+    _data.setFrom(Uint8List.sublistView(bytes, 0, first).toJS, offset);
+    if (first < length) {
+      _data.setFrom(Uint8List.sublistView(bytes, first, length).toJS, 0);
+    }
+    // publish only once the bytes are in place
+    _atomicsStore(_control, _writeIndex, (write + length).toSigned(32));
+    return length;
+  }
+}
+
 String _createWorkletUrl() {
   final blob = Blob(
     [_workletJs.jsify()!].toJS,
@@ -135,8 +261,15 @@ class PCMProcessor extends AudioWorkletProcessor {
     super();
     this._queue = [];
     this.numChannels = 1;
+    this.sampleFormat = 's16le';
     this.feedThreshold = 8000;
     this.invokedFeedCallback = false;
+    // set by a 'ring' message: samples then come through shared memory,
+    // see _SampleRing
+    this.ringControl = null;
+    this.ringView = null;
+    this.ringMask = 0;
+    this.ringFedTo = 0;
 
     this.port.onmessage = (event) => {
       const data = event.data;
@@ -144,31 +277,114 @@ class PCMProcessor extends AudioWorkletProcessor {
       switch (data.type) {
         case 'config':
           this.numChannels = data.numChannels;
+          this.sampleFormat = data.sampleFormat || 's16le';
           this.port.postMessage({type: 'configured'});
           break;
         case 'configThreshold':
           this.feedThreshold = data.feedThreshold;
           break;
+        case 'ring':
+          this.ringControl = new Int32Array(data.buffer, 0, 2);
+          this.ringView = new DataView(data.buffer, 8);
+          this.ringMask = this.ringView.byteLength - 1;
+          this.ringFedTo = Atomics.load(this.ringControl, 0);
+          break;
         case 'samples':
           if (!data.samples || data.samples.length === 0) return;
           
           const bytes = new Uint8Array(data.samples);
-          const int16Samples = new Int16Array(bytes.length / 2);
-          
-          // Combine bytes into 16-bit samples (little-endian)
-          for (let i = 0; i < bytes.length; i += 2) {
-            int16Samples[i/2] = (bytes[i+1] << 8) | bytes[i];
+          const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+          let samples;
+
+          // Decode little-endian samples to floats once, on arrival
+          if (this.sampleFormat === 'f32le') {
+            samples = new Float32Array(bytes.length / 4);
+            for (let i = 0; i < samples.length; i++) {
+              samples[i] = view.getFloat32(i * 4, true);
+            }
+          } else if (this.sampleFormat === 's32le') {
+            samples = new Float32Array(bytes.length / 4);
+            for (let i = 0; i < samples.length; i++) {
+              samples[i] = view.getInt32(i * 4, true) / 2147483648.0;
+            }
+          } else if (this.sampleFormat === 's24le') {
+            // 24 bits in the low bits of a 32-bit container
+            samples = new Float32Array(bytes.length / 4);
+            for (let i = 0; i < samples.length; i++) {
+              samples[i] = ((view.getInt32(i * 4, true) << 8) >> 8) / 8388608.0;
+            }
+          } else {
+            samples = new Float32Array(bytes.length / 2);
+            for (let i = 0; i < samples.length; i++) {
+              samples[i] = view.getInt16(i * 2, true) / 32768.0;
+            }
           }
-          
-          this._queue.push(int16Samples);
+
+          this._queue.push(samples);
           this.invokedFeedCallback = false;
           break;
       }
     };
   }
 
+  // Decodes one sample at ring byte position `pos`
+  ringSample(pos) {
+    const view = this.ringView;
+    const i = pos & this.ringMask;
+    if (this.sampleFormat === 'f32le') {
+      return view.getFloat32(i, true);
+    } else if (this.sampleFormat === 's32le') {
+      return view.getInt32(i, true) / 2147483648.0;
+    } else if (this.sampleFormat === 's24le') {
+      return ((view.getInt32(i, true) << 8) >> 8) / 8388608.0;
+    }
+    return view.getInt16(i, true) / 32768.0;
+  }
+
+  // process() for the shared ring: reads in place, allocating nothing
+  processRing(output) {
+    const framesNeeded = output[0].length;
+    const bytesPerSample = this.sampleFormat === 's16le' ? 2 : 4;
+    const bytesPerFrame = bytesPerSample * this.numChannels;
+    const write = Atomics.load(this.ringControl, 0);
+    let read = Atomics.load(this.ringControl, 1);
+    const available = ((write - read) >>> 0) / bytesPerFrame;
+    const frames = Math.min(framesNeeded, available);
+
+    for (let f = 0; f < frames; f++) {
+      for (let ch = 0; ch < this.numChannels; ch++) {
+        output[ch][f] = this.ringSample(read + ch * bytesPerSample);
+      }
+      read += bytesPerFrame;
+    }
+    for (let f = frames; f < framesNeeded; f++) {
+      for (let ch = 0; ch < this.numChannels; ch++) {
+        output[ch][f] = 0.0;
+      }
+    }
+    Atomics.store(this.ringControl, 1, read | 0);
+
+    // a feed since the last request re-arms it
+    if (write !== this.ringFedTo) {
+      this.ringFedTo = write;
+      this.invokedFeedCallback = false;
+    }
+    const remainingFrames = available - frames;
+    if (remainingFrames <= this.feedThreshold && !this.invokedFeedCallback) {
+      this.invokedFeedCallback = true;
+      this.port.postMessage({
+        type: 'requestMoreData',
+        remainingFrames: remainingFrames
+      });
+    }
+    return true;
+  }
+
   process(inputs, outputs, parameters) {
     const output = outputs[0];
+    if (this.ringControl !== null) {
+      return this.processRing(output);
+    }
     const framesNeeded = output[0].length;
     let framePos = 0;
 
@@ -181,10 +397,7 @@ class PCMProcessor extends AudioWorkletProcessor {
 
       for (let f = 0; f < framesFromBuffer; f++) {
         for (let ch = 0; ch < this.numChannels; ch++) {
-          const sampleInt = currentBuffer[f * this.numChannels + ch];
-          // Normalize 16-bit PCM to float.
-          const sampleFloat = sampleInt / 32768.0;
-          output[ch][framePos + f] = sampleFloat;
+          output[ch][framePos + f] = currentBuffer[f * this.numChannels + ch];
         }
       }
 
@@ -0,0 +1,212 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "pcm_convert.h"
+#include "pcm_mixer.h"
+#include "pcm_resampler.h"
+#include "pcm_ring_buffer.h"
+
+// The audio core on its own: what one period of the playback thread costs,
+// with a mock sink standing in for the device. Bytes per second are in the
+// feed's format, so runs with different formats compare by throughput.
+
+namespace flutter_pcm_sound {
+namespace {
+
+constexpr int kRate = 48000;
+constexpr int kChannels = 2;
+constexpr size_t kPeriodFrames = 1024;
+
+// Takes whatever it is given, like a device that is never full
+class MockSink {
+ public:
+  explicit MockSink(size_t bytes) : buffer_(bytes) {}
+
+  size_t Write(const uint8_t* data, size_t length) {
+    length = std::min(length, buffer_.size());
+    std::memcpy(buffer_.data(), data, length);
+    benchmark::ClobberMemory();
+    return length;
+  }
+
+ private:
+  std::vector<uint8_t> buffer_;
+};
+
+std::vector<uint8_t> Tone(SampleFormat format, size_t frames, int channels) {
+  std::vector<float> samples(frames * channels);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = 0.5f * std::sin(static_cast<float>(i / channels) * 0.05f);
+  }
+  std::vector<uint8_t> bytes(samples.size() * BytesPerSample(format));
+  FromFloat(format, samples.data(), bytes.data(), samples.size());
+  return bytes;
+}
+
+// feed → queue → device on one thread: the two copies every byte takes
+void BM_RingBufferFeedAndDrain(benchmark::State& state) {
+  const size_t chunk = state.range(0);
+  std::vector<uint8_t> data = Tone(SampleFormat::kS16, chunk / 4, kChannels);
+  RingBuffer queue;
+  queue.Reset(10 * kRate * 4);
+  MockSink sink(chunk);
+  for (auto _ : state) {
+    queue.Write(data.data(), data.size());
+    const uint8_t* peeked = nullptr;
+    size_t length;
+    while ((length = queue.Peek(&peeked)) > 0) {
+      queue.Consume(sink.Write(peeked, length));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * chunk);
+}
+BENCHMARK(BM_RingBufferFeedAndDrain)->Arg(256)->Arg(4096)->Arg(65536);
+
+// The same with the consumer on its own thread, as the playback thread is:
+// adds the cost of the two sides sharing head and tail
+void BM_RingBufferAcrossThreads(benchmark::State& state) {
+  const size_t chunk = state.range(0);
+  std::vector<uint8_t> data = Tone(SampleFormat::kS16, chunk / 4, kChannels);
+  RingBuffer queue;
+  queue.Reset(1 << 20);
+  std::atomic<bool> stop{false};
+  std::thread consumer([&] {
+    MockSink sink(1 << 20);
+    const uint8_t* peeked = nullptr;
+    while (!stop.load(std::memory_order_relaxed)) {
+      size_t length = queue.Peek(&peeked);
+      if (length > 0) {
+        queue.Consume(sink.Write(peeked, length));
+      }
+    }
+  });
+  for (auto _ : state) {
+    for (size_t done = 0; done < data.size();) {
+      done += queue.Write(data.data() + done, data.size() - done);
+    }
+  }
+  stop = true;
+  consumer.join();
+  state.SetBytesProcessed(state.iterations() * chunk);
+}
+BENCHMARK(BM_RingBufferAcrossThreads)->Arg(4096)->Arg(65536)->UseRealTime();
+
+void BM_ToFloat(benchmark::State& state) {
+  const SampleFormat format = static_cast<SampleFormat>(state.range(0));
+  std::vector<uint8_t> in = Tone(format, kPeriodFrames, kChannels);
+  std::vector<float> out(kPeriodFrames * kChannels);
+  for (auto _ : state) {
+    ToFloat(format, in.data(), out.data(), out.size());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * in.size());
+}
+BENCHMARK(BM_ToFloat)
+    ->Arg(static_cast<int>(SampleFormat::kS16))
+    ->Arg(static_cast<int>(SampleFormat::kS24))
+    ->Arg(static_cast<int>(SampleFormat::kS32))
+    ->Arg(static_cast<int>(SampleFormat::kF32));
+
+void BM_FromFloat(benchmark::State& state) {
+  const SampleFormat format = static_cast<SampleFormat>(state.range(0));
+  std::vector<float> in(kPeriodFrames * kChannels, 0.25f);
+  std::vector<uint8_t> out(in.size() * BytesPerSample(format));
+  for (auto _ : state) {
+    FromFloat(format, in.data(), out.data(), in.size());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_FromFloat)
+    ->Arg(static_cast<int>(SampleFormat::kS16))
+    ->Arg(static_cast<int>(SampleFormat::kS24))
+    ->Arg(static_cast<int>(SampleFormat::kS32))
+    ->Arg(static_cast<int>(SampleFormat::kF32));
+
+// One period from 44.1 kHz to the device's 48 kHz, by quality
+void BM_ResamplePeriod(benchmark::State& state) {
+  const ResampleQuality quality = static_cast<ResampleQuality>(state.range(0));
+  Resampler resampler;
+  resampler.Configure(44100, kRate, kChannels, quality, kPeriodFrames);
+  std::vector<float> in(kPeriodFrames * kChannels, 0.25f);
+  std::vector<float> out(resampler.MaxOutputFrames(kPeriodFrames) * kChannels);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(resampler.Process(in.data(), kPeriodFrames, out.data()));
+  }
+  state.SetItemsProcessed(state.iterations() * kPeriodFrames);
+}
+BENCHMARK(BM_ResamplePeriod)
+    ->Arg(static_cast<int>(ResampleQuality::kLow))
+    ->Arg(static_cast<int>(ResampleQuality::kMedium))
+    ->Arg(static_cast<int>(ResampleQuality::kHigh));
+
+// The primary queue plus `range(0)` extra streams mixed into one period
+void BM_MixPeriod(benchmark::State& state) {
+  const int streams = state.range(0);
+  const size_t period_bytes = kPeriodFrames * kChannels * 2;
+  std::vector<uint8_t> data = Tone(SampleFormat::kS16, kPeriodFrames, kChannels);
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kS16, kChannels, 4 * period_bytes, kPeriodFrames);
+  std::vector<int64_t> ids;
+  for (int i = 0; i < streams; i++) {
+    ids.push_back(mixer.AddVoice(0.5f, i % 2 ? 0.5f : -0.5f));
+  }
+  RingBuffer queue;
+  queue.Reset(4 * period_bytes);
+  std::vector<float> mix(kPeriodFrames * kChannels);
+  for (auto _ : state) {
+    queue.Write(data.data(), data.size());
+    for (int64_t id : ids) {
+      mixer.Write(id, data.data(), data.size(), FeedPolicy::kPartial);
+    }
+    size_t frames = std::max(mixer.MaxQueuedFrames(), kPeriodFrames);
+    std::fill(mix.begin(), mix.end(), 0.0f);
+    mixer.MixQueue(queue, 0.8f, 0.0f, mix.data(), frames);
+    mixer.MixVoices(mix.data(), frames);
+    benchmark::DoNotOptimize(mix.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kPeriodFrames);
+}
+BENCHMARK(BM_MixPeriod)->Arg(0)->Arg(1)->Arg(4)->Arg(Mixer::kMaxVoices);
+
+// A whole period the way the playback thread handles a feed in a layout
+// the device refused: queue → float → (resample) → device format → sink.
+// range(0) is the feed rate; 48000 skips the resampler.
+void BM_PlaybackPeriod(benchmark::State& state) {
+  const int in_rate = state.range(0);
+  const bool resample = in_rate != kRate;
+  std::vector<uint8_t> data = Tone(SampleFormat::kS16, kPeriodFrames, kChannels);
+  RingBuffer queue;
+  queue.Reset(4 * data.size());
+  Resampler resampler;
+  resampler.Configure(in_rate, kRate, kChannels, ResampleQuality::kMedium, kPeriodFrames);
+  std::vector<uint8_t> chunk(data.size());
+  std::vector<float> in(kPeriodFrames * kChannels);
+  std::vector<float> out(resampler.MaxOutputFrames(kPeriodFrames) * kChannels);
+  std::vector<uint8_t> device(out.size() * BytesPerSample(SampleFormat::kS32));
+  MockSink sink(device.size());
+  for (auto _ : state) {
+    queue.Write(data.data(), data.size());
+    size_t frames = queue.Read(chunk.data(), chunk.size()) / (kChannels * 2);
+    ToFloat(SampleFormat::kS16, chunk.data(), in.data(), frames * kChannels);
+    const float* converted = in.data();
+    if (resample) {
+      frames = resampler.Process(in.data(), frames, out.data());
+      converted = out.data();
+    }
+    FromFloat(SampleFormat::kS32, converted, device.data(), frames * kChannels);
+    sink.Write(device.data(), frames * kChannels * 4);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_PlaybackPeriod)->Arg(kRate)->Arg(44100)->Arg(16000);
+
+}  // namespace
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,221 @@
+#include <benchmark/benchmark.h>
+#include <flutter_linux/flutter_linux.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "flutter_pcm_sound_plugin_private.h"
+
+// The plugin end to end, through its method handler: feed → call_mutex →
+// sample queue → playback thread → snd_pcm_writei, and back through the
+// main loop for feed requests. By default it runs against the ALSA null
+// device, which takes frames as fast as they come, so what is measured is
+// the plugin's own cost. Set ALSA_CONFIG_PATH to run against another
+// default device.
+
+namespace {
+
+constexpr int kRate = 48000;
+constexpr int kChannels = 2;
+constexpr size_t kBytesPerFrame = kChannels * 2;
+
+const char kNullDeviceConfig[] =
+    "pcm.!default { type null }\n"
+    "pcm.null { type null }\n";
+
+// A set up plugin that was never registered with an engine
+class Plugin {
+ public:
+  explicit Plugin(const char* latency_profile = "standard") {
+    plugin_ = reinterpret_cast<FlutterPcmSoundPlugin*>(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+    g_autoptr(FlValue) args = fl_value_new_map();
+    fl_value_set_string_take(args, "sample_rate", fl_value_new_int(kRate));
+    fl_value_set_string_take(args, "num_channels", fl_value_new_int(kChannels));
+    fl_value_set_string_take(args, "sample_format", fl_value_new_string("s16le"));
+    fl_value_set_string_take(args, "latency_profile", fl_value_new_string(latency_profile));
+    ok_ = Succeeds("setup", args);
+  }
+
+  ~Plugin() {
+    Succeeds("release", nullptr);
+    g_object_unref(plugin_);
+  }
+
+  Plugin(const Plugin&) = delete;
+  Plugin& operator=(const Plugin&) = delete;
+
+  bool ok() const { return ok_; }
+  FlutterPcmSoundPlugin* get() const { return plugin_; }
+
+  bool Succeeds(const char* method, FlValue* args) {
+    g_autoptr(FlMethodResponse) response = flutter_pcm_sound_plugin_handle_method(plugin_, method, args);
+    return FL_IS_METHOD_SUCCESS_RESPONSE(response);
+  }
+
+  int64_t BytesPlayed() {
+    g_autoptr(FlMethodResponse) response = flutter_pcm_sound_plugin_handle_method(plugin_, "getStats", nullptr);
+    if (!FL_IS_METHOD_SUCCESS_RESPONSE(response)) {
+      return -1;
+    }
+    FlValue* stats = fl_method_success_response_get_result(FL_METHOD_SUCCESS_RESPONSE(response));
+    return fl_value_get_int(fl_value_lookup_string(stats, "bytes_played"));
+  }
+
+ private:
+  FlutterPcmSoundPlugin* plugin_;
+  bool ok_ = false;
+};
+
+// Feed arguments for `frames` frames of silence, built once and reused so
+// the codec's copy isn't part of the measurement
+FlValue* FeedArgs(size_t frames) {
+  std::vector<uint8_t> samples(frames * kBytesPerFrame);
+  FlValue* args = fl_value_new_map();
+  fl_value_set_string_take(args, "buffer", fl_value_new_uint8_list(samples.data(), samples.size()));
+  return args;
+}
+
+// How long one feed holds call_mutex, which the FFI feed and every method
+// call wait on. The handler holds it for the whole call.
+void BM_PluginFeed(benchmark::State& state) {
+  Plugin plugin;
+  if (!plugin.ok()) {
+    state.SkipWithError("setup failed; is the ALSA null device available?");
+    return;
+  }
+  const size_t frames = state.range(0);
+  g_autoptr(FlValue) args = FeedArgs(frames);
+  for (auto _ : state) {
+    if (!plugin.Succeeds("feed", args)) {
+      state.SkipWithError("feed failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * frames * kBytesPerFrame);
+}
+BENCHMARK(BM_PluginFeed)->Arg(256)->Arg(4096);
+
+// Feed to written: one second of audio fed in `range(0)` frame chunks,
+// timed until the playback thread has handed all of it to the device
+void BM_PluginThroughput(benchmark::State& state) {
+  Plugin plugin;
+  if (!plugin.ok()) {
+    state.SkipWithError("setup failed; is the ALSA null device available?");
+    return;
+  }
+  const size_t frames = state.range(0);
+  g_autoptr(FlValue) args = FeedArgs(frames);
+  const size_t feeds = kRate / frames;
+  const int64_t bytes_per_iteration = feeds * frames * kBytesPerFrame;
+  int64_t target = plugin.BytesPlayed();
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < feeds; i++) {
+      plugin.Succeeds("feed", args);
+    }
+    target += bytes_per_iteration;
+    while (plugin.BytesPlayed() < target) {
+      std::this_thread::yield();
+    }
+    state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_iteration);
+}
+BENCHMARK(BM_PluginThroughput)->Arg(256)->Arg(4096)->UseManualTime();
+
+struct FeedRequest {
+  bool received = false;
+  std::chrono::steady_clock::time_point at;
+};
+
+void OnFeedRequest(FlValue* message, gpointer user_data) {
+  auto* request = static_cast<FeedRequest*>(user_data);
+  request->at = std::chrono::steady_clock::now();
+  request->received = true;
+}
+
+gboolean OnTimeout(gpointer user_data) {
+  *static_cast<bool*>(user_data) = true;
+  return G_SOURCE_REMOVE;
+}
+
+// Waits on the default main context, as a GTK app's main loop does
+bool WaitForFeedRequest(FeedRequest* request) {
+  bool timed_out = false;
+  guint timeout = g_timeout_add(1000, OnTimeout, &timed_out);
+  while (!request->received && !timed_out) {
+    g_main_context_iteration(nullptr, TRUE);
+  }
+  if (!timed_out) {
+    g_source_remove(timeout);
+  }
+  return request->received;
+}
+
+// Callback dispatch: from a one period feed to the OnFeedSamples it
+// triggers once the device has taken it, through the playback thread's
+// request and the main loop
+void BM_PluginFeedCallbackLatency(benchmark::State& state) {
+  FeedRequest request;
+  Plugin plugin("lowLatency");
+  if (!plugin.ok()) {
+    state.SkipWithError("setup failed; is the ALSA null device available?");
+    return;
+  }
+  flutter_pcm_sound_plugin_set_feed_observer(plugin.get(), OnFeedRequest, &request);
+  g_autoptr(FlValue) args = FeedArgs(state.range(0));
+  // The request an empty queue makes right after setup
+  plugin.Succeeds("feed", args);
+  WaitForFeedRequest(&request);
+
+  for (auto _ : state) {
+    request.received = false;
+    auto start = std::chrono::steady_clock::now();
+    plugin.Succeeds("feed", args);
+    if (!WaitForFeedRequest(&request)) {
+      state.SkipWithError("no feed request within a second");
+      break;
+    }
+    state.SetIterationTime(std::chrono::duration<double>(request.at - start).count());
+  }
+}
+BENCHMARK(BM_PluginFeedCallbackLatency)->Arg(256)->UseManualTime();
+
+void IgnorePrint(const gchar* message) {}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Point the default device at the null plugin, unless told otherwise
+  std::string config_path;
+  if (getenv("ALSA_CONFIG_PATH") == nullptr) {
+    gchar* path = nullptr;
+    gint fd = g_file_open_tmp("flutter_pcm_sound_benchmark_XXXXXX.conf", &path, nullptr);
+    if (fd >= 0) {
+      close(fd);
+      g_file_set_contents(path, kNullDeviceConfig, -1, nullptr);
+      config_path = path;
+      setenv("ALSA_CONFIG_PATH", path, 1);
+      g_free(path);
+    }
+  }
+  // The plugin logs every feed request
+  g_set_print_handler(IgnorePrint);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  if (!config_path.empty()) {
+    remove(config_path.c_str());
+  }
+  return 0;
+}
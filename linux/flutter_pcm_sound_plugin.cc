@@ -3,17 +3,37 @@
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
 #include <sys/utsname.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
 #include <alsa/asoundlib.h>
 #include <thread>
+#include <atomic>
+#include <future>
 #include <mutex>
 #include <vector>
 #include <algorithm>
 #include <chrono>
+#include <map>
+#include <string>
+#include <ctime>
 
 
 #include <cstring>
 
 #include "flutter_pcm_sound_plugin_private.h"
+#include "pcm_convert.h"
+#include "pcm_feed_policy.h"
+#include "pcm_file_player.h"
+#include "pcm_file_source.h"
+#include "pcm_clip_bank.h"
+#include "pcm_jitter_buffer.h"
+#include "pcm_mixer.h"
+#include "pcm_resampler.h"
+#include "pcm_ring_buffer.h"
+#include "pcm_stats.h"
+#include "pcm_trace.h"
+#include "pcm_thread_priority.h"
 
 #define FLUTTER_PCM_SOUND_PLUGIN(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), flutter_pcm_sound_plugin_get_type(), \
@@ -22,40 +42,300 @@
 
 struct _FlutterPcmSoundPlugin {
  GObject parent_instance;
+ // The registered instance is output 0. openOutput makes more instances,
+ // one per device, each with its own handle, queue and thread; the
+ // registered one routes calls carrying their output_id to them and owns
+ // them in `outputs` (null on the others).
+ int64_t output_id;
+ std::map<int64_t, FlutterPcmSoundPlugin*>* outputs;
+ int64_t next_output_id;
  snd_pcm_t* handle;
+ // The ALSA PCM name setup opened: device_id, or "default"
+ std::string* device_name;
  int sample_rate;
  int channels;
+ // Sample format and layout fed from Dart
+ snd_pcm_format_t format;
+ size_t bytes_per_frame;
+ // What the device was opened with. Differs from the above only when the
+ // device refused the Dart layout and the playback thread converts.
+ snd_pcm_format_t device_format;
+ int device_channels;
+ int device_rate;
+ size_t device_bytes_per_frame;
+ bool needs_conversion;
+ // Converts sample_rate to device_rate when they differ
+ flutter_pcm_sound::Resampler* resampler;
+ flutter_pcm_sound::ResampleQuality resample_quality;
+ bool needs_resampling;
+ // Preallocated conversion buffers, sized for one write_frames chunk,
+ // which converts to at most convert_frames device frames
+ std::vector<float>* convert_float;
+ std::vector<uint8_t>* convert_out;
+ size_t convert_frames;
+ snd_pcm_uframes_t buffer_frames;
+ snd_pcm_uframes_t period_frames;
+ // The playback thread starts the device itself once the buffer holds
+ // this much, rather than leaving it to ALSA, so pre-roll can hold it
+ snd_pcm_uframes_t start_threshold;
+ // When the last samples were queued (PlaybackStats::NowNs). A device
+ // short of start_threshold is only started early once feeds have been
+ // quiet for DRY_START_GRACE_NS.
+ std::atomic<int64_t> last_feed_ns;
+ // Pre-roll: while start_held, the playback thread fills the device buffer
+ // but doesn't start it. start_at_ns, on CLOCK_MONOTONIC, is when startAt
+ // asked it to start; 0 when no start is scheduled.
+ std::atomic<bool> start_held;
+ std::atomic<int64_t> start_at_ns;
+ // Device frames handed to ALSA since setup and not dropped since, for
+ // getPlaybackPosition
+ std::atomic<uint64_t> device_frames_written;
+ // Flush: the platform thread notes how far the primary queue reaches in
+ // flush_to and bumps flush_requests. The playback thread drops the device
+ // buffer and the queue up to there, and counts flushes_done (playback
+ // thread only).
+ std::atomic<uint64_t> flush_to;
+ std::atomic<uint32_t> flush_requests;
+ uint32_t flushes_done;
+ // While paused, the playback thread holds the device with snd_pcm_pause,
+ // or drops its buffer when the hardware can't pause, and sleeps.
+ std::atomic<bool> paused;
+ bool can_pause;
+ // Fill the device's DMA area directly instead of using snd_pcm_writei
+ bool use_mmap;
+ // Outputs borrow the registered instance's channel, which outlives them,
+ // and tag what they send with their output_id
  FlMethodChannel* channel;
+ // Gets OnFeedSamples instead of the channel, for plugins made without a
+ // registrar (tests and benchmarks)
+ FlutterPcmSoundFeedObserver feed_observer;
+ gpointer feed_observer_data;
  int feed_threshold;
- bool did_invoke_feed_callback;
- std::vector<uint8_t> samples;
- std::mutex samples_mutex;
- bool should_stop;
+ std::atomic<bool> did_invoke_feed_callback;
+ // Feed requests from the playback thread coalesce here: it only stores
+ // the latest numbers and marks feed_source ready, and the main loop sends
+ // one OnFeedSamples for however many requests piled up.
+ GSource* feed_source;
+ FlValue* feed_message;
+ std::atomic<size_t> pending_remaining_frames;
+ std::atomic<size_t> pending_requested_frames;
+ // Written by the platform thread in feed, drained by the playback thread.
+ // setup sizes it for max_queue_us of audio and it never grows; what feed
+ // does with samples that don't fit is up to feed_policy.
+ flutter_pcm_sound::RingBuffer* samples;
+ int64_t max_queue_us;
+ flutter_pcm_sound::FeedPolicy feed_policy;
+ // Where a blocking FFI feed sleeps, without call_mutex, for the playback
+ // thread to drain the queues. Pause, flush and release cancel the wait.
+ flutter_pcm_sound::FeedWaiter* feed_waiter;
+ // Gain and pan of the primary stream (stream id 0)
+ std::atomic<float> stream_gain;
+ std::atomic<float> stream_pan;
+ // setAdaptiveBuffer: the primary stream plays through the jitter buffer,
+ // which stretches it to hold a queue depth that follows the feed jitter.
+ // The limits are kept across setups; adaptive_out holds one write_frames
+ // chunk of stretched float frames.
+ std::atomic<bool> adaptive;
+ int64_t adaptive_min_us;
+ int64_t adaptive_max_us;
+ flutter_pcm_sound::JitterBuffer* jitter;
+ std::vector<float>* adaptive_out;
+ // Extra streams mixed over the primary one
+ flutter_pcm_sound::Mixer* mixer;
+ // loadClip's clips, which the mixer plays in place
+ flutter_pcm_sound::ClipBank* clips;
+ // playFile: queues a file into `samples` from its own thread.
+ // file_path is what it is playing; only changed while it is stopped.
+ flutter_pcm_sound::FilePlayer* file_player;
+ std::string* file_path;
+ // Primary stream telemetry, for getStats and the periodic OnStats push
+ flutter_pcm_sound::PlaybackStats* stats;
+ guint stats_timer;  // 0 when not pushing
+ // Most frames handed to ALSA per write
+ snd_pcm_uframes_t write_frames;
+ std::atomic<bool> should_stop;
  std::thread* playback_thread;
+ // Signalled by feed and release so the playback thread can sleep in poll()
+ int wakeup_fd;
+ // Serializes method calls with flutter_pcm_sound_ffi_feed, which Dart
+ // calls on its own thread. The playback thread never takes it.
+ std::mutex* call_mutex;
 };
 
-struct FeedCallbackData {
+// The registered instance, for the FFI feed entry point. It holds a
+// reference so that an FFI feed racing the engine's teardown never sees a
+// freed instance; ffi_mutex guards the pointer, not the feed.
+static std::mutex ffi_mutex;
+static FlutterPcmSoundPlugin* ffi_plugin = nullptr;
+
+// setAdaptiveBuffer's default depth limits
+#define ADAPTIVE_MIN_US 40000
+#define ADAPTIVE_MAX_US 500000
+
+struct FeedSource {
+  GSource source;
   FlutterPcmSoundPlugin* plugin;
-  size_t remaining_frames;
 };
 
-static gboolean feed_callback(gpointer user_data) {
-  FeedCallbackData* data = static_cast<FeedCallbackData*>(user_data);
-  g_print("Feed callback triggered with remaining frames: %zu\n", data->remaining_frames);
-  
-  g_autoptr(FlValue) map = fl_value_new_map();
-  fl_value_set_string_take(map, "remaining_frames", fl_value_new_int(data->remaining_frames));
-  fl_method_channel_invoke_method(data->plugin->channel, "OnFeedSamples", map, NULL, NULL, NULL);
-  
-  delete data;
-  return G_SOURCE_REMOVE;
+// Runs on the main loop once feed_source is marked ready.
+static gboolean feed_source_dispatch(GSource* source, GSourceFunc callback, gpointer user_data) {
+  g_source_set_ready_time(source, -1);
+  FlutterPcmSoundPlugin* self = reinterpret_cast<FeedSource*>(source)->plugin;
+  PCM_TRACE_SCOPE("feed_callback");
+
+  // remaining: frames (at the Dart sample rate) left to play before the
+  // device runs dry, counting both the sample queue and the device buffer.
+  // requested: how many more would keep one period beyond the threshold.
+  size_t remaining_frames = self->pending_remaining_frames;
+  size_t requested_frames = self->pending_requested_frames;
+  int64_t remaining_us = (int64_t)remaining_frames * 1000000 / self->sample_rate;
+  g_print("Feed callback triggered with remaining frames: %zu (%ld us)\n", remaining_frames, (long)remaining_us);
+  self->stats->RecordFeedCallback();
+
+  // The message map is reused; setting a key replaces its old value
+  FlValue* map = self->feed_message;
+  fl_value_set_string_take(map, "remaining_frames", fl_value_new_int(remaining_frames));
+  fl_value_set_string_take(map, "remaining_us", fl_value_new_int(remaining_us));
+  fl_value_set_string_take(map, "requested_frames", fl_value_new_int(requested_frames));
+  fl_value_set_string_take(map, "requested_bytes", fl_value_new_int(requested_frames * self->bytes_per_frame));
+  if (self->feed_observer) {
+    self->feed_observer(map, self->feed_observer_data);
+  } else {
+    fl_method_channel_invoke_method(self->channel, "OnFeedSamples", map, NULL, NULL, NULL);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs feed_source_funcs = {nullptr, nullptr, feed_source_dispatch, nullptr, nullptr, nullptr};
+
+// Attaches feed_source to the default main context, never ready until the
+// playback thread asks for samples.
+static void attach_feed_source(FlutterPcmSoundPlugin* self) {
+  self->feed_source = g_source_new(&feed_source_funcs, sizeof(FeedSource));
+  reinterpret_cast<FeedSource*>(self->feed_source)->plugin = self;
+  g_source_set_ready_time(self->feed_source, -1);
+  g_source_attach(self->feed_source, nullptr);
 }
 
 
 
 G_DEFINE_TYPE(FlutterPcmSoundPlugin, flutter_pcm_sound_plugin, g_object_get_type())
 
-static void playback_thread_func(FlutterPcmSoundPlugin* self);
+// Frames handed to snd_pcm_writei per loop iteration of the playback thread.
+// Smaller periods cap this at one period.
+#define FRAMES_PER_WRITE 2048
+
+// Device buffer geometry for the standard profile, in frames
+#define DEFAULT_BUFFER_FRAMES 16384
+#define DEFAULT_PERIOD_FRAMES 4096
+
+// Low latency profile: periods shorter than this tend to underrun on
+// desktop kernels even when the device advertises them
+#define LOW_LATENCY_MIN_PERIOD_US 2000
+#define LOW_LATENCY_PERIODS 3
+
+// How long the queue has to stay dry, with no feeds, before a device that
+// hasn't reached its start threshold is started anyway. Shorter gaps are
+// Dart still priming it.
+#define DRY_START_GRACE_NS 100000000
+
+static void playback_thread_func(FlutterPcmSoundPlugin* self,
+                                 flutter_pcm_sound::ThreadSchedulingRequest scheduling,
+                                 std::promise<flutter_pcm_sound::ThreadSchedulingResult> scheduled);
+static FlMethodResponse* release_alsa(FlutterPcmSoundPlugin* self);
+
+static void wake_playback_thread(FlutterPcmSoundPlugin* self) {
+  uint64_t one = 1;
+  if (write(self->wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    g_print("Failed to wake playback thread: %s\n", strerror(errno));
+  }
+}
+
+// Closes a half-configured device and builds the error response for setup.
+static FlMethodResponse* alsa_setup_error(FlutterPcmSoundPlugin* self, int err) {
+  snd_pcm_close(self->handle);
+  self->handle = NULL;
+  return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+}
+
+// Maps the Dart `PcmFormat` name to the ALSA format it is sent as.
+// s24le is 24-bit audio in the low bits of a 32-bit container.
+static snd_pcm_format_t lookup_format(FlValue* args) {
+  FlValue* value = fl_value_lookup_string(args, "sample_format");
+  if (!value || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return SND_PCM_FORMAT_S16_LE;
+  }
+  const gchar* name = fl_value_get_string(value);
+  if (strcmp(name, "s16le") == 0) return SND_PCM_FORMAT_S16_LE;
+  if (strcmp(name, "s24le") == 0) return SND_PCM_FORMAT_S24_LE;
+  if (strcmp(name, "s32le") == 0) return SND_PCM_FORMAT_S32_LE;
+  if (strcmp(name, "f32le") == 0) return SND_PCM_FORMAT_FLOAT_LE;
+  return SND_PCM_FORMAT_UNKNOWN;
+}
+
+static flutter_pcm_sound::SampleFormat to_sample_format(snd_pcm_format_t format) {
+  switch (format) {
+    case SND_PCM_FORMAT_S24_LE: return flutter_pcm_sound::SampleFormat::kS24;
+    case SND_PCM_FORMAT_S32_LE: return flutter_pcm_sound::SampleFormat::kS32;
+    case SND_PCM_FORMAT_FLOAT_LE: return flutter_pcm_sound::SampleFormat::kF32;
+    default: return flutter_pcm_sound::SampleFormat::kS16;
+  }
+}
+
+static flutter_pcm_sound::ResampleQuality lookup_resample_quality(FlValue* args) {
+  FlValue* value = fl_value_lookup_string(args, "resample_quality");
+  if (value && fl_value_get_type(value) == FL_VALUE_TYPE_STRING) {
+    if (strcmp(fl_value_get_string(value), "low") == 0) return flutter_pcm_sound::ResampleQuality::kLow;
+    if (strcmp(fl_value_get_string(value), "high") == 0) return flutter_pcm_sound::ResampleQuality::kHigh;
+  }
+  return flutter_pcm_sound::ResampleQuality::kMedium;
+}
+
+static const char* resample_quality_name(flutter_pcm_sound::ResampleQuality quality) {
+  switch (quality) {
+    case flutter_pcm_sound::ResampleQuality::kLow: return "low";
+    case flutter_pcm_sound::ResampleQuality::kHigh: return "high";
+    default: return "medium";
+  }
+}
+
+static const char* format_name(snd_pcm_format_t format) {
+  switch (format) {
+    case SND_PCM_FORMAT_S24_LE: return "s24le";
+    case SND_PCM_FORMAT_S32_LE: return "s32le";
+    case SND_PCM_FORMAT_FLOAT_LE: return "f32le";
+    default: return "s16le";
+  }
+}
+
+// Reads an optional floating point argument, falling back to `fallback`.
+static double lookup_double(FlValue* args, const char* key, double fallback) {
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (!value) return fallback;
+  if (fl_value_get_type(value) == FL_VALUE_TYPE_FLOAT) return fl_value_get_float(value);
+  if (fl_value_get_type(value) == FL_VALUE_TYPE_INT) return fl_value_get_int(value);
+  return fallback;
+}
+
+// Reads an optional integer setup argument, falling back to `fallback`.
+static int64_t lookup_int(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (!value || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return fallback;
+  }
+  return fl_value_get_int(value);
+}
+
+// Hands setAdaptiveBuffer's limits to the jitter buffer, in frames at the
+// Dart sample rate. Waits for setup when there is no rate yet.
+static void set_adaptive_limits(FlutterPcmSoundPlugin* self) {
+  if (self->sample_rate <= 0) {
+    return;
+  }
+  self->jitter->SetLimits(self->adaptive_min_us * self->sample_rate / 1000000,
+                          self->adaptive_max_us * self->sample_rate / 1000000);
+}
+
 static FlMethodResponse* setup_alsa(FlutterPcmSoundPlugin* self, FlValue* args) {
   int err;
   g_print("Setup args: %s\n", fl_value_to_string(args));
@@ -70,11 +350,36 @@ static FlMethodResponse* setup_alsa(FlutterPcmSoundPlugin* self, FlValue* args)
     return FL_METHOD_RESPONSE(fl_method_error_response_new("DEBUG", err_msg, nullptr));
   }
 
+  // Setting up again replaces the current device, queue and thread
+  if (self->handle) {
+    g_autoptr(FlMethodResponse) released = release_alsa(self);
+  }
+
   self->sample_rate = fl_value_get_int(sample_rate_value);
   self->channels = fl_value_get_int(channel_value);
+  self->format = lookup_format(args);
+  if (self->format == SND_PCM_FORMAT_UNKNOWN) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unsupported sample_format", nullptr));
+  }
+  self->bytes_per_frame = self->channels * (snd_pcm_format_physical_width(self->format) / 8);
+  FlValue* feed_policy_value = fl_value_lookup_string(args, "feed_policy");
+  bool has_feed_policy = feed_policy_value && fl_value_get_type(feed_policy_value) == FL_VALUE_TYPE_STRING;
+  if (!flutter_pcm_sound::ParseFeedPolicy(has_feed_policy ? fl_value_get_string(feed_policy_value) : nullptr,
+                                          &self->feed_policy)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown feed_policy", nullptr));
+  }
+  self->max_queue_us = lookup_int(args, "max_queue_us", flutter_pcm_sound::kDefaultMaxQueueMicros);
 
-  // Open PCM device
-  if ((err = snd_pcm_open(&self->handle, "default", SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
+  // Open PCM device: a name from listDevices, such as hw:CARD=PCH,DEV=0,
+  // or the default chain. Non-blocking, so the playback thread can wait on
+  // the device and the wakeup eventfd at the same time. alsa-lib's own
+  // rate plugin is disabled: when the device doesn't run at the requested
+  // rate we resample natively instead.
+  FlValue* device_value = fl_value_lookup_string(args, "device_id");
+  bool has_device = device_value && fl_value_get_type(device_value) == FL_VALUE_TYPE_STRING;
+  self->device_name->assign(has_device ? fl_value_get_string(device_value) : "default");
+  if ((err = snd_pcm_open(&self->handle, self->device_name->c_str(), SND_PCM_STREAM_PLAYBACK,
+                          SND_PCM_NONBLOCK | SND_PCM_NO_AUTO_RESAMPLE)) < 0) {
     return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
   }
 
@@ -85,145 +390,1027 @@ static FlMethodResponse* setup_alsa(FlutterPcmSoundPlugin* self, FlValue* args)
   // Fill params with a full configuration space for the PCM
   snd_pcm_hw_params_any(self->handle, hw_params);
 
-  // Set access type to interleaved
-  if ((err = snd_pcm_hw_params_set_access(self->handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  // Set access type to interleaved. mmap is opt-in, and falls back to
+  // read/write transfers when the device refuses it.
+  FlValue* transfer_value = fl_value_lookup_string(args, "transfer_mode");
+  bool want_mmap = transfer_value && fl_value_get_type(transfer_value) == FL_VALUE_TYPE_STRING &&
+                   strcmp(fl_value_get_string(transfer_value), "mmap") == 0;
+  self->use_mmap = want_mmap &&
+      snd_pcm_hw_params_set_access(self->handle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+  if (want_mmap && !self->use_mmap) {
+    g_print("ALSA device refused mmap access - using read/write transfers\n");
+  }
+  if (!self->use_mmap &&
+      (err = snd_pcm_hw_params_set_access(self->handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+    return alsa_setup_error(self, err);
   }
 
-  // Set sample format
-  if ((err = snd_pcm_hw_params_set_format(self->handle, hw_params, SND_PCM_FORMAT_S16_LE)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  // Set sample format. If the device refuses the one Dart feeds, pick the
+  // first it takes and convert in the playback thread.
+  self->device_format = self->format;
+  if (snd_pcm_hw_params_test_format(self->handle, hw_params, self->format) < 0) {
+    const snd_pcm_format_t fallbacks[] = {SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S16_LE};
+    for (snd_pcm_format_t fallback : fallbacks) {
+      if (snd_pcm_hw_params_test_format(self->handle, hw_params, fallback) == 0) {
+        self->device_format = fallback;
+        break;
+      }
+    }
+    g_print("ALSA device refused %s - converting to %s\n", snd_pcm_format_name(self->format),
+            snd_pcm_format_name(self->device_format));
+  }
+  if ((err = snd_pcm_hw_params_set_format(self->handle, hw_params, self->device_format)) < 0) {
+    return alsa_setup_error(self, err);
   }
 
   // Set sample rate
   unsigned int actual_rate = self->sample_rate;
   if ((err = snd_pcm_hw_params_set_rate_near(self->handle, hw_params, &actual_rate, 0)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+    return alsa_setup_error(self, err);
   }
+  self->device_rate = actual_rate;
+  self->needs_resampling = self->device_rate != self->sample_rate;
 
-  // Set channels
-  if ((err = snd_pcm_hw_params_set_channels(self->handle, hw_params, self->channels)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  // Set channels, up- or down-mixing between mono and stereo if the
+  // device only takes the other
+  self->device_channels = self->channels;
+  if ((self->channels == 1 || self->channels == 2) &&
+      snd_pcm_hw_params_test_channels(self->handle, hw_params, self->channels) < 0 &&
+      snd_pcm_hw_params_test_channels(self->handle, hw_params, 3 - self->channels) == 0) {
+    self->device_channels = 3 - self->channels;
+    g_print("ALSA device refused %d channels - mixing to %d\n", self->channels, self->device_channels);
   }
-
-  // Set buffer and period sizes - use 4 periods
-  snd_pcm_uframes_t buffer_size = 16384;  // Total buffer
-  snd_pcm_uframes_t period_size = 4096;   // Period size (chunk size)
-  
-  if ((err = snd_pcm_hw_params_set_buffer_size_near(self->handle, hw_params, &buffer_size)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  if ((err = snd_pcm_hw_params_set_channels(self->handle, hw_params, self->device_channels)) < 0) {
+    return alsa_setup_error(self, err);
   }
+  self->device_bytes_per_frame = self->device_channels * (snd_pcm_format_physical_width(self->device_format) / 8);
+  self->needs_conversion = self->needs_resampling || self->device_format != self->format ||
+                           self->device_channels != self->channels;
 
-  if ((err = snd_pcm_hw_params_set_period_size_near(self->handle, hw_params, &period_size, 0)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  // Buffer geometry. The standard profile uses 4 large periods; the low
+  // latency profile asks for the smallest period the device allows (but
+  // at least LOW_LATENCY_MIN_PERIOD_US) and triple buffers it.
+  FlValue* profile_value = fl_value_lookup_string(args, "latency_profile");
+  bool low_latency = profile_value && fl_value_get_type(profile_value) == FL_VALUE_TYPE_STRING &&
+                     strcmp(fl_value_get_string(profile_value), "lowLatency") == 0;
+
+  snd_pcm_uframes_t buffer_size = lookup_int(args, "buffer_frames", DEFAULT_BUFFER_FRAMES);
+  snd_pcm_uframes_t period_size = lookup_int(args, "period_frames", DEFAULT_PERIOD_FRAMES);
+
+  if (low_latency) {
+    snd_pcm_uframes_t min_period = 0;
+    snd_pcm_hw_params_get_period_size_min(hw_params, &min_period, 0);
+    snd_pcm_uframes_t floor_period = (snd_pcm_uframes_t)actual_rate * LOW_LATENCY_MIN_PERIOD_US / 1000000;
+    period_size = lookup_int(args, "period_frames", std::max(min_period, floor_period));
+
+    if ((err = snd_pcm_hw_params_set_period_size_near(self->handle, hw_params, &period_size, 0)) < 0) {
+      return alsa_setup_error(self, err);
+    }
+
+    unsigned int periods = LOW_LATENCY_PERIODS;
+    buffer_size = lookup_int(args, "buffer_frames", period_size * periods);
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(self->handle, hw_params, &buffer_size)) < 0) {
+      return alsa_setup_error(self, err);
+    }
+  } else {
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(self->handle, hw_params, &buffer_size)) < 0) {
+      return alsa_setup_error(self, err);
+    }
+
+    if ((err = snd_pcm_hw_params_set_period_size_near(self->handle, hw_params, &period_size, 0)) < 0) {
+      return alsa_setup_error(self, err);
+    }
   }
 
   // Apply hw params
   if ((err = snd_pcm_hw_params(self->handle, hw_params)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+    return alsa_setup_error(self, err);
   }
 
   // Get actual configured values
   snd_pcm_uframes_t actual_buffer_size;
+  snd_pcm_uframes_t actual_period_size;
   snd_pcm_hw_params_get_buffer_size(hw_params, &actual_buffer_size);
-  g_print("ALSA configured - rate: %u, channels: %d, buffer: %lu frames\n", 
-          actual_rate, self->channels, actual_buffer_size);
+  snd_pcm_hw_params_get_period_size(hw_params, &actual_period_size, 0);
+  self->buffer_frames = actual_buffer_size;
+  self->period_frames = actual_period_size;
+  self->can_pause = snd_pcm_hw_params_can_pause(hw_params) == 1;
+
+  // Start playing when we're 75% full by default, or after the first
+  // period in the low latency profile
+  snd_pcm_uframes_t default_start = low_latency ? actual_period_size : (actual_buffer_size / 4) * 3;
+  snd_pcm_uframes_t start_threshold = lookup_int(args, "start_threshold_frames", default_start);
+  start_threshold = std::min(std::max(start_threshold, (snd_pcm_uframes_t)1), actual_buffer_size);
+  self->start_threshold = start_threshold;
+
+  g_print("ALSA configured - rate: %u, channels: %d, format: %s, buffer: %lu frames, period: %lu frames, start: %lu frames\n",
+          actual_rate, self->device_channels, snd_pcm_format_name(self->device_format), actual_buffer_size, actual_period_size,
+          start_threshold);
 
   // Configure software params
   snd_pcm_sw_params_t* sw_params;
   snd_pcm_sw_params_alloca(&sw_params);
   snd_pcm_sw_params_current(self->handle, sw_params);
 
-  // Start playing when we're 75% full
-  if ((err = snd_pcm_sw_params_set_start_threshold(self->handle, sw_params, 
-      (actual_buffer_size / 4) * 3)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  // ALSA never starts the device on its own; see start_threshold
+  snd_pcm_uframes_t boundary;
+  snd_pcm_sw_params_get_boundary(sw_params, &boundary);
+  if ((err = snd_pcm_sw_params_set_start_threshold(self->handle, sw_params, boundary)) < 0) {
+    return alsa_setup_error(self, err);
   }
 
+  // Position timestamps on the same clock startAt uses
+  snd_pcm_sw_params_set_tstamp_mode(self->handle, sw_params, SND_PCM_TSTAMP_ENABLE);
+  snd_pcm_sw_params_set_tstamp_type(self->handle, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+
   // Allow transfer when at least period_size samples can be processed
-  if ((err = snd_pcm_sw_params_set_avail_min(self->handle, sw_params, period_size)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  if ((err = snd_pcm_sw_params_set_avail_min(self->handle, sw_params, actual_period_size)) < 0) {
+    return alsa_setup_error(self, err);
   }
 
   if ((err = snd_pcm_sw_params(self->handle, sw_params)) < 0) {
-    snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+    return alsa_setup_error(self, err);
   }
 
   // Prepare device
   if ((err = snd_pcm_prepare(self->handle)) < 0) {
+    return alsa_setup_error(self, err);
+  }
+
+  // Allocate the sample queue up front so neither thread touches the heap
+  // while playing. Its capacity is a whole number of frames, so the
+  // contiguous regions the playback thread writes from never split one.
+  size_t bytes_per_frame = self->bytes_per_frame;
+  if (!self->samples->Reset(flutter_pcm_sound::QueueBytesFor(self->max_queue_us, self->sample_rate, bytes_per_frame))) {
     snd_pcm_close(self->handle);
-    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+    self->handle = NULL;
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("NO_MEMORY", "Failed to allocate sample queue", nullptr));
+  }
+  self->write_frames = std::min((snd_pcm_uframes_t)FRAMES_PER_WRITE, actual_period_size);
+  flutter_pcm_sound::ResampleQuality resample_quality = lookup_resample_quality(args);
+  self->resample_quality = resample_quality;
+  // Conversion buffers are needed whenever the device layout differs, and
+  // also for mixing, so always allocate them
+  {
+    size_t out_frames = self->write_frames;
+    if (self->needs_resampling) {
+      // Resample before mixing, at the Dart channel count
+      if (!self->resampler->Configure(self->sample_rate, self->device_rate, self->channels, resample_quality,
+                                      self->write_frames)) {
+        snd_pcm_close(self->handle);
+        self->handle = NULL;
+        return FL_METHOD_RESPONSE(
+            fl_method_error_response_new("ALSA_ERROR", "Unsupported resampling ratio", nullptr));
+      }
+      out_frames = self->resampler->MaxOutputFrames(self->write_frames);
+      g_print("ALSA device runs at %d Hz - resampling from %d Hz with %d taps\n", self->device_rate,
+              self->sample_rate, self->resampler->taps());
+    }
+    // Dart frames, then resampled frames, then channel-mapped frames
+    self->convert_float->assign(self->write_frames * self->channels + out_frames * self->channels +
+                                    out_frames * self->device_channels, 0.0f);
+    self->convert_out->assign(out_frames * self->device_bytes_per_frame, 0);
+    self->convert_frames = out_frames;
   }
 
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+  // Extra streams share the primary stream's layout. setup drops them all.
+  self->mixer->Configure(to_sample_format(self->format), self->channels, self->samples->capacity(),
+                         self->write_frames);
+  // Clips survive a setup with the same rate and channel count
+  self->clips->Configure(self->sample_rate, self->channels);
+  self->stream_gain = 1.0f;
+  self->stream_pan = 0.0f;
+  self->stats->Reset();
+
+  // The jitter buffer stretches in the Dart layout, before resampling
+  self->jitter->Configure(to_sample_format(self->format), self->sample_rate, self->channels, self->write_frames);
+  set_adaptive_limits(self);
+  self->adaptive_out->assign(self->write_frames * self->channels, 0.0f);
+
+  // Optional real-time scheduling and CPU pinning for the playback thread
+  flutter_pcm_sound::ThreadSchedulingRequest scheduling;
+  scheduling.priority = lookup_int(args, "realtime_priority", 0);
+  FlValue* policy_value = fl_value_lookup_string(args, "realtime_policy");
+  bool round_robin = policy_value && fl_value_get_type(policy_value) == FL_VALUE_TYPE_STRING &&
+                     strcmp(fl_value_get_string(policy_value), "rr") == 0;
+  scheduling.policy = round_robin ? SCHED_RR : SCHED_FIFO;
+  FlValue* affinity_value = fl_value_lookup_string(args, "cpu_affinity");
+  if (affinity_value && fl_value_get_type(affinity_value) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(affinity_value); i++) {
+      FlValue* cpu = fl_value_get_list_value(affinity_value, i);
+      if (fl_value_get_type(cpu) == FL_VALUE_TYPE_INT) {
+        scheduling.cpus.push_back(fl_value_get_int(cpu));
+      }
+    }
+  }
+
+  // Start the playback thread now; it sleeps until the first feed. The
+  // feed callback stays quiet until then, since Dart kicks off playback
+  // by calling it itself.
+  std::promise<flutter_pcm_sound::ThreadSchedulingResult> scheduled;
+  std::future<flutter_pcm_sound::ThreadSchedulingResult> scheduled_future = scheduled.get_future();
+  self->should_stop = false;
+  self->did_invoke_feed_callback = true;
+  self->start_held = false;
+  self->start_at_ns = 0;
+  self->last_feed_ns = flutter_pcm_sound::PlaybackStats::NowNs();
+  self->device_frames_written = 0;
+  self->flush_to = 0;
+  self->flush_requests = 0;
+  self->flushes_done = 0;
+  self->paused = false;
+  self->playback_thread = new std::thread(playback_thread_func, self, scheduling, std::move(scheduled));
+  flutter_pcm_sound::ThreadSchedulingResult sched = scheduled_future.get();
+  if (!sched.error.empty()) {
+    g_print("Playback thread scheduling: %s\n", sched.error.c_str());
+  }
+
+  // Report what the device actually negotiated
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "stream_id", fl_value_new_int(0));
+  fl_value_set_string_take(result, "device_id", fl_value_new_string(self->device_name->c_str()));
+  fl_value_set_string_take(result, "sample_rate", fl_value_new_int(self->sample_rate));
+  fl_value_set_string_take(result, "device_sample_rate", fl_value_new_int(self->device_rate));
+  if (self->needs_resampling) {
+    fl_value_set_string_take(result, "resample_quality", fl_value_new_string(resample_quality_name(resample_quality)));
+  }
+  fl_value_set_string_take(result, "num_channels", fl_value_new_int(self->channels));
+  fl_value_set_string_take(result, "sample_format", fl_value_new_string(format_name(self->format)));
+  fl_value_set_string_take(result, "device_sample_format", fl_value_new_string(format_name(self->device_format)));
+  fl_value_set_string_take(result, "device_channels", fl_value_new_int(self->device_channels));
+  fl_value_set_string_take(result, "buffer_frames", fl_value_new_int(actual_buffer_size));
+  fl_value_set_string_take(result, "period_frames", fl_value_new_int(actual_period_size));
+  fl_value_set_string_take(result, "start_threshold_frames", fl_value_new_int(start_threshold));
+  fl_value_set_string_take(result, "max_queue_frames", fl_value_new_int(self->samples->capacity() / bytes_per_frame));
+  fl_value_set_string_take(result, "feed_policy",
+                           fl_value_new_string(flutter_pcm_sound::FeedPolicyName(self->feed_policy)));
+  fl_value_set_string_take(result, "latency_profile", fl_value_new_string(low_latency ? "lowLatency" : "standard"));
+  fl_value_set_string_take(result, "transfer_mode", fl_value_new_string(self->use_mmap ? "mmap" : "readWrite"));
+  fl_value_set_string_take(result, "realtime_granted", fl_value_new_bool(sched.realtime_granted));
+  fl_value_set_string_take(result, "realtime_method", fl_value_new_string(sched.realtime_method));
+  fl_value_set_string_take(result, "realtime_priority", fl_value_new_int(sched.priority));
+  fl_value_set_string_take(result, "cpu_affinity_granted", fl_value_new_bool(sched.affinity_granted));
+  if (!sched.error.empty()) {
+    fl_value_set_string_take(result, "scheduling_error", fl_value_new_string(sched.error.c_str()));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
 }
 
+static size_t queue_file_samples(FlutterPcmSoundPlugin* self, const uint8_t* data, size_t length);
+static void post_file_done(FlutterPcmSoundPlugin* self, const std::string& error);
+
 static void flutter_pcm_sound_plugin_init(FlutterPcmSoundPlugin* self) {
+  self->output_id = 0;
+  self->outputs = new std::map<int64_t, FlutterPcmSoundPlugin*>();
+  self->next_output_id = 1;
   self->handle = NULL;
+  self->device_name = new std::string("default");
   self->feed_threshold = 1024;  // Will feed when one period worth of data remains
   self->did_invoke_feed_callback = false;
+  self->channel = nullptr;
+  self->feed_observer = nullptr;
+  self->feed_observer_data = nullptr;
+  self->feed_source = nullptr;
+  self->feed_message = fl_value_new_map();
+  self->pending_remaining_frames = 0;
+  self->pending_requested_frames = 0;
+  self->period_frames = 0;
+  self->start_held = false;
+  self->start_at_ns = 0;
+  self->last_feed_ns = 0;
+  self->device_frames_written = 0;
+  self->flush_to = 0;
+  self->flush_requests = 0;
+  self->flushes_done = 0;
+  self->paused = false;
+  self->can_pause = false;
+  self->samples = new flutter_pcm_sound::RingBuffer();
+  self->feed_waiter = new flutter_pcm_sound::FeedWaiter();
+  self->max_queue_us = flutter_pcm_sound::kDefaultMaxQueueMicros;
+  self->feed_policy = flutter_pcm_sound::FeedPolicy::kPartial;
+  self->stream_gain = 1.0f;
+  self->stream_pan = 0.0f;
+  self->mixer = new flutter_pcm_sound::Mixer();
+  self->adaptive = false;
+  self->adaptive_min_us = ADAPTIVE_MIN_US;
+  self->adaptive_max_us = ADAPTIVE_MAX_US;
+  self->jitter = new flutter_pcm_sound::JitterBuffer();
+  self->adaptive_out = new std::vector<float>();
+  self->clips = new flutter_pcm_sound::ClipBank();
+  self->stats = new flutter_pcm_sound::PlaybackStats();
+  self->stats_timer = 0;
+  self->write_frames = FRAMES_PER_WRITE;
+  self->use_mmap = false;
+  self->format = SND_PCM_FORMAT_S16_LE;
+  self->bytes_per_frame = 0;
+  self->device_format = SND_PCM_FORMAT_S16_LE;
+  self->device_channels = 0;
+  self->device_bytes_per_frame = 0;
+  self->device_rate = 0;
+  self->needs_conversion = false;
+  self->resampler = new flutter_pcm_sound::Resampler();
+  self->resample_quality = flutter_pcm_sound::ResampleQuality::kMedium;
+  self->needs_resampling = false;
+  self->convert_float = new std::vector<float>();
+  self->convert_out = new std::vector<uint8_t>();
+  self->convert_frames = 0;
   self->should_stop = false;
   self->playback_thread = nullptr;
+  self->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  self->call_mutex = new std::mutex();
+  self->file_path = new std::string();
+  self->file_player = new flutter_pcm_sound::FilePlayer(
+      [self](const uint8_t* data, size_t length) { return queue_file_samples(self, data, length); },
+      [self](const std::string& error) { post_file_done(self, error); });
+}
+
+// Queues what fits of `data` under `policy` right away, and wakes the
+// playback thread for it.
+static size_t queue_samples_now(FlutterPcmSoundPlugin* self, const uint8_t* data, size_t length,
+                                flutter_pcm_sound::FeedPolicy policy) {
+  size_t bytes_per_frame = self->bytes_per_frame;
+  size_t written = flutter_pcm_sound::FeedQueue(*self->samples, data, length, bytes_per_frame, policy);
+  int64_t now_ns = flutter_pcm_sound::PlaybackStats::NowNs();
+  self->stats->RecordFeed(written, now_ns);
+  self->last_feed_ns = now_ns;
+  if (self->adaptive) {
+    self->jitter->RecordFeed(written / bytes_per_frame, now_ns);
+  }
+  self->did_invoke_feed_callback = false;
+  wake_playback_thread(self);
+  return written;
+}
+
+// Queues samples for the playback thread under feed_policy and returns how
+// many bytes it took. Shared by the `feed` method and the FFI entry point.
+// Only a caller that passes the call_mutex `lock` it holds can block: the
+// rest, the platform thread among them, queue what fits.
+static size_t queue_samples(FlutterPcmSoundPlugin* self, const uint8_t* data, size_t length,
+                            std::unique_lock<std::mutex>* lock) {
+  PCM_TRACE_SCOPE("feed");
+  // Only whole frames are queued, so the reader never sees a torn frame.
+  // A blocked feed waits at most as long as it would take to play, and
+  // gives up while nothing drains the queue.
+  size_t bytes_per_frame = self->bytes_per_frame;
+  size_t written;
+  if (self->feed_policy == flutter_pcm_sound::FeedPolicy::kBlock && lock) {
+    size_t whole = length / bytes_per_frame * bytes_per_frame;
+    int64_t timeout_ns = (int64_t)(whole / bytes_per_frame) * 1000000000 / self->sample_rate;
+    written = self->feed_waiter->Block(*lock, whole, timeout_ns, [self, data, whole](size_t* written) {
+      // Release can run while the lock is let go
+      if (!self->handle) {
+        return false;
+      }
+      *written += queue_samples_now(self, data + *written, whole - *written, flutter_pcm_sound::FeedPolicy::kPartial);
+      return !self->paused && !self->start_held;
+    });
+  } else {
+    written = queue_samples_now(self, data, length, self->feed_policy);
+  }
+  if (written < length) {
+    g_print("Sample queue full - %s %zu bytes\n",
+            self->feed_policy == flutter_pcm_sound::FeedPolicy::kPartial ? "dropped" : "rejected",
+            length - written);
+  }
+  if (self->handle) {
+    PCM_TRACE_COUNTER("queue_frames", self->samples->ReadableBytes() / bytes_per_frame);
+  }
+  return written;
+}
+
+// Queues what fits of `data` for an addStream stream under `policy`, and
+// wakes the playback thread for it. -1 for an unknown stream.
+static int64_t queue_voice_samples_now(FlutterPcmSoundPlugin* self, int64_t stream_id, const uint8_t* data,
+                                       size_t length, flutter_pcm_sound::FeedPolicy policy) {
+  int64_t written = self->mixer->Write(stream_id, data, length, policy);
+  if (written >= 0) {
+    self->last_feed_ns = flutter_pcm_sound::PlaybackStats::NowNs();
+    wake_playback_thread(self);
+  }
+  return written;
+}
+
+// Queues samples for `stream_id`: the primary stream, or one added with
+// addStream. Either follows feed_policy, blocking only as queue_samples
+// does. Returns how many bytes it took, or -1 for an unknown stream.
+static int64_t queue_stream_samples(FlutterPcmSoundPlugin* self, int64_t stream_id, const uint8_t* data,
+                                    size_t length, std::unique_lock<std::mutex>* lock) {
+  if (stream_id == 0) {
+    return queue_samples(self, data, length, lock);
+  }
+  if (self->feed_policy != flutter_pcm_sound::FeedPolicy::kBlock || !lock) {
+    return queue_voice_samples_now(self, stream_id, data, length, self->feed_policy);
+  }
+  size_t bytes_per_frame = self->bytes_per_frame;
+  size_t whole = length / bytes_per_frame * bytes_per_frame;
+  int64_t timeout_ns = (int64_t)(whole / bytes_per_frame) * 1000000000 / self->sample_rate;
+  bool found = true;
+  size_t written = self->feed_waiter->Block(*lock, whole, timeout_ns, [&](size_t* written) {
+    // Release or removeStream can run while the lock is let go
+    if (!self->handle) {
+      return false;
+    }
+    int64_t queued = queue_voice_samples_now(self, stream_id, data + *written, whole - *written,
+                                             flutter_pcm_sound::FeedPolicy::kPartial);
+    if (queued < 0) {
+      found = *written > 0;
+      return false;
+    }
+    *written += queued;
+    return !self->paused && !self->start_held;
+  });
+  return found ? (int64_t)written : -1;
 }
 
 static FlMethodResponse* feed_alsa(FlutterPcmSoundPlugin* self, FlValue* args) {
   if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
 
   FlValue* buffer = fl_value_lookup_string(args, "buffer");
-  const uint8_t* data = fl_value_get_uint8_list(buffer);
-  size_t length = fl_value_get_length(buffer);
+  int64_t stream_id = lookup_int(args, "stream_id", 0);
+  // Never blocks: this is the platform thread
+  int64_t written = queue_stream_samples(self, stream_id, fl_value_get_uint8_list(buffer), fl_value_get_length(buffer),
+                                         nullptr);
+  if (written < 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown stream_id", nullptr));
+  }
 
-  {
-    std::lock_guard<std::mutex> lock(self->samples_mutex);
-    self->samples.insert(self->samples.end(), data, data + length);
+  // How many frames were accepted, so producers can back off
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(written / self->bytes_per_frame)));
+}
+
+// The file player's writer. It runs on the file thread and must not wait
+// for call_mutex, since Stop is called with it held; the player retries
+// whatever doesn't fit, so nothing is dropped.
+static size_t queue_file_samples(FlutterPcmSoundPlugin* self, const uint8_t* data, size_t length) {
+  std::unique_lock<std::mutex> lock(*self->call_mutex, std::try_to_lock);
+  if (!lock.owns_lock() || !self->handle) {
+    return 0;
+  }
+  size_t bytes_per_frame = self->bytes_per_frame;
+  size_t writable = self->samples->WritableBytes() / bytes_per_frame * bytes_per_frame;
+  size_t written = self->samples->Write(data, std::min(length, writable));
+  if (written > 0) {
+    int64_t now_ns = flutter_pcm_sound::PlaybackStats::NowNs();
+    self->stats->RecordFeed(written, now_ns);
+    self->last_feed_ns = now_ns;
     self->did_invoke_feed_callback = false;
+    wake_playback_thread(self);
+  }
+  return written;
+}
+
+struct FileDone {
+  FlutterPcmSoundPlugin* plugin;  // holds a reference
+  gchar* path;
+  gchar* error;  // null on success
+};
+
+static gboolean file_done_dispatch(gpointer user_data) {
+  FileDone* done = static_cast<FileDone*>(user_data);
+  g_autoptr(FlValue) map = fl_value_new_map();
+  fl_value_set_string_take(map, "path", fl_value_new_string(done->path));
+  if (done->plugin->output_id != 0) {
+    fl_value_set_string_take(map, "output_id", fl_value_new_int(done->plugin->output_id));
   }
+  if (done->error) {
+    fl_value_set_string_take(map, "error", fl_value_new_string(done->error));
+  }
+  fl_method_channel_invoke_method(done->plugin->channel, "OnFileDone", map, NULL, NULL, NULL);
+  return G_SOURCE_REMOVE;
+}
 
-  if (!self->playback_thread) {
-    self->should_stop = false;
-    self->playback_thread = new std::thread(playback_thread_func, self);
+static void file_done_free(gpointer user_data) {
+  FileDone* done = static_cast<FileDone*>(user_data);
+  g_object_unref(done->plugin);
+  g_free(done->path);
+  g_free(done->error);
+  g_free(done);
+}
+
+// Called on the file thread once the file is queued; tells Dart from the
+// main loop. file_path can't change before the thread exits.
+static void post_file_done(FlutterPcmSoundPlugin* self, const std::string& error) {
+  if (!error.empty()) {
+    g_print("playFile %s failed: %s\n", self->file_path->c_str(), error.c_str());
   }
+  FileDone* done = g_new0(FileDone, 1);
+  done->plugin = FLUTTER_PCM_SOUND_PLUGIN(g_object_ref(self));
+  done->path = g_strdup(self->file_path->c_str());
+  done->error = error.empty() ? nullptr : g_strdup(error.c_str());
+  g_idle_add_full(G_PRIORITY_DEFAULT, file_done_dispatch, done, file_done_free);
+}
 
+// Plays a WAV or raw PCM file, queued behind whatever was fed before it.
+// The file is mapped and fed into the primary stream by the file player's
+// thread, converted to the setup format; Dart hears OnFileDone once all of
+// it is queued. Compressed files need a decoder this plugin doesn't link.
+static FlMethodResponse* play_file(FlutterPcmSoundPlugin* self, FlValue* args) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  FlValue* path_value = fl_value_lookup_string(args, "path");
+  if (!path_value || fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "path required", nullptr));
+  }
+  const gchar* path = fl_value_get_string(path_value);
+  self->file_player->Stop();
+
+  std::string error;
+  auto file = std::make_unique<flutter_pcm_sound::MappedFile>();
+  if (!file->Open(path, &error)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("FILE_ERROR", error.c_str(), nullptr));
+  }
+  std::unique_ptr<flutter_pcm_sound::PcmSource> source;
+  FlValue* raw = fl_value_lookup_string(args, "raw");
+  if (raw && fl_value_get_type(raw) == FL_VALUE_TYPE_MAP) {
+    snd_pcm_format_t raw_format = lookup_format(raw);
+    if (raw_format == SND_PCM_FORMAT_UNKNOWN) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown raw sample_format", nullptr));
+    }
+    source = flutter_pcm_sound::OpenRawSource(std::move(file), to_sample_format(raw_format),
+                                              lookup_int(raw, "sample_rate", 0), lookup_int(raw, "num_channels", 0),
+                                              &error);
+  } else if (flutter_pcm_sound::IsWav(file->data(), file->size())) {
+    source = flutter_pcm_sound::OpenWavSource(std::move(file), &error);
+  } else {
+    error = "only WAV and raw PCM files can be played on Linux";
+  }
+  if (source) {
+    *self->file_path = path;
+    flutter_pcm_sound::SourceInfo info = source->info();
+    if (self->file_player->Start(std::move(source), self->sample_rate, self->channels,
+                                 to_sample_format(self->format), self->resample_quality, &error)) {
+      g_print("playFile %s: %d Hz, %d channels\n", path, info.sample_rate, info.channels);
+      g_autoptr(FlValue) result = fl_value_new_map();
+      fl_value_set_string_take(result, "sample_rate", fl_value_new_int(info.sample_rate));
+      fl_value_set_string_take(result, "num_channels", fl_value_new_int(info.channels));
+      if (info.frames >= 0) {
+        fl_value_set_string_take(result, "duration_us",
+                                 fl_value_new_int(info.frames * 1000000 / info.sample_rate));
+      }
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  return FL_METHOD_RESPONSE(fl_method_error_response_new("UNSUPPORTED_FORMAT", error.c_str(), nullptr));
+}
+
+// Stops queueing the current file. What's already queued still plays.
+static FlMethodResponse* stop_file(FlutterPcmSoundPlugin* self) {
+  self->file_player->Stop();
   return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
 }
 
+static FlMethodResponse* add_stream(FlutterPcmSoundPlugin* self, FlValue* args) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  int64_t stream_id = self->mixer->AddVoice(lookup_double(args, "gain", 1.0), lookup_double(args, "pan", 0.0));
+  if (stream_id < 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("TOO_MANY_STREAMS", "no free stream slots", nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "stream_id", fl_value_new_int(stream_id));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse* remove_stream(FlutterPcmSoundPlugin* self, FlValue* args) {
+  if (!self->mixer->RemoveVoice(lookup_int(args, "stream_id", 0))) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown stream_id", nullptr));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+static FlMethodResponse* set_stream_gain(FlutterPcmSoundPlugin* self, FlValue* args) {
+  int64_t stream_id = lookup_int(args, "stream_id", 0);
+  float gain = lookup_double(args, "gain", 1.0);
+  float pan = lookup_double(args, "pan", 0.0);
+  if (stream_id == 0) {
+    self->stream_gain = gain;
+    self->stream_pan = pan;
+  } else if (!self->mixer->SetVoiceGain(stream_id, gain, pan)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown stream_id", nullptr));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+// Reads the clip_id argument, or returns null.
+static const gchar* lookup_clip_id(FlValue* args) {
+  FlValue* value = fl_value_lookup_string(args, "clip_id");
+  if (!value || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+// Converts a clip to float at the setup rate and channel count once, so
+// playClip costs no copy or conversion. Clips are in the setup format
+// unless the arguments say otherwise.
+static FlMethodResponse* load_clip(FlutterPcmSoundPlugin* self, FlValue* args) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  const gchar* clip_id = lookup_clip_id(args);
+  FlValue* buffer = fl_value_lookup_string(args, "buffer");
+  if (!clip_id || !buffer || fl_value_get_type(buffer) != FL_VALUE_TYPE_UINT8_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "clip_id and buffer required", nullptr));
+  }
+  snd_pcm_format_t format = fl_value_lookup_string(args, "sample_format") ? lookup_format(args) : self->format;
+  if (format == SND_PCM_FORMAT_UNKNOWN) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown sample_format", nullptr));
+  }
+  std::string error;
+  if (!self->clips->Load(clip_id, fl_value_get_uint8_list(buffer), fl_value_get_length(buffer),
+                         to_sample_format(format), lookup_int(args, "sample_rate", self->sample_rate),
+                         lookup_int(args, "num_channels", self->channels), self->resample_quality, &error)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", error.c_str(), nullptr));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+static FlMethodResponse* play_clip(FlutterPcmSoundPlugin* self, FlValue* args) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  const gchar* clip_id = lookup_clip_id(args);
+  flutter_pcm_sound::Clip* clip = clip_id ? self->clips->Find(clip_id) : nullptr;
+  if (!clip) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown clip_id", nullptr));
+  }
+  int64_t voice_id = self->mixer->PlayClip(clip, lookup_double(args, "gain", 1.0), lookup_double(args, "pan", 0.0));
+  if (voice_id < 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("TOO_MANY_CLIPS", "every clip voice is playing", nullptr));
+  }
+  wake_playback_thread(self);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(voice_id)));
+}
+
+static FlMethodResponse* unload_clip(FlutterPcmSoundPlugin* self, FlValue* args) {
+  const gchar* clip_id = lookup_clip_id(args);
+  if (!clip_id || !self->clips->Unload(clip_id)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown clip_id", nullptr));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+static FlMethodResponse* set_clip_cache_limit(FlutterPcmSoundPlugin* self, FlValue* args) {
+  int64_t bytes = lookup_int(args, "bytes", -1);
+  if (bytes < 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "bytes required", nullptr));
+  }
+  self->clips->SetLimit(bytes);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+static FlValue* stats_to_value(FlutterPcmSoundPlugin* self) {
+  flutter_pcm_sound::StatsSnapshot snapshot;
+  self->stats->Snapshot(&snapshot);
+  FlValue* map = fl_value_new_map();
+  if (self->output_id != 0) {
+    fl_value_set_string_take(map, "output_id", fl_value_new_int(self->output_id));
+  }
+  fl_value_set_string_take(map, "underruns", fl_value_new_int(snapshot.underruns));
+  fl_value_set_string_take(map, "device_errors", fl_value_new_int(snapshot.device_errors));
+  fl_value_set_string_take(map, "recoveries", fl_value_new_int(snapshot.recoveries));
+  fl_value_set_string_take(map, "recovery_us_total", fl_value_new_int(snapshot.recovery_ns_total / 1000));
+  fl_value_set_string_take(map, "recovery_us_max", fl_value_new_int(snapshot.recovery_ns_max / 1000));
+  fl_value_set_string_take(map, "queue_high_frames", fl_value_new_int(snapshot.queue_high_frames));
+  if (snapshot.has_queue_low) {
+    fl_value_set_string_take(map, "queue_low_frames", fl_value_new_int(snapshot.queue_low_frames));
+  }
+  fl_value_set_string_take(map, "device_callbacks", fl_value_new_int(snapshot.device_callbacks));
+  fl_value_set_string_take(map, "feed_callbacks", fl_value_new_int(snapshot.feed_callbacks));
+  fl_value_set_string_take(map, "bytes_fed", fl_value_new_int(snapshot.bytes_fed));
+  fl_value_set_string_take(map, "bytes_played", fl_value_new_int(snapshot.bytes_played));
+  int64_t histogram[flutter_pcm_sound::kLatencyBuckets];
+  std::copy(snapshot.latency_histogram, snapshot.latency_histogram + flutter_pcm_sound::kLatencyBuckets, histogram);
+  fl_value_set_string_take(map, "latency_histogram",
+                           fl_value_new_int64_list(histogram, flutter_pcm_sound::kLatencyBuckets));
+  if (self->adaptive) {
+    fl_value_set_string_take(map, "adaptive_target_frames", fl_value_new_int(self->jitter->target_frames()));
+    fl_value_set_string_take(map, "adaptive_speed", fl_value_new_float(self->jitter->speed()));
+  }
+  return map;
+}
+
+static FlMethodResponse* get_stats(FlutterPcmSoundPlugin* self) {
+  g_autoptr(FlValue) result = stats_to_value(self);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static gboolean stats_timer_cb(gpointer user_data) {
+  FlutterPcmSoundPlugin* self = FLUTTER_PCM_SOUND_PLUGIN(user_data);
+  g_autoptr(FlValue) map = stats_to_value(self);
+  fl_method_channel_invoke_method(self->channel, "OnStats", map, NULL, NULL, NULL);
+  return G_SOURCE_CONTINUE;
+}
+
+// Pushes OnStats every `interval_ms` on the main loop; 0 stops it.
+static FlMethodResponse* set_stats_interval(FlutterPcmSoundPlugin* self, FlValue* args) {
+  int64_t interval_ms = lookup_int(args, "interval_ms", 0);
+  if (self->stats_timer) {
+    g_source_remove(self->stats_timer);
+    self->stats_timer = 0;
+  }
+  if (interval_ms > 0) {
+    self->stats_timer = g_timeout_add(interval_ms, stats_timer_cb, self);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+// Turns the adaptive jitter buffer on or off for the primary stream, with
+// the range its target depth stays in. Works before setup too; the
+// settings carry over to later setups.
+static FlMethodResponse* set_adaptive_buffer(FlutterPcmSoundPlugin* self, FlValue* args) {
+  FlValue* enabled_value = fl_value_lookup_string(args, "enabled");
+  if (!enabled_value || fl_value_get_type(enabled_value) != FL_VALUE_TYPE_BOOL) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "enabled required", nullptr));
+  }
+  int64_t min_us = lookup_int(args, "min_us", ADAPTIVE_MIN_US);
+  int64_t max_us = lookup_int(args, "max_us", ADAPTIVE_MAX_US);
+  if (min_us < 0 || max_us < min_us) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "need 0 <= min_us <= max_us", nullptr));
+  }
+  self->adaptive_min_us = min_us;
+  self->adaptive_max_us = max_us;
+  set_adaptive_limits(self);
+  self->adaptive = fl_value_get_bool(enabled_value);
+  wake_playback_thread(self);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+static int64_t monotonic_now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Holds playback until startAt: feeds fill the device buffer without
+// starting it. Takes effect the next time the device is stopped, so call
+// it right after setup, or once playback has run dry.
+static FlMethodResponse* prime_alsa(FlutterPcmSoundPlugin* self) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  self->start_at_ns = 0;
+  self->start_held = true;
+  self->feed_waiter->Cancel();
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+// Starts a primed device at host_time_ns on CLOCK_MONOTONIC, or right away
+// if that has passed.
+static FlMethodResponse* start_at_alsa(FlutterPcmSoundPlugin* self, FlValue* args) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+  if (!self->start_held) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_PRIMED", "call prime before startAt", nullptr));
+  }
+
+  self->start_at_ns = std::max(lookup_int(args, "host_time_ns", 0), (int64_t)1);
+  wake_playback_thread(self);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+// Frames of the primary stream that have reached the speaker, at the Dart
+// sample rate, and the CLOCK_MONOTONIC time the count was true at.
+static FlMethodResponse* get_playback_position(FlutterPcmSoundPlugin* self) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  // alsa-lib serializes this with the playback thread's writes. Retry if a
+  // write lands between reading the counter and the status, so the delay
+  // and the written count describe the same moment.
+  snd_pcm_status_t* status;
+  snd_pcm_status_alloca(&status);
+  uint64_t written;
+  int err;
+  do {
+    written = self->device_frames_written;
+    err = snd_pcm_status(self->handle, status);
+  } while (err == 0 && written != self->device_frames_written);
+  if (err < 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  }
+
+  // Stopped devices (primed, or after an xrun) still hold what the buffer
+  // fill level says
+  snd_pcm_state_t state = snd_pcm_status_get_state(status);
+  bool running = state == SND_PCM_STATE_RUNNING || state == SND_PCM_STATE_DRAINING;
+  uint64_t unplayed;
+  if (running) {
+    unplayed = std::max(snd_pcm_status_get_delay(status), (snd_pcm_sframes_t)0);
+  } else {
+    unplayed = self->buffer_frames - std::min(snd_pcm_status_get_avail(status), self->buffer_frames);
+  }
+  uint64_t played = written - std::min(unplayed, written);
+  if (self->needs_resampling) {
+    played = played * self->sample_rate / self->device_rate;
+  }
+
+  snd_htimestamp_t tstamp;
+  snd_pcm_status_get_htstamp(status, &tstamp);
+  int64_t host_time_ns = running ? (int64_t)tstamp.tv_sec * 1000000000 + tstamp.tv_nsec : monotonic_now_ns();
+
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "frames", fl_value_new_int(played));
+  fl_value_set_string_take(result, "host_time_ns", fl_value_new_int(host_time_ns));
+  fl_value_set_string_take(result, "running", fl_value_new_bool(running));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Drops everything fed so far, on every stream, and what the device holds.
+// A file being played stops too.
+// The playback thread does the work as soon as the wakeup reaches it, and
+// keeps the device open and prepared; feeds after this play as usual.
+static FlMethodResponse* flush_alsa(FlutterPcmSoundPlugin* self) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  // A file still being queued is cut off along with what it queued
+  self->file_player->Stop();
+  self->flush_to = self->samples->WritePosition();
+  self->mixer->Flush();
+  self->flush_requests++;
+  self->feed_waiter->Cancel();
+  wake_playback_thread(self);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+// Stops the device where it is, keeping everything queued, until resume.
+static FlMethodResponse* pause_alsa(FlutterPcmSoundPlugin* self) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  self->paused = true;
+  self->feed_waiter->Cancel();
+  wake_playback_thread(self);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+static FlMethodResponse* resume_alsa(FlutterPcmSoundPlugin* self) {
+  if (!self->handle) return FL_METHOD_RESPONSE(fl_method_error_response_new("NOT_INITIALIZED", "ALSA not initialized", nullptr));
+
+  self->paused = false;
+  wake_playback_thread(self);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+}
+
+int64_t flutter_pcm_sound_ffi_feed(const uint8_t* data, int64_t length) {
+  return flutter_pcm_sound_ffi_feed_stream(0, data, length);
+}
+
+int64_t flutter_pcm_sound_ffi_feed_stream(int64_t stream_id, const uint8_t* data, int64_t length) {
+  if (length < 0) {
+    return -1;
+  }
+  FlutterPcmSoundPlugin* self = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(ffi_mutex);
+    if (ffi_plugin) {
+      self = FLUTTER_PCM_SOUND_PLUGIN(g_object_ref(ffi_plugin));
+    }
+  }
+  if (!self) {
+    return -1;
+  }
+  int64_t result = -1;
+  {
+    std::unique_lock<std::mutex> lock(*self->call_mutex);
+    // A blocked feed on the main loop would hold off the calls that end it
+    bool can_block = !g_main_context_is_owner(g_main_context_default());
+    if (self->handle) {
+      result = queue_stream_samples(self, stream_id, data, length, can_block ? &lock : nullptr);
+    }
+  }
+  // May be the last reference if a newer engine replaced this one
+  g_object_unref(self);
+  return result;
+}
+
 static FlMethodResponse* release_alsa(FlutterPcmSoundPlugin* self) {
  if (self->handle) {
+   self->feed_waiter->Cancel();
+   self->file_player->Stop();
    if (self->playback_thread) {
      self->should_stop = true;
+     wake_playback_thread(self);
      self->playback_thread->join();
      delete self->playback_thread;
      self->playback_thread = nullptr;
    }
 
-   snd_pcm_drain(self->handle);
+   // Drain must block until the device has played out. A paused device
+   // is dropped instead, since draining would resume it.
+   if (self->paused) {
+     snd_pcm_drop(self->handle);
+   } else {
+     snd_pcm_nonblock(self->handle, 0);
+     snd_pcm_drain(self->handle);
+   }
    snd_pcm_close(self->handle);
    self->handle = NULL;
 
-   {
-     std::lock_guard<std::mutex> lock(self->samples_mutex);
-     self->samples.clear();
-   }
+   // Safe without a lock: the playback thread has been joined
+   self->samples->Clear();
+   self->mixer->Clear();
  }
  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
 }
 
-static void flutter_pcm_sound_plugin_handle_method_call(
-   FlutterPcmSoundPlugin* self,
-   FlMethodCall* method_call) {
- g_autoptr(FlMethodResponse) response = nullptr;
- const gchar* method = fl_method_call_get_name(method_call);
- FlValue* args = fl_method_call_get_args(method_call);
+// The playback PCMs ALSA knows of, for setup's device_id. Cards show up
+// as hw: (no conversion at all) and plughw: (format and channel conversion
+// only) as well as through the configured plugins such as dmix.
+static FlMethodResponse* list_devices() {
+  void** hints = nullptr;
+  int err = snd_device_name_hint(-1, "pcm", &hints);
+  if (err < 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("ALSA_ERROR", snd_strerror(err), nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_list();
+  for (void** hint = hints; *hint; hint++) {
+    char* name = snd_device_name_get_hint(*hint, "NAME");
+    char* desc = snd_device_name_get_hint(*hint, "DESC");
+    char* ioid = snd_device_name_get_hint(*hint, "IOID");
+    // No IOID means both directions
+    if (name && strcmp(name, "null") != 0 && (!ioid || strcmp(ioid, "Output") == 0)) {
+      // DESC is a title line, then details
+      std::string title = desc ? desc : name;
+      std::string details;
+      size_t newline = title.find('\n');
+      if (newline != std::string::npos) {
+        details = title.substr(newline + 1);
+        title.resize(newline);
+      }
+      FlValue* device = fl_value_new_map();
+      fl_value_set_string_take(device, "id", fl_value_new_string(name));
+      fl_value_set_string_take(device, "name", fl_value_new_string(title.c_str()));
+      fl_value_set_string_take(device, "description", fl_value_new_string(details.c_str()));
+      fl_value_set_string_take(device, "is_default", fl_value_new_bool(strcmp(name, "default") == 0));
+      fl_value_append_take(result, device);
+    }
+    free(name);
+    free(desc);
+    free(ioid);
+  }
+  snd_device_name_free_hint(hints);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// A new output for another device: a plugin instance of its own, which
+// the registered one forwards calls carrying its output_id to.
+static FlMethodResponse* open_output(FlutterPcmSoundPlugin* self) {
+  FlutterPcmSoundPlugin* output =
+      FLUTTER_PCM_SOUND_PLUGIN(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+  // Outputs don't have outputs of their own
+  delete output->outputs;
+  output->outputs = nullptr;
+  output->output_id = self->next_output_id++;
+  output->channel = self->channel;
+  output->feed_observer = self->feed_observer;
+  output->feed_observer_data = self->feed_observer_data;
+  fl_value_set_string_take(output->feed_message, "output_id", fl_value_new_int(output->output_id));
+  if (self->channel || self->feed_observer) {
+    attach_feed_source(output);
+  }
+  (*self->outputs)[output->output_id] = output;
+
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "output_id", fl_value_new_int(output->output_id));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Releases an output, playing out what it holds, and forgets it.
+static void close_output(FlutterPcmSoundPlugin* output) {
+  {
+    std::lock_guard<std::mutex> lock(*output->call_mutex);
+    g_autoptr(FlMethodResponse) released = release_alsa(output);
+  }
+  g_object_unref(output);
+}
+
+FlMethodResponse* flutter_pcm_sound_plugin_handle_method(FlutterPcmSoundPlugin* self, const gchar* method,
+                                                         FlValue* args) {
+ // Calls for another output go to its instance, which takes its own lock.
+ // Only the platform thread touches `outputs`.
+ FlValue* output_value =
+     args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "output_id") : nullptr;
+ if (self->outputs && output_value && fl_value_get_type(output_value) == FL_VALUE_TYPE_INT &&
+     fl_value_get_int(output_value) != 0) {
+   auto found = self->outputs->find(fl_value_get_int(output_value));
+   if (found == self->outputs->end()) {
+     return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "unknown output_id", nullptr));
+   }
+   FlutterPcmSoundPlugin* output = found->second;
+   if (strcmp(method, "closeOutput") == 0) {
+     self->outputs->erase(found);
+     close_output(output);
+     return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+   }
+   return flutter_pcm_sound_plugin_handle_method(output, method, args);
+ }
+ if (strcmp(method, "listDevices") == 0) {
+   return list_devices();
+ }
+ if (strcmp(method, "openOutput") == 0) {
+   if (!self->outputs) {
+     return FL_METHOD_RESPONSE(fl_method_error_response_new("INVALID_ARGS", "outputs can't open outputs", nullptr));
+   }
+   return open_output(self);
+ }
+
+ FlMethodResponse* response = nullptr;
+ std::lock_guard<std::mutex> lock(*self->call_mutex);
 
 if (strcmp(method, "setLogLevel") == 0) {
   response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
@@ -239,88 +1426,672 @@ if (strcmp(method, "setLogLevel") == 0) {
    response = setup_alsa(self, args);
  } else if (strcmp(method, "feed") == 0) {
    response = feed_alsa(self, args);
+ } else if (strcmp(method, "addStream") == 0) {
+   response = add_stream(self, args);
+ } else if (strcmp(method, "removeStream") == 0) {
+   response = remove_stream(self, args);
+ } else if (strcmp(method, "setStreamGain") == 0) {
+   response = set_stream_gain(self, args);
+ } else if (strcmp(method, "loadClip") == 0) {
+   response = load_clip(self, args);
+ } else if (strcmp(method, "playClip") == 0) {
+   response = play_clip(self, args);
+ } else if (strcmp(method, "unloadClip") == 0) {
+   response = unload_clip(self, args);
+ } else if (strcmp(method, "setClipCacheLimit") == 0) {
+   response = set_clip_cache_limit(self, args);
+ } else if (strcmp(method, "prime") == 0) {
+   response = prime_alsa(self);
+ } else if (strcmp(method, "startAt") == 0) {
+   response = start_at_alsa(self, args);
+ } else if (strcmp(method, "getPlaybackPosition") == 0) {
+   response = get_playback_position(self);
+ } else if (strcmp(method, "flush") == 0) {
+   response = flush_alsa(self);
+ } else if (strcmp(method, "pause") == 0) {
+   response = pause_alsa(self);
+ } else if (strcmp(method, "resume") == 0) {
+   response = resume_alsa(self);
+ } else if (strcmp(method, "playFile") == 0) {
+   response = play_file(self, args);
+ } else if (strcmp(method, "stopFile") == 0) {
+   response = stop_file(self);
+ } else if (strcmp(method, "getStats") == 0) {
+   response = get_stats(self);
+ } else if (strcmp(method, "setAdaptiveBuffer") == 0) {
+   response = set_adaptive_buffer(self, args);
+ } else if (strcmp(method, "setStatsInterval") == 0) {
+   response = set_stats_interval(self, args);
  } else if (strcmp(method, "release") == 0) {
    response = release_alsa(self);
+   // Only an explicit release drops clips; setup keeps them
+   self->clips->Clear();
  } else {
    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
  }
+ return response;
+}
+
+void flutter_pcm_sound_plugin_set_feed_observer(FlutterPcmSoundPlugin* self, FlutterPcmSoundFeedObserver observer,
+                                                gpointer user_data) {
+  self->feed_observer = observer;
+  self->feed_observer_data = user_data;
+  if (!self->feed_source) {
+    attach_feed_source(self);
+  }
+}
 
+static void flutter_pcm_sound_plugin_handle_method_call(
+   FlutterPcmSoundPlugin* self,
+   FlMethodCall* method_call) {
+ g_autoptr(FlMethodResponse) response = flutter_pcm_sound_plugin_handle_method(
+     self, fl_method_call_get_name(method_call), fl_method_call_get_args(method_call));
  fl_method_call_respond(method_call, response, nullptr);
 }
 
 static void flutter_pcm_sound_plugin_dispose(GObject* object) {
  FlutterPcmSoundPlugin* self = FLUTTER_PCM_SOUND_PLUGIN(object);
+ // Never ffi_plugin here: that holds a reference
+ // Outputs go the way this instance does, without draining
+ if (self->outputs) {
+   for (auto& output : *self->outputs) {
+     g_object_unref(output.second);
+   }
+   delete self->outputs;
+   self->outputs = nullptr;
+ }
+ if (self->feed_source) {
+   g_source_destroy(self->feed_source);
+   g_source_unref(self->feed_source);
+   self->feed_source = nullptr;
+ }
+ if (self->feed_message) {
+   fl_value_unref(self->feed_message);
+   self->feed_message = nullptr;
+ }
+ if (self->stats_timer) {
+   g_source_remove(self->stats_timer);
+   self->stats_timer = 0;
+ }
+ // Joins the file thread, which may be waiting for room in the queue
+ delete self->file_player;
+ self->file_player = nullptr;
+ delete self->file_path;
+ self->file_path = nullptr;
+ if (self->playback_thread) {
+   self->should_stop = true;
+   wake_playback_thread(self);
+   self->playback_thread->join();
+   delete self->playback_thread;
+   self->playback_thread = nullptr;
+ }
  if (self->handle) {
    snd_pcm_close(self->handle);
    self->handle = NULL;
  }
+ if (self->wakeup_fd >= 0) {
+   close(self->wakeup_fd);
+   self->wakeup_fd = -1;
+ }
+ delete self->samples;
+ self->samples = nullptr;
+ delete self->feed_waiter;
+ self->feed_waiter = nullptr;
+ delete self->device_name;
+ self->device_name = nullptr;
+ delete self->mixer;
+ self->mixer = nullptr;
+ delete self->jitter;
+ self->jitter = nullptr;
+ delete self->adaptive_out;
+ self->adaptive_out = nullptr;
+ delete self->clips;
+ self->clips = nullptr;
+ delete self->stats;
+ self->stats = nullptr;
+ delete self->resampler;
+ self->resampler = nullptr;
+ delete self->convert_float;
+ self->convert_float = nullptr;
+ delete self->convert_out;
+ self->convert_out = nullptr;
+ delete self->call_mutex;
+ self->call_mutex = nullptr;
  G_OBJECT_CLASS(flutter_pcm_sound_plugin_parent_class)->dispose(object);
 }
 
 static void flutter_pcm_sound_plugin_class_init(FlutterPcmSoundPluginClass* klass) {
  G_OBJECT_CLASS(klass)->dispose = flutter_pcm_sound_plugin_dispose;
-}static void playback_thread_func(FlutterPcmSoundPlugin* self) {
-  // Write larger chunks to reduce thread overhead
-  const size_t frames_per_write = 2048;  // Increased from 1024
-  const size_t bytes_per_write = frames_per_write * self->channels * 2;
-  
+}
+
+// Sleeps until feed/release signal the wakeup eventfd or, when
+// `for_device` is set, until the device can accept more frames.
+static void wait_for_playback_event(FlutterPcmSoundPlugin* self, struct pollfd* fds,
+                                    int pcm_fd_count, bool for_device) {
+  struct pollfd* wakeup = &fds[pcm_fd_count];
+  struct pollfd* first = for_device ? fds : wakeup;
+  nfds_t count = for_device ? pcm_fd_count + 1 : 1;
+
   while (!self->should_stop) {
-    std::vector<uint8_t> chunk;
-    size_t remaining_frames;
-    bool need_more_data = false;
-    
-    {
-      std::lock_guard<std::mutex> lock(self->samples_mutex);
-      if (self->samples.empty()) {
-        if (!self->did_invoke_feed_callback) {
-          self->did_invoke_feed_callback = true;
-          need_more_data = true;
-          g_print("Buffer empty - requesting more data\n");  // Add this back
+    if (poll(first, count, -1) < 0) {
+      if (errno == EINTR) continue;
+      g_print("Playback poll failed: %s\n", strerror(errno));
+      return;
+    }
+
+    if (wakeup->revents & POLLIN) {
+      uint64_t value;
+      if (read(self->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        g_print("Failed to read wakeup eventfd: %s\n", strerror(errno));
+      }
+      return;
+    }
+
+    // Some plugins multiplex several fds; let ALSA translate the events
+    unsigned short revents = 0;
+    snd_pcm_poll_descriptors_revents(self->handle, fds, pcm_fd_count, &revents);
+    if (revents & (POLLOUT | POLLERR)) {
+      return;
+    }
+  }
+}
+
+// Sleeps until feed/release signal the wakeup eventfd or `timeout_ns`
+// passes, whichever comes first.
+static void wait_for_wakeup(FlutterPcmSoundPlugin* self, struct pollfd* wakeup, int64_t timeout_ns) {
+  struct timespec timeout;
+  timeout.tv_sec = timeout_ns / 1000000000;
+  timeout.tv_nsec = timeout_ns % 1000000000;
+  if (ppoll(wakeup, 1, &timeout, nullptr) > 0) {
+    uint64_t value;
+    if (read(self->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+      g_print("Failed to read wakeup eventfd: %s\n", strerror(errno));
+    }
+  }
+}
+
+// Copies up to `frames` frames into the device's mmap area. Returns the
+// number of frames committed, 0 when the device has no room, or a
+// negative ALSA error.
+static snd_pcm_sframes_t mmap_write(FlutterPcmSoundPlugin* self, const uint8_t* data, snd_pcm_uframes_t frames) {
+  const size_t bytes_per_frame = self->device_bytes_per_frame;
+
+  snd_pcm_sframes_t avail = snd_pcm_avail_update(self->handle);
+  if (avail < 0) {
+    return avail;
+  }
+  if (avail == 0) {
+    return 0;
+  }
+
+  const snd_pcm_channel_area_t* areas;
+  snd_pcm_uframes_t offset;
+  snd_pcm_uframes_t count = std::min(frames, (snd_pcm_uframes_t)avail);
+  int err = snd_pcm_mmap_begin(self->handle, &areas, &offset, &count);
+  if (err < 0) {
+    return err;
+  }
+
+  // Interleaved access: every channel shares one area with a frame-sized step
+  uint8_t* dst = static_cast<uint8_t*>(areas[0].addr) + areas[0].first / 8 + offset * (areas[0].step / 8);
+  memcpy(dst, data, count * bytes_per_frame);
+
+  snd_pcm_sframes_t committed = snd_pcm_mmap_commit(self->handle, offset, count);
+  if (committed < 0) {
+    return committed;
+  }
+  if ((snd_pcm_uframes_t)committed != count) {
+    return -EPIPE;
+  }
+  return committed;
+}
+
+// Converts `frames` frames from the Dart layout to the device's rate,
+// channels and format in the preallocated scratch buffers. Points `out` at
+// the result and returns how many device frames it holds, which differs
+// from `frames` when resampling.
+static size_t convert_float_for_device(FlutterPcmSoundPlugin* self, size_t frames, const uint8_t** out);
+
+static size_t convert_for_device(FlutterPcmSoundPlugin* self, const uint8_t* data, size_t frames,
+                                 const uint8_t** out) {
+  flutter_pcm_sound::ToFloat(to_sample_format(self->format), data, self->convert_float->data(),
+                             frames * self->channels);
+  return convert_float_for_device(self, frames, out);
+}
+
+// Same as convert_for_device, for float frames already at the start of
+// convert_float.
+static size_t convert_float_for_device(FlutterPcmSoundPlugin* self, size_t frames, const uint8_t** out) {
+  float* in = self->convert_float->data();
+  float* resampled = in + self->write_frames * self->channels;
+
+  float* current = in;
+  if (self->needs_resampling) {
+    frames = self->resampler->Process(in, frames, resampled);
+    current = resampled;
+  }
+
+  if (self->device_channels != self->channels) {
+    float* mixed = resampled + self->convert_frames * self->channels;
+    flutter_pcm_sound::RemapChannels(current, self->channels, mixed, self->device_channels, frames);
+    current = mixed;
+  }
+
+  flutter_pcm_sound::FromFloat(to_sample_format(self->device_format), current, self->convert_out->data(),
+                               frames * self->device_channels);
+  *out = self->convert_out->data();
+  return frames;
+}
+
+// Frames left to play, at the Dart sample rate: `queued_frames` still in
+// the sample queue plus whatever the device (and resampler) hold.
+static size_t remaining_playback_frames(FlutterPcmSoundPlugin* self, size_t queued_frames) {
+  snd_pcm_sframes_t delay = 0;
+  if (snd_pcm_delay(self->handle, &delay) < 0) {
+    // Not running (e.g. after an xrun): fall back to the buffer fill level
+    snd_pcm_sframes_t avail = snd_pcm_avail(self->handle);
+    delay = avail < 0 ? 0 : (snd_pcm_sframes_t)self->buffer_frames - std::min(avail, (snd_pcm_sframes_t)self->buffer_frames);
+  }
+  delay = std::max(delay, (snd_pcm_sframes_t)0);
+
+  size_t device_frames = delay;
+  if (self->needs_resampling) {
+    device_frames = (uint64_t)delay * self->sample_rate / self->device_rate + self->resampler->latency_frames();
+  }
+  return queued_frames + device_frames;
+}
+
+// Asks Dart for more samples without allocating: requests made before the
+// main loop gets round to sending one are merged into it. A plugin that was
+// never registered has nowhere to send them.
+static void request_feed(FlutterPcmSoundPlugin* self, size_t remaining_frames) {
+  if (!self->feed_source) {
+    return;
+  }
+  // Everything here counts frames at the Dart rate, period_frames included
+  size_t period_frames = self->period_frames;
+  if (self->needs_resampling) {
+    period_frames = std::max<size_t>((uint64_t)period_frames * self->sample_rate / self->device_rate, 1);
+  }
+  size_t target = self->feed_threshold + period_frames;
+  self->pending_remaining_frames = remaining_frames;
+  self->pending_requested_frames = remaining_frames < target ? target - remaining_frames : period_frames;
+  PCM_TRACE_INSTANT("feed_request");
+  g_source_set_ready_time(self->feed_source, 0);
+}
+
+// Starts the device once it holds start_threshold frames, unless pre-roll
+// is holding it. The adaptive buffer also needs its target depth queued,
+// counting the device buffer, before playback starts. When the queue is
+// `dry` (or nothing more can be written) the device also starts short, so
+// a short clip isn't left sitting in its buffer, but only once no feed has
+// come for DRY_START_GRACE_NS. Returns how long until that grace runs out,
+// or 0 when the device isn't waiting on it.
+static int64_t maybe_start_device(FlutterPcmSoundPlugin* self, bool dry) {
+  if (self->start_held || snd_pcm_state(self->handle) != SND_PCM_STATE_PREPARED) {
+    return 0;
+  }
+  snd_pcm_sframes_t avail = snd_pcm_avail_update(self->handle);
+  if (avail < 0) {
+    return 0;
+  }
+  snd_pcm_uframes_t held = self->buffer_frames - std::min((snd_pcm_uframes_t)avail, self->buffer_frames);
+  bool deep_enough = true;
+  if (self->adaptive) {
+    size_t queued_frames = self->samples->ReadableBytes() / self->bytes_per_frame + self->jitter->buffered_frames();
+    deep_enough = remaining_playback_frames(self, queued_frames) >= self->jitter->target_frames();
+  }
+  if (held >= self->start_threshold && deep_enough) {
+    snd_pcm_start(self->handle);
+    return 0;
+  }
+  if (!dry || held == 0) {
+    return 0;
+  }
+  int64_t quiet_ns = flutter_pcm_sound::PlaybackStats::NowNs() - self->last_feed_ns;
+  if (quiet_ns >= DRY_START_GRACE_NS) {
+    snd_pcm_start(self->handle);
+    return 0;
+  }
+  return DRY_START_GRACE_NS - quiet_ns;
+}
+
+// Wakeups closer than this to a scheduled start are slept out with
+// clock_nanosleep, which lands within scheduler jitter of the target
+#define START_AT_FINE_NS 2000000
+
+static bool start_due(FlutterPcmSoundPlugin* self) {
+  int64_t start_at = self->start_at_ns;
+  return start_at != 0 && start_at - monotonic_now_ns() <= START_AT_FINE_NS;
+}
+
+// Pre-roll. Sleeps until startAt's time or a wakeup, whichever comes
+// first, and starts the device if the time came.
+static void wait_for_start(FlutterPcmSoundPlugin* self, struct pollfd* wakeup) {
+  int64_t start_at = self->start_at_ns;
+  if (!start_due(self)) {
+    struct timespec timeout;
+    int64_t remaining = start_at - START_AT_FINE_NS - monotonic_now_ns();
+    timeout.tv_sec = remaining / 1000000000;
+    timeout.tv_nsec = remaining % 1000000000;
+    // No start scheduled: wait for startAt itself
+    int ready = ppoll(wakeup, 1, start_at == 0 ? nullptr : &timeout, nullptr);
+    if (ready != 0) {
+      if (ready > 0) {
+        uint64_t value;
+        if (read(self->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+          g_print("Failed to read wakeup eventfd: %s\n", strerror(errno));
         }
-        // Don't sleep if we're empty, just try again
+      }
+      return;  // fed, rescheduled or released: go round again
+    }
+  }
+
+  struct timespec at;
+  at.tv_sec = start_at / 1000000000;
+  at.tv_nsec = start_at % 1000000000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, nullptr) == EINTR) {
+  }
+  if (self->should_stop || self->start_at_ns != start_at) {
+    return;
+  }
+  int err = snd_pcm_start(self->handle);
+  if (err < 0) {
+    g_print("Scheduled start failed: %s\n", snd_strerror(err));
+    self->stats->RecordDeviceError();
+  }
+  self->start_at_ns = 0;
+  self->start_held = false;
+}
+
+static bool flush_pending(FlutterPcmSoundPlugin* self) {
+  return self->flush_requests != self->flushes_done;
+}
+
+// Drops what the device holds, keeping the playback position to what was
+// actually played, and leaves it prepared.
+static void drop_device(FlutterPcmSoundPlugin* self) {
+  snd_pcm_sframes_t delay = 0;
+  if (snd_pcm_delay(self->handle, &delay) == 0 && delay > 0) {
+    self->device_frames_written -= std::min((uint64_t)delay, (uint64_t)self->device_frames_written);
+  }
+  int err = snd_pcm_drop(self->handle);
+  if (err == 0) {
+    err = snd_pcm_prepare(self->handle);
+  }
+  if (err < 0) {
+    g_print("Failed to drop the device buffer: %s\n", snd_strerror(err));
+    self->stats->RecordDeviceError();
+  }
+}
+
+// Carries out flush: drops the device buffer, the primary queue up to
+// flush_to and the resampler's history. Voice queues go on the next
+// MaxQueuedFrames.
+static void apply_flush(FlutterPcmSoundPlugin* self) {
+  uint32_t requests = self->flush_requests;
+  drop_device(self);
+  self->stats->RecordDiscarded(self->samples->DiscardTo(self->flush_to));
+  if (self->needs_resampling) {
+    self->resampler->Reset();
+  }
+  self->jitter->Flush();
+  self->flushes_done = requests;
+}
+
+// Holds the device while paused, sleeping until resume, flush or release.
+static void wait_while_paused(FlutterPcmSoundPlugin* self, struct pollfd* wakeup) {
+  bool hardware_paused = false;
+  if (snd_pcm_state(self->handle) == SND_PCM_STATE_RUNNING) {
+    if (self->can_pause && snd_pcm_pause(self->handle, 1) == 0) {
+      hardware_paused = true;
+    } else {
+      // Resume replays from the sample queue; only the device buffer is lost
+      drop_device(self);
+    }
+  }
+
+  while (self->paused && !self->should_stop && !flush_pending(self)) {
+    if (ppoll(wakeup, 1, nullptr, nullptr) > 0) {
+      uint64_t value;
+      if (read(self->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        g_print("Failed to read wakeup eventfd: %s\n", strerror(errno));
+      }
+    }
+  }
+
+  // A flush drops the paused buffer without letting it play first
+  if (hardware_paused && !self->should_stop && !flush_pending(self)) {
+    int err = snd_pcm_pause(self->handle, 0);
+    if (err < 0) {
+      g_print("Failed to resume the device: %s\n", snd_strerror(err));
+      self->stats->RecordDeviceError();
+      snd_pcm_prepare(self->handle);
+    }
+  }
+}
+
+static void playback_thread_func(FlutterPcmSoundPlugin* self,
+                                 flutter_pcm_sound::ThreadSchedulingRequest scheduling,
+                                 std::promise<flutter_pcm_sound::ThreadSchedulingResult> scheduled) {
+  // Elevate before touching the device, and let setup report the outcome
+  scheduled.set_value(flutter_pcm_sound::ApplyThreadScheduling(scheduling));
+
+  const size_t bytes_per_frame = self->bytes_per_frame;
+  const size_t device_bytes_per_frame = self->device_bytes_per_frame;
+
+  // Poll set: the PCM's own descriptors followed by the wakeup eventfd
+  int pcm_fd_count = snd_pcm_poll_descriptors_count(self->handle);
+  if (pcm_fd_count < 0) {
+    g_print("Failed to get ALSA poll descriptors: %s\n", snd_strerror(pcm_fd_count));
+    return;
+  }
+  std::vector<struct pollfd> fds(pcm_fd_count + 1);
+  snd_pcm_poll_descriptors(self->handle, fds.data(), pcm_fd_count);
+  fds[pcm_fd_count].fd = self->wakeup_fd;
+  fds[pcm_fd_count].events = POLLIN;
+
+  while (!self->should_stop) {
+    // Whatever the last pass took out of the queues made room
+    self->feed_waiter->Notify();
+    if (flush_pending(self)) {
+      apply_flush(self);
+      continue;
+    }
+    if (self->paused) {
+      wait_while_paused(self, &fds[pcm_fd_count]);
+      continue;
+    }
+
+    // A scheduled start takes priority over topping up the buffer
+    if (self->start_held && start_due(self)) {
+      wait_for_start(self, &fds[pcm_fd_count]);
+      continue;
+    }
+
+    // Write straight out of the queue's storage: feed's copy into the
+    // queue is the only one before alsa-lib
+    const uint8_t* chunk = nullptr;
+    size_t contiguous = self->samples->Peek(&chunk);
+    size_t readable = self->samples->ReadableBytes();
+    size_t voice_frames = self->mixer->MaxQueuedFrames();
+    // Frames the jitter buffer took from the queue and hasn't played. It
+    // plays out what it holds even once turned off.
+    size_t held_frames = self->jitter->buffered_frames();
+    bool adaptive = self->adaptive || held_frames > 0;
+    if (contiguous < bytes_per_frame && held_frames == 0 && !self->did_invoke_feed_callback.exchange(true)) {
+      request_feed(self, remaining_playback_frames(self, 0));
+      g_print("Buffer empty - requesting more data\n");
+    }
+    if (contiguous < bytes_per_frame && held_frames == 0 && voice_frames == 0) {
+      if (self->start_held) {
+        wait_for_start(self, &fds[pcm_fd_count]);
         continue;
       }
+      // Nothing to play: sleep until feed or release wakes us. A device
+      // that never reached its start threshold is checked on again when
+      // the grace for more feeds runs out.
+      int64_t grace_ns = maybe_start_device(self, true);
+      if (grace_ns > 0) {
+        wait_for_wakeup(self, &fds[pcm_fd_count], grace_ns);
+      } else {
+        wait_for_playback_event(self, fds.data(), pcm_fd_count, false);
+      }
+      continue;
+    }
+
+    // One period: from taking a chunk out of the queue until the device
+    // has all of it
+    PCM_TRACE_SCOPE("period");
+    PCM_TRACE_COUNTER("queue_frames", readable / bytes_per_frame);
+
+    // Extra streams, or gain on the primary one, mean mixing in float.
+    // Otherwise write the primary stream as it is.
+    float gain = self->stream_gain;
+    float pan = self->stream_pan;
+    bool mixing = adaptive || voice_frames > 0 || gain != 1.0f || pan != 0.0f;
+    size_t chunk_frames = mixing ? std::max(readable / bytes_per_frame, voice_frames)
+                                 : contiguous / bytes_per_frame;
+    chunk_frames = std::min((size_t)self->write_frames, chunk_frames);
+    self->stats->RecordDeviceCallback(readable / bytes_per_frame);
 
-      size_t bytes_to_take = std::min(bytes_per_write, self->samples.size());
-      chunk.assign(self->samples.begin(), self->samples.begin() + bytes_to_take);
-      self->samples.erase(self->samples.begin(), self->samples.begin() + bytes_to_take);
-      
-      remaining_frames = self->samples.size() / (self->channels * 2);
-      
-      if (remaining_frames <= self->feed_threshold && !self->did_invoke_feed_callback) {
-        self->did_invoke_feed_callback = true;
-        need_more_data = true;
+    // Request more data based on how long until the device actually runs
+    // dry, not just on what's left in the queue. Only query the device
+    // while a request is still possible.
+    // The jitter buffer wants its target depth queued on top.
+    if (!self->did_invoke_feed_callback) {
+      size_t remaining_frames = remaining_playback_frames(self, readable / bytes_per_frame + held_frames);
+      size_t threshold = self->feed_threshold;
+      if (self->adaptive) {
+        threshold = std::max(threshold, self->jitter->target_frames());
+      }
+      if (remaining_frames <= threshold && !self->did_invoke_feed_callback.exchange(true)) {
+        request_feed(self, remaining_frames);
       }
     }
 
-    // Request more data outside the lock if needed
-    if (need_more_data) {
-      FeedCallbackData* data = new FeedCallbackData{self, remaining_frames};
-      g_idle_add(feed_callback, data);
+    // Convert once per chunk when the device layout differs. The converted
+    // copy is all the write loop needs, so the queue can let go right away.
+    const uint8_t* device_chunk = chunk;
+    size_t device_frames = chunk_frames;
+    bool zero_copy = false;
+    // Primary stream bytes taken out of the queue but not yet counted as
+    // played. Zero-copy writes count as they go instead.
+    size_t unplayed_bytes = 0;
+    if (adaptive) {
+      // The jitter buffer keeps a lookahead back from the device, and only
+      // plays it out when the device is down to two periods
+      size_t drain_frames = (uint64_t)self->period_frames * 2 * self->sample_rate / self->device_rate;
+      bool drain = !self->adaptive || remaining_playback_frames(self, 0) <= drain_frames;
+      size_t consumed_frames = 0;
+      float* stretched = self->adaptive_out->data();
+      size_t stretched_frames = self->jitter->Read(*self->samples, stretched, self->write_frames, drain,
+                                                   &consumed_frames);
+      unplayed_bytes = consumed_frames * bytes_per_frame;
+      if (stretched_frames == 0 && voice_frames == 0) {
+        self->stats->RecordPlayed(unplayed_bytes, flutter_pcm_sound::PlaybackStats::NowNs());
+        // What the device holds has to play before the lookahead can, so
+        // start it once the target depth is reached, or once feeds have
+        // stopped short of it
+        int64_t period_ns = (int64_t)self->period_frames * 1000000000 / self->device_rate;
+        int64_t grace_ns = maybe_start_device(self, true);
+        wait_for_wakeup(self, &fds[pcm_fd_count], grace_ns > 0 ? std::min(grace_ns, period_ns) : period_ns);
+        continue;
+      }
+      chunk_frames = std::max(stretched_frames, std::min(voice_frames, (size_t)self->write_frames));
+      float* mix = self->convert_float->data();
+      std::fill(mix, mix + chunk_frames * self->channels, 0.0f);
+      self->mixer->MixSamples(stretched, gain, pan, mix, stretched_frames);
+      self->mixer->MixVoices(mix, chunk_frames);
+      device_frames = convert_float_for_device(self, chunk_frames, &device_chunk);
+    } else if (mixing) {
+      // Streams that run out early are padded with silence
+      float* mix = self->convert_float->data();
+      std::fill(mix, mix + chunk_frames * self->channels, 0.0f);
+      unplayed_bytes = self->mixer->MixQueue(*self->samples, gain, pan, mix, chunk_frames) * bytes_per_frame;
+      self->mixer->MixVoices(mix, chunk_frames);
+      device_frames = convert_float_for_device(self, chunk_frames, &device_chunk);
+    } else if (self->needs_conversion) {
+      device_frames = convert_for_device(self, chunk, chunk_frames, &device_chunk);
+      self->samples->Consume(chunk_frames * bytes_per_frame);
+      unplayed_bytes = chunk_frames * bytes_per_frame;
+    } else {
+      zero_copy = true;
     }
 
-    // Write to ALSA without holding the lock
-    if (!chunk.empty()) {
-      snd_pcm_sframes_t frames;
-      while ((frames = snd_pcm_writei(self->handle, chunk.data(), 
-             chunk.size() / (self->channels * 2))) == -EAGAIN) {
-        // If buffer is full, keep trying without sleeping
+    // Write to ALSA, sleeping whenever the device buffer is full. Frames
+    // are released back to the feeder as soon as ALSA has taken them. A
+    // flush abandons the rest of the chunk; a pause picks it up again on
+    // resume.
+    size_t written_frames = 0;
+    bool failed = false;
+    while (written_frames < device_frames && !self->should_stop && !flush_pending(self)) {
+      if (self->paused) {
+        wait_while_paused(self, &fds[pcm_fd_count]);
+        continue;
+      }
+      const uint8_t* data = device_chunk + written_frames * device_bytes_per_frame;
+      snd_pcm_uframes_t count = device_frames - written_frames;
+      PCM_TRACE_BEGIN("write");
+      snd_pcm_sframes_t frames = self->use_mmap ? mmap_write(self, data, count)
+                                                : snd_pcm_writei(self->handle, data, count);
+      PCM_TRACE_END("write");
+      if (frames == -EAGAIN || frames == 0) {
+        // A full buffer that was never started won't signal POLLOUT. One
+        // still short of the adaptive target waits on feeds instead.
+        if (self->start_held) {
+          wait_for_start(self, &fds[pcm_fd_count]);
+        } else {
+          int64_t grace_ns = maybe_start_device(self, true);
+          if (grace_ns > 0) {
+            wait_for_wakeup(self, &fds[pcm_fd_count], grace_ns);
+          } else {
+            wait_for_playback_event(self, fds.data(), pcm_fd_count, true);
+          }
+        }
         continue;
       }
 
       if (frames < 0) {
         if (frames == -EPIPE) {  // Underrun
+          self->stats->RecordUnderrun(flutter_pcm_sound::PlaybackStats::NowNs());
+          if (self->adaptive) {
+            self->jitter->RecordUnderrun();
+          }
+          PCM_TRACE_INSTANT("underrun");
+          PCM_TRACE_BEGIN("recover");
           frames = snd_pcm_recover(self->handle, frames, 0);
+          PCM_TRACE_END("recover");
           if (frames < 0) {
             g_print("Failed to recover from underrun: %s\n", snd_strerror(frames));
+            self->stats->RecordDeviceError();
+            failed = true;
             break;
           }
           snd_pcm_prepare(self->handle);
           continue;
         }
         g_print("ALSA write error: %s\n", snd_strerror(frames));
+        self->stats->RecordDeviceError();
+        failed = true;
         break;
       }
+      written_frames += frames;
+      self->device_frames_written += frames;
+      PCM_TRACE_COUNTER("written_frames", frames);
+      maybe_start_device(self, false);
+      if (zero_copy) {
+        self->samples->Consume(frames * bytes_per_frame);
+        unplayed_bytes = frames * bytes_per_frame;
+      }
+      int64_t now_ns = flutter_pcm_sound::PlaybackStats::NowNs();
+      self->stats->RecordRecovered(now_ns);
+      self->stats->RecordPlayed(unplayed_bytes, now_ns);
+      unplayed_bytes = 0;
+    }
+
+    if (failed) {
+      break;
     }
   }
 }
@@ -344,6 +2115,17 @@ void flutter_pcm_sound_plugin_register_with_registrar(FlPluginRegistrar* registr
                                          g_object_ref(plugin),
                                          g_object_unref);
  plugin->channel = FL_METHOD_CHANNEL(g_object_ref(channel));
+ // A newer engine takes over the FFI entry point
+ FlutterPcmSoundPlugin* previous;
+ {
+   std::lock_guard<std::mutex> lock(ffi_mutex);
+   previous = ffi_plugin;
+   ffi_plugin = FLUTTER_PCM_SOUND_PLUGIN(g_object_ref(plugin));
+ }
+ if (previous) {
+   g_object_unref(previous);
+ }
+ attach_feed_source(plugin);
 
  g_object_unref(plugin);
 }
\ No newline at end of file
@@ -6,5 +6,18 @@
 // https://github.com/flutter/flutter/issues/88724 for current limitations
 // in the unit-testable API.
 
-// Handles the getPlatformVersion method call.
-FlMethodResponse *get_platform_version();
+// Handles a method call as the method channel does, holding the same lock,
+// and returns the response instead of sending it. Works on a plugin made
+// with g_object_new, without a registrar or a running engine.
+FlMethodResponse* flutter_pcm_sound_plugin_handle_method(FlutterPcmSoundPlugin* self, const gchar* method,
+                                                         FlValue* args);
+
+// Receives the OnFeedSamples arguments on the default main context; the
+// message is only valid during the call.
+typedef void (*FlutterPcmSoundFeedObserver)(FlValue* message, gpointer user_data);
+
+// Sends feed requests to `observer` instead of the method channel, and
+// attaches the plugin's feed source to the default main context if
+// registration didn't.
+void flutter_pcm_sound_plugin_set_feed_observer(FlutterPcmSoundPlugin* self, FlutterPcmSoundFeedObserver observer,
+                                                gpointer user_data);
@@ -2,6 +2,7 @@
 #define FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_H_
 
 #include <flutter_linux/flutter_linux.h>
+#include <stdint.h>
 
 G_BEGIN_DECLS
 
@@ -21,6 +22,16 @@ FLUTTER_PLUGIN_EXPORT GType flutter_pcm_sound_plugin_get_type();
 FLUTTER_PLUGIN_EXPORT void flutter_pcm_sound_plugin_register_with_registrar(
     FlPluginRegistrar* registrar);
 
+// Queues `length` bytes of samples, in the format passed to setup,
+// without going through the method channel. Called from Dart via FFI.
+// Returns the number of bytes queued, or -1 if setup hasn't been called.
+FLUTTER_PLUGIN_EXPORT int64_t flutter_pcm_sound_ffi_feed(const uint8_t* data, int64_t length);
+
+// Same as flutter_pcm_sound_ffi_feed, for a stream returned by addStream
+// (0 is the primary stream). Returns -1 for an unknown stream.
+FLUTTER_PLUGIN_EXPORT int64_t flutter_pcm_sound_ffi_feed_stream(int64_t stream_id, const uint8_t* data,
+                                                                int64_t length);
+
 G_END_DECLS
 
 #endif  // FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_H_
@@ -0,0 +1,135 @@
+#include "pcm_thread_priority.h"
+
+#include <gio/gio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// rtkit refuses threads that could hog the CPU forever, so the process
+// must cap its real-time CPU time first. This matches rtkit's default.
+constexpr rlim_t kRtkitMaxRealtimeUsec = 200000;
+
+// The rtkit calls run on the playback thread, but setup waits for their
+// outcome on the platform thread, so they can't have D-Bus's default 25 s
+// timeout. A responsive rtkit answers in a few milliseconds.
+constexpr int kRtkitTimeoutMs = 500;
+
+// rtkit only hands out priorities up to its configured maximum (20 by
+// default); asking for more fails outright.
+int RtkitMaxPriority(GDBusConnection* bus, int fallback) {
+  GVariant* reply = g_dbus_connection_call_sync(
+      bus, "org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+      "org.freedesktop.DBus.Properties", "Get",
+      g_variant_new("(ss)", "org.freedesktop.RealtimeKit1", "MaxRealtimePriority"),
+      G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, kRtkitTimeoutMs, nullptr, nullptr);
+  if (!reply) {
+    return fallback;
+  }
+  GVariant* value = nullptr;
+  g_variant_get(reply, "(v)", &value);
+  int max = fallback;
+  if (value && g_variant_is_of_type(value, G_VARIANT_TYPE_INT32)) {
+    max = g_variant_get_int32(value);
+  }
+  if (value) g_variant_unref(value);
+  g_variant_unref(reply);
+  return max;
+}
+
+bool MakeRealtimeWithRtkit(int* priority, std::string* error) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_RTTIME, &limit) == 0 &&
+      (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > kRtkitMaxRealtimeUsec)) {
+    limit.rlim_cur = kRtkitMaxRealtimeUsec;
+    limit.rlim_max = kRtkitMaxRealtimeUsec;
+    setrlimit(RLIMIT_RTTIME, &limit);
+  }
+
+  GError* gerror = nullptr;
+  GDBusConnection* bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, &gerror);
+  if (!bus) {
+    *error = gerror ? gerror->message : "no system bus";
+    g_clear_error(&gerror);
+    return false;
+  }
+
+  *priority = std::min(*priority, RtkitMaxPriority(bus, *priority));
+
+  guint64 tid = static_cast<guint64>(syscall(SYS_gettid));
+  GVariant* reply = g_dbus_connection_call_sync(
+      bus, "org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+      "org.freedesktop.RealtimeKit1", "MakeThreadRealtime",
+      g_variant_new("(tu)", tid, static_cast<guint32>(*priority)), nullptr,
+      G_DBUS_CALL_FLAGS_NONE, kRtkitTimeoutMs, nullptr, &gerror);
+  g_object_unref(bus);
+
+  if (!reply) {
+    *error = gerror ? gerror->message : "rtkit call failed";
+    g_clear_error(&gerror);
+    return false;
+  }
+  g_variant_unref(reply);
+  return true;
+}
+
+}  // namespace
+
+ThreadSchedulingResult ApplyThreadScheduling(const ThreadSchedulingRequest& request) {
+  ThreadSchedulingResult result;
+
+  if (request.priority > 0) {
+    int min = sched_get_priority_min(request.policy);
+    int max = sched_get_priority_max(request.policy);
+    int priority = std::min(std::max(request.priority, min), max);
+
+    struct sched_param param = {};
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(pthread_self(), request.policy, &param);
+    if (err == 0) {
+      result.realtime_granted = true;
+      result.realtime_method = "pthread";
+      result.priority = priority;
+    } else if (err == EPERM) {
+      std::string rtkit_error;
+      if (MakeRealtimeWithRtkit(&priority, &rtkit_error)) {
+        result.realtime_granted = true;
+        result.realtime_method = "rtkit";
+        result.priority = priority;
+      } else {
+        result.error = "pthread_setschedparam: " + std::string(strerror(err)) + ", rtkit: " + rtkit_error;
+      }
+    } else {
+      result.error = "pthread_setschedparam: " + std::string(strerror(err));
+    }
+  }
+
+  if (!request.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : request.cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    result.affinity_granted = err == 0;
+    if (err != 0) {
+      if (!result.error.empty()) result.error += "; ";
+      result.error += "pthread_setaffinity_np: " + std::string(strerror(err));
+    }
+  }
+
+  return result;
+}
+
+}  // namespace flutter_pcm_sound
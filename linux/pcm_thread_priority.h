@@ -0,0 +1,36 @@
+#ifndef FLUTTER_PLUGIN_PCM_THREAD_PRIORITY_H_
+#define FLUTTER_PLUGIN_PCM_THREAD_PRIORITY_H_
+
+#include <string>
+#include <vector>
+
+namespace flutter_pcm_sound {
+
+// What the playback thread should ask the scheduler for when it starts.
+struct ThreadSchedulingRequest {
+  // SCHED_FIFO or SCHED_RR. Ignored when priority is 0.
+  int policy = 0;
+  // 1-99. 0 leaves the thread on the default time-sharing scheduler.
+  int priority = 0;
+  // CPUs the thread may run on. Empty leaves the affinity untouched.
+  std::vector<int> cpus;
+};
+
+// What the scheduler actually granted.
+struct ThreadSchedulingResult {
+  bool realtime_granted = false;
+  // "pthread", "rtkit" or "none"
+  const char* realtime_method = "none";
+  int priority = 0;
+  bool affinity_granted = false;
+  std::string error;
+};
+
+// Applies `request` to the calling thread. Real-time priority is tried
+// with pthread_setschedparam first; when that is not permitted (no
+// CAP_SYS_NICE / RLIMIT_RTPRIO) the thread asks rtkit over D-Bus instead.
+ThreadSchedulingResult ApplyThreadScheduling(const ThreadSchedulingRequest& request);
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_THREAD_PRIORITY_H_
@@ -16,15 +16,112 @@
 namespace flutter_pcm_sound {
 namespace test {
 
-TEST(FlutterPcmSoundPlugin, GetPlatformVersion) {
-  g_autoptr(FlMethodResponse) response = get_platform_version();
-  ASSERT_NE(response, nullptr);
+// The methods that don't need an audio device, on a plugin that was never
+// registered with an engine.
+
+TEST(FlutterPcmSoundPlugin, FeedBeforeSetupIsNotInitialized) {
+  g_autoptr(GObject) plugin = G_OBJECT(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+  g_autoptr(FlValue) args = fl_value_new_map();
+  const uint8_t samples[4] = {0};
+  fl_value_set_string_take(args, "buffer", fl_value_new_uint8_list(samples, sizeof(samples)));
+
+  g_autoptr(FlMethodResponse) response =
+      flutter_pcm_sound_plugin_handle_method(reinterpret_cast<FlutterPcmSoundPlugin*>(plugin), "feed", args);
+  ASSERT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(response));
+  EXPECT_STREQ(fl_method_error_response_get_code(FL_METHOD_ERROR_RESPONSE(response)), "NOT_INITIALIZED");
+}
+
+TEST(FlutterPcmSoundPlugin, UnknownMethodIsNotImplemented) {
+  g_autoptr(GObject) plugin = G_OBJECT(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+  g_autoptr(FlMethodResponse) response =
+      flutter_pcm_sound_plugin_handle_method(reinterpret_cast<FlutterPcmSoundPlugin*>(plugin), "getPlatformVersion",
+                                             nullptr);
+  EXPECT_TRUE(FL_IS_METHOD_NOT_IMPLEMENTED_RESPONSE(response));
+}
+
+TEST(FlutterPcmSoundPlugin, SetFeedThresholdSucceeds) {
+  g_autoptr(GObject) plugin = G_OBJECT(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "feed_threshold", fl_value_new_int(2048));
+
+  g_autoptr(FlMethodResponse) response = flutter_pcm_sound_plugin_handle_method(
+      reinterpret_cast<FlutterPcmSoundPlugin*>(plugin), "setFeedThreshold", args);
   ASSERT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(response));
-  FlValue* result = fl_method_success_response_get_result(
-      FL_METHOD_SUCCESS_RESPONSE(response));
-  ASSERT_EQ(fl_value_get_type(result), FL_VALUE_TYPE_STRING);
-  // The full string varies, so just validate that it has the right format.
-  EXPECT_THAT(fl_value_get_string(result), testing::StartsWith("Linux "));
+  FlValue* result = fl_method_success_response_get_result(FL_METHOD_SUCCESS_RESPONSE(response));
+  ASSERT_EQ(fl_value_get_type(result), FL_VALUE_TYPE_BOOL);
+  EXPECT_TRUE(fl_value_get_bool(result));
+}
+
+TEST(FlutterPcmSoundPlugin, OutputsTakeTheirOwnCalls) {
+  g_autoptr(GObject) plugin = G_OBJECT(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+  FlutterPcmSoundPlugin* self = reinterpret_cast<FlutterPcmSoundPlugin*>(plugin);
+
+  g_autoptr(FlMethodResponse) opened = flutter_pcm_sound_plugin_handle_method(self, "openOutput", nullptr);
+  ASSERT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(opened));
+  FlValue* id = fl_value_lookup_string(fl_method_success_response_get_result(FL_METHOD_SUCCESS_RESPONSE(opened)),
+                                       "output_id");
+  ASSERT_NE(id, nullptr);
+  ASSERT_EQ(fl_value_get_type(id), FL_VALUE_TYPE_INT);
+  EXPECT_GT(fl_value_get_int(id), 0);
+
+  // The output hasn't been set up, whatever the registered instance has
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "output_id", fl_value_new_int(fl_value_get_int(id)));
+  const uint8_t samples[4] = {0};
+  fl_value_set_string_take(args, "buffer", fl_value_new_uint8_list(samples, sizeof(samples)));
+  g_autoptr(FlMethodResponse) fed = flutter_pcm_sound_plugin_handle_method(self, "feed", args);
+  ASSERT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(fed));
+  EXPECT_STREQ(fl_method_error_response_get_code(FL_METHOD_ERROR_RESPONSE(fed)), "NOT_INITIALIZED");
+
+  g_autoptr(FlMethodResponse) closed = flutter_pcm_sound_plugin_handle_method(self, "closeOutput", args);
+  EXPECT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(closed));
+  g_autoptr(FlMethodResponse) gone = flutter_pcm_sound_plugin_handle_method(self, "feed", args);
+  ASSERT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(gone));
+  EXPECT_STREQ(fl_method_error_response_get_code(FL_METHOD_ERROR_RESPONSE(gone)), "INVALID_ARGS");
+}
+
+namespace {
+
+// Setup plays into ALSA's null device here, and skips where there is none.
+FlMethodResponse* SetupNull(FlutterPcmSoundPlugin* self, int sample_rate) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "sample_rate", fl_value_new_int(sample_rate));
+  fl_value_set_string_take(args, "num_channels", fl_value_new_int(1));
+  fl_value_set_string_take(args, "device_id", fl_value_new_string("null"));
+  return flutter_pcm_sound_plugin_handle_method(self, "setup", args);
+}
+
+}  // namespace
+
+TEST(FlutterPcmSoundPlugin, ClipsSurviveASetupWithTheSameFormat) {
+  g_autoptr(GObject) plugin = G_OBJECT(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+  FlutterPcmSoundPlugin* self = reinterpret_cast<FlutterPcmSoundPlugin*>(plugin);
+
+  g_autoptr(FlMethodResponse) set_up = SetupNull(self, 48000);
+  if (!FL_IS_METHOD_SUCCESS_RESPONSE(set_up)) {
+    GTEST_SKIP() << "no ALSA null device";
+  }
+  g_autoptr(FlValue) clip = fl_value_new_map();
+  fl_value_set_string_take(clip, "clip_id", fl_value_new_string("click"));
+  const uint8_t samples[64] = {0};
+  fl_value_set_string_take(clip, "buffer", fl_value_new_uint8_list(samples, sizeof(samples)));
+  g_autoptr(FlMethodResponse) loaded = flutter_pcm_sound_plugin_handle_method(self, "loadClip", clip);
+  ASSERT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(loaded));
+
+  g_autoptr(FlMethodResponse) set_up_again = SetupNull(self, 48000);
+  ASSERT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(set_up_again));
+  g_autoptr(FlMethodResponse) played = flutter_pcm_sound_plugin_handle_method(self, "playClip", clip);
+  EXPECT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(played));
+
+  // Another rate drops it
+  g_autoptr(FlMethodResponse) set_up_other = SetupNull(self, 44100);
+  ASSERT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(set_up_other));
+  g_autoptr(FlMethodResponse) gone = flutter_pcm_sound_plugin_handle_method(self, "playClip", clip);
+  ASSERT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(gone));
+  EXPECT_STREQ(fl_method_error_response_get_code(FL_METHOD_ERROR_RESPONSE(gone)), "INVALID_ARGS");
+
+  g_autoptr(FlMethodResponse) released = flutter_pcm_sound_plugin_handle_method(self, "release", nullptr);
+  EXPECT_TRUE(FL_IS_METHOD_SUCCESS_RESPONSE(released));
 }
 
 }  // namespace test
@@ -0,0 +1,67 @@
+#include "loopback_pattern.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+void FillPattern(uint32_t first_frame, int16_t* out, size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    uint32_t number = first_frame + static_cast<uint32_t>(i);
+    out[i * 2] = static_cast<int16_t>(number & 0xFFFF);
+    out[i * 2 + 1] = static_cast<int16_t>(number >> 16);
+  }
+}
+
+void PatternChecker::Process(const int16_t* data, size_t frames, int64_t last_ns, int rate) {
+  for (size_t i = 0; i < frames; i++) {
+    const int16_t left = data[i * 2];
+    const int16_t right = data[i * 2 + 1];
+    const int64_t at = last_ns - static_cast<int64_t>(frames - 1 - i) * 1000000000 / rate;
+    if (left == 0 && right == 0) {
+      if (report_.found) {
+        pending_silent_++;
+      }
+      continue;
+    }
+    const uint32_t number = static_cast<uint16_t>(left) | static_cast<uint32_t>(static_cast<uint16_t>(right)) << 16;
+    if (number < kFirstPatternFrame) {
+      // Other channel contents, or a partial frame that got through
+      report_.noise++;
+      continue;
+    }
+
+    if (!report_.found) {
+      report_.found = true;
+      report_.first_ns = at;
+      first_number_ = number;
+    } else {
+      if (pending_silent_ > 0) {
+        report_.silent += pending_silent_;
+        report_.gaps++;
+        pending_silent_ = 0;
+      }
+      if (number <= report_.last_frame) {
+        report_.duplicated++;
+        continue;
+      }
+      report_.dropped += number - report_.last_frame - 1;
+    }
+    report_.frames++;
+    report_.last_frame = number;
+
+    size_t index = number - first_number_;
+    if (index < kMaxTimes) {
+      times_.resize(index, -1);
+      times_.push_back(at);
+    }
+  }
+}
+
+int64_t PatternChecker::CaptureTime(uint32_t number) const {
+  if (!report_.found || number < first_number_ || number - first_number_ >= times_.size()) {
+    return -1;
+  }
+  return times_[number - first_number_];
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,64 @@
+#ifndef FLUTTER_PLUGIN_LOOPBACK_PATTERN_H_
+#define FLUTTER_PLUGIN_LOOPBACK_PATTERN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flutter_pcm_sound {
+namespace test {
+
+// A stereo s16 signal that numbers its own frames, for playing through a
+// bit-exact loopback and checking what comes back frame by frame. Frame n
+// holds the low 16 bits of n on the left and the high 16 bits on the
+// right. Numbering starts at kFirstPatternFrame, so the right channel is
+// never zero and no pattern frame looks like silence.
+constexpr int kPatternChannels = 2;
+constexpr uint32_t kFirstPatternFrame = 1u << 16;
+
+void FillPattern(uint32_t first_frame, int16_t* out, size_t frames);
+
+// What a capture of the pattern looked like, from the first pattern
+// frame on.
+struct PatternReport {
+  bool found = false;
+  uint64_t frames = 0;      // pattern frames captured
+  uint64_t dropped = 0;     // frames skipped over
+  uint64_t duplicated = 0;  // frames that came again, or out of order
+  uint64_t silent = 0;      // silent frames inside the pattern
+  uint64_t gaps = 0;        // runs of them, i.e. audible dropouts
+  uint64_t noise = 0;       // frames that are neither
+  uint32_t last_frame = 0;  // number of the last pattern frame captured
+  int64_t first_ns = 0;     // when the first pattern frame was captured
+};
+
+// Checks captured frames against the pattern as they arrive. Silence
+// before the first pattern frame and after the last is not counted.
+class PatternChecker {
+ public:
+  // `frames` interleaved stereo frames; `last_ns` is when the last of them
+  // was captured, on CLOCK_MONOTONIC, and `rate` spaces the others.
+  void Process(const int16_t* data, size_t frames, int64_t last_ns, int rate);
+
+  // When frame `number` was captured, or -1 if it wasn't (yet)
+  int64_t CaptureTime(uint32_t number) const;
+
+  const PatternReport& report() const { return report_; }
+
+ private:
+  static constexpr size_t kMaxTimes = 1 << 20;
+
+  PatternReport report_;
+  // Silent frames since the last pattern frame, counted once the pattern
+  // resumes
+  uint64_t pending_silent_ = 0;
+  // Capture time of each in-order frame from first_number_, as long as
+  // they fit
+  uint32_t first_number_ = 0;
+  std::vector<int64_t> times_;
+};
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_LOOPBACK_PATTERN_H_
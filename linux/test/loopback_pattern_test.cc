@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "loopback_pattern.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+constexpr int kRate = 48000;
+
+std::vector<int16_t> Pattern(uint32_t first, size_t frames) {
+  std::vector<int16_t> out(frames * kPatternChannels);
+  FillPattern(first, out.data(), frames);
+  return out;
+}
+
+void Append(std::vector<int16_t>* capture, const std::vector<int16_t>& frames) {
+  capture->insert(capture->end(), frames.begin(), frames.end());
+}
+
+}  // namespace
+
+TEST(PatternChecker, CleanCaptureAfterLeadingSilence) {
+  std::vector<int16_t> capture(100 * kPatternChannels, 0);
+  Append(&capture, Pattern(kFirstPatternFrame, 1000));
+  capture.resize(capture.size() + 50 * kPatternChannels, 0);
+
+  PatternChecker checker;
+  checker.Process(capture.data(), capture.size() / kPatternChannels, 1000000000, kRate);
+  const PatternReport& report = checker.report();
+  ASSERT_TRUE(report.found);
+  EXPECT_EQ(report.frames, 1000u);
+  EXPECT_EQ(report.dropped, 0u);
+  EXPECT_EQ(report.duplicated, 0u);
+  EXPECT_EQ(report.gaps, 0u);
+  EXPECT_EQ(report.last_frame, kFirstPatternFrame + 999);
+  // 1049 frames after the first pattern frame, the last one at 1s
+  EXPECT_EQ(report.first_ns, 1000000000 - int64_t{1049} * 1000000000 / kRate);
+  EXPECT_EQ(checker.CaptureTime(kFirstPatternFrame), report.first_ns);
+}
+
+TEST(PatternChecker, CountsDropsDuplicatesAndDropouts) {
+  std::vector<int16_t> capture;
+  Append(&capture, Pattern(kFirstPatternFrame, 100));
+  // 20 frames lost
+  Append(&capture, Pattern(kFirstPatternFrame + 120, 100));
+  // the last 10 again
+  Append(&capture, Pattern(kFirstPatternFrame + 210, 10));
+  // a 30 frame dropout, then the pattern carries on where it was
+  capture.resize(capture.size() + 30 * kPatternChannels, 0);
+  Append(&capture, Pattern(kFirstPatternFrame + 220, 100));
+
+  PatternChecker checker;
+  checker.Process(capture.data(), capture.size() / kPatternChannels, 0, kRate);
+  const PatternReport& report = checker.report();
+  EXPECT_EQ(report.frames, 300u);
+  EXPECT_EQ(report.dropped, 20u);
+  EXPECT_EQ(report.duplicated, 10u);
+  EXPECT_EQ(report.silent, 30u);
+  EXPECT_EQ(report.gaps, 1u);
+  EXPECT_EQ(checker.CaptureTime(kFirstPatternFrame + 110), -1);
+  EXPECT_NE(checker.CaptureTime(kFirstPatternFrame + 120), -1);
+}
+
+TEST(PatternChecker, IgnoresNoiseBeforeThePattern) {
+  std::vector<int16_t> capture = {5, 0, -3, 0};
+  Append(&capture, Pattern(kFirstPatternFrame, 10));
+
+  PatternChecker checker;
+  checker.Process(capture.data(), capture.size() / kPatternChannels, 0, kRate);
+  EXPECT_EQ(checker.report().noise, 2u);
+  EXPECT_EQ(checker.report().frames, 10u);
+  EXPECT_EQ(checker.report().dropped, 0u);
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
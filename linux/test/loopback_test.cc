@@ -0,0 +1,394 @@
+#include <alsa/asoundlib.h>
+#include <flutter_linux/flutter_linux.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "flutter_pcm_sound_plugin_private.h"
+#include "loopback_pattern.h"
+
+// End-to-end glitch and latency checks through an ALSA loopback card
+// (snd-aloop). The plugin plays a pattern that numbers its own frames into
+// device 0 of the card, fed the way an app feeds it, from OnFeedSamples,
+// while a capture thread reads device 1 back and checks every frame. The
+// hw devices are bit-exact, so any dropped, repeated or silent frame is
+// the plugin's doing.
+//
+// Lab only: every test skips unless FLUTTER_PCM_SOUND_LOOPBACK is set.
+// $ sudo modprobe snd-aloop
+// $ FLUTTER_PCM_SOUND_LOOPBACK=1 build/linux/x64/release/plugins/flutter_pcm_sound/flutter_pcm_sound_loopback_test
+//
+// Also read from the environment:
+//   FLUTTER_PCM_SOUND_LOOPBACK_CARD     loopback card id, "Loopback" by default
+//   FLUTTER_PCM_SOUND_LOOPBACK_SECONDS  audio played per test, 5 by default
+//   FLUTTER_PCM_SOUND_LOOPBACK_MAX_START_MS, FLUTTER_PCM_SOUND_LOOPBACK_MAX_JITTER_MS
+//                                       fail above these; unset, the
+//                                       latencies are only reported
+// Every result is also recorded as a test property, for --gtest_output=xml.
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+constexpr int kRate = 48000;
+constexpr snd_pcm_uframes_t kCapturePeriod = 128;
+constexpr size_t kMinFeedFrames = 256;
+
+int64_t NowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+const char* Env(const char* name, const char* fallback) {
+  const char* value = getenv(name);
+  return value && *value ? value : fallback;
+}
+
+// Reads the loopback's capture side on its own thread
+class Capture {
+ public:
+  ~Capture() { Stop(); }
+
+  // Fixes the loopback's format before the plugin opens the other side
+  bool Open(std::string* error) {
+    int err = snd_pcm_open(&handle_, "loopback_capture", SND_PCM_STREAM_CAPTURE, 0);
+    if (err < 0) {
+      *error = std::string("can't open the loopback capture device: ") + snd_strerror(err);
+      return false;
+    }
+    snd_pcm_uframes_t buffer = kCapturePeriod * 32;
+    snd_pcm_uframes_t period = kCapturePeriod;
+    snd_pcm_hw_params_t* params;
+    snd_pcm_hw_params_alloca(&params);
+    snd_pcm_hw_params_any(handle_, params);
+    if ((err = snd_pcm_hw_params_set_access(handle_, params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(handle_, params, SND_PCM_FORMAT_S16_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(handle_, params, kPatternChannels)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate(handle_, params, kRate, 0)) < 0 ||
+        (err = snd_pcm_hw_params_set_buffer_size_near(handle_, params, &buffer)) < 0 ||
+        (err = snd_pcm_hw_params_set_period_size_near(handle_, params, &period, nullptr)) < 0 ||
+        (err = snd_pcm_hw_params(handle_, params)) < 0) {
+      *error = std::string("can't configure the loopback capture device: ") + snd_strerror(err);
+      return false;
+    }
+    period_ = period;
+    return true;
+  }
+
+  void Start() {
+    snd_pcm_start(handle_);
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  void Stop() {
+    if (thread_.joinable()) {
+      stop_ = true;
+      thread_.join();
+    }
+    if (handle_) {
+      snd_pcm_close(handle_);
+      handle_ = nullptr;
+    }
+  }
+
+  // Safe while running
+  uint32_t last_frame() const { return last_frame_; }
+
+  // Only once stopped
+  const PatternChecker& checker() const { return checker_; }
+  int overruns() const { return overruns_; }
+
+ private:
+  void Run() {
+    std::vector<int16_t> buffer(period_ * kPatternChannels);
+    while (!stop_) {
+      snd_pcm_sframes_t frames = snd_pcm_readi(handle_, buffer.data(), period_);
+      if (frames == -EPIPE) {
+        overruns_++;
+        snd_pcm_prepare(handle_);
+        snd_pcm_start(handle_);
+        continue;
+      }
+      if (frames < 0) {
+        snd_pcm_recover(handle_, frames, 1);
+        continue;
+      }
+      // Frames captured but not read yet date the last one read
+      snd_pcm_sframes_t delay = 0;
+      snd_pcm_delay(handle_, &delay);
+      int64_t last_ns = NowNs() - (int64_t)std::max(delay, (snd_pcm_sframes_t)0) * 1000000000 / kRate;
+      checker_.Process(buffer.data(), frames, last_ns, kRate);
+      last_frame_ = checker_.report().last_frame;
+    }
+  }
+
+  snd_pcm_t* handle_ = nullptr;
+  snd_pcm_uframes_t period_ = kCapturePeriod;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint32_t> last_frame_{0};
+  PatternChecker checker_;
+  int overruns_ = 0;
+};
+
+// Busy threads at normal priority, competing with the playback thread
+class CpuLoad {
+ public:
+  explicit CpuLoad(int threads) {
+    for (int i = 0; i < threads; i++) {
+      threads_.emplace_back([this] {
+        volatile double x = 1.0;
+        while (!stop_.load(std::memory_order_relaxed)) {
+          x = std::sqrt(x + 1.0);
+        }
+      });
+    }
+  }
+
+  ~CpuLoad() {
+    stop_ = true;
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+  std::atomic<bool> stop_{false};
+};
+
+// Feeds the pattern whenever the plugin asks, the way an app does
+struct Feeder {
+  struct Feed {
+    uint32_t first_frame;
+    int64_t at_ns;
+  };
+
+  FlutterPcmSoundPlugin* plugin = nullptr;
+  uint32_t next_frame = kFirstPatternFrame;
+  size_t frames_left = 0;
+  std::vector<Feed> feeds;
+
+  void FeedFrames(size_t frames) {
+    frames = std::min(std::max(frames, kMinFeedFrames), frames_left);
+    if (frames == 0) {
+      return;
+    }
+    std::vector<int16_t> samples(frames * kPatternChannels);
+    FillPattern(next_frame, samples.data(), frames);
+    g_autoptr(FlValue) args = fl_value_new_map();
+    fl_value_set_string_take(args, "buffer", fl_value_new_uint8_list(reinterpret_cast<const uint8_t*>(samples.data()),
+                                                                     samples.size() * sizeof(int16_t)));
+    feeds.push_back({next_frame, NowNs()});
+    g_object_unref(flutter_pcm_sound_plugin_handle_method(plugin, "feed", args));
+    next_frame += frames;
+    frames_left -= frames;
+  }
+
+  static void OnFeedSamples(FlValue* message, gpointer user_data) {
+    FlValue* requested = fl_value_lookup_string(message, "requested_frames");
+    static_cast<Feeder*>(user_data)->FeedFrames(requested ? fl_value_get_int(requested) : 0);
+  }
+};
+
+gboolean KeepAwake(gpointer user_data) {
+  return G_SOURCE_CONTINUE;
+}
+
+struct LoopbackResult {
+  PatternReport pattern;
+  uint64_t fed_frames = 0;
+  int64_t underruns = 0;
+  int capture_overruns = 0;
+  double start_latency_ms = -1;
+  // From each feed to its first frame coming back
+  double latency_mean_ms = 0;
+  double latency_min_ms = 0;
+  double latency_max_ms = 0;
+};
+
+}  // namespace
+
+class LoopbackTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    if (!getenv("FLUTTER_PCM_SOUND_LOOPBACK")) {
+      return;
+    }
+    // The plugin plays to "default"; point it, and the capture side, at
+    // the loopback card before ALSA first reads its configuration
+    std::string card = Env("FLUTTER_PCM_SOUND_LOOPBACK_CARD", "Loopback");
+    std::string config = "pcm.!default { type hw card " + card + " device 0 }\n" +
+                         "pcm.loopback_capture { type hw card " + card + " device 1 }\n";
+    gchar* path = nullptr;
+    gint fd = g_file_open_tmp("flutter_pcm_sound_loopback_XXXXXX.conf", &path, nullptr);
+    if (fd >= 0) {
+      close(fd);
+      g_file_set_contents(path, config.c_str(), -1, nullptr);
+      setenv("ALSA_CONFIG_PATH", path, 1);
+      config_path_ = path;
+      g_free(path);
+    }
+  }
+
+  static void TearDownTestSuite() {
+    if (!config_path_.empty()) {
+      remove(config_path_.c_str());
+    }
+  }
+
+  void SetUp() override {
+    if (!getenv("FLUTTER_PCM_SOUND_LOOPBACK")) {
+      GTEST_SKIP() << "set FLUTTER_PCM_SOUND_LOOPBACK to run against snd-aloop";
+    }
+  }
+
+  // Plays FLUTTER_PCM_SOUND_LOOPBACK_SECONDS of the pattern with
+  // `load_threads` busy threads running
+  LoopbackResult Run(const char* latency_profile, int load_threads) {
+    LoopbackResult result;
+    Capture capture;
+    std::string error;
+    if (!capture.Open(&error)) {
+      ADD_FAILURE() << error;
+      return result;
+    }
+
+    g_autoptr(GObject) object = G_OBJECT(g_object_new(flutter_pcm_sound_plugin_get_type(), nullptr));
+    FlutterPcmSoundPlugin* plugin = reinterpret_cast<FlutterPcmSoundPlugin*>(object);
+    g_autoptr(FlValue) setup = fl_value_new_map();
+    fl_value_set_string_take(setup, "sample_rate", fl_value_new_int(kRate));
+    fl_value_set_string_take(setup, "num_channels", fl_value_new_int(kPatternChannels));
+    fl_value_set_string_take(setup, "sample_format", fl_value_new_string("s16le"));
+    fl_value_set_string_take(setup, "latency_profile", fl_value_new_string(latency_profile));
+    g_autoptr(FlMethodResponse) setup_response = flutter_pcm_sound_plugin_handle_method(plugin, "setup", setup);
+    if (!FL_IS_METHOD_SUCCESS_RESPONSE(setup_response)) {
+      ADD_FAILURE() << "setup failed on the loopback card";
+      return result;
+    }
+
+    Feeder feeder;
+    feeder.plugin = plugin;
+    feeder.frames_left = (size_t)(atof(Env("FLUTTER_PCM_SOUND_LOOPBACK_SECONDS", "5")) * kRate);
+    result.fed_frames = feeder.frames_left;
+    flutter_pcm_sound_plugin_set_feed_observer(plugin, Feeder::OnFeedSamples, &feeder);
+
+    {
+      CpuLoad load(load_threads);
+      capture.Start();
+      // Wakes the loop regularly, so the deadline is noticed even if the
+      // plugin stops asking
+      guint wake = g_timeout_add(50, KeepAwake, nullptr);
+      const int64_t deadline = NowNs() + (int64_t)(feeder.frames_left / kRate + 10) * 1000000000;
+      // The first feed, as FlutterPcmSound.start gives it
+      feeder.FeedFrames(kMinFeedFrames);
+      const uint32_t last_frame = kFirstPatternFrame + (uint32_t)result.fed_frames - 1;
+      while (capture.last_frame() != last_frame && NowNs() < deadline) {
+        g_main_context_iteration(nullptr, TRUE);
+      }
+      g_source_remove(wake);
+      capture.Stop();
+    }
+
+    g_autoptr(FlMethodResponse) stats = flutter_pcm_sound_plugin_handle_method(plugin, "getStats", nullptr);
+    if (FL_IS_METHOD_SUCCESS_RESPONSE(stats)) {
+      FlValue* map = fl_method_success_response_get_result(FL_METHOD_SUCCESS_RESPONSE(stats));
+      result.underruns = fl_value_get_int(fl_value_lookup_string(map, "underruns"));
+    }
+    g_object_unref(flutter_pcm_sound_plugin_handle_method(plugin, "release", nullptr));
+
+    result.pattern = capture.checker().report();
+    result.capture_overruns = capture.overruns();
+    if (result.pattern.found && !feeder.feeds.empty()) {
+      result.start_latency_ms = (result.pattern.first_ns - feeder.feeds.front().at_ns) / 1e6;
+    }
+    std::vector<double> latencies;
+    for (const Feeder::Feed& feed : feeder.feeds) {
+      int64_t captured = capture.checker().CaptureTime(feed.first_frame);
+      if (captured >= 0) {
+        latencies.push_back((captured - feed.at_ns) / 1e6);
+      }
+    }
+    if (!latencies.empty()) {
+      auto [min, max] = std::minmax_element(latencies.begin(), latencies.end());
+      result.latency_min_ms = *min;
+      result.latency_max_ms = *max;
+      double sum = 0;
+      for (double latency : latencies) {
+        sum += latency;
+      }
+      result.latency_mean_ms = sum / latencies.size();
+    }
+    Report(result);
+    return result;
+  }
+
+  void Report(const LoopbackResult& result) {
+    const PatternReport& p = result.pattern;
+    printf("captured %llu of %llu frames: %llu dropped, %llu duplicated, %llu silent in %llu gaps, "
+           "%lld underruns, %d capture overruns\n",
+           (unsigned long long)p.frames, (unsigned long long)result.fed_frames, (unsigned long long)p.dropped,
+           (unsigned long long)p.duplicated, (unsigned long long)p.silent, (unsigned long long)p.gaps,
+           (long long)result.underruns, result.capture_overruns);
+    printf("start latency %.2f ms; feed to capture %.2f ms mean, %.2f to %.2f ms (jitter %.2f ms)\n",
+           result.start_latency_ms, result.latency_mean_ms, result.latency_min_ms, result.latency_max_ms,
+           result.latency_max_ms - result.latency_min_ms);
+    RecordProperty("captured_frames", std::to_string(p.frames));
+    RecordProperty("dropped_frames", std::to_string(p.dropped));
+    RecordProperty("duplicated_frames", std::to_string(p.duplicated));
+    RecordProperty("silent_frames", std::to_string(p.silent));
+    RecordProperty("gaps", std::to_string(p.gaps));
+    RecordProperty("underruns", std::to_string(result.underruns));
+    RecordProperty("start_latency_us", std::to_string((int64_t)(result.start_latency_ms * 1000)));
+    RecordProperty("latency_mean_us", std::to_string((int64_t)(result.latency_mean_ms * 1000)));
+    RecordProperty("latency_jitter_us",
+                   std::to_string((int64_t)((result.latency_max_ms - result.latency_min_ms) * 1000)));
+  }
+
+  // Everything played, bit-exact and in order, within the latency budgets
+  void ExpectClean(const LoopbackResult& result) {
+    ASSERT_EQ(result.capture_overruns, 0) << "the capture side overran, so the results are unreliable";
+    ASSERT_TRUE(result.pattern.found) << "the pattern never came back; the loopback must be bit-exact";
+    EXPECT_EQ(result.pattern.frames, result.fed_frames);
+    EXPECT_EQ(result.pattern.dropped, 0u);
+    EXPECT_EQ(result.pattern.duplicated, 0u);
+    EXPECT_EQ(result.pattern.gaps, 0u);
+    EXPECT_EQ(result.underruns, 0);
+    if (const char* budget = getenv("FLUTTER_PCM_SOUND_LOOPBACK_MAX_START_MS")) {
+      EXPECT_LE(result.start_latency_ms, atof(budget));
+    }
+    if (const char* budget = getenv("FLUTTER_PCM_SOUND_LOOPBACK_MAX_JITTER_MS")) {
+      EXPECT_LE(result.latency_max_ms - result.latency_min_ms, atof(budget));
+    }
+  }
+
+  static std::string config_path_;
+};
+
+std::string LoopbackTest::config_path_;
+
+TEST_F(LoopbackTest, StandardProfile) {
+  ExpectClean(Run("standard", 0));
+}
+
+TEST_F(LoopbackTest, LowLatencyProfile) {
+  ExpectClean(Run("lowLatency", 0));
+}
+
+TEST_F(LoopbackTest, LowLatencyProfileUnderCpuLoad) {
+  ExpectClean(Run("lowLatency", std::max(1u, std::thread::hardware_concurrency())));
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pcm_clip_bank.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+std::vector<int16_t> Ramp(size_t samples) {
+  std::vector<int16_t> ramp(samples);
+  for (size_t i = 0; i < samples; i++) {
+    ramp[i] = static_cast<int16_t>(i * 64);
+  }
+  return ramp;
+}
+
+bool LoadS16(ClipBank& bank, const std::string& id, const std::vector<int16_t>& samples, int rate, int channels) {
+  std::string error;
+  return bank.Load(id, reinterpret_cast<const uint8_t*>(samples.data()), samples.size() * sizeof(int16_t),
+                   SampleFormat::kS16, rate, channels, ResampleQuality::kLow, &error);
+}
+
+}  // namespace
+
+TEST(ClipBank, StoresFloatInStreamLayout) {
+  ClipBank bank;
+  bank.Configure(48000, 2);
+  ASSERT_TRUE(LoadS16(bank, "ding", {16384, -16384, 8192}, 48000, 1));
+
+  Clip* clip = bank.Find("ding");
+  ASSERT_NE(clip, nullptr);
+  EXPECT_EQ(clip->frames, 3u);
+  EXPECT_EQ(clip->samples, std::vector<float>({0.5f, 0.5f, -0.5f, -0.5f, 0.25f, 0.25f}));
+  EXPECT_EQ(bank.bytes(), 6 * sizeof(float));
+  EXPECT_EQ(bank.Find("dong"), nullptr);
+}
+
+TEST(ClipBank, ResamplesToStreamRate) {
+  ClipBank bank;
+  bank.Configure(48000, 1);
+  ASSERT_TRUE(LoadS16(bank, "ding", Ramp(1600), 16000, 1));
+  Clip* clip = bank.Find("ding");
+  ASSERT_NE(clip, nullptr);
+  // Three times as many frames, give or take the filter's edge
+  EXPECT_NEAR(static_cast<double>(clip->frames), 4800.0, 3.0);
+}
+
+TEST(ClipBank, EvictsLeastRecentlyPlayed) {
+  ClipBank bank;
+  bank.Configure(48000, 1);
+  const std::vector<int16_t> samples = Ramp(100);  // 400 bytes as float
+  bank.SetLimit(1000);
+  ASSERT_TRUE(LoadS16(bank, "a", samples, 48000, 1));
+  ASSERT_TRUE(LoadS16(bank, "b", samples, 48000, 1));
+  ASSERT_NE(bank.Find("a"), nullptr);
+  ASSERT_TRUE(LoadS16(bank, "c", samples, 48000, 1));
+
+  EXPECT_NE(bank.Find("a"), nullptr);
+  EXPECT_EQ(bank.Find("b"), nullptr);
+  EXPECT_NE(bank.Find("c"), nullptr);
+  EXPECT_EQ(bank.bytes(), 800u);
+
+  std::string error;
+  const std::vector<int16_t> big = Ramp(300);
+  EXPECT_FALSE(bank.Load("big", reinterpret_cast<const uint8_t*>(big.data()), big.size() * sizeof(int16_t),
+                         SampleFormat::kS16, 48000, 1, ResampleQuality::kLow, &error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST(ClipBank, KeepsPlayingClipsUntilTheyFinish) {
+  ClipBank bank;
+  bank.Configure(48000, 1);
+  const std::vector<int16_t> samples = Ramp(100);
+  bank.SetLimit(400);
+  ASSERT_TRUE(LoadS16(bank, "a", samples, 48000, 1));
+  Clip* playing = bank.Find("a");
+  playing->voices = 1;
+
+  // Over the limit while "a" plays, rather than freeing it under the mixer
+  ASSERT_TRUE(LoadS16(bank, "b", samples, 48000, 1));
+  EXPECT_EQ(bank.bytes(), 800u);
+  // Playing "a" again makes "b" the one to go
+  EXPECT_EQ(bank.Find("a"), playing);
+  EXPECT_EQ(bank.Find("b"), nullptr);
+
+  // Replacing it retires the old samples until their voice is done
+  ASSERT_TRUE(LoadS16(bank, "a", samples, 48000, 1));
+  EXPECT_NE(bank.Find("a"), playing);
+  EXPECT_EQ(bank.bytes(), 800u);
+  playing->voices = 0;
+  EXPECT_TRUE(bank.Unload("a"));
+  EXPECT_EQ(bank.bytes(), 0u);
+  EXPECT_EQ(bank.size(), 0u);
+}
+
+TEST(ClipBank, ConfigureKeepsClipsForTheSameLayout) {
+  ClipBank bank;
+  bank.Configure(48000, 2);
+  ASSERT_TRUE(LoadS16(bank, "ding", Ramp(8), 48000, 2));
+  bank.Configure(48000, 2);
+  EXPECT_NE(bank.Find("ding"), nullptr);
+  bank.Configure(44100, 2);
+  EXPECT_EQ(bank.Find("ding"), nullptr);
+  EXPECT_EQ(bank.bytes(), 0u);
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
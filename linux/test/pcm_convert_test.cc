@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "pcm_convert.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+// Odd lengths so every kernel runs both its vector loop and scalar tail.
+constexpr size_t kCount = 203;
+
+std::vector<const ConvertKernels*> AvailableKernels() {
+  std::vector<const ConvertKernels*> tables;
+  for (SimdLevel level : {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2, SimdLevel::kNeon}) {
+    if (const ConvertKernels* kernels = GetConvertKernels(level)) {
+      tables.push_back(kernels);
+    }
+  }
+  return tables;
+}
+
+std::vector<float> TestSignal(size_t count) {
+  std::vector<float> out(count);
+  for (size_t i = 0; i < count; i++) {
+    // Sweeps past full scale on both sides, and hits exact .5 steps
+    out[i] = -1.25f + 2.5f * i / (count - 1);
+  }
+  out[1] = 0.5f / 32768.0f;
+  out[2] = 1.5f / 32768.0f;
+  return out;
+}
+
+}  // namespace
+
+TEST(PcmConvert, ScalarKernelsAlwaysAvailable) {
+  ASSERT_NE(GetConvertKernels(SimdLevel::kScalar), nullptr);
+  EXPECT_NE(Kernels().name, nullptr);
+}
+
+TEST(PcmConvert, F32ToS16ClampsAndRounds) {
+  const float in[] = {-2.0f, -1.0f, 0.0f, 0.5f / 32768.0f, 1.5f / 32768.0f, 1.0f, 2.0f};
+  const int16_t expected[] = {-32768, -32768, 0, 0, 2, 32767, 32767};
+  for (const ConvertKernels* kernels : AvailableKernels()) {
+    int16_t out[7] = {};
+    kernels->f32_to_s16(in, out, 7);
+    EXPECT_EQ(std::vector<int16_t>(out, out + 7), std::vector<int16_t>(expected, expected + 7))
+        << kernels->name;
+  }
+}
+
+TEST(PcmConvert, SimdKernelsMatchScalar) {
+  const ConvertKernels* scalar = GetConvertKernels(SimdLevel::kScalar);
+  std::vector<float> signal = TestSignal(kCount * 2);
+
+  std::vector<int16_t> s16(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    s16[i] = static_cast<int16_t>(i * 331 - 32768);
+  }
+
+  std::vector<float> f_ref(kCount * 2), f_out(kCount * 2);
+  std::vector<int16_t> s_ref(kCount * 2), s_out(kCount * 2);
+
+  for (const ConvertKernels* kernels : AvailableKernels()) {
+    SCOPED_TRACE(kernels->name);
+
+    scalar->s16_to_f32(s16.data(), f_ref.data(), kCount);
+    kernels->s16_to_f32(s16.data(), f_out.data(), kCount);
+    EXPECT_EQ(std::vector<float>(f_out.begin(), f_out.begin() + kCount),
+              std::vector<float>(f_ref.begin(), f_ref.begin() + kCount));
+
+    scalar->f32_to_s16(signal.data(), s_ref.data(), signal.size());
+    kernels->f32_to_s16(signal.data(), s_out.data(), signal.size());
+    EXPECT_EQ(s_out, s_ref);
+
+    scalar->mono_to_stereo(signal.data(), f_ref.data(), kCount);
+    kernels->mono_to_stereo(signal.data(), f_out.data(), kCount);
+    EXPECT_EQ(f_out, f_ref);
+
+    scalar->stereo_to_mono(signal.data(), f_ref.data(), kCount);
+    kernels->stereo_to_mono(signal.data(), f_out.data(), kCount);
+    EXPECT_EQ(std::vector<float>(f_out.begin(), f_out.begin() + kCount),
+              std::vector<float>(f_ref.begin(), f_ref.begin() + kCount));
+
+    f_ref = signal;
+    f_out = signal;
+    scalar->apply_gain(f_ref.data(), f_ref.size(), 0.3f);
+    kernels->apply_gain(f_out.data(), f_out.size(), 0.3f);
+    EXPECT_EQ(f_out, f_ref);
+
+    // Contracting to fused multiply-add may differ in the last bit
+    std::vector<float> mixed = signal;
+    std::reverse(mixed.begin(), mixed.end());
+    f_ref = mixed;
+    f_out = mixed;
+    scalar->mix(signal.data(), f_ref.data(), signal.size(), 0.7f);
+    kernels->mix(signal.data(), f_out.data(), signal.size(), 0.7f);
+    for (size_t i = 0; i < f_ref.size(); i++) {
+      EXPECT_NEAR(f_out[i], f_ref[i], 1e-6f) << i;
+    }
+
+    f_ref = mixed;
+    f_out = mixed;
+    scalar->mix_stereo(signal.data(), f_ref.data(), kCount, 0.25f, 1.0f);
+    kernels->mix_stereo(signal.data(), f_out.data(), kCount, 0.25f, 1.0f);
+    for (size_t i = 0; i < f_ref.size(); i++) {
+      EXPECT_NEAR(f_out[i], f_ref[i], 1e-6f) << i;
+    }
+  }
+}
+
+TEST(PcmConvert, WideFormatsRoundTrip) {
+  const float in[] = {-1.0f, -0.5f, 0.0f, 0.25f, 0.5f};
+  for (SampleFormat format : {SampleFormat::kS24, SampleFormat::kS32, SampleFormat::kF32}) {
+    int32_t raw[5] = {};
+    float out[5] = {};
+    FromFloat(format, in, raw, 5);
+    ToFloat(format, raw, out, 5);
+    EXPECT_EQ(std::vector<float>(out, out + 5), std::vector<float>(in, in + 5));
+  }
+}
+
+TEST(PcmConvert, S24IgnoresPaddingByte) {
+  const int32_t raw[] = {static_cast<int32_t>(0xFF800000u), 0x7F400000};
+  float out[2] = {};
+  ToFloat(SampleFormat::kS24, raw, out, 2);
+  EXPECT_EQ(out[0], -1.0f);
+  EXPECT_EQ(out[1], 0.5f);
+}
+
+TEST(PcmConvert, RemapChannels) {
+  const float stereo[] = {1.0f, 0.0f, 0.5f, 0.5f};
+  float mono[2] = {};
+  ASSERT_TRUE(RemapChannels(stereo, 2, mono, 1, 2));
+  EXPECT_EQ(mono[0], 0.5f);
+  EXPECT_EQ(mono[1], 0.5f);
+
+  float back[4] = {};
+  ASSERT_TRUE(RemapChannels(mono, 1, back, 2, 2));
+  EXPECT_EQ(std::vector<float>(back, back + 4), std::vector<float>({0.5f, 0.5f, 0.5f, 0.5f}));
+
+  // Mono and stereo land on the front pair of a wider layout
+  float surround[12];
+  std::fill(surround, surround + 12, 9.0f);
+  ASSERT_TRUE(RemapChannels(stereo, 2, surround, 6, 2));
+  EXPECT_EQ(std::vector<float>(surround, surround + 12),
+            std::vector<float>({1.0f, 0.0f, 0, 0, 0, 0, 0.5f, 0.5f, 0, 0, 0, 0}));
+  ASSERT_TRUE(RemapChannels(mono, 1, surround, 4, 1));
+  EXPECT_EQ(std::vector<float>(surround, surround + 4), std::vector<float>({0.5f, 0.5f, 0, 0}));
+
+  float unused[2] = {};
+  EXPECT_FALSE(RemapChannels(surround, 6, unused, 2, 1));
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
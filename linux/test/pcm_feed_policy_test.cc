@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pcm_feed_policy.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+constexpr size_t kFrame = 4;
+constexpr int64_t kSecondNs = 1000000000;
+
+}  // namespace
+
+TEST(FeedPolicy, ParsesSetupNames) {
+  FeedPolicy policy = FeedPolicy::kBlock;
+  EXPECT_TRUE(ParseFeedPolicy(nullptr, &policy));
+  EXPECT_EQ(policy, FeedPolicy::kPartial);
+  EXPECT_TRUE(ParseFeedPolicy("reject", &policy));
+  EXPECT_EQ(policy, FeedPolicy::kReject);
+  EXPECT_TRUE(ParseFeedPolicy("block", &policy));
+  EXPECT_EQ(policy, FeedPolicy::kBlock);
+  EXPECT_TRUE(ParseFeedPolicy("partial", &policy));
+  EXPECT_EQ(policy, FeedPolicy::kPartial);
+  EXPECT_FALSE(ParseFeedPolicy("grow", &policy));
+  for (FeedPolicy named : {FeedPolicy::kPartial, FeedPolicy::kReject, FeedPolicy::kBlock}) {
+    EXPECT_TRUE(ParseFeedPolicy(FeedPolicyName(named), &policy));
+    EXPECT_EQ(policy, named);
+  }
+}
+
+TEST(FeedPolicy, SizesTheQueueInWholeFrames) {
+  EXPECT_EQ(QueueBytesFor(500000, 48000, kFrame), 24000 * kFrame);
+  EXPECT_EQ(QueueBytesFor(0, 48000, kFrame), 480000 * kFrame);
+  EXPECT_EQ(QueueBytesFor(1, 48000, kFrame), kFrame);
+}
+
+TEST(FeedPolicy, PartialQueuesWhatFits) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(10 * kFrame));
+  std::vector<uint8_t> data(16 * kFrame, 1);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kPartial), 10 * kFrame);
+  EXPECT_EQ(queue.ReadableBytes(), 10 * kFrame);
+}
+
+TEST(FeedPolicy, PartialNeverQueuesATornFrame) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(10 * kFrame + 2));
+  std::vector<uint8_t> data(3 * kFrame + 1, 1);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kPartial), 3 * kFrame);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kPartial), 3 * kFrame);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kPartial), 3 * kFrame);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kPartial), kFrame);
+  EXPECT_EQ(queue.ReadableBytes(), 10 * kFrame);
+}
+
+TEST(FeedPolicy, RejectIsAllOrNothing) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(10 * kFrame));
+  std::vector<uint8_t> data(6 * kFrame, 1);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kReject), 6 * kFrame);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kReject), 0u);
+  EXPECT_EQ(queue.ReadableBytes(), 6 * kFrame);
+}
+
+TEST(FeedPolicy, FeedQueueNeverWaits) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(4 * kFrame));
+  std::vector<uint8_t> data(6 * kFrame, 1);
+  EXPECT_EQ(FeedQueue(queue, data.data(), data.size(), kFrame, FeedPolicy::kBlock), 4 * kFrame);
+}
+
+TEST(FeedPolicy, BlockWaitsForTheConsumer) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(8 * kFrame));
+  std::vector<uint8_t> data(32 * kFrame, 1);
+  FeedWaiter waiter;
+  std::mutex feed_mutex;
+
+  std::atomic<bool> done{false};
+  std::thread consumer([&] {
+    uint8_t frame[kFrame];
+    while (!done) {
+      if (queue.Read(frame, sizeof(frame)) > 0) {
+        waiter.Notify();
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+  std::unique_lock<std::mutex> lock(feed_mutex);
+  size_t written = waiter.Block(lock, data.size(), 10 * kSecondNs, [&](size_t* written) {
+    *written += FeedQueue(queue, data.data() + *written, data.size() - *written, kFrame, FeedPolicy::kPartial);
+    return true;
+  });
+  done = true;
+  consumer.join();
+  EXPECT_EQ(written, data.size());
+  EXPECT_TRUE(lock.owns_lock());
+}
+
+TEST(FeedPolicy, BlockGivesUpWhenNothingDrains) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(8 * kFrame));
+  std::vector<uint8_t> data(16 * kFrame, 1);
+  FeedWaiter waiter;
+  std::mutex feed_mutex;
+  std::unique_lock<std::mutex> lock(feed_mutex);
+
+  int asked = 0;
+  auto start = std::chrono::steady_clock::now();
+  size_t written = waiter.Block(lock, data.size(), 10 * kSecondNs, [&](size_t* written) {
+    asked++;
+    *written += FeedQueue(queue, data.data() + *written, data.size() - *written, kFrame, FeedPolicy::kPartial);
+    return false;
+  });
+  EXPECT_EQ(written, 8 * kFrame);
+  EXPECT_EQ(asked, 1);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+  // And at the timeout when something could drain but doesn't
+  written = waiter.Block(lock, data.size(), kSecondNs / 100, [&](size_t* written) {
+    *written += FeedQueue(queue, data.data() + *written, data.size() - *written, kFrame, FeedPolicy::kPartial);
+    return true;
+  });
+  EXPECT_EQ(written, 0u);
+  EXPECT_TRUE(lock.owns_lock());
+}
+
+TEST(FeedPolicy, CancelEndsABlockedFeedWithoutItsLock) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(8 * kFrame));
+  std::vector<uint8_t> data(16 * kFrame, 1);
+  FeedWaiter waiter;
+  std::mutex feed_mutex;
+
+  std::atomic<bool> blocked{false};
+  std::thread flusher([&] {
+    while (!blocked) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Only takes the lock because the blocked feed let go of it
+    std::lock_guard<std::mutex> flush_lock(feed_mutex);
+    waiter.Cancel();
+  });
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(feed_mutex);
+  size_t written = waiter.Block(lock, data.size(), 10 * kSecondNs, [&](size_t* written) {
+    *written += FeedQueue(queue, data.data() + *written, data.size() - *written, kFrame, FeedPolicy::kPartial);
+    blocked = true;
+    return true;
+  });
+  flusher.join();
+  EXPECT_EQ(written, 8 * kFrame);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST(FeedPolicy, CancelEndsEveryBlockedFeed) {
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(8 * kFrame));
+  std::vector<uint8_t> data(16 * kFrame, 1);
+  FeedWaiter waiter;
+  std::mutex feed_mutex;
+
+  std::atomic<int> attempts{0};
+  auto feed = [&] {
+    std::unique_lock<std::mutex> lock(feed_mutex);
+    waiter.Block(lock, data.size(), 10 * kSecondNs, [&](size_t* written) {
+      *written += FeedQueue(queue, data.data() + *written, data.size() - *written, kFrame, FeedPolicy::kPartial);
+      attempts++;
+      return true;
+    });
+  };
+  auto start = std::chrono::steady_clock::now();
+  std::thread first(feed);
+  std::thread second(feed);
+  while (attempts < 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  {
+    std::lock_guard<std::mutex> flush_lock(feed_mutex);
+    waiter.Cancel();
+  }
+  first.join();
+  second.join();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pcm_file_player.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+// Counts up from 0, one step per frame, on every channel
+class RampSource : public PcmSource {
+ public:
+  RampSource(int sample_rate, int channels, size_t frames) : frames_(frames) {
+    info_.sample_rate = sample_rate;
+    info_.channels = channels;
+    info_.frames = static_cast<int64_t>(frames);
+  }
+
+  size_t Read(float* out, size_t frames) override {
+    frames = std::min(frames, frames_ - position_);
+    for (size_t i = 0; i < frames; i++) {
+      for (int c = 0; c < info_.channels; c++) {
+        *out++ = static_cast<float>(position_ + i) / 32768.0f;
+      }
+    }
+    position_ += frames;
+    return frames;
+  }
+
+ private:
+  size_t frames_;
+  size_t position_ = 0;
+};
+
+// Collects what the player writes, taking at most `limit` bytes per call
+struct Sink {
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  std::vector<uint8_t> bytes;
+  size_t limit = SIZE_MAX;
+  bool done = false;
+  std::string error;
+
+  FilePlayer::Writer Writer() {
+    return [this](const uint8_t* data, size_t length) {
+      std::lock_guard<std::mutex> lock(mutex);
+      length = std::min(length, limit);
+      bytes.insert(bytes.end(), data, data + length);
+      return length;
+    };
+  }
+
+  FilePlayer::DoneCallback Done() {
+    return [this](const std::string& e) {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+      error = e;
+      done_cv.notify_all();
+    };
+  }
+
+  bool WaitDone() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return done_cv.wait_for(lock, std::chrono::seconds(5), [this] { return done; });
+  }
+};
+
+}  // namespace
+
+TEST(FilePlayer, QueuesWholeSourceInStreamFormat) {
+  Sink sink;
+  sink.limit = 100;  // forces partial writes and retries
+  FilePlayer player(sink.Writer(), sink.Done());
+  std::string error;
+  ASSERT_TRUE(player.Start(std::make_unique<RampSource>(16000, 1, 5000), 16000, 2, SampleFormat::kS16,
+                           ResampleQuality::kMedium, &error))
+      << error;
+  ASSERT_TRUE(sink.WaitDone());
+  EXPECT_FALSE(player.playing());
+  EXPECT_TRUE(sink.error.empty());
+
+  // Mono was spread onto both channels of 16-bit frames
+  ASSERT_EQ(sink.bytes.size(), 5000u * 2 * sizeof(int16_t));
+  std::vector<int16_t> out(sink.bytes.size() / sizeof(int16_t));
+  memcpy(out.data(), sink.bytes.data(), sink.bytes.size());
+  for (size_t i = 0; i < 5000; i++) {
+    ASSERT_EQ(out[2 * i], static_cast<int16_t>(i));
+    ASSERT_EQ(out[2 * i + 1], static_cast<int16_t>(i));
+  }
+}
+
+TEST(FilePlayer, ResamplesToStreamRate) {
+  Sink sink;
+  FilePlayer player(sink.Writer(), sink.Done());
+  std::string error;
+  ASSERT_TRUE(player.Start(std::make_unique<RampSource>(24000, 1, 24000), 48000, 1, SampleFormat::kF32,
+                           ResampleQuality::kLow, &error))
+      << error;
+  ASSERT_TRUE(sink.WaitDone());
+
+  // A second at the stream rate, give or take the filter's edges
+  size_t frames = sink.bytes.size() / sizeof(float);
+  EXPECT_NEAR(static_cast<double>(frames), 48000.0, 64.0);
+}
+
+TEST(FilePlayer, StopWhileQueueIsFull) {
+  Sink sink;
+  sink.limit = 0;  // the queue never drains
+  FilePlayer player(sink.Writer(), sink.Done());
+  std::string error;
+  ASSERT_TRUE(player.Start(std::make_unique<RampSource>(16000, 1, 16000), 16000, 1, SampleFormat::kS16,
+                           ResampleQuality::kMedium, &error));
+  EXPECT_TRUE(player.playing());
+  player.Stop();
+  EXPECT_FALSE(player.playing());
+  EXPECT_FALSE(sink.done);
+}
+
+TEST(FilePlayer, RejectsUnmappableLayout) {
+  Sink sink;
+  FilePlayer player(sink.Writer(), sink.Done());
+  std::string error;
+  EXPECT_FALSE(player.Start(std::make_unique<RampSource>(16000, 6, 100), 16000, 2, SampleFormat::kS16,
+                            ResampleQuality::kMedium, &error));
+  EXPECT_FALSE(error.empty());
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "pcm_file_source.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+void PutLe16(std::vector<uint8_t>* out, uint16_t v) {
+  out->push_back(v & 0xFF);
+  out->push_back(v >> 8);
+}
+
+void PutLe32(std::vector<uint8_t>* out, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back((v >> (8 * i)) & 0xFF);
+  }
+}
+
+void PutTag(std::vector<uint8_t>* out, const char* tag) {
+  out->insert(out->end(), tag, tag + 4);
+}
+
+// A WAV file with an odd-sized chunk before the samples, which leaves them
+// 2-byte aligned but not 4-byte aligned
+std::vector<uint8_t> MakeWav(uint16_t format, int channels, int rate, int bits, const std::vector<uint8_t>& samples) {
+  std::vector<uint8_t> wav;
+  PutTag(&wav, "RIFF");
+  PutLe32(&wav, 0);  // patched below
+  PutTag(&wav, "WAVE");
+  PutTag(&wav, "fmt ");
+  PutLe32(&wav, 16);
+  PutLe16(&wav, format);
+  PutLe16(&wav, channels);
+  PutLe32(&wav, rate);
+  PutLe32(&wav, rate * channels * bits / 8);
+  PutLe16(&wav, channels * bits / 8);
+  PutLe16(&wav, bits);
+  PutTag(&wav, "LIST");
+  PutLe32(&wav, 1);
+  wav.insert(wav.end(), {'a', 0});  // padded to even
+  PutTag(&wav, "data");
+  PutLe32(&wav, samples.size());
+  wav.insert(wav.end(), samples.begin(), samples.end());
+  uint32_t riff_size = wav.size() - 8;
+  memcpy(wav.data() + 4, &riff_size, 4);
+  return wav;
+}
+
+class TempFile {
+ public:
+  explicit TempFile(const std::vector<uint8_t>& contents) {
+    char name[] = "/tmp/pcm_file_source_testXXXXXX";
+    int fd = mkstemp(name);
+    path_ = name;
+    FILE* file = fdopen(fd, "wb");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+  }
+  ~TempFile() { remove(path_.c_str()); }
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+std::unique_ptr<MappedFile> Map(const TempFile& file) {
+  auto mapped = std::make_unique<MappedFile>();
+  std::string error;
+  EXPECT_TRUE(mapped->Open(file.path(), &error)) << error;
+  return mapped;
+}
+
+}  // namespace
+
+TEST(FileSource, ReadsSixteenBitWav) {
+  std::vector<uint8_t> samples;
+  for (int16_t v : {0, 16384, -16384, -32768}) {
+    PutLe16(&samples, static_cast<uint16_t>(v));
+  }
+  TempFile file(MakeWav(1, 2, 22050, 16, samples));
+  std::string error;
+  std::unique_ptr<PcmSource> source = OpenWavSource(Map(file), &error);
+  ASSERT_TRUE(source) << error;
+  EXPECT_EQ(source->info().sample_rate, 22050);
+  EXPECT_EQ(source->info().channels, 2);
+  EXPECT_EQ(source->info().frames, 2);
+
+  float out[8] = {};
+  EXPECT_EQ(source->Read(out, 4), 2u);
+  EXPECT_FLOAT_EQ(out[0], 0.0f);
+  EXPECT_FLOAT_EQ(out[1], 0.5f);
+  EXPECT_FLOAT_EQ(out[2], -0.5f);
+  EXPECT_FLOAT_EQ(out[3], -1.0f);
+  EXPECT_EQ(source->Read(out, 4), 0u);
+  EXPECT_TRUE(source->error().empty());
+}
+
+TEST(FileSource, ReadsPackedTwentyFourBitWav) {
+  // 0x400000 is half scale, 0xC00000 minus half
+  std::vector<uint8_t> samples = {0x00, 0x00, 0x40, 0x00, 0x00, 0xC0};
+  TempFile file(MakeWav(1, 1, 48000, 24, samples));
+  std::string error;
+  std::unique_ptr<PcmSource> source = OpenWavSource(Map(file), &error);
+  ASSERT_TRUE(source) << error;
+
+  float out[2] = {};
+  EXPECT_EQ(source->Read(out, 2), 2u);
+  EXPECT_FLOAT_EQ(out[0], 0.5f);
+  EXPECT_FLOAT_EQ(out[1], -0.5f);
+}
+
+TEST(FileSource, ReadsUnalignedFloatWav) {
+  std::vector<uint8_t> samples(8);
+  const float values[2] = {0.25f, -0.75f};
+  memcpy(samples.data(), values, sizeof(values));
+  TempFile file(MakeWav(3, 1, 8000, 32, samples));
+  std::string error;
+  std::unique_ptr<PcmSource> source = OpenWavSource(Map(file), &error);
+  ASSERT_TRUE(source) << error;
+
+  float out[2] = {};
+  EXPECT_EQ(source->Read(out, 2), 2u);
+  EXPECT_FLOAT_EQ(out[0], 0.25f);
+  EXPECT_FLOAT_EQ(out[1], -0.75f);
+}
+
+TEST(FileSource, RejectsOtherFiles) {
+  TempFile not_wav({'O', 'g', 'g', 'S', 0, 0, 0, 0, 0, 0, 0, 0});
+  std::string error;
+  EXPECT_FALSE(OpenWavSource(Map(not_wav), &error));
+  EXPECT_FALSE(error.empty());
+
+  // 64-bit float
+  TempFile doubles(MakeWav(3, 1, 8000, 64, std::vector<uint8_t>(16)));
+  EXPECT_FALSE(OpenWavSource(Map(doubles), &error));
+}
+
+TEST(FileSource, ReadsRawSamples) {
+  std::vector<uint8_t> samples;
+  PutLe32(&samples, 0x40000000);
+  PutLe32(&samples, 0xC0000000);
+  PutLe16(&samples, 0);  // a torn frame at the end is dropped
+  TempFile file(samples);
+  std::string error;
+  std::unique_ptr<PcmSource> source = OpenRawSource(Map(file), SampleFormat::kS32, 16000, 1, &error);
+  ASSERT_TRUE(source) << error;
+  EXPECT_EQ(source->info().frames, 2);
+
+  float out[2] = {};
+  EXPECT_EQ(source->Read(out, 2), 2u);
+  EXPECT_FLOAT_EQ(out[0], 0.5f);
+  EXPECT_FLOAT_EQ(out[1], -0.5f);
+}
+
+TEST(FileSource, MissingFileFails) {
+  MappedFile file;
+  std::string error;
+  EXPECT_FALSE(file.Open("/nonexistent/pcm_file_source_test.wav", &error));
+  EXPECT_FALSE(error.empty());
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "pcm_jitter_buffer.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+constexpr int kRate = 48000;
+constexpr size_t kFeedFrames = 960;  // 20 ms
+constexpr int64_t kFeedNs = 20000000;
+constexpr size_t kReadFrames = 480;
+
+class JitterBufferTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(jitter_.Configure(SampleFormat::kS16, kRate, 1, kReadFrames));
+    jitter_.SetLimits(kRate / 25, kRate / 2);  // 40 ms to 500 ms
+    jitter_.Reset();
+    ASSERT_TRUE(queue_.Reset(kRate * 2 * sizeof(int16_t)));
+    out_.resize(kReadFrames);
+  }
+
+  // Queues `frames` frames of silence
+  void Queue(size_t frames) {
+    std::vector<uint8_t> bytes(frames * sizeof(int16_t), 0);
+    ASSERT_EQ(queue_.Write(bytes.data(), bytes.size()), bytes.size());
+  }
+
+  size_t Read() {
+    size_t consumed = 0;
+    return jitter_.Read(queue_, out_.data(), kReadFrames, false, &consumed);
+  }
+
+  JitterBuffer jitter_;
+  RingBuffer queue_;
+  std::vector<float> out_;
+};
+
+}  // namespace
+
+TEST_F(JitterBufferTest, SteadyFeedsKeepTheMinimum) {
+  for (int i = 0; i < 500; i++) {
+    jitter_.RecordFeed(kFeedFrames, 1000000000 + i * kFeedNs);
+  }
+  Read();
+  EXPECT_EQ(jitter_.target_frames(), static_cast<size_t>(kRate / 25));
+}
+
+TEST_F(JitterBufferTest, LateFeedsRaiseTheTarget) {
+  // Every tenth feed stalls for 80 ms, and the next one follows at once
+  for (int i = 0; i < 500; i++) {
+    int64_t late = i % 10 == 9 ? 80000000 : 0;
+    jitter_.RecordFeed(kFeedFrames, 1000000000 + i * kFeedNs + late);
+  }
+  Read();
+  EXPECT_GE(jitter_.target_frames(), static_cast<size_t>(kRate * 80 / 1000));
+  EXPECT_LE(jitter_.target_frames(), static_cast<size_t>(kRate * 120 / 1000));
+}
+
+TEST_F(JitterBufferTest, AStoppedStreamIsNotJitter) {
+  for (int i = 0; i < 100; i++) {
+    jitter_.RecordFeed(kFeedFrames, 1000000000 + i * kFeedNs);
+  }
+  // A pause far longer than the maximum depth, then steady feeds again
+  for (int i = 0; i < 100; i++) {
+    jitter_.RecordFeed(kFeedFrames, 60000000000 + i * kFeedNs);
+  }
+  Read();
+  EXPECT_EQ(jitter_.target_frames(), static_cast<size_t>(kRate / 25));
+}
+
+TEST_F(JitterBufferTest, UnderrunsRaiseTheTargetUntilTheyAreForgotten) {
+  Read();
+  const size_t before = jitter_.target_frames();
+  for (int i = 0; i < 4; i++) {
+    jitter_.RecordUnderrun();
+  }
+  Read();
+  EXPECT_GT(jitter_.target_frames(), before);
+
+  // A minute without underruns is six half lives
+  for (int i = 0; i < 60 * kRate / static_cast<int>(kReadFrames); i++) {
+    Read();
+  }
+  EXPECT_LT(jitter_.target_frames(), before + static_cast<size_t>(kRate / 100));
+}
+
+TEST_F(JitterBufferTest, SpeedFollowsTheDepth) {
+  jitter_.SetLimits(kRate / 10, kRate / 10);
+  Queue(kRate / 2);
+  Read();
+  EXPECT_GT(jitter_.speed(), 1.0f);
+  EXPECT_LE(jitter_.speed(), 1.0f + JitterBuffer::kMaxSpeedChange);
+
+  jitter_.Reset();
+  queue_.Clear();
+  Queue(kRate / 100);
+  Read();
+  EXPECT_LT(jitter_.speed(), 1.0f);
+  EXPECT_GE(jitter_.speed(), 1.0f - JitterBuffer::kMaxSpeedChange);
+}
+
+TEST_F(JitterBufferTest, SmallErrorsPlayAtSpeedOne) {
+  jitter_.SetLimits(kRate / 10, kRate / 10);
+  Queue(kRate / 10 + kRate / 200);
+  Read();
+  EXPECT_EQ(jitter_.speed(), 1.0f);
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
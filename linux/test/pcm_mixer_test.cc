@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "pcm_mixer.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+std::vector<uint8_t> FloatBytes(const std::vector<float>& samples) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(samples.data());
+  return std::vector<uint8_t>(p, p + samples.size() * sizeof(float));
+}
+
+}  // namespace
+
+TEST(Mixer, AddsAndRemovesVoices) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kF32, 2, 1024, 64);
+
+  std::vector<int64_t> ids;
+  for (int i = 0; i < Mixer::kMaxVoices; i++) {
+    int64_t id = mixer.AddVoice(1.0f, 0.0f);
+    ASSERT_GT(id, 0);
+    ids.push_back(id);
+  }
+  EXPECT_EQ(mixer.AddVoice(1.0f, 0.0f), -1);
+
+  // The slot only frees once the playback side has seen the removal
+  EXPECT_TRUE(mixer.RemoveVoice(ids[3]));
+  EXPECT_FALSE(mixer.RemoveVoice(ids[3]));
+  EXPECT_EQ(mixer.AddVoice(1.0f, 0.0f), -1);
+  mixer.MaxQueuedFrames();
+  int64_t reused = mixer.AddVoice(1.0f, 0.0f);
+  EXPECT_GT(reused, ids.back());
+
+  EXPECT_EQ(mixer.Write(ids[3], nullptr, 0, FeedPolicy::kPartial), -1);
+  EXPECT_FALSE(mixer.SetVoiceGain(ids[3], 0.5f, 0.0f));
+}
+
+TEST(Mixer, WriteQueuesWholeFrames) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kS16, 2, 10, 64);
+  int64_t id = mixer.AddVoice(1.0f, 0.0f);
+  const uint8_t data[12] = {};
+  EXPECT_EQ(mixer.Write(id, data, sizeof(data), FeedPolicy::kPartial), 8);
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 2u);
+}
+
+TEST(Mixer, WriteFollowsTheFeedPolicy) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kS16, 2, 16, 64);
+  int64_t id = mixer.AddVoice(1.0f, 0.0f);
+  const uint8_t data[12] = {};
+  EXPECT_EQ(mixer.Write(id, data, sizeof(data), FeedPolicy::kReject), 12);
+  EXPECT_EQ(mixer.Write(id, data, sizeof(data), FeedPolicy::kReject), 0);
+  EXPECT_EQ(mixer.Write(id, data, sizeof(data), FeedPolicy::kPartial), 4);
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 4u);
+}
+
+TEST(Mixer, FlushDropsQueuedFramesOnly) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kS16, 1, 64, 64);
+  int64_t id = mixer.AddVoice(1.0f, 0.0f);
+  const uint8_t data[8] = {};
+  mixer.Write(id, data, sizeof(data), FeedPolicy::kPartial);
+
+  mixer.Flush();
+  mixer.Write(id, data, 2, FeedPolicy::kPartial);
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 1u);
+  EXPECT_EQ(mixer.Write(id, data, 2, FeedPolicy::kPartial), 2);
+}
+
+TEST(Mixer, MixesVoicesWithGainAndPan) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kF32, 2, 1024, 64);
+  int64_t a = mixer.AddVoice(0.5f, 0.0f);
+  int64_t b = mixer.AddVoice(1.0f, -1.0f);  // left only
+
+  std::vector<uint8_t> ones = FloatBytes(std::vector<float>(8, 1.0f));
+  ASSERT_EQ(mixer.Write(a, ones.data(), ones.size(), FeedPolicy::kPartial), (int64_t)ones.size());
+  ASSERT_EQ(mixer.Write(b, ones.data(), ones.size() / 2, FeedPolicy::kPartial), (int64_t)ones.size() / 2);
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 4u);
+
+  std::vector<float> out(8, 0.0f);
+  mixer.MixVoices(out.data(), 4);
+  // Voice b ran out after two frames
+  EXPECT_EQ(out, std::vector<float>({1.5f, 0.5f, 1.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f}));
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 0u);
+}
+
+TEST(Mixer, MixQueueConvertsFormat) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kS16, 1, 1024, 64);
+  RingBuffer queue;
+  ASSERT_TRUE(queue.Reset(64));
+  const int16_t samples[] = {16384, -16384, 8192};
+  queue.Write(reinterpret_cast<const uint8_t*>(samples), sizeof(samples));
+
+  std::vector<float> out(4, 0.25f);
+  EXPECT_EQ(mixer.MixQueue(queue, 2.0f, 0.0f, out.data(), 4), 3u);
+  EXPECT_EQ(out, std::vector<float>({1.25f, -0.75f, 0.75f, 0.25f}));
+}
+
+TEST(Mixer, PlaysClipsInPlaceUntilTheyEnd) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kS16, 2, 1024, 64);
+  Clip clip;
+  clip.samples = {0.5f, 0.25f, 0.5f, 0.25f, 0.5f, 0.25f};
+  clip.frames = 3;
+
+  int64_t id = mixer.PlayClip(&clip, 1.0f, 1.0f);  // right only
+  EXPECT_GT(id, 0);
+  EXPECT_EQ(clip.voices.load(), 1);
+  EXPECT_TRUE(mixer.clips_playing());
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 3u);
+
+  std::vector<float> out(4, 0.0f);
+  mixer.MixVoices(out.data(), 2);
+  EXPECT_EQ(out, std::vector<float>({0.0f, 0.25f, 0.0f, 0.25f}));
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 1u);
+  mixer.MixVoices(out.data(), 2);
+  EXPECT_EQ(out[1], 0.5f);
+  EXPECT_EQ(out[3], 0.25f);  // the clip ended after one more frame
+  EXPECT_EQ(clip.voices.load(), 0);
+  EXPECT_FALSE(mixer.clips_playing());
+}
+
+TEST(Mixer, FlushStopsClips) {
+  Mixer mixer;
+  mixer.Configure(SampleFormat::kF32, 1, 1024, 64);
+  Clip clip;
+  clip.samples.assign(16, 1.0f);
+  clip.frames = 16;
+  for (int i = 0; i < Mixer::kMaxClipVoices; i++) {
+    ASSERT_GT(mixer.PlayClip(&clip, 1.0f, 0.0f), 0);
+  }
+  EXPECT_EQ(mixer.PlayClip(&clip, 1.0f, 0.0f), -1);
+
+  mixer.Flush();
+  EXPECT_EQ(mixer.MaxQueuedFrames(), 0u);
+  EXPECT_EQ(clip.voices.load(), 0);
+  EXPECT_GT(mixer.PlayClip(&clip, 1.0f, 0.0f), 0);
+}
+
+TEST(Mixer, PanIsBalance) {
+  float left, right;
+  Mixer::PanGains(0.8f, 0.0f, &left, &right);
+  EXPECT_EQ(left, 0.8f);
+  EXPECT_EQ(right, 0.8f);
+  Mixer::PanGains(1.0f, 0.5f, &left, &right);
+  EXPECT_EQ(left, 0.5f);
+  EXPECT_EQ(right, 1.0f);
+  Mixer::PanGains(1.0f, -3.0f, &left, &right);
+  EXPECT_EQ(left, 1.0f);
+  EXPECT_EQ(right, 0.0f);
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "pcm_resampler.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+std::vector<float> Sine(double frequency, int rate, size_t frames, int channels) {
+  std::vector<float> out(frames * channels);
+  for (size_t i = 0; i < frames; i++) {
+    for (int c = 0; c < channels; c++) {
+      out[i * channels + c] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * frequency * i / rate));
+    }
+  }
+  return out;
+}
+
+std::vector<float> ResampleAll(Resampler& resampler, const std::vector<float>& in, int channels, size_t chunk) {
+  std::vector<float> out;
+  std::vector<float> scratch(resampler.MaxOutputFrames(chunk) * channels);
+  const size_t frames = in.size() / channels;
+  for (size_t i = 0; i < frames; i += chunk) {
+    size_t n = std::min(chunk, frames - i);
+    size_t produced = resampler.Process(&in[i * channels], n, scratch.data());
+    out.insert(out.end(), scratch.begin(), scratch.begin() + produced * channels);
+  }
+  return out;
+}
+
+// Largest deviation from the ideal sine, skipping the filter's ramp-in and
+// the tail it hasn't seen enough input for
+double MaxSineError(const std::vector<float>& out, double frequency, int rate, size_t skip) {
+  double worst = 0.0;
+  for (size_t i = skip; i + skip < out.size(); i++) {
+    double expected = 0.5 * std::sin(2.0 * M_PI * frequency * i / rate);
+    worst = std::max(worst, std::fabs(out[i] - expected));
+  }
+  return worst;
+}
+
+}  // namespace
+
+TEST(Resampler, RejectsInvalidRates) {
+  Resampler resampler;
+  EXPECT_FALSE(resampler.Configure(0, 48000, 2, ResampleQuality::kMedium, 256));
+  EXPECT_FALSE(resampler.Configure(48000, 44100, 0, ResampleQuality::kMedium, 256));
+}
+
+TEST(Resampler, UnityRatioKeepsSignal) {
+  Resampler resampler;
+  ASSERT_TRUE(resampler.Configure(48000, 48000, 2, ResampleQuality::kMedium, 256));
+  std::vector<float> in = Sine(1000, 48000, 1000, 2);
+  std::vector<float> out = ResampleAll(resampler, in, 2, 256);
+  ASSERT_EQ(out.size(), in.size() - resampler.latency_frames() * 2);
+  std::vector<float> left;
+  for (size_t i = 0; i < out.size(); i += 2) {
+    left.push_back(out[i]);
+  }
+  EXPECT_LT(MaxSineError(left, 1000, 48000, 50), 1e-3);
+}
+
+TEST(Resampler, UpsamplesNonIntegerRatio) {
+  Resampler resampler;
+  ASSERT_TRUE(resampler.Configure(22050, 48000, 1, ResampleQuality::kHigh, 512));
+  std::vector<float> out = ResampleAll(resampler, Sine(1000, 22050, 22050, 1), 1, 512);
+  EXPECT_NEAR(static_cast<double>(out.size()), 48000.0, 100.0);
+  EXPECT_LT(MaxSineError(out, 1000, 48000, 200), 1e-3);
+}
+
+TEST(Resampler, InterpolatesPhasesForLargeRatios) {
+  // 48000/44101 doesn't reduce, so there are more phases than the table holds
+  Resampler resampler;
+  ASSERT_TRUE(resampler.Configure(44101, 48000, 1, ResampleQuality::kMedium, 512));
+  std::vector<float> out = ResampleAll(resampler, Sine(440, 44101, 44101, 1), 1, 512);
+  EXPECT_LT(MaxSineError(out, 440, 48000, 200), 1e-3);
+}
+
+TEST(Resampler, DownsamplingRemovesContentAboveNyquist) {
+  Resampler resampler;
+  ASSERT_TRUE(resampler.Configure(48000, 16000, 1, ResampleQuality::kMedium, 512));
+  std::vector<float> out = ResampleAll(resampler, Sine(10000, 48000, 48000, 1), 1, 512);
+  double energy = 0.0;
+  for (size_t i = 200; i < out.size(); i++) {
+    energy += out[i] * out[i];
+  }
+  EXPECT_LT(std::sqrt(energy / (out.size() - 200)), 1e-3);
+}
+
+TEST(Resampler, ChunkSizeDoesNotChangeOutput) {
+  std::vector<float> in = Sine(3000, 44100, 5000, 2);
+  Resampler whole, pieces;
+  ASSERT_TRUE(whole.Configure(44100, 48000, 2, ResampleQuality::kLow, 5000));
+  ASSERT_TRUE(pieces.Configure(44100, 48000, 2, ResampleQuality::kLow, 5000));
+  EXPECT_EQ(ResampleAll(whole, in, 2, 5000), ResampleAll(pieces, in, 2, 37));
+}
+
+TEST(Resampler, TakesMoreThanItWasSizedFor) {
+  std::vector<float> in = Sine(3000, 44100, 5000, 2);
+  Resampler sized, small;
+  ASSERT_TRUE(sized.Configure(44100, 48000, 2, ResampleQuality::kLow, 5000));
+  ASSERT_TRUE(small.Configure(44100, 48000, 2, ResampleQuality::kLow, 64));
+  EXPECT_EQ(ResampleAll(small, in, 2, 5000), ResampleAll(sized, in, 2, 5000));
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
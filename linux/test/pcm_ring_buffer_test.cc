@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "pcm_ring_buffer.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+TEST(RingBuffer, WriteThenRead) {
+  RingBuffer ring;
+  ASSERT_TRUE(ring.Reset(8));
+
+  const uint8_t in[] = {1, 2, 3, 4, 5};
+  EXPECT_EQ(ring.Write(in, sizeof(in)), 5u);
+  EXPECT_EQ(ring.ReadableBytes(), 5u);
+  EXPECT_EQ(ring.WritableBytes(), 3u);
+
+  uint8_t out[5] = {};
+  EXPECT_EQ(ring.Read(out, sizeof(out)), 5u);
+  EXPECT_EQ(std::vector<uint8_t>(out, out + 5), std::vector<uint8_t>(in, in + 5));
+  EXPECT_EQ(ring.ReadableBytes(), 0u);
+}
+
+TEST(RingBuffer, WrapsAroundEndOfStorage) {
+  RingBuffer ring;
+  ASSERT_TRUE(ring.Reset(8));
+
+  uint8_t scratch[8];
+  const uint8_t first[] = {0, 0, 0, 0, 0, 0};
+  ring.Write(first, sizeof(first));
+  ring.Read(scratch, sizeof(first));
+
+  // Starts at offset 6, so this write is split across the end of storage
+  const uint8_t in[] = {10, 11, 12, 13, 14};
+  EXPECT_EQ(ring.Write(in, sizeof(in)), 5u);
+  uint8_t out[5] = {};
+  EXPECT_EQ(ring.Read(out, sizeof(out)), 5u);
+  EXPECT_EQ(std::vector<uint8_t>(out, out + 5), std::vector<uint8_t>(in, in + 5));
+}
+
+TEST(RingBuffer, PeekReturnsContiguousRegionUntilConsumed) {
+  RingBuffer ring;
+  ASSERT_TRUE(ring.Reset(8));
+
+  uint8_t scratch[8];
+  const uint8_t first[] = {0, 0, 0, 0, 0, 0};
+  ring.Write(first, sizeof(first));
+  ring.Read(scratch, sizeof(first));
+
+  const uint8_t in[] = {10, 11, 12, 13, 14};
+  ring.Write(in, sizeof(in));
+
+  // Only the two bytes before the end of storage are contiguous
+  const uint8_t* data = nullptr;
+  ASSERT_EQ(ring.Peek(&data), 2u);
+  EXPECT_EQ(data[0], 10);
+  EXPECT_EQ(data[1], 11);
+  EXPECT_EQ(ring.ReadableBytes(), 5u);
+
+  ring.Consume(2);
+  ASSERT_EQ(ring.Peek(&data), 3u);
+  EXPECT_EQ(data[0], 12);
+  ring.Consume(3);
+  EXPECT_EQ(ring.Peek(&data), 0u);
+}
+
+TEST(RingBuffer, WriteStopsWhenFull) {
+  RingBuffer ring;
+  ASSERT_TRUE(ring.Reset(4));
+
+  const uint8_t in[] = {1, 2, 3, 4, 5, 6};
+  EXPECT_EQ(ring.Write(in, sizeof(in)), 4u);
+  EXPECT_EQ(ring.Write(in, sizeof(in)), 0u);
+
+  ring.Clear();
+  EXPECT_EQ(ring.ReadableBytes(), 0u);
+  EXPECT_EQ(ring.WritableBytes(), 4u);
+}
+
+TEST(RingBuffer, DiscardToKeepsLaterWrites) {
+  RingBuffer ring;
+  ASSERT_TRUE(ring.Reset(8));
+
+  const uint8_t old[] = {1, 2, 3, 4, 5, 6};
+  ring.Write(old, sizeof(old));
+  uint8_t scratch[2];
+  ring.Read(scratch, sizeof(scratch));
+  uint64_t flush_to = ring.WritePosition();
+  EXPECT_EQ(flush_to, 6u);
+
+  // Written after the flush was asked for, before the consumer saw it
+  const uint8_t in[] = {10, 11};
+  ring.Write(in, sizeof(in));
+  EXPECT_EQ(ring.DiscardTo(flush_to), 4u);
+  uint8_t out[2] = {};
+  EXPECT_EQ(ring.Read(out, sizeof(out)), 2u);
+  EXPECT_EQ(out[0], 10);
+  EXPECT_EQ(out[1], 11);
+
+  // Already consumed past it: nothing to drop
+  ring.Write(in, sizeof(in));
+  EXPECT_EQ(ring.DiscardTo(flush_to), 0u);
+  EXPECT_EQ(ring.ReadableBytes(), 2u);
+}
+
+TEST(RingBuffer, ProducerAndConsumerThreadsSeeSameStream) {
+  RingBuffer ring;
+  ASSERT_TRUE(ring.Reset(1000));
+  const size_t total = 1 << 18;
+
+  std::thread producer([&] {
+    uint8_t block[97];
+    size_t sent = 0;
+    while (sent < total) {
+      size_t n = std::min(sizeof(block), total - sent);
+      for (size_t i = 0; i < n; i++) {
+        block[i] = static_cast<uint8_t>(sent + i);
+      }
+      size_t offset = 0;
+      while (offset < n) {
+        offset += ring.Write(block + offset, n - offset);
+      }
+      sent += n;
+    }
+  });
+
+  uint8_t block[61];
+  size_t received = 0;
+  bool in_order = true;
+  while (received < total) {
+    size_t n = ring.Read(block, sizeof(block));
+    for (size_t i = 0; i < n; i++) {
+      in_order &= block[i] == static_cast<uint8_t>(received + i);
+    }
+    received += n;
+  }
+  producer.join();
+
+  EXPECT_TRUE(in_order);
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
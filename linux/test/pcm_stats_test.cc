@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "pcm_stats.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+constexpr int64_t kMs = 1000000;
+
+TEST(PlaybackStats, CountsBytesAndCallbacks) {
+  PlaybackStats stats;
+  stats.RecordFeed(100, 0);
+  stats.RecordFeed(50, 0);
+  stats.RecordFeedCallback();
+  stats.RecordDeviceCallback(40);
+  stats.RecordDeviceCallback(10);
+  stats.RecordDeviceCallback(25);
+  stats.RecordPlayed(120, 0);
+
+  StatsSnapshot snapshot;
+  stats.Snapshot(&snapshot);
+  EXPECT_EQ(snapshot.bytes_fed, 150u);
+  EXPECT_EQ(snapshot.bytes_played, 120u);
+  EXPECT_EQ(snapshot.feed_callbacks, 1u);
+  EXPECT_EQ(snapshot.device_callbacks, 3u);
+  EXPECT_EQ(snapshot.queue_high_frames, 40u);
+  EXPECT_TRUE(snapshot.has_queue_low);
+  EXPECT_EQ(snapshot.queue_low_frames, 10u);
+
+  stats.Reset();
+  stats.Snapshot(&snapshot);
+  EXPECT_EQ(snapshot.bytes_fed, 0u);
+  EXPECT_EQ(snapshot.device_callbacks, 0u);
+  EXPECT_FALSE(snapshot.has_queue_low);
+}
+
+TEST(PlaybackStats, MeasuresFeedLatencyFromFirstByte) {
+  PlaybackStats stats;
+  stats.RecordFeed(100, 0);
+  stats.RecordFeed(100, 1 * kMs);
+
+  // Only the first feed has started playing
+  stats.RecordPlayed(50, 3 * kMs);
+  StatsSnapshot snapshot;
+  stats.Snapshot(&snapshot);
+  EXPECT_EQ(snapshot.latency_histogram[2], 1u);  // 3 ms: [2, 4)
+
+  // The second starts 99 ms after it was fed
+  stats.RecordPlayed(100, 100 * kMs);
+  stats.Snapshot(&snapshot);
+  EXPECT_EQ(snapshot.latency_histogram[7], 1u);  // [64, 128)
+
+  uint64_t total = 0;
+  for (uint64_t count : snapshot.latency_histogram) {
+    total += count;
+  }
+  EXPECT_EQ(total, 2u);
+}
+
+TEST(PlaybackStats, SlowFeedsLandInLastBucket) {
+  PlaybackStats stats;
+  stats.RecordFeed(10, 0);
+  stats.RecordPlayed(10, 5000 * kMs);
+
+  StatsSnapshot snapshot;
+  stats.Snapshot(&snapshot);
+  EXPECT_EQ(snapshot.latency_histogram[kLatencyBuckets - 1], 1u);
+}
+
+TEST(PlaybackStats, TimesFeedAfterFlushFromItsFirstByte) {
+  PlaybackStats stats;
+  stats.RecordFeed(100, 0);
+  stats.RecordFeed(100, 0);
+  stats.RecordPlayed(50, 1 * kMs);  // the first feed starts: [1, 2)
+
+  // Flush drops the rest of the first feed and all of the second, which
+  // never plays
+  stats.RecordDiscarded(150);
+  stats.RecordFeed(100, 10 * kMs);
+  stats.RecordPlayed(10, 30 * kMs);  // 20 ms after its feed: [16, 32)
+
+  StatsSnapshot snapshot;
+  stats.Snapshot(&snapshot);
+  EXPECT_EQ(snapshot.bytes_fed, 300u);
+  EXPECT_EQ(snapshot.bytes_played, 60u);
+  EXPECT_EQ(snapshot.latency_histogram[1], 1u);
+  EXPECT_EQ(snapshot.latency_histogram[5], 1u);
+
+  uint64_t total = 0;
+  for (uint64_t count : snapshot.latency_histogram) {
+    total += count;
+  }
+  EXPECT_EQ(total, 2u);
+}
+
+TEST(PlaybackStats, TimesRecoveryFromFirstUnderrun) {
+  PlaybackStats stats;
+  stats.RecordRecovered(1 * kMs);  // no underrun yet
+  stats.RecordUnderrun(10 * kMs);
+  stats.RecordUnderrun(12 * kMs);
+  stats.RecordRecovered(15 * kMs);
+  stats.RecordUnderrun(20 * kMs);
+  stats.RecordRecovered(22 * kMs);
+  stats.RecordDeviceError();
+
+  StatsSnapshot snapshot;
+  stats.Snapshot(&snapshot);
+  EXPECT_EQ(snapshot.underruns, 3u);
+  EXPECT_EQ(snapshot.recoveries, 2u);
+  EXPECT_EQ(snapshot.recovery_ns_total, static_cast<uint64_t>(7 * kMs));
+  EXPECT_EQ(snapshot.recovery_ns_max, static_cast<uint64_t>(5 * kMs));
+  EXPECT_EQ(snapshot.device_errors, 1u);
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "pcm_time_stretch.h"
+
+namespace flutter_pcm_sound {
+namespace test {
+
+namespace {
+
+constexpr int kRate = 48000;
+
+std::vector<float> Sine(double frequency, size_t frames, int channels) {
+  std::vector<float> out(frames * channels);
+  for (size_t i = 0; i < frames; i++) {
+    for (int c = 0; c < channels; c++) {
+      out[i * channels + c] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * frequency * i / kRate));
+    }
+  }
+  return out;
+}
+
+// Writes `in` in `chunk` frame pieces, reading whatever comes out after
+// each, and drains at the end if asked
+std::vector<float> StretchAll(TimeStretcher& stretcher, const std::vector<float>& in, int channels, size_t chunk,
+                              bool drain) {
+  std::vector<float> out;
+  std::vector<float> scratch(chunk * channels);
+  const size_t frames = in.size() / channels;
+  size_t written = 0;
+  while (written < frames) {
+    written += stretcher.Write(&in[written * channels], std::min(chunk, frames - written));
+    size_t read;
+    while ((read = stretcher.Read(scratch.data(), chunk, false)) > 0) {
+      out.insert(out.end(), scratch.begin(), scratch.begin() + read * channels);
+    }
+  }
+  if (drain) {
+    size_t read;
+    while ((read = stretcher.Read(scratch.data(), chunk, true)) > 0) {
+      out.insert(out.end(), scratch.begin(), scratch.begin() + read * channels);
+    }
+  }
+  return out;
+}
+
+// Largest step between neighbouring samples of channel 0
+float MaxStep(const std::vector<float>& samples, int channels) {
+  float worst = 0.0f;
+  for (size_t i = channels; i < samples.size(); i += channels) {
+    worst = std::max(worst, std::fabs(samples[i] - samples[i - channels]));
+  }
+  return worst;
+}
+
+}  // namespace
+
+TEST(TimeStretcher, PassesInputThroughAtSpeedOne) {
+  TimeStretcher stretcher;
+  ASSERT_TRUE(stretcher.Configure(kRate, 2, 256));
+  std::vector<float> in = Sine(440.0, kRate / 2, 2);
+  for (size_t i = 0; i < in.size(); i += 7) {
+    in[i] += 0.1f;  // not periodic, so only the exact offset matches
+  }
+  std::vector<float> out = StretchAll(stretcher, in, 2, 256, true);
+  EXPECT_EQ(out, in);
+  EXPECT_EQ(stretcher.buffered_frames(), 0u);
+}
+
+TEST(TimeStretcher, HoldsBackItsLookahead) {
+  TimeStretcher stretcher;
+  ASSERT_TRUE(stretcher.Configure(kRate, 1, 2048));
+  const size_t latency = stretcher.latency_frames();
+  std::vector<float> in = Sine(440.0, latency, 1);
+  std::vector<float> out(2 * latency);
+  EXPECT_EQ(stretcher.Write(in.data(), latency), latency);
+  EXPECT_EQ(stretcher.Read(out.data(), out.size(), false), 0u);
+  EXPECT_EQ(stretcher.buffered_frames(), latency);
+  EXPECT_EQ(stretcher.Read(out.data(), out.size(), true), latency);
+  EXPECT_EQ(stretcher.buffered_frames(), 0u);
+}
+
+TEST(TimeStretcher, SpeedSetsHowMuchInputIsPlayed) {
+  const std::vector<float> in = Sine(220.0, 4 * kRate, 1);
+  for (float speed : {0.95f, 1.05f}) {
+    TimeStretcher stretcher;
+    ASSERT_TRUE(stretcher.Configure(kRate, 1, 512));
+    stretcher.set_speed(speed);
+    std::vector<float> out = StretchAll(stretcher, in, 1, 512, false);
+    const double played = static_cast<double>(in.size() - stretcher.buffered_frames());
+    EXPECT_NEAR(out.size() * speed / played, 1.0, 0.01) << "speed " << speed;
+  }
+}
+
+TEST(TimeStretcher, StretchedSineHasNoClicks) {
+  const std::vector<float> in = Sine(220.0, 2 * kRate, 2);
+  // The steepest a 220 Hz sine at 0.5 gets, with room for the crossfades
+  const float limit = static_cast<float>(1.5 * 0.5 * 2.0 * M_PI * 220.0 / kRate);
+  for (float speed : {0.95f, 1.05f}) {
+    TimeStretcher stretcher;
+    ASSERT_TRUE(stretcher.Configure(kRate, 2, 480));
+    stretcher.set_speed(speed);
+    std::vector<float> out = StretchAll(stretcher, in, 2, 480, true);
+    EXPECT_LT(MaxStep(out, 2), limit) << "speed " << speed;
+    float peak = 0.0f;
+    for (float sample : out) {
+      peak = std::max(peak, std::fabs(sample));
+    }
+    EXPECT_LT(peak, 0.51f) << "speed " << speed;
+  }
+}
+
+TEST(TimeStretcher, RejectsBadConfiguration) {
+  TimeStretcher stretcher;
+  EXPECT_FALSE(stretcher.Configure(0, 2, 256));
+  EXPECT_FALSE(stretcher.Configure(kRate, 0, 256));
+}
+
+}  // namespace test
+}  // namespace flutter_pcm_sound
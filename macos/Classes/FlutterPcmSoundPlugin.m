@@ -1 +0,0 @@
-../../ios/Classes/FlutterPcmSoundPlugin.m
\ No newline at end of file
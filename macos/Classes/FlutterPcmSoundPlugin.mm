@@ -0,0 +1 @@
+../../ios/Classes/FlutterPcmSoundPlugin.mm
\ No newline at end of file
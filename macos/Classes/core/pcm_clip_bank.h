@@ -0,0 +1 @@
+../../../src/pcm_clip_bank.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_convert.h
\ No newline at end of file
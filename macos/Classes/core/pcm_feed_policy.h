@@ -0,0 +1 @@
+../../../src/pcm_feed_policy.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_file_player.h
\ No newline at end of file
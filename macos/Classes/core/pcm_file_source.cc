@@ -0,0 +1 @@
+../../../src/pcm_file_source.cc
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_file_source.h
\ No newline at end of file
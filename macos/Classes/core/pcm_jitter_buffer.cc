@@ -0,0 +1 @@
+../../../src/pcm_jitter_buffer.cc
\ No newline at end of file
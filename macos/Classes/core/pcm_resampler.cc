@@ -0,0 +1 @@
+../../../src/pcm_resampler.cc
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_resampler.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_ring_buffer.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_stats.h
\ No newline at end of file
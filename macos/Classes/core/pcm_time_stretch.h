@@ -0,0 +1 @@
+../../../src/pcm_time_stretch.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/pcm_trace.cc
\ No newline at end of file
@@ -0,0 +1,32 @@
+# Platform-independent audio core shared by the native backends: the sample
+# queue and its feed policies, format conversion, resampling, mixing,
+# playback stats, file playback, the clip cache, the adaptive jitter buffer
+# and trace points. Include this file from a backend's CMakeLists.txt and
+# add CORE_SOURCES to its targets, with CORE_INCLUDE_DIR on their include
+# path and CORE_DEFINITIONS defined.
+#
+# The Apple backends can't reach outside their pod directory, so they pick
+# the same files up through symlinks in {ios,macos}/Classes/core.
+set(CORE_INCLUDE_DIR "${CMAKE_CURRENT_LIST_DIR}")
+
+list(APPEND CORE_SOURCES
+  "${CORE_INCLUDE_DIR}/pcm_clip_bank.cc"
+  "${CORE_INCLUDE_DIR}/pcm_convert.cc"
+  "${CORE_INCLUDE_DIR}/pcm_feed_policy.cc"
+  "${CORE_INCLUDE_DIR}/pcm_file_player.cc"
+  "${CORE_INCLUDE_DIR}/pcm_file_source.cc"
+  "${CORE_INCLUDE_DIR}/pcm_jitter_buffer.cc"
+  "${CORE_INCLUDE_DIR}/pcm_mixer.cc"
+  "${CORE_INCLUDE_DIR}/pcm_resampler.cc"
+  "${CORE_INCLUDE_DIR}/pcm_ring_buffer.cc"
+  "${CORE_INCLUDE_DIR}/pcm_stats.cc"
+  "${CORE_INCLUDE_DIR}/pcm_time_stretch.cc"
+  "${CORE_INCLUDE_DIR}/pcm_trace.cc"
+)
+
+# Trace points for the audio threads (see pcm_trace.h) are compiled out
+# unless this is on: -DFLUTTER_PCM_SOUND_TRACE=ON.
+option(FLUTTER_PCM_SOUND_TRACE "Emit system trace events from the audio threads" OFF)
+if(FLUTTER_PCM_SOUND_TRACE)
+  list(APPEND CORE_DEFINITIONS FLUTTER_PCM_SOUND_TRACE)
+endif()
@@ -0,0 +1,152 @@
+#include "pcm_clip_bank.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// Frames converted per resampler pass
+constexpr size_t kChunkFrames = 2048;
+
+}  // namespace
+
+void ClipBank::Configure(int sample_rate, int channels) {
+  if (sample_rate != sample_rate_ || channels != channels_) {
+    Clear();
+  }
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+}
+
+void ClipBank::SetLimit(size_t bytes) {
+  limit_ = bytes;
+  Evict();
+}
+
+bool ClipBank::Load(const std::string& id, const uint8_t* data, size_t length, SampleFormat format, int sample_rate,
+                    int channels, ResampleQuality quality, std::string* error) {
+  if (sample_rate <= 0 || channels <= 0) {
+    *error = "invalid clip sample rate or channel count";
+    return false;
+  }
+  const size_t frames = length / (BytesPerSample(format) * channels);
+  std::vector<float> decoded(frames * channels);
+  ToFloat(format, data, decoded.data(), decoded.size());
+
+  std::vector<float> remapped(frames * channels_);
+  if (!RemapChannels(decoded.data(), channels, remapped.data(), channels_, frames)) {
+    *error = "can't play a " + std::to_string(channels) + " channel clip on a " + std::to_string(channels_) +
+             " channel stream";
+    return false;
+  }
+  decoded = std::vector<float>();
+
+  auto clip = std::make_unique<Clip>();
+  if (sample_rate == sample_rate_) {
+    clip->samples = std::move(remapped);
+  } else {
+    Resampler resampler;
+    if (!resampler.Configure(sample_rate, sample_rate_, channels_, quality, kChunkFrames)) {
+      *error = "can't resample a " + std::to_string(sample_rate) + " Hz clip to " + std::to_string(sample_rate_) + " Hz";
+      return false;
+    }
+    std::vector<float> out(resampler.MaxOutputFrames(kChunkFrames) * channels_);
+    clip->samples.reserve((frames * sample_rate_ / sample_rate + 1) * channels_);
+    // Then silence through the filter, to get the last frames out
+    const size_t total = frames + resampler.latency_frames();
+    std::vector<float> silence(std::min(resampler.latency_frames(), kChunkFrames) * channels_, 0.0f);
+    for (size_t done = 0; done < total;) {
+      size_t count = std::min(kChunkFrames, total - done);
+      const float* in = remapped.data() + done * channels_;
+      if (done >= frames) {
+        count = std::min(count, silence.size() / channels_);
+        in = silence.data();
+      } else {
+        count = std::min(count, frames - done);
+      }
+      size_t produced = resampler.Process(in, count, out.data());
+      clip->samples.insert(clip->samples.end(), out.begin(), out.begin() + produced * channels_);
+      done += count;
+    }
+  }
+  clip->frames = clip->samples.size() / channels_;
+  if (clip->bytes() > limit_) {
+    *error = "the clip is larger than the clip cache";
+    return false;
+  }
+
+  auto existing = index_.find(id);
+  if (existing != index_.end()) {
+    Retire(existing->second);
+  }
+  bytes_ += clip->bytes();
+  lru_.push_front(Entry{id, std::move(clip)});
+  index_[id] = lru_.begin();
+  Evict();
+  return true;
+}
+
+Clip* ClipBank::Find(const std::string& id) {
+  auto found = index_.find(id);
+  if (found == index_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, found->second);
+  // Clips retired or left over the limit may have finished by now
+  Evict();
+  return lru_.front().clip.get();
+}
+
+bool ClipBank::Unload(const std::string& id) {
+  auto found = index_.find(id);
+  if (found == index_.end()) {
+    return false;
+  }
+  Retire(found->second);
+  Evict();
+  return true;
+}
+
+void ClipBank::Clear() {
+  lru_.clear();
+  index_.clear();
+  retired_.clear();
+  bytes_ = 0;
+}
+
+void ClipBank::Retire(std::list<Entry>::iterator entry) {
+  index_.erase(entry->id);
+  retired_.push_back(std::move(entry->clip));
+  lru_.erase(entry);
+}
+
+void ClipBank::Evict() {
+  for (size_t i = 0; i < retired_.size();) {
+    if (retired_[i]->voices.load(std::memory_order_acquire) == 0) {
+      bytes_ -= retired_[i]->bytes();
+      retired_[i] = std::move(retired_.back());
+      retired_.pop_back();
+    } else {
+      i++;
+    }
+  }
+  if (lru_.empty()) {
+    return;
+  }
+  // The most recently played clip stays, so Load never evicts what it
+  // just loaded
+  auto entry = std::prev(lru_.end());
+  while (bytes_ > limit_ && entry != lru_.begin()) {
+    auto previous = std::prev(entry);
+    if (entry->clip->voices.load(std::memory_order_acquire) == 0) {
+      bytes_ -= entry->clip->bytes();
+      index_.erase(entry->id);
+      lru_.erase(entry);
+    }
+    entry = previous;
+  }
+}
+
+}  // namespace flutter_pcm_sound
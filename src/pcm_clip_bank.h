@@ -0,0 +1,99 @@
+#ifndef FLUTTER_PLUGIN_PCM_CLIP_BANK_H_
+#define FLUTTER_PLUGIN_PCM_CLIP_BANK_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pcm_convert.h"
+#include "pcm_resampler.h"
+
+namespace flutter_pcm_sound {
+
+// A short sound loaded once with loadClip, kept as float at the stream's
+// rate and channel count so the mixer reads it in place.
+struct Clip {
+  std::vector<float> samples;
+  size_t frames = 0;
+  // Voices playing it. Raised by the platform thread when a voice starts,
+  // lowered by the playback thread once it has read the last frame; the
+  // clip is only freed at zero.
+  std::atomic<int> voices{0};
+
+  size_t bytes() const { return samples.size() * sizeof(float); }
+};
+
+// The loaded clips, by id, evicted least recently played first once they
+// take more than the limit. The most recently loaded or played clip is
+// always kept.
+//
+// A clip that is playing is never freed: eviction skips it, and unloading
+// or replacing it retires it until its voices are done. So the limit can
+// be exceeded for as long as that takes.
+//
+// Platform thread only.
+class ClipBank {
+ public:
+  static constexpr size_t kDefaultLimitBytes = 32 * 1024 * 1024;
+
+  ClipBank() = default;
+
+  ClipBank(const ClipBank&) = delete;
+  ClipBank& operator=(const ClipBank&) = delete;
+
+  // Clips are converted to `sample_rate` and `channels`. Drops every clip
+  // when either changes, so nothing may be playing then.
+  void Configure(int sample_rate, int channels);
+
+  // At most this many bytes of clips are kept once playing ones finish.
+  void SetLimit(size_t bytes);
+
+  // Converts `length` bytes of `format` samples at `sample_rate` with
+  // `channels` and stores them as `id`, replacing any clip of that id.
+  // Returns false with `error` set when the layout can't be converted or
+  // the clip alone is over the limit.
+  bool Load(const std::string& id, const uint8_t* data, size_t length, SampleFormat format, int sample_rate,
+            int channels, ResampleQuality quality, std::string* error);
+
+  // The clip `id`, marked as the most recently played, or null.
+  Clip* Find(const std::string& id);
+
+  bool Unload(const std::string& id);
+
+  // Drops every clip. Nothing may be playing.
+  void Clear();
+
+  // Bytes held, retired clips included
+  size_t bytes() const { return bytes_; }
+  size_t size() const { return index_.size(); }
+
+ private:
+  struct Entry {
+    std::string id;
+    std::unique_ptr<Clip> clip;
+  };
+
+  void Retire(std::list<Entry>::iterator entry);
+  // Frees retired clips that finished playing, then idle clips from the
+  // least recently played end until the bank is within the limit
+  void Evict();
+
+  int sample_rate_ = 0;
+  int channels_ = 0;
+  size_t limit_ = kDefaultLimitBytes;
+  size_t bytes_ = 0;
+
+  std::list<Entry> lru_;  // most recently played first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  // Unloaded or replaced while still playing
+  std::vector<std::unique_ptr<Clip>> retired_;
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_CLIP_BANK_H_
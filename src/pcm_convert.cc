@@ -0,0 +1,485 @@
+#include "pcm_convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PCM_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+#if PCM_CONVERT_X86 && defined(_MSC_VER) && !defined(__clang__)
+// MSVC compiles any intrinsic without per-function target attributes
+#include <intrin.h>
+#define PCM_TARGET(isa)
+#elif PCM_CONVERT_X86
+#define PCM_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(__aarch64__) || (defined(__ARM_NEON) && defined(__ARM_FEATURE_DIRECTED_ROUNDING))
+#define PCM_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+constexpr float kS16Scale = 32768.0f;
+constexpr float kS16Max = 32767.0f;
+
+// === Scalar ===
+// Reference implementations. The SIMD versions below handle the bulk of
+// each buffer and fall back to these for the tail.
+
+void S16ToF32Scalar(const int16_t* in, float* out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = in[i] * (1.0f / kS16Scale);
+  }
+}
+
+void F32ToS16Scalar(const float* in, int16_t* out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    float v = std::min(std::max(in[i] * kS16Scale, -kS16Scale), kS16Max);
+    out[i] = static_cast<int16_t>(lrintf(v));
+  }
+}
+
+void MonoToStereoScalar(const float* in, float* out, size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    out[i * 2] = in[i];
+    out[i * 2 + 1] = in[i];
+  }
+}
+
+void StereoToMonoScalar(const float* in, float* out, size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    out[i] = (in[i * 2] + in[i * 2 + 1]) * 0.5f;
+  }
+}
+
+void ApplyGainScalar(float* data, size_t count, float gain) {
+  for (size_t i = 0; i < count; i++) {
+    data[i] *= gain;
+  }
+}
+
+void MixScalar(const float* in, float* out, size_t count, float gain) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] += in[i] * gain;
+  }
+}
+
+void MixStereoScalar(const float* in, float* out, size_t frames, float left, float right) {
+  for (size_t i = 0; i < frames; i++) {
+    out[i * 2] += in[i * 2] * left;
+    out[i * 2 + 1] += in[i * 2 + 1] * right;
+  }
+}
+
+const ConvertKernels kScalarKernels = {
+    "scalar", S16ToF32Scalar, F32ToS16Scalar, MonoToStereoScalar, StereoToMonoScalar, ApplyGainScalar,
+    MixScalar, MixStereoScalar,
+};
+
+#if PCM_CONVERT_X86
+
+// === SSE2 ===
+
+PCM_TARGET("sse2") void S16ToF32Sse2(const int16_t* in, float* out, size_t count) {
+  const __m128 scale = _mm_set1_ps(1.0f / kS16Scale);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    // Duplicate each sample into both halves of a 32-bit lane, then shift
+    // right to sign-extend
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  S16ToF32Scalar(in + i, out + i, count - i);
+}
+
+PCM_TARGET("sse2") void F32ToS16Sse2(const float* in, int16_t* out, size_t count) {
+  const __m128 scale = _mm_set1_ps(kS16Scale);
+  const __m128 min = _mm_set1_ps(-kS16Scale);
+  const __m128 max = _mm_set1_ps(kS16Max);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), min), max);
+    __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), min), max);
+    __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+  }
+  F32ToS16Scalar(in + i, out + i, count - i);
+}
+
+PCM_TARGET("sse2") void MonoToStereoSse2(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    __m128 m = _mm_loadu_ps(in + i);
+    _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(m, m));
+    _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(m, m));
+  }
+  MonoToStereoScalar(in + i, out + i * 2, frames - i);
+}
+
+PCM_TARGET("sse2") void StereoToMonoSse2(const float* in, float* out, size_t frames) {
+  const __m128 half = _mm_set1_ps(0.5f);
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    __m128 a = _mm_loadu_ps(in + i * 2);      // L0 R0 L1 R1
+    __m128 b = _mm_loadu_ps(in + i * 2 + 4);  // L2 R2 L3 R3
+    __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+  }
+  StereoToMonoScalar(in + i * 2, out + i, frames - i);
+}
+
+PCM_TARGET("sse2") void ApplyGainSse2(float* data, size_t count, float gain) {
+  const __m128 g = _mm_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+  }
+  ApplyGainScalar(data + i, count - i, gain);
+}
+
+PCM_TARGET("sse2") void MixSse2(const float* in, float* out, size_t count, float gain) {
+  const __m128 g = _mm_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), g)));
+  }
+  MixScalar(in + i, out + i, count - i, gain);
+}
+
+PCM_TARGET("sse2") void MixStereoSse2(const float* in, float* out, size_t frames, float left,
+                                                   float right) {
+  const __m128 g = _mm_setr_ps(left, right, left, right);
+  size_t i = 0;
+  for (; i + 2 <= frames; i += 2) {
+    _mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), _mm_mul_ps(_mm_loadu_ps(in + i * 2), g)));
+  }
+  MixStereoScalar(in + i * 2, out + i * 2, frames - i, left, right);
+}
+
+const ConvertKernels kSse2Kernels = {
+    "sse2", S16ToF32Sse2, F32ToS16Sse2, MonoToStereoSse2, StereoToMonoSse2, ApplyGainSse2,
+    MixSse2, MixStereoSse2,
+};
+
+// === AVX2 ===
+
+PCM_TARGET("avx2") void S16ToF32Avx2(const int16_t* in, float* out, size_t count) {
+  const __m256 scale = _mm256_set1_ps(1.0f / kS16Scale);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), scale));
+    _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), scale));
+  }
+  S16ToF32Sse2(in + i, out + i, count - i);
+}
+
+PCM_TARGET("avx2") void F32ToS16Avx2(const float* in, int16_t* out, size_t count) {
+  const __m256 scale = _mm256_set1_ps(kS16Scale);
+  const __m256 min = _mm256_set1_ps(-kS16Scale);
+  const __m256 max = _mm256_set1_ps(kS16Max);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), min), max);
+    __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), min), max);
+    // packs works per 128-bit lane, so put the 64-bit quarters back in order
+    __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+    packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+  }
+  F32ToS16Sse2(in + i, out + i, count - i);
+}
+
+PCM_TARGET("avx2") void MonoToStereoAvx2(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    __m256 m = _mm256_loadu_ps(in + i);
+    __m256 lo = _mm256_unpacklo_ps(m, m);  // 0 0 1 1 | 4 4 5 5
+    __m256 hi = _mm256_unpackhi_ps(m, m);  // 2 2 3 3 | 6 6 7 7
+    _mm256_storeu_ps(out + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(out + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+  MonoToStereoSse2(in + i, out + i * 2, frames - i);
+}
+
+PCM_TARGET("avx2") void StereoToMonoAvx2(const float* in, float* out, size_t frames) {
+  const __m256 half = _mm256_set1_ps(0.5f);
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    __m256 a = _mm256_loadu_ps(in + i * 2);
+    __m256 b = _mm256_loadu_ps(in + i * 2 + 8);
+    // Per lane: L0 L1 L4 L5 | L2 L3 L6 L7, then reorder the 64-bit pairs
+    __m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    __m256 sum = _mm256_mul_ps(_mm256_add_ps(left, right), half);
+    sum = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(out + i, sum);
+  }
+  StereoToMonoSse2(in + i * 2, out + i, frames - i);
+}
+
+PCM_TARGET("avx2") void ApplyGainAvx2(float* data, size_t count, float gain) {
+  const __m256 g = _mm256_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+  }
+  ApplyGainSse2(data + i, count - i, gain);
+}
+
+PCM_TARGET("avx2") void MixAvx2(const float* in, float* out, size_t count, float gain) {
+  const __m256 g = _mm256_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), g)));
+  }
+  MixSse2(in + i, out + i, count - i, gain);
+}
+
+PCM_TARGET("avx2") void MixStereoAvx2(const float* in, float* out, size_t frames, float left,
+                                                   float right) {
+  const __m256 g = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    _mm256_storeu_ps(out + i * 2,
+                     _mm256_add_ps(_mm256_loadu_ps(out + i * 2), _mm256_mul_ps(_mm256_loadu_ps(in + i * 2), g)));
+  }
+  MixStereoSse2(in + i * 2, out + i * 2, frames - i, left, right);
+}
+
+const ConvertKernels kAvx2Kernels = {
+    "avx2", S16ToF32Avx2, F32ToS16Avx2, MonoToStereoAvx2, StereoToMonoAvx2, ApplyGainAvx2,
+    MixAvx2, MixStereoAvx2,
+};
+
+#endif  // PCM_CONVERT_X86
+
+#if PCM_CONVERT_NEON
+
+// === NEON ===
+
+void S16ToF32Neon(const int16_t* in, float* out, size_t count) {
+  const float32x4_t scale = vdupq_n_f32(1.0f / kS16Scale);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t s = vld1q_s16(in + i);
+    vst1q_f32(out + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+    vst1q_f32(out + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+  }
+  S16ToF32Scalar(in + i, out + i, count - i);
+}
+
+void F32ToS16Neon(const float* in, int16_t* out, size_t count) {
+  const float32x4_t scale = vdupq_n_f32(kS16Scale);
+  const float32x4_t min = vdupq_n_f32(-kS16Scale);
+  const float32x4_t max = vdupq_n_f32(kS16Max);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    float32x4_t a = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(in + i), scale), min), max);
+    float32x4_t b = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(in + i + 4), scale), min), max);
+    // vcvtnq rounds to nearest even, matching lrintf
+    int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+    vst1q_s16(out + i, packed);
+  }
+  F32ToS16Scalar(in + i, out + i, count - i);
+}
+
+void MonoToStereoNeon(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    float32x4_t m = vld1q_f32(in + i);
+    float32x4x2_t lr = {{m, m}};
+    vst2q_f32(out + i * 2, lr);
+  }
+  MonoToStereoScalar(in + i, out + i * 2, frames - i);
+}
+
+void StereoToMonoNeon(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    float32x4x2_t lr = vld2q_f32(in + i * 2);
+    vst1q_f32(out + i, vmulq_n_f32(vaddq_f32(lr.val[0], lr.val[1]), 0.5f));
+  }
+  StereoToMonoScalar(in + i * 2, out + i, frames - i);
+}
+
+void ApplyGainNeon(float* data, size_t count, float gain) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(data + i, vmulq_n_f32(vld1q_f32(data + i), gain));
+  }
+  ApplyGainScalar(data + i, count - i, gain);
+}
+
+void MixNeon(const float* in, float* out, size_t count, float gain) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_n_f32(vld1q_f32(in + i), gain)));
+  }
+  MixScalar(in + i, out + i, count - i, gain);
+}
+
+void MixStereoNeon(const float* in, float* out, size_t frames, float left, float right) {
+  const float lr[4] = {left, right, left, right};
+  const float32x4_t g = vld1q_f32(lr);
+  size_t i = 0;
+  for (; i + 2 <= frames; i += 2) {
+    vst1q_f32(out + i * 2, vaddq_f32(vld1q_f32(out + i * 2), vmulq_f32(vld1q_f32(in + i * 2), g)));
+  }
+  MixStereoScalar(in + i * 2, out + i * 2, frames - i, left, right);
+}
+
+const ConvertKernels kNeonKernels = {
+    "neon", S16ToF32Neon, F32ToS16Neon, MonoToStereoNeon, StereoToMonoNeon, ApplyGainNeon,
+    MixNeon, MixStereoNeon,
+};
+
+#endif  // PCM_CONVERT_NEON
+
+#if PCM_CONVERT_X86
+bool CpuSupports(SimdLevel level) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 1);
+  if (level == SimdLevel::kSse2) {
+    return (info[3] & (1 << 26)) != 0;
+  }
+  // AVX2 also needs the OS to save YMM state (OSXSAVE + XCR0 bits 1, 2)
+  bool os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+  __cpuidex(info, 7, 0);
+  return os_avx && (info[1] & (1 << 5)) != 0;
+#else
+  return level == SimdLevel::kSse2 ? __builtin_cpu_supports("sse2") : __builtin_cpu_supports("avx2");
+#endif
+}
+#endif  // PCM_CONVERT_X86
+
+const ConvertKernels& SelectKernels() {
+  const ConvertKernels* best = &kScalarKernels;
+  for (SimdLevel level : {SimdLevel::kSse2, SimdLevel::kNeon, SimdLevel::kAvx2}) {
+    if (const ConvertKernels* kernels = GetConvertKernels(level)) {
+      best = kernels;
+    }
+  }
+  return *best;
+}
+
+}  // namespace
+
+size_t BytesPerSample(SampleFormat format) {
+  return format == SampleFormat::kS16 ? 2 : 4;
+}
+
+const ConvertKernels* GetConvertKernels(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::kScalar:
+      return &kScalarKernels;
+#if PCM_CONVERT_X86
+    case SimdLevel::kSse2:
+      return CpuSupports(SimdLevel::kSse2) ? &kSse2Kernels : nullptr;
+    case SimdLevel::kAvx2:
+      return CpuSupports(SimdLevel::kAvx2) ? &kAvx2Kernels : nullptr;
+#endif
+#if PCM_CONVERT_NEON
+    case SimdLevel::kNeon:
+      return &kNeonKernels;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+const ConvertKernels& Kernels() {
+  static const ConvertKernels& kernels = SelectKernels();
+  return kernels;
+}
+
+void ToFloat(SampleFormat format, const void* in, float* out, size_t count) {
+  switch (format) {
+    case SampleFormat::kS16:
+      Kernels().s16_to_f32(static_cast<const int16_t*>(in), out, count);
+      break;
+    case SampleFormat::kS24: {
+      const int32_t* s = static_cast<const int32_t*>(in);
+      for (size_t i = 0; i < count; i++) {
+        // Sign-extend from bit 23, ignoring whatever is in the top byte
+        int32_t v = static_cast<int32_t>(static_cast<uint32_t>(s[i]) << 8) >> 8;
+        out[i] = v * (1.0f / 8388608.0f);
+      }
+      break;
+    }
+    case SampleFormat::kS32: {
+      const int32_t* s = static_cast<const int32_t*>(in);
+      for (size_t i = 0; i < count; i++) {
+        out[i] = s[i] * (1.0f / 2147483648.0f);
+      }
+      break;
+    }
+    case SampleFormat::kF32:
+      memcpy(out, in, count * sizeof(float));
+      break;
+  }
+}
+
+void FromFloat(SampleFormat format, const float* in, void* out, size_t count) {
+  switch (format) {
+    case SampleFormat::kS16:
+      Kernels().f32_to_s16(in, static_cast<int16_t*>(out), count);
+      break;
+    case SampleFormat::kS24: {
+      int32_t* d = static_cast<int32_t*>(out);
+      for (size_t i = 0; i < count; i++) {
+        float v = std::min(std::max(in[i] * 8388608.0f, -8388608.0f), 8388607.0f);
+        d[i] = static_cast<int32_t>(lrintf(v));
+      }
+      break;
+    }
+    case SampleFormat::kS32: {
+      int32_t* d = static_cast<int32_t*>(out);
+      for (size_t i = 0; i < count; i++) {
+        // Float can't represent INT32_MAX, so clamp in double
+        double v = std::min(std::max(in[i] * 2147483648.0, -2147483648.0), 2147483647.0);
+        d[i] = static_cast<int32_t>(llrint(v));
+      }
+      break;
+    }
+    case SampleFormat::kF32:
+      memcpy(out, in, count * sizeof(float));
+      break;
+  }
+}
+
+bool RemapChannels(const float* in, int in_channels, float* out, int out_channels, size_t frames) {
+  if (in_channels == out_channels) {
+    memcpy(out, in, frames * in_channels * sizeof(float));
+  } else if (in_channels == 1 && out_channels == 2) {
+    Kernels().mono_to_stereo(in, out, frames);
+  } else if (in_channels == 2 && out_channels == 1) {
+    Kernels().stereo_to_mono(in, out, frames);
+  } else if (in_channels <= 2 && out_channels > 2) {
+    // Onto the front pair of a surround layout; the rest stays silent
+    for (size_t i = 0; i < frames; i++) {
+      float* frame = out + i * out_channels;
+      frame[0] = in[i * in_channels];
+      frame[1] = in[i * in_channels + in_channels - 1];
+      std::fill(frame + 2, frame + out_channels, 0.0f);
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,54 @@
+#ifndef FLUTTER_PLUGIN_PCM_CONVERT_H_
+#define FLUTTER_PLUGIN_PCM_CONVERT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flutter_pcm_sound {
+
+// Interleaved little-endian sample layouts. kS24 is 24-bit audio in the
+// low bits of a 32-bit container.
+enum class SampleFormat { kS16, kS24, kS32, kF32 };
+
+size_t BytesPerSample(SampleFormat format);
+
+// Instruction sets a kernel table can be built for.
+enum class SimdLevel { kScalar, kSse2, kAvx2, kNeon };
+
+// Hot-path conversion kernels. Counts are in samples, except for the
+// channel mixers and mix_stereo, which take frames. Input and output must
+// not overlap, except for apply_gain, which works in place.
+struct ConvertKernels {
+  const char* name;
+  void (*s16_to_f32)(const int16_t* in, float* out, size_t count);
+  // Clamps to [-1, 1) and rounds to nearest.
+  void (*f32_to_s16)(const float* in, int16_t* out, size_t count);
+  void (*mono_to_stereo)(const float* in, float* out, size_t frames);
+  // Averages left and right.
+  void (*stereo_to_mono)(const float* in, float* out, size_t frames);
+  void (*apply_gain)(float* data, size_t count, float gain);
+  // out += in * gain
+  void (*mix)(const float* in, float* out, size_t count, float gain);
+  // Like mix, for interleaved stereo with separate left and right gains.
+  void (*mix_stereo)(const float* in, float* out, size_t frames, float left, float right);
+};
+
+// Returns the kernels for `level`, or nullptr when this build or CPU
+// can't run them.
+const ConvertKernels* GetConvertKernels(SimdLevel level);
+
+// The fastest kernels this CPU supports, picked once on first use.
+const ConvertKernels& Kernels();
+
+// Converts `count` samples of `format` to float, and back.
+void ToFloat(SampleFormat format, const void* in, float* out, size_t count);
+void FromFloat(SampleFormat format, const float* in, void* out, size_t count);
+
+// Maps `frames` frames between channel counts. Supports identical counts,
+// mono <-> stereo, and mono or stereo onto the front left/right pair of a
+// layout with more channels. Returns false otherwise.
+bool RemapChannels(const float* in, int in_channels, float* out, int out_channels, size_t frames);
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_CONVERT_H_
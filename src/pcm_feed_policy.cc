@@ -0,0 +1,201 @@
+#include "pcm_feed_policy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <errno.h>
+#include <semaphore.h>
+#include <time.h>
+#endif
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// Posting never takes a lock: a futex on Linux and Android, a Mach
+// semaphore under dispatch on Apple, a kernel semaphore on Windows.
+#if defined(_WIN32)
+
+void* NewSemaphore() {
+  return CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr);
+}
+
+void DeleteSemaphore(void* semaphore) {
+  CloseHandle(semaphore);
+}
+
+void PostSemaphore(void* semaphore) {
+  ReleaseSemaphore(semaphore, 1, nullptr);
+}
+
+bool WaitSemaphore(void* semaphore, int64_t timeout_ns) {
+  int64_t ms = std::min<int64_t>((timeout_ns + 999999) / 1000000, INFINITE - 1);
+  return WaitForSingleObject(semaphore, static_cast<DWORD>(ms)) == WAIT_OBJECT_0;
+}
+
+#elif defined(__APPLE__)
+
+void* NewSemaphore() {
+  return dispatch_semaphore_create(0);
+}
+
+void DeleteSemaphore(void* semaphore) {
+  dispatch_release(static_cast<dispatch_semaphore_t>(semaphore));
+}
+
+void PostSemaphore(void* semaphore) {
+  dispatch_semaphore_signal(static_cast<dispatch_semaphore_t>(semaphore));
+}
+
+bool WaitSemaphore(void* semaphore, int64_t timeout_ns) {
+  return dispatch_semaphore_wait(static_cast<dispatch_semaphore_t>(semaphore),
+                                 dispatch_time(DISPATCH_TIME_NOW, timeout_ns)) == 0;
+}
+
+#else
+
+void* NewSemaphore() {
+  sem_t* semaphore = new sem_t;
+  sem_init(semaphore, 0, 0);
+  return semaphore;
+}
+
+void DeleteSemaphore(void* semaphore) {
+  sem_destroy(static_cast<sem_t*>(semaphore));
+  delete static_cast<sem_t*>(semaphore);
+}
+
+void PostSemaphore(void* semaphore) {
+  sem_post(static_cast<sem_t*>(semaphore));
+}
+
+// sem_timedwait only takes a CLOCK_REALTIME deadline. Block bounds the
+// whole wait on the steady clock, so a clock change costs one early or
+// late wake at most.
+bool WaitSemaphore(void* semaphore, int64_t timeout_ns) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  int64_t ns = deadline.tv_nsec + timeout_ns;
+  deadline.tv_sec += ns / 1000000000;
+  deadline.tv_nsec = ns % 1000000000;
+  while (sem_timedwait(static_cast<sem_t*>(semaphore), &deadline) != 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
+
+size_t WriteFrames(RingBuffer& queue, const uint8_t* data, size_t length, size_t bytes_per_frame) {
+  size_t writable = queue.WritableBytes() / bytes_per_frame * bytes_per_frame;
+  return queue.Write(data, std::min(length, writable));
+}
+
+}  // namespace
+
+bool ParseFeedPolicy(const char* name, FeedPolicy* policy) {
+  if (name == nullptr || strcmp(name, "partial") == 0) {
+    *policy = FeedPolicy::kPartial;
+  } else if (strcmp(name, "reject") == 0) {
+    *policy = FeedPolicy::kReject;
+  } else if (strcmp(name, "block") == 0) {
+    *policy = FeedPolicy::kBlock;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* FeedPolicyName(FeedPolicy policy) {
+  switch (policy) {
+    case FeedPolicy::kReject:
+      return "reject";
+    case FeedPolicy::kBlock:
+      return "block";
+    case FeedPolicy::kPartial:
+      break;
+  }
+  return "partial";
+}
+
+size_t QueueBytesFor(int64_t max_queue_us, int sample_rate, size_t bytes_per_frame) {
+  if (max_queue_us <= 0) {
+    max_queue_us = kDefaultMaxQueueMicros;
+  }
+  uint64_t frames = static_cast<uint64_t>(max_queue_us) * sample_rate / 1000000;
+  return std::max<uint64_t>(frames, 1) * bytes_per_frame;
+}
+
+size_t FeedQueue(RingBuffer& queue, const uint8_t* data, size_t length, size_t bytes_per_frame, FeedPolicy policy) {
+  length = length / bytes_per_frame * bytes_per_frame;
+  if (policy == FeedPolicy::kReject && queue.WritableBytes() < length) {
+    return 0;
+  }
+  return WriteFrames(queue, data, length, bytes_per_frame);
+}
+
+FeedWaiter::FeedWaiter() : semaphore_(NewSemaphore()) {}
+
+FeedWaiter::~FeedWaiter() {
+  DeleteSemaphore(semaphore_);
+}
+
+size_t FeedWaiter::Block(std::unique_lock<std::mutex>& lock, size_t length, int64_t timeout_ns,
+                         const Attempt& attempt) {
+  // Registered before the first attempt: a consumer that makes room after
+  // an attempt found none then sees the waiter and posts, and the post
+  // keeps until the wait below takes it.
+  waiters_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const uint64_t cancels = cancels_.load(std::memory_order_relaxed);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeout_ns);
+  size_t written = 0;
+  while (attempt(&written) && written < length) {
+    int64_t left =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+    if (left <= 0) {
+      break;
+    }
+    lock.unlock();
+    bool woken = WaitSemaphore(semaphore_, left);
+    lock.lock();
+    if (!woken || cancels_.load(std::memory_order_relaxed) != cancels) {
+      break;
+    }
+  }
+
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+  return written;
+}
+
+void FeedWaiter::Notify() {
+  // Pairs with the fence in Block: either it sees this waiter, or the
+  // waiter's next attempt sees the room
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  Wake();
+}
+
+void FeedWaiter::Cancel() {
+  cancels_.fetch_add(1, std::memory_order_relaxed);
+  // Likewise: either a new waiter sees this cancel, or it is posted
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  Wake();
+}
+
+void FeedWaiter::Wake() {
+  for (int waiters = waiters_.load(std::memory_order_relaxed); waiters > 0; waiters--) {
+    PostSemaphore(semaphore_);
+  }
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,87 @@
+#ifndef FLUTTER_PLUGIN_PCM_FEED_POLICY_H_
+#define FLUTTER_PLUGIN_PCM_FEED_POLICY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "pcm_ring_buffer.h"
+
+namespace flutter_pcm_sound {
+
+// What feed does with samples that don't fit in the sample queue, which is
+// allocated once by setup and never grows.
+enum class FeedPolicy {
+  kPartial,  // queue the frames that fit and drop the rest
+  kReject,   // queue all of the frames or none of them
+  kBlock,    // wait for the playback thread to make room, then as kPartial.
+             // Only feeds off the platform thread wait; see FeedWaiter.
+};
+
+// How much the sample queue holds unless setup says otherwise
+constexpr int64_t kDefaultMaxQueueMicros = 10000000;
+
+// The setup names: "partial", "reject" and "block". Null is kPartial.
+// Returns false for anything else.
+bool ParseFeedPolicy(const char* name, FeedPolicy* policy);
+const char* FeedPolicyName(FeedPolicy policy);
+
+// Bytes of sample queue for `max_queue_us` of audio, in whole frames, and
+// at least one frame. Non-positive durations mean the default.
+size_t QueueBytesFor(int64_t max_queue_us, int sample_rate, size_t bytes_per_frame);
+
+// Producer side. Queues whole frames of `data` into `queue` under `policy`
+// and returns how many bytes it took. It never waits: kBlock takes what
+// fits now, as kPartial, and FeedWaiter waits for the rest.
+size_t FeedQueue(RingBuffer& queue, const uint8_t* data, size_t length, size_t bytes_per_frame, FeedPolicy policy);
+
+// Lets a kBlock feed sleep until the playback thread makes room, without
+// polling and without holding the lock that serializes it with the other
+// calls, so pause, flush and release never wait behind it.
+//
+// The consumer calls Notify after taking samples out, from the audio
+// thread itself: it costs a fence and a load unless a feed is waiting, and
+// then only posts a semaphore, which takes no lock and never allocates.
+// Pause, flush, release and setup call Cancel, which ends every wait in
+// progress.
+class FeedWaiter {
+ public:
+  // Queues more of the feed and adds the bytes it took to `written`.
+  // Returns false when waiting for room is pointless: nothing is draining
+  // the queue, or it has gone.
+  using Attempt = std::function<bool(size_t* written)>;
+
+  FeedWaiter();
+  ~FeedWaiter();
+
+  FeedWaiter(const FeedWaiter&) = delete;
+  FeedWaiter& operator=(const FeedWaiter&) = delete;
+
+  // Feeder. Calls `attempt`, with `lock` held, until `length` bytes (whole
+  // frames) are written, `attempt` returns false, Cancel is called or
+  // `timeout_ns` is up. Between attempts it sleeps until Notify with `lock`
+  // released. Returns the bytes written.
+  size_t Block(std::unique_lock<std::mutex>& lock, size_t length, int64_t timeout_ns, const Attempt& attempt);
+
+  // Consumer side, real-time safe. There may be room now.
+  void Notify();
+
+  // Any thread. Blocked feeds return what they have written so far.
+  void Cancel();
+
+ private:
+  // Posts the semaphore once for every feed waiting
+  void Wake();
+
+  // The platform's counting semaphore. Extra posts only cost a waiter an
+  // early attempt.
+  void* semaphore_ = nullptr;
+  std::atomic<uint64_t> cancels_{0};
+  std::atomic<int> waiters_{0};
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_FEED_POLICY_H_
@@ -0,0 +1,124 @@
+#include "pcm_file_player.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// Frames read from the source per pass
+constexpr size_t kChunkFrames = 2048;
+
+// How long to wait before offering the queue more once it's full. The
+// queue holds seconds of audio, so this only needs to beat draining it.
+constexpr std::chrono::milliseconds kRetryInterval(5);
+
+}  // namespace
+
+FilePlayer::FilePlayer(Writer writer, DoneCallback on_done)
+    : writer_(std::move(writer)), on_done_(std::move(on_done)) {}
+
+FilePlayer::~FilePlayer() {
+  Stop();
+}
+
+bool FilePlayer::Start(std::unique_ptr<PcmSource> source, int sample_rate, int channels, SampleFormat format,
+                       ResampleQuality quality, std::string* error) {
+  Stop();
+  const SourceInfo& info = source->info();
+  // RemapChannels says what it supports; try it on a single frame
+  std::vector<float> probe_in(info.channels, 0.0f);
+  std::vector<float> probe_out(channels, 0.0f);
+  if (!RemapChannels(probe_in.data(), info.channels, probe_out.data(), channels, 1)) {
+    *error = "can't play a " + std::to_string(info.channels) + " channel file on a " + std::to_string(channels) +
+             " channel stream";
+    return false;
+  }
+
+  source_ = std::move(source);
+  channels_ = channels;
+  format_ = format;
+  resampling_ = info.sample_rate != sample_rate;
+  size_t out_frames = kChunkFrames;
+  if (resampling_) {
+    if (!resampler_.Configure(info.sample_rate, sample_rate, info.channels, quality, kChunkFrames)) {
+      source_.reset();
+      *error = "can't resample a " + std::to_string(info.sample_rate) + " Hz file to " + std::to_string(sample_rate) +
+               " Hz";
+      return false;
+    }
+    out_frames = resampler_.MaxOutputFrames(kChunkFrames);
+    resampled_.assign(out_frames * info.channels, 0.0f);
+  }
+  decoded_.assign(kChunkFrames * info.channels, 0.0f);
+  remapped_.assign(out_frames * channels, 0.0f);
+  converted_.assign(out_frames * channels * BytesPerSample(format), 0);
+
+  stop_ = false;
+  playing_ = true;
+  thread_ = std::thread(&FilePlayer::Run, this);
+  return true;
+}
+
+void FilePlayer::Stop() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+  }
+  source_.reset();
+  playing_ = false;
+}
+
+void FilePlayer::Run() {
+  const int source_channels = source_->info().channels;
+  bool draining = false;
+  while (true) {
+    size_t frames = source_->Read(decoded_.data(), kChunkFrames);
+    if (frames == 0) {
+      // The resampler still holds the last few frames; push silence
+      // through to get them out
+      if (!resampling_ || draining || !source_->error().empty()) {
+        break;
+      }
+      draining = true;
+      frames = std::min(resampler_.latency_frames(), kChunkFrames);
+      std::fill(decoded_.begin(), decoded_.begin() + frames * source_channels, 0.0f);
+    }
+    const float* in = decoded_.data();
+    if (resampling_) {
+      frames = resampler_.Process(in, frames, resampled_.data());
+      in = resampled_.data();
+    }
+    RemapChannels(in, source_channels, remapped_.data(), channels_, frames);
+    FromFloat(format_, remapped_.data(), converted_.data(), frames * channels_);
+    if (!WriteAll(converted_.data(), frames * channels_ * BytesPerSample(format_))) {
+      return;  // stopped
+    }
+  }
+  std::string error = source_->error();
+  playing_ = false;
+  on_done_(error);
+}
+
+bool FilePlayer::WriteAll(const uint8_t* data, size_t length) {
+  while (true) {
+    size_t written = writer_(data, length);
+    data += written;
+    length -= written;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stop_) {
+      return false;
+    }
+    if (length == 0) {
+      return true;
+    }
+    wake_.wait_for(lock, kRetryInterval, [this] { return stop_; });
+  }
+}
+
+}  // namespace flutter_pcm_sound
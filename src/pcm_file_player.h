@@ -0,0 +1,87 @@
+#ifndef FLUTTER_PLUGIN_PCM_FILE_PLAYER_H_
+#define FLUTTER_PLUGIN_PCM_FILE_PLAYER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pcm_convert.h"
+#include "pcm_file_source.h"
+#include "pcm_resampler.h"
+
+namespace flutter_pcm_sound {
+
+// Feeds a PcmSource into the sample queue from a background thread, so
+// file playback never crosses the method channel.
+//
+// Samples are converted to the format, channel count and rate passed to
+// setup and handed to the writer, which queues what fits. When the queue
+// is full the thread sleeps briefly and offers the rest again, so it stays
+// as far ahead of the device as the queue allows and no further.
+//
+// Start, Stop and the destructor are called from one thread (the platform
+// thread).
+class FilePlayer {
+ public:
+  // Queues `length` bytes of whole frames and returns how many it took.
+  // Called on the file thread. It must not wait on anything Stop's caller
+  // may hold: take the platform's lock with a try-lock and return 0 when
+  // it is busy.
+  using Writer = std::function<size_t(const uint8_t* data, size_t length)>;
+  // Called on the file thread once the whole source is queued, or reading
+  // it failed, with `error` empty on success. Not called when stopped.
+  using DoneCallback = std::function<void(const std::string& error)>;
+
+  FilePlayer(Writer writer, DoneCallback on_done);
+  ~FilePlayer();
+
+  FilePlayer(const FilePlayer&) = delete;
+  FilePlayer& operator=(const FilePlayer&) = delete;
+
+  // Stops whatever was playing and starts queueing `source`. Returns false
+  // with `error` set when its channel layout can't be mapped.
+  bool Start(std::unique_ptr<PcmSource> source, int sample_rate, int channels, SampleFormat format,
+             ResampleQuality quality, std::string* error);
+
+  // Stops queueing and waits for the file thread. What is already queued
+  // still plays; flush drops it.
+  void Stop();
+
+  // True from Start until the source is fully queued, fails or is stopped
+  bool playing() const { return playing_; }
+
+ private:
+  void Run();
+  // Offers `length` bytes to the writer until it took them all, or Stop
+  bool WriteAll(const uint8_t* data, size_t length);
+
+  Writer writer_;
+  DoneCallback on_done_;
+
+  std::unique_ptr<PcmSource> source_;
+  int channels_ = 0;
+  SampleFormat format_ = SampleFormat::kS16;
+  Resampler resampler_;
+  bool resampling_ = false;
+  std::vector<float> decoded_;
+  std::vector<float> resampled_;
+  std::vector<float> remapped_;
+  std::vector<uint8_t> converted_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  std::atomic<bool> playing_{false};
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_FILE_PLAYER_H_
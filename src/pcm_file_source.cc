@@ -0,0 +1,350 @@
+#include "pcm_file_source.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// Sample layouts found in files, beyond the ones `feed` takes
+enum class FileEncoding { kU8, kS16, kS24Packed, kS24, kS32, kF32 };
+
+size_t BytesPerFileSample(FileEncoding encoding) {
+  switch (encoding) {
+    case FileEncoding::kU8: return 1;
+    case FileEncoding::kS16: return 2;
+    case FileEncoding::kS24Packed: return 3;
+    default: return 4;
+  }
+}
+
+uint16_t Le16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t Le32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+constexpr uint16_t kWaveFormatPcm = 1;
+constexpr uint16_t kWaveFormatFloat = 3;
+constexpr uint16_t kWaveFormatExtensible = 0xFFFE;
+
+// Frames converted per pass when samples have to be copied out of the
+// mapping first
+constexpr size_t kScratchFrames = 1024;
+
+// Reads samples straight out of a mapped file
+class MappedSource : public PcmSource {
+ public:
+  MappedSource(std::unique_ptr<MappedFile> file, const uint8_t* samples, size_t frames, FileEncoding encoding,
+               int sample_rate, int channels)
+      : file_(std::move(file)), samples_(samples), frames_(frames), encoding_(encoding),
+        frame_bytes_(BytesPerFileSample(encoding) * channels) {
+    info_.sample_rate = sample_rate;
+    info_.channels = channels;
+    info_.frames = static_cast<int64_t>(frames);
+  }
+
+  size_t Read(float* out, size_t frames) override {
+    frames = std::min(frames, frames_ - position_);
+    const uint8_t* in = samples_ + position_ * frame_bytes_;
+    size_t count = frames * info_.channels;
+    switch (encoding_) {
+      case FileEncoding::kU8:
+        for (size_t i = 0; i < count; i++) {
+          out[i] = (static_cast<int>(in[i]) - 128) * (1.0f / 128.0f);
+        }
+        break;
+      case FileEncoding::kS24Packed:
+        for (size_t i = 0; i < count; i++, in += 3) {
+          int32_t v = static_cast<int32_t>((static_cast<uint32_t>(in[0]) << 8) | (static_cast<uint32_t>(in[1]) << 16) |
+                                           (static_cast<uint32_t>(in[2]) << 24)) >>
+                      8;
+          out[i] = v * (1.0f / 8388608.0f);
+        }
+        break;
+      default:
+        Convert(in, out, frames);
+        break;
+    }
+    position_ += frames;
+    return frames;
+  }
+
+ private:
+  SampleFormat Format() const {
+    switch (encoding_) {
+      case FileEncoding::kS16: return SampleFormat::kS16;
+      case FileEncoding::kS24: return SampleFormat::kS24;
+      case FileEncoding::kS32: return SampleFormat::kS32;
+      default: return SampleFormat::kF32;
+    }
+  }
+
+  // The converters take aligned samples, which chunk padding in a WAV
+  // file doesn't guarantee past 16 bits
+  void Convert(const uint8_t* in, float* out, size_t frames) {
+    size_t sample_bytes = BytesPerFileSample(encoding_);
+    size_t channels = info_.channels;
+    if (reinterpret_cast<uintptr_t>(in) % sample_bytes == 0) {
+      ToFloat(Format(), in, out, frames * channels);
+      return;
+    }
+    scratch_.resize(kScratchFrames * frame_bytes_ / sizeof(uint32_t) + 1);
+    while (frames > 0) {
+      size_t piece = std::min(frames, kScratchFrames);
+      memcpy(scratch_.data(), in, piece * frame_bytes_);
+      ToFloat(Format(), scratch_.data(), out, piece * channels);
+      in += piece * frame_bytes_;
+      out += piece * channels;
+      frames -= piece;
+    }
+  }
+
+  std::unique_ptr<MappedFile> file_;
+  const uint8_t* samples_;
+  size_t frames_;
+  size_t position_ = 0;
+  FileEncoding encoding_;
+  size_t frame_bytes_;
+  std::vector<uint32_t> scratch_;
+};
+
+}  // namespace
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path, std::string* error) {
+  Close();
+  int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  std::wstring wide(length > 0 ? length - 1 : 0, L'\0');
+  if (length > 0) {
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+  }
+  HANDLE file = CreateFileW(wide.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    *error = "can't open " + path + " (error " + std::to_string(GetLastError()) + ")";
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    *error = "can't read the size of " + path;
+    CloseHandle(file);
+    return false;
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return true;
+  }
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping) {
+    *error = "can't map " + path + " (error " + std::to_string(GetLastError()) + ")";
+    return false;
+  }
+  // The view keeps the mapping alive once its handle is closed
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!view) {
+    *error = "can't map " + path + " (error " + std::to_string(GetLastError()) + ")";
+    return false;
+  }
+  map_ = view;
+  map_size_ = static_cast<size_t>(size.QuadPart);
+  data_ = static_cast<const uint8_t*>(view);
+  size_ = map_size_;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (map_) {
+    UnmapViewOfFile(map_);
+  }
+  map_ = nullptr;
+  map_size_ = 0;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path, std::string* error) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = "can't open " + path + ": " + strerror(errno);
+    return false;
+  }
+  bool opened = OpenFd(fd, 0, -1, error);
+  close(fd);
+  if (!opened) {
+    *error = path + ": " + *error;
+  }
+  return opened;
+}
+
+bool MappedFile::OpenFd(int fd, int64_t offset, int64_t length, std::string* error) {
+  Close();
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    *error = std::string("fstat failed: ") + strerror(errno);
+    return false;
+  }
+  if (offset < 0 || offset > st.st_size) {
+    *error = "offset is past the end of the file";
+    return false;
+  }
+  if (length < 0 || offset + length > st.st_size) {
+    length = st.st_size - offset;
+  }
+  if (length == 0) {
+    return true;
+  }
+
+  // mmap wants a page-aligned offset; map from the page holding `offset`
+  int64_t page = sysconf(_SC_PAGESIZE);
+  int64_t start = offset / page * page;
+  size_t map_size = static_cast<size_t>(offset - start + length);
+  void* map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(start));
+  if (map == MAP_FAILED) {
+    *error = std::string("mmap failed: ") + strerror(errno);
+    return false;
+  }
+  // Read front to back once; let the kernel read ahead and drop pages behind
+  madvise(map, map_size, MADV_SEQUENTIAL);
+  map_ = map;
+  map_size_ = map_size;
+  data_ = static_cast<const uint8_t*>(map) + (offset - start);
+  size_ = static_cast<size_t>(length);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+  map_ = nullptr;
+  map_size_ = 0;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif
+
+bool IsWav(const uint8_t* data, size_t size) {
+  return size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0;
+}
+
+std::unique_ptr<PcmSource> OpenWavSource(std::unique_ptr<MappedFile> file, std::string* error) {
+  const uint8_t* data = file->data();
+  size_t size = file->size();
+  if (!IsWav(data, size)) {
+    *error = "not a WAV file";
+    return nullptr;
+  }
+
+  // Walk the chunks for the format and the samples. Chunks are padded to
+  // an even length.
+  const uint8_t* fmt = nullptr;
+  size_t fmt_size = 0;
+  const uint8_t* samples = nullptr;
+  size_t samples_size = 0;
+  size_t offset = 12;
+  while (offset + 8 <= size && !samples) {
+    const uint8_t* chunk = data + offset;
+    size_t chunk_size = Le32(chunk + 4);
+    size_t available = size - offset - 8;
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      fmt = chunk + 8;
+      fmt_size = std::min(chunk_size, available);
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      // Streamed files leave the size at 0 or 0xFFFFFFFF; a truncated one
+      // plays what's there
+      samples = chunk + 8;
+      samples_size = chunk_size == 0 || chunk_size > available ? available : chunk_size;
+    }
+    if (chunk_size >= available) {
+      break;
+    }
+    offset += 8 + chunk_size + (chunk_size & 1);
+  }
+  if (!fmt || fmt_size < 16) {
+    *error = "WAV file has no fmt chunk";
+    return nullptr;
+  }
+  if (!samples) {
+    *error = "WAV file has no data chunk";
+    return nullptr;
+  }
+
+  uint16_t format = Le16(fmt);
+  int channels = Le16(fmt + 2);
+  int sample_rate = static_cast<int>(Le32(fmt + 4));
+  uint16_t block_align = Le16(fmt + 12);
+  uint16_t bits = Le16(fmt + 14);
+  if (format == kWaveFormatExtensible && fmt_size >= 40) {
+    // The subformat GUID starts with the plain format tag
+    format = Le16(fmt + 24);
+  }
+
+  FileEncoding encoding;
+  if (format == kWaveFormatPcm && bits == 8) {
+    encoding = FileEncoding::kU8;
+  } else if (format == kWaveFormatPcm && bits == 16) {
+    encoding = FileEncoding::kS16;
+  } else if (format == kWaveFormatPcm && bits == 24) {
+    encoding = FileEncoding::kS24Packed;
+  } else if (format == kWaveFormatPcm && bits == 32) {
+    // Also 24 valid bits in a 32-bit container, which WAV left-justifies
+    encoding = FileEncoding::kS32;
+  } else if (format == kWaveFormatFloat && bits == 32) {
+    encoding = FileEncoding::kF32;
+  } else {
+    *error = "unsupported WAV format " + std::to_string(format) + " with " + std::to_string(bits) + " bits";
+    return nullptr;
+  }
+  if (channels <= 0 || sample_rate <= 0 || block_align != BytesPerFileSample(encoding) * channels) {
+    *error = "malformed WAV fmt chunk";
+    return nullptr;
+  }
+
+  size_t frames = samples_size / block_align;
+  return std::make_unique<MappedSource>(std::move(file), samples, frames, encoding, sample_rate, channels);
+}
+
+std::unique_ptr<PcmSource> OpenRawSource(std::unique_ptr<MappedFile> file, SampleFormat format, int sample_rate,
+                                         int channels, std::string* error) {
+  if (sample_rate <= 0 || channels <= 0) {
+    *error = "raw files need a positive sample_rate and num_channels";
+    return nullptr;
+  }
+  FileEncoding encoding;
+  switch (format) {
+    case SampleFormat::kS16: encoding = FileEncoding::kS16; break;
+    case SampleFormat::kS24: encoding = FileEncoding::kS24; break;
+    case SampleFormat::kS32: encoding = FileEncoding::kS32; break;
+    default: encoding = FileEncoding::kF32; break;
+  }
+  const uint8_t* samples = file->data();
+  size_t frames = file->size() / (BytesPerSample(format) * channels);
+  return std::make_unique<MappedSource>(std::move(file), samples, frames, encoding, sample_rate, channels);
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,88 @@
+#ifndef FLUTTER_PLUGIN_PCM_FILE_SOURCE_H_
+#define FLUTTER_PLUGIN_PCM_FILE_SOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pcm_convert.h"
+
+namespace flutter_pcm_sound {
+
+// A read-only memory mapping of a whole file, or of part of one.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // `path` is UTF-8. On failure returns false with `error` set.
+  bool Open(const std::string& path, std::string* error);
+
+#ifndef _WIN32
+  // Maps `length` bytes of `fd` from `offset`, or everything after it when
+  // `length` is negative, as for an Android asset file descriptor. The fd
+  // can be closed once this returns.
+  bool OpenFd(int fd, int64_t offset, int64_t length, std::string* error);
+#endif
+
+  void Close();
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  // What to unmap: mappings start on a page boundary, before data_
+  void* map_ = nullptr;
+  size_t map_size_ = 0;
+};
+
+struct SourceInfo {
+  int sample_rate = 0;
+  int channels = 0;
+  // Total frames, or -1 when the source can't tell ahead of time
+  int64_t frames = -1;
+};
+
+// Audio decoded from a file, read as interleaved float frames at the
+// file's own rate and channel count.
+//
+// Sources are read from one thread at a time (the FilePlayer's).
+class PcmSource {
+ public:
+  virtual ~PcmSource() = default;
+
+  const SourceInfo& info() const { return info_; }
+
+  // Reads up to `frames` frames into `out` and returns how many. Returns 0
+  // at the end of the file, or on a decoding error, which sets error().
+  virtual size_t Read(float* out, size_t frames) = 0;
+
+  const std::string& error() const { return error_; }
+
+ protected:
+  SourceInfo info_;
+  std::string error_;
+};
+
+// Whether `data` starts like a RIFF WAVE file.
+bool IsWav(const uint8_t* data, size_t size);
+
+// Plays a RIFF WAVE file straight from its mapping: integer PCM of 8, 16,
+// 24 or 32 bits, or 32-bit float, including WAVE_FORMAT_EXTENSIBLE. Returns
+// null with `error` set for anything else.
+std::unique_ptr<PcmSource> OpenWavSource(std::unique_ptr<MappedFile> file, std::string* error);
+
+// Plays headerless samples in one of the formats `feed` takes.
+std::unique_ptr<PcmSource> OpenRawSource(std::unique_ptr<MappedFile> file, SampleFormat format, int sample_rate,
+                                         int channels, std::string* error);
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_FILE_SOURCE_H_
@@ -0,0 +1,185 @@
+#include "pcm_jitter_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+constexpr std::memory_order kRelaxed = std::memory_order_relaxed;
+
+// Each feed's weight in the delay histogram decays by this much per feed:
+// a few hundred feeds of memory
+constexpr double kDelayForgetting = 0.997;
+
+// The earliest a feed arrived is looked for over the last one to two of
+// these, so a lasting rise in delay is forgotten
+constexpr int64_t kBaseWindowNs = 2000000000;
+
+// Once correcting, the speed stays at least this far from 1 until the
+// depth is back within kStopBandMs of the target
+constexpr float kMinSpeedChange = 0.01f;
+constexpr int kStartBandMs = 20;
+constexpr int kStopBandMs = 10;
+
+}  // namespace
+
+bool JitterBuffer::Configure(SampleFormat format, int rate, int channels, size_t max_frames) {
+  if (rate <= 0 || channels <= 0 || max_frames == 0 || !stretcher_.Configure(rate, channels, max_frames)) {
+    return false;
+  }
+  format_ = format;
+  rate_ = rate;
+  channels_ = channels;
+  bytes_per_frame_ = BytesPerSample(format) * channels;
+  bytes_.assign(max_frames * bytes_per_frame_, 0);
+  samples_.assign(max_frames * channels, 0.0f);
+  Reset();
+  return true;
+}
+
+void JitterBuffer::SetLimits(size_t min_frames, size_t max_frames) {
+  min_frames_.store(min_frames, kRelaxed);
+  max_frames_.store(std::max(min_frames, max_frames), kRelaxed);
+}
+
+void JitterBuffer::Reset() {
+  clock_started_ = false;
+  clock_start_ns_ = 0;
+  clock_frames_ = 0;
+  window_start_ns_ = 0;
+  window_min_ns_ = 0;
+  previous_window_min_ns_ = 0;
+  std::fill(delays_, delays_ + kDelayBuckets, 0.0);
+  feed_frames_average_ = 0.0;
+  delay_frames_.store(0, kRelaxed);
+  feed_frames_.store(0, kRelaxed);
+
+  stretcher_.Reset();
+  stretcher_.set_speed(1.0f);
+  underrun_frames_ = 0.0;
+  correcting_ = false;
+  target_frames_.store(min_frames_.load(kRelaxed), kRelaxed);
+  speed_.store(1.0f, kRelaxed);
+}
+
+void JitterBuffer::RecordFeed(size_t frames, int64_t now_ns) {
+  if (frames == 0 || rate_ == 0) {
+    return;
+  }
+
+  // How much later than the stream clock says this feed arrived, and how
+  // much later than the earliest recent one
+  int64_t delay_ns = 0;
+  bool restart = !clock_started_;
+  if (clock_started_) {
+    const uint64_t clock_ns = clock_frames_ / rate_ * 1000000000 + clock_frames_ % rate_ * 1000000000 / rate_;
+    const int64_t offset_ns = now_ns - clock_start_ns_ - static_cast<int64_t>(clock_ns);
+    if (now_ns - window_start_ns_ >= kBaseWindowNs) {
+      previous_window_min_ns_ = window_min_ns_;
+      window_min_ns_ = offset_ns;
+      window_start_ns_ = now_ns;
+    } else {
+      window_min_ns_ = std::min(window_min_ns_, offset_ns);
+    }
+    delay_ns = offset_ns - std::min(window_min_ns_, previous_window_min_ns_);
+    // A gap longer than any depth kept is the stream stopping and
+    // starting again, not jitter
+    const int64_t max_ns = static_cast<int64_t>(max_frames_.load(kRelaxed) * 1000000000 / rate_);
+    restart = delay_ns > max_ns;
+  }
+
+  if (restart) {
+    clock_started_ = true;
+    clock_start_ns_ = now_ns;
+    clock_frames_ = 0;
+    window_start_ns_ = now_ns;
+    window_min_ns_ = 0;
+    previous_window_min_ns_ = 0;
+  } else {
+    int bucket = static_cast<int>(std::min<int64_t>(delay_ns / (kDelayBucketMs * 1000000), kDelayBuckets - 1));
+    double total = 0.0;
+    for (int i = 0; i < kDelayBuckets; i++) {
+      delays_[i] *= kDelayForgetting;
+      total += delays_[i];
+    }
+    delays_[bucket] += 1.0 - kDelayForgetting;
+    total += 1.0 - kDelayForgetting;
+
+    double seen = 0.0;
+    int quantile = 0;
+    while (quantile < kDelayBuckets - 1 && (seen += delays_[quantile]) < kDelayQuantile * total) {
+      quantile++;
+    }
+    const int64_t quantile_ns = static_cast<int64_t>(quantile + 1) * kDelayBucketMs * 1000000;
+    delay_frames_.store(static_cast<size_t>(quantile_ns * rate_ / 1000000000), kRelaxed);
+  }
+  clock_frames_ += frames;
+
+  feed_frames_average_ = feed_frames_average_ == 0.0 ? frames : feed_frames_average_ * 0.9 + frames * 0.1;
+  feed_frames_.store(static_cast<size_t>(feed_frames_average_), kRelaxed);
+}
+
+void JitterBuffer::RecordUnderrun() {
+  const double step = std::max<double>(target_frames() / 2, rate_ / 100);
+  underrun_frames_ = std::min(underrun_frames_ + step, static_cast<double>(max_frames_.load(kRelaxed)));
+}
+
+void JitterBuffer::Flush() {
+  stretcher_.Reset();
+  correcting_ = false;
+}
+
+size_t JitterBuffer::Read(RingBuffer& queue, float* out, size_t frames, bool drain, size_t* consumed_frames) {
+  // Top the stretcher up from the queue
+  size_t consumed = 0;
+  const size_t chunk_frames = samples_.size() / channels_;
+  for (;;) {
+    size_t want = std::min(stretcher_.WritableFrames(), chunk_frames);
+    size_t read = want == 0 ? 0 : queue.Read(bytes_.data(), want * bytes_per_frame_) / bytes_per_frame_;
+    if (read == 0) {
+      break;
+    }
+    ToFloat(format_, bytes_.data(), samples_.data(), read * channels_);
+    stretcher_.Write(samples_.data(), read);
+    consumed += read;
+  }
+  *consumed_frames = consumed;
+
+  size_t depth = queue.ReadableBytes() / bytes_per_frame_ + stretcher_.buffered_frames();
+  stretcher_.set_speed(UpdateSpeed(depth, frames));
+  return stretcher_.Read(out, frames, drain);
+}
+
+float JitterBuffer::UpdateSpeed(size_t depth, size_t frames) {
+  underrun_frames_ *= std::exp2(-static_cast<double>(frames) / (rate_ * kUnderrunHalfLifeSeconds));
+
+  const size_t lo = min_frames_.load(kRelaxed);
+  const size_t hi = std::max(max_frames_.load(kRelaxed), lo);
+  const double wanted = delay_frames_.load(kRelaxed) + feed_frames_.load(kRelaxed) + underrun_frames_;
+  const size_t target = std::min(std::max(static_cast<size_t>(wanted), lo), hi);
+  target_frames_.store(target, kRelaxed);
+
+  // Leave small errors alone, so the speed doesn't hunt, but once
+  // correcting carry on until the depth is close
+  const double error = static_cast<double>(depth) - static_cast<double>(target);
+  const double start_band = std::max<double>(target / 4, static_cast<double>(rate_) * kStartBandMs / 1000);
+  const double stop_band = static_cast<double>(rate_) * kStopBandMs / 1000;
+  if (!correcting_ && std::fabs(error) > start_band) {
+    correcting_ = true;
+  } else if (correcting_ && std::fabs(error) < stop_band) {
+    correcting_ = false;
+  }
+
+  float speed = 1.0f;
+  if (correcting_) {
+    float change = static_cast<float>(error / (rate_ * kCorrectionSeconds));
+    change = std::copysign(std::min(std::max(std::fabs(change), kMinSpeedChange), kMaxSpeedChange), change);
+    speed = 1.0f + change;
+  }
+  speed_.store(speed, kRelaxed);
+  return speed;
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,122 @@
+#ifndef FLUTTER_PLUGIN_PCM_JITTER_BUFFER_H_
+#define FLUTTER_PLUGIN_PCM_JITTER_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pcm_convert.h"
+#include "pcm_ring_buffer.h"
+#include "pcm_time_stretch.h"
+
+namespace flutter_pcm_sound {
+
+// Adaptive playout depth for a stream whose feeds arrive with jitter, say
+// from the network. It moves a target queue depth with how late feeds
+// arrive and how often the device ran dry, and plays the queue slightly
+// faster or slower through a TimeStretcher to keep it there.
+//
+// Lateness is measured against the stream's own clock: each feed should
+// arrive as much later than the first as the audio before it lasts. The
+// target covers kDelayQuantile of the recent delays past the earliest
+// one, plus a feed's worth, plus a margin that every underrun raises and
+// that halves every kUnderrunHalfLifeSeconds. It stays within SetLimits.
+//
+// Feeds are recorded on the platform thread and everything else runs on
+// the playback thread; the two share only atomics.
+class JitterBuffer {
+ public:
+  static constexpr int kDelayBuckets = 128;
+  static constexpr int kDelayBucketMs = 4;
+  static constexpr double kDelayQuantile = 0.95;
+  static constexpr double kUnderrunHalfLifeSeconds = 10.0;
+  // Most the playback speed moves away from 1, and how long a depth
+  // error takes to correct below that
+  static constexpr float kMaxSpeedChange = 0.05f;
+  static constexpr double kCorrectionSeconds = 2.0;
+
+  JitterBuffer() = default;
+
+  JitterBuffer(const JitterBuffer&) = delete;
+  JitterBuffer& operator=(const JitterBuffer&) = delete;
+
+  // Sizes the buffers for Reads of at most `max_frames` and forgets
+  // everything. Must not be called while the playback thread is running.
+  bool Configure(SampleFormat format, int rate, int channels, size_t max_frames);
+
+  // Any thread. The range the target depth is kept in, in frames.
+  void SetLimits(size_t min_frames, size_t max_frames);
+
+  // Forgets the feed and underrun history and what the stretcher holds.
+  // Must not be called while the playback thread is running.
+  void Reset();
+
+  // Platform thread. Called for every feed of the stream, with how many
+  // frames it queued.
+  void RecordFeed(size_t frames, int64_t now_ns);
+
+  // Playback thread. The device ran dry.
+  void RecordUnderrun();
+
+  // Playback thread. Drops what the stretcher holds, for a flush.
+  void Flush();
+
+  // Playback thread. Takes what it needs from `queue`, which holds the
+  // stream in the configured format, and writes up to `frames` float
+  // frames, played at the speed the depth calls for, to `out`. Returns
+  // how many, and sets `consumed_frames` to how many left the queue.
+  // Output waits for the stretcher's lookahead unless `drain` is set.
+  size_t Read(RingBuffer& queue, float* out, size_t frames, bool drain, size_t* consumed_frames);
+
+  // Playback thread. Frames taken from the queue but not played yet.
+  size_t buffered_frames() const { return stretcher_.buffered_frames(); }
+
+  // Any thread. The current target depth, and the speed last played at.
+  size_t target_frames() const { return target_frames_.load(std::memory_order_relaxed); }
+  float speed() const { return speed_.load(std::memory_order_relaxed); }
+
+ private:
+  // Playback thread. Moves the target and picks the speed for `depth`
+  // frames queued, `frames` frames after the last time.
+  float UpdateSpeed(size_t depth, size_t frames);
+
+  SampleFormat format_ = SampleFormat::kS16;
+  int rate_ = 0;
+  int channels_ = 0;
+  size_t bytes_per_frame_ = 0;
+
+  std::atomic<size_t> min_frames_{0};
+  std::atomic<size_t> max_frames_{0};
+
+  // Platform thread: the stream clock, the earliest arrivals in this and
+  // the last base window, and the delay histogram, whose weights decay
+  // with every feed
+  bool clock_started_ = false;
+  int64_t clock_start_ns_ = 0;
+  uint64_t clock_frames_ = 0;
+  int64_t window_start_ns_ = 0;
+  int64_t window_min_ns_ = 0;
+  int64_t previous_window_min_ns_ = 0;
+  double delays_[kDelayBuckets] = {};
+  double feed_frames_average_ = 0.0;
+
+  // Published by the platform thread for the playback thread
+  std::atomic<size_t> delay_frames_{0};
+  std::atomic<size_t> feed_frames_{0};
+
+  // Playback thread
+  TimeStretcher stretcher_;
+  double underrun_frames_ = 0.0;
+  bool correcting_ = false;
+  std::vector<uint8_t> bytes_;
+  std::vector<float> samples_;
+
+  // Published by the playback thread
+  std::atomic<size_t> target_frames_{0};
+  std::atomic<float> speed_{1.0f};
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_JITTER_BUFFER_H_
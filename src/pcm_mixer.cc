@@ -0,0 +1,196 @@
+#include "pcm_mixer.h"
+
+#include <algorithm>
+
+namespace flutter_pcm_sound {
+
+void Mixer::Configure(SampleFormat format, int channels, size_t queue_bytes, size_t max_frames) {
+  Clear();
+  format_ = format;
+  channels_ = channels;
+  bytes_per_frame_ = BytesPerSample(format) * channels;
+  queue_bytes_ = queue_bytes;
+  bytes_.assign(max_frames * bytes_per_frame_, 0);
+  samples_.assign(max_frames * channels, 0.0f);
+}
+
+void Mixer::Clear() {
+  for (Voice& voice : voices_) {
+    voice.state.store(kFree, std::memory_order_relaxed);
+    voice.queue.Clear();
+  }
+  for (ClipVoice& voice : clip_voices_) {
+    if (voice.state.load(std::memory_order_relaxed) != kFree) {
+      EndClip(voice);
+    }
+  }
+  clip_flushes_seen_ = clip_flushes_.load(std::memory_order_relaxed);
+}
+
+int64_t Mixer::AddVoice(float gain, float pan) {
+  for (Voice& voice : voices_) {
+    if (voice.state.load(std::memory_order_acquire) != kFree) {
+      continue;
+    }
+    // The playback thread doesn't touch free slots, so this is safe
+    if (!voice.queue.Reset(queue_bytes_)) {
+      return -1;
+    }
+    voice.gain.store(gain, std::memory_order_relaxed);
+    voice.pan.store(pan, std::memory_order_relaxed);
+    voice.flush_to.store(0, std::memory_order_relaxed);
+    voice.id = next_id_++;
+    voice.state.store(kActive, std::memory_order_release);
+    return voice.id;
+  }
+  return -1;
+}
+
+bool Mixer::RemoveVoice(int64_t id) {
+  Voice* voice = Find(id);
+  if (!voice) {
+    return false;
+  }
+  voice->state.store(kRemoving, std::memory_order_release);
+  return true;
+}
+
+bool Mixer::SetVoiceGain(int64_t id, float gain, float pan) {
+  Voice* voice = Find(id);
+  if (!voice) {
+    return false;
+  }
+  voice->gain.store(gain, std::memory_order_relaxed);
+  voice->pan.store(pan, std::memory_order_relaxed);
+  return true;
+}
+
+int64_t Mixer::Write(int64_t id, const uint8_t* data, size_t length, FeedPolicy policy) {
+  Voice* voice = Find(id);
+  if (!voice) {
+    return -1;
+  }
+  return FeedQueue(voice->queue, data, length, bytes_per_frame_, policy);
+}
+
+int64_t Mixer::PlayClip(Clip* clip, float gain, float pan) {
+  for (ClipVoice& voice : clip_voices_) {
+    if (voice.state.load(std::memory_order_acquire) != kFree) {
+      continue;
+    }
+    voice.clip = clip;
+    voice.gain = gain;
+    voice.pan = pan;
+    voice.position = 0;
+    voice.id = next_id_++;
+    clip->voices.fetch_add(1, std::memory_order_relaxed);
+    clips_playing_.fetch_add(1, std::memory_order_relaxed);
+    voice.state.store(kActive, std::memory_order_release);
+    return voice.id;
+  }
+  return -1;
+}
+
+void Mixer::Flush() {
+  for (Voice& voice : voices_) {
+    if (voice.state.load(std::memory_order_acquire) == kActive) {
+      voice.flush_to.store(voice.queue.WritePosition(), std::memory_order_relaxed);
+    }
+  }
+  clip_flushes_.fetch_add(1, std::memory_order_release);
+}
+
+void Mixer::EndClip(ClipVoice& voice) {
+  // Release: the platform thread may free the clip once it sees zero
+  voice.clip->voices.fetch_sub(1, std::memory_order_release);
+  clips_playing_.fetch_sub(1, std::memory_order_release);
+  voice.state.store(kFree, std::memory_order_release);
+}
+
+size_t Mixer::MaxQueuedFrames() {
+  size_t frames = 0;
+  uint32_t clip_flushes = clip_flushes_.load(std::memory_order_acquire);
+  bool flush_clips = clip_flushes != clip_flushes_seen_;
+  clip_flushes_seen_ = clip_flushes;
+  for (ClipVoice& voice : clip_voices_) {
+    if (voice.state.load(std::memory_order_acquire) != kActive) {
+      continue;
+    }
+    if (flush_clips || voice.position >= voice.clip->frames) {
+      EndClip(voice);
+    } else {
+      frames = std::max(frames, voice.clip->frames - voice.position);
+    }
+  }
+  for (Voice& voice : voices_) {
+    int state = voice.state.load(std::memory_order_acquire);
+    if (state == kRemoving) {
+      voice.queue.Clear();
+      voice.state.store(kFree, std::memory_order_release);
+    } else if (state == kActive) {
+      voice.queue.DiscardTo(voice.flush_to.load(std::memory_order_relaxed));
+      frames = std::max(frames, voice.queue.ReadableBytes() / bytes_per_frame_);
+    }
+  }
+  return frames;
+}
+
+size_t Mixer::MixQueue(RingBuffer& queue, float gain, float pan, float* out, size_t frames) {
+  frames = std::min(frames, samples_.size() / channels_);
+  size_t read = queue.Read(bytes_.data(), frames * bytes_per_frame_) / bytes_per_frame_;
+  if (read == 0) {
+    return 0;
+  }
+  ToFloat(format_, bytes_.data(), samples_.data(), read * channels_);
+  MixSamples(samples_.data(), gain, pan, out, read);
+  return read;
+}
+
+void Mixer::MixSamples(const float* in, float gain, float pan, float* out, size_t frames) const {
+  if (channels_ == 2) {
+    float left, right;
+    PanGains(gain, pan, &left, &right);
+    Kernels().mix_stereo(in, out, frames, left, right);
+  } else {
+    Kernels().mix(in, out, frames * channels_, gain);
+  }
+}
+
+void Mixer::MixVoices(float* out, size_t frames) {
+  for (Voice& voice : voices_) {
+    if (voice.state.load(std::memory_order_acquire) != kActive) {
+      continue;
+    }
+    MixQueue(voice.queue, voice.gain.load(std::memory_order_relaxed), voice.pan.load(std::memory_order_relaxed),
+             out, frames);
+  }
+  for (ClipVoice& voice : clip_voices_) {
+    if (voice.state.load(std::memory_order_acquire) != kActive) {
+      continue;
+    }
+    const Clip* clip = voice.clip;
+    size_t count = std::min(frames, clip->frames - voice.position);
+    MixSamples(clip->samples.data() + voice.position * channels_, voice.gain, voice.pan, out, count);
+    voice.position += count;
+    if (voice.position >= clip->frames) {
+      EndClip(voice);
+    }
+  }
+}
+
+void Mixer::PanGains(float gain, float pan, float* left, float* right) {
+  pan = std::min(std::max(pan, -1.0f), 1.0f);
+  *left = gain * std::min(1.0f, 1.0f - pan);
+  *right = gain * std::min(1.0f, 1.0f + pan);
+}
+
+Mixer::Voice* Mixer::Find(int64_t id) {
+  for (Voice& voice : voices_) {
+    if (voice.state.load(std::memory_order_acquire) == kActive && voice.id == id) {
+      return &voice;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace flutter_pcm_sound
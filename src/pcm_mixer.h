@@ -0,0 +1,143 @@
+#ifndef FLUTTER_PLUGIN_PCM_MIXER_H_
+#define FLUTTER_PLUGIN_PCM_MIXER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pcm_clip_bank.h"
+#include "pcm_convert.h"
+#include "pcm_feed_policy.h"
+#include "pcm_ring_buffer.h"
+
+namespace flutter_pcm_sound {
+
+// Sums extra playback streams ("voices") over the primary one, so several
+// sounds share one device and one playback thread.
+//
+// Voices live in a fixed set of slots. The platform thread claims a free
+// slot, sets up its queue and then publishes it; removal only marks the
+// slot, and the playback thread frees it the next time it looks. Neither
+// side locks, and the playback thread never allocates.
+//
+// Clips play on voices of their own, which read the clip's float samples
+// in place rather than through a queue, and end with the clip.
+//
+// All voices share the sample format and channel count given to
+// Configure. Gain is linear; pan only applies to stereo and is a balance
+// control: -1 is left only, 0 leaves both channels at full gain.
+class Mixer {
+ public:
+  static constexpr int kMaxVoices = 8;
+  static constexpr int kMaxClipVoices = 16;
+
+  Mixer() = default;
+
+  Mixer(const Mixer&) = delete;
+  Mixer& operator=(const Mixer&) = delete;
+
+  // Drops every voice and sizes scratch space for mixing up to
+  // `max_frames` frames at a time. Each voice queue holds `queue_bytes`.
+  // Must not be called while the playback thread is running.
+  void Configure(SampleFormat format, int channels, size_t queue_bytes, size_t max_frames);
+
+  // Drops every voice. Must not be called while the playback thread is
+  // running.
+  void Clear();
+
+  // Platform thread. Returns the new voice's id (always > 0), or -1 when
+  // every slot is taken or its queue can't be allocated.
+  int64_t AddVoice(float gain, float pan);
+  bool RemoveVoice(int64_t id);
+  bool SetVoiceGain(int64_t id, float gain, float pan);
+
+  // Platform thread. Queues whole frames for voice `id` under `policy`, as
+  // FeedQueue does, and returns how many bytes it took, or -1 if there is
+  // no such voice.
+  int64_t Write(int64_t id, const uint8_t* data, size_t length, FeedPolicy policy);
+
+  // Platform thread. Plays `clip` once, from the start. Returns the id of
+  // the voice playing it, or -1 when kMaxClipVoices clips are playing.
+  // The clip stays alive while its voice count is above zero.
+  int64_t PlayClip(Clip* clip, float gain, float pan);
+
+  // Platform thread. Drops what every voice has queued so far and stops
+  // every clip; the playback thread lets go of them on its next
+  // MaxQueuedFrames. Voices stay added, and later writes play as usual.
+  void Flush();
+
+  // Playback thread. The most frames any voice has queued or has left of
+  // its clip. Also frees the slots of removed voices and carries out
+  // Flush.
+  size_t MaxQueuedFrames();
+
+  // Playback thread. Reads up to `frames` frames from `queue`, in the
+  // configured format, and adds them to `out` with gain and pan applied.
+  // Returns how many frames it read.
+  size_t MixQueue(RingBuffer& queue, float gain, float pan, float* out, size_t frames);
+
+  // Playback thread. Adds `frames` float frames from `in`, in the
+  // configured channel count, to `out` with gain and pan applied.
+  void MixSamples(const float* in, float gain, float pan, float* out, size_t frames) const;
+
+  // Playback thread. Adds up to `frames` frames of every voice and clip to
+  // `out`.
+  void MixVoices(float* out, size_t frames);
+
+  // Whether a clip is playing. Any thread, for deciding whether the
+  // device may stop.
+  bool clips_playing() const { return clips_playing_.load(std::memory_order_acquire) > 0; }
+
+  // Left and right multipliers for a stereo stream.
+  static void PanGains(float gain, float pan, float* left, float* right);
+
+ private:
+  enum State { kFree, kActive, kRemoving };
+
+  struct Voice {
+    RingBuffer queue;
+    std::atomic<int> state{kFree};
+    std::atomic<float> gain{1.0f};
+    std::atomic<float> pan{0.0f};
+    // Queue position Flush last asked the playback thread to drop up to
+    std::atomic<uint64_t> flush_to{0};
+    int64_t id = 0;  // written only while the slot is free
+  };
+
+  struct ClipVoice {
+    std::atomic<int> state{kFree};
+    // Written only while the slot is free
+    Clip* clip = nullptr;
+    float gain = 1.0f;
+    float pan = 0.0f;
+    int64_t id = 0;
+    size_t position = 0;  // frames played; playback thread once active
+  };
+
+  Voice* Find(int64_t id);
+  // Playback thread, or with it stopped. Lets go of the clip and the slot.
+  void EndClip(ClipVoice& voice);
+
+  Voice voices_[kMaxVoices];
+  int64_t next_id_ = 1;
+
+  ClipVoice clip_voices_[kMaxClipVoices];
+  std::atomic<int> clips_playing_{0};
+  // Flush bumps this; the playback thread stops every clip when it moves
+  std::atomic<uint32_t> clip_flushes_{0};
+  uint32_t clip_flushes_seen_ = 0;  // playback thread
+
+  SampleFormat format_ = SampleFormat::kS16;
+  int channels_ = 1;
+  size_t bytes_per_frame_ = 2;
+  size_t queue_bytes_ = 0;
+
+  // Playback thread scratch, max_frames long
+  std::vector<uint8_t> bytes_;
+  std::vector<float> samples_;
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_MIXER_H_
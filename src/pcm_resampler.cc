@@ -0,0 +1,169 @@
+#include "pcm_resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+struct QualityParams {
+  int taps;       // per phase, when not downsampling
+  double beta;    // Kaiser window shape
+  double rolloff; // passband edge as a fraction of the output Nyquist
+};
+
+// Roughly 60, 90 and 120 dB of stopband attenuation
+QualityParams ParamsFor(ResampleQuality quality) {
+  switch (quality) {
+    case ResampleQuality::kLow: return {16, 5.65, 0.85};
+    case ResampleQuality::kHigh: return {64, 12.26, 0.95};
+    default: return {32, 8.96, 0.91};
+  }
+}
+
+// Longest filter we'll build when downsampling by a large factor
+constexpr int kMaxTaps = 512;
+
+// Zeroth-order modified Bessel function of the first kind
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 64; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12) break;
+  }
+  return sum;
+}
+
+}  // namespace
+
+bool Resampler::Configure(int in_rate, int out_rate, int channels, ResampleQuality quality,
+                          size_t max_input_frames) {
+  if (in_rate <= 0 || out_rate <= 0 || channels <= 0) {
+    return false;
+  }
+
+  const uint64_t g = std::gcd(in_rate, out_rate);
+  up_ = out_rate / g;
+  down_ = in_rate / g;
+  channels_ = channels;
+
+  // Downsampling lowers the cutoff, so stretch the filter to keep the
+  // same transition band relative to the output rate
+  const QualityParams params = ParamsFor(quality);
+  const double scale = std::min(1.0, static_cast<double>(out_rate) / in_rate);
+  taps_ = std::min(kMaxTaps, static_cast<int>(std::ceil(params.taps / scale)));
+  taps_ += taps_ % 2;
+  half_taps_ = taps_ / 2;
+
+  // Cutoff in cycles per input frame
+  const double cutoff = 0.5 * scale * params.rolloff;
+  const double window_norm = BesselI0(params.beta);
+
+  phases_ = std::min<uint64_t>(up_, kMaxPhases);
+  coefficients_.assign((phases_ + 1) * taps_, 0.0f);
+  for (uint64_t p = 0; p <= phases_; p++) {
+    const double frac = static_cast<double>(p) / phases_;
+    float* row = &coefficients_[p * taps_];
+    double sum = 0.0;
+    for (int j = 0; j < taps_; j++) {
+      // Distance from the output position to the input frame this tap reads
+      const double t = (j - static_cast<double>(half_taps_) + 1.0) - frac;
+      const double x = t / half_taps_;
+      const double window = std::fabs(x) > 1.0 ? 0.0 : BesselI0(params.beta * std::sqrt(1.0 - x * x)) / window_norm;
+      const double arg = 2.0 * cutoff * t;
+      const double sinc = std::fabs(arg) < 1e-12 ? 1.0 : std::sin(M_PI * arg) / (M_PI * arg);
+      const double h = 2.0 * cutoff * sinc * window;
+      row[j] = static_cast<float>(h);
+      sum += h;
+    }
+    // Unity gain at DC for every phase, so there's no fractional ripple
+    for (int j = 0; j < taps_; j++) {
+      row[j] = static_cast<float>(row[j] / sum);
+    }
+  }
+  row_.assign(taps_, 0.0f);
+
+  history_.assign((taps_ + max_input_frames) * channels_, 0.0f);
+  Reset();
+  return true;
+}
+
+void Resampler::Reset() {
+  // Start centred on the first input frame, with silence before it
+  std::fill(history_.begin(), history_.end(), 0.0f);
+  history_frames_ = half_taps_ - 1;
+  position_ = half_taps_ - 1;
+  fraction_ = 0;
+}
+
+size_t Resampler::MaxOutputFrames(size_t in_frames) const {
+  return ((in_frames + taps_) * up_ + down_ - 1) / down_ + 1;
+}
+
+size_t Resampler::Process(const float* in, size_t in_frames, float* out) {
+  const size_t channels = channels_;
+  const size_t capacity = history_.size() / channels;
+  size_t produced = 0;
+  // After a pass the history holds less than taps_ frames, so there is
+  // always room for more input
+  while (in_frames > 0) {
+    const size_t take = std::min(in_frames, capacity - history_frames_);
+    memcpy(&history_[history_frames_ * channels], in, take * channels * sizeof(float));
+    history_frames_ += take;
+    in += take * channels;
+    in_frames -= take;
+    produced += Drain(out + produced * channels);
+  }
+  return produced;
+}
+
+size_t Resampler::Drain(float* out) {
+  const size_t channels = channels_;
+  size_t produced = 0;
+  while (position_ + half_taps_ < history_frames_) {
+    const float* row;
+    if (phases_ == up_) {
+      row = &coefficients_[fraction_ * taps_];
+    } else {
+      // Interpolate between the two nearest tabulated phases
+      const uint64_t scaled = fraction_ * phases_;
+      const uint64_t index = scaled / up_;
+      const float weight = static_cast<float>(scaled % up_) / up_;
+      const float* a = &coefficients_[index * taps_];
+      const float* b = a + taps_;
+      for (int j = 0; j < taps_; j++) {
+        row_[j] = a[j] + (b[j] - a[j]) * weight;
+      }
+      row = row_.data();
+    }
+
+    const float* frames = &history_[(position_ + 1 - half_taps_) * channels];
+    float* dst = out + produced * channels;
+    for (size_t c = 0; c < channels; c++) {
+      float acc = 0.0f;
+      for (int j = 0; j < taps_; j++) {
+        acc += row[j] * frames[j * channels + c];
+      }
+      dst[c] = acc;
+    }
+    produced++;
+
+    fraction_ += down_;
+    position_ += fraction_ / up_;
+    fraction_ %= up_;
+  }
+
+  // Keep only the frames the next output can still reach
+  const size_t drop = std::min(position_ + 1 - half_taps_, history_frames_);
+  memmove(history_.data(), &history_[drop * channels], (history_frames_ - drop) * channels * sizeof(float));
+  history_frames_ -= drop;
+  position_ -= drop;
+  return produced;
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,82 @@
+#ifndef FLUTTER_PLUGIN_PCM_RESAMPLER_H_
+#define FLUTTER_PLUGIN_PCM_RESAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flutter_pcm_sound {
+
+// Trades CPU for stopband attenuation and passband width.
+enum class ResampleQuality { kLow, kMedium, kHigh };
+
+// Streaming polyphase windowed-sinc sample rate converter for interleaved
+// float frames.
+//
+// The ratio is reduced to out/in = L/M and the Kaiser-windowed sinc is
+// tabulated for up to kMaxPhases fractional positions. When L fits, every
+// output lands exactly on a tabulated phase; otherwise neighbouring phases
+// are interpolated linearly, so any pair of integer rates works.
+//
+// All storage is allocated by Configure. Process never allocates, so it is
+// safe to call from the playback thread.
+class Resampler {
+ public:
+  static constexpr int kMaxPhases = 1024;
+
+  Resampler() = default;
+
+  Resampler(const Resampler&) = delete;
+  Resampler& operator=(const Resampler&) = delete;
+
+  // Builds the filter for `in_rate` -> `out_rate` and sizes the history for
+  // input chunks of at most `max_input_frames`. Returns false for
+  // non-positive rates or channel counts.
+  bool Configure(int in_rate, int out_rate, int channels, ResampleQuality quality, size_t max_input_frames);
+
+  // Forgets buffered input, as if freshly configured.
+  void Reset();
+
+  // Consumes all `in_frames` frames and writes the output frames they
+  // complete to `out`, returning how many. `out` must hold
+  // MaxOutputFrames(in_frames) frames. Input beyond max_input_frames is
+  // taken in several passes, so it costs more but nothing is dropped.
+  size_t Process(const float* in, size_t in_frames, float* out);
+
+  size_t MaxOutputFrames(size_t in_frames) const;
+
+  // Input frames held back until enough lookahead arrives.
+  size_t latency_frames() const { return half_taps_; }
+  int taps() const { return taps_; }
+
+ private:
+  int channels_ = 0;
+  int taps_ = 0;
+  size_t half_taps_ = 0;
+
+  // Reduced ratio: each output advances the input position by M/L frames
+  uint64_t up_ = 1;    // L
+  uint64_t down_ = 1;  // M
+
+  // phases_ + 1 rows of taps_ coefficients; the extra row lets the
+  // interpolating path read phase + 1 without wrapping
+  std::vector<float> coefficients_;
+  uint64_t phases_ = 1;
+  // Interpolated row for ratios with more than kMaxPhases phases
+  std::vector<float> row_;
+
+  // Pending input frames, interleaved. `position_` indexes the frame the
+  // next output is centred on; `fraction_` is its phase, in units of 1/L.
+  std::vector<float> history_;
+  size_t history_frames_ = 0;
+  size_t position_ = 0;
+  uint64_t fraction_ = 0;
+
+  // Writes every output the history completes to `out` and drops the
+  // input no later output reaches. Returns how many.
+  size_t Drain(float* out);
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_RESAMPLER_H_
@@ -0,0 +1,112 @@
+#include "pcm_ring_buffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace flutter_pcm_sound {
+
+RingBuffer::~RingBuffer() {
+  free(data_);
+}
+
+bool RingBuffer::Reset(size_t capacity) {
+  if (capacity != capacity_) {
+    uint8_t* data = static_cast<uint8_t*>(malloc(capacity));
+    if (!data && capacity > 0) {
+      return false;
+    }
+    free(data_);
+    data_ = data;
+    capacity_ = capacity;
+  }
+  Clear();
+  return true;
+}
+
+void RingBuffer::Clear() {
+  head_.store(0, std::memory_order_relaxed);
+  tail_.store(0, std::memory_order_relaxed);
+}
+
+size_t RingBuffer::Write(const uint8_t* data, size_t length) {
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const size_t count = std::min(length, capacity_ - static_cast<size_t>(tail - head));
+  if (count == 0) {
+    return 0;
+  }
+
+  // Copy in at most two pieces: up to the end of storage, then from the start.
+  const size_t offset = tail % capacity_;
+  const size_t first = std::min(count, capacity_ - offset);
+  memcpy(data_ + offset, data, first);
+  memcpy(data_, data + first, count - first);
+
+  tail_.store(tail + count, std::memory_order_release);
+  return count;
+}
+
+size_t RingBuffer::Read(uint8_t* out, size_t length) {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  const size_t count = std::min(length, static_cast<size_t>(tail - head));
+  if (count == 0) {
+    return 0;
+  }
+
+  const size_t offset = head % capacity_;
+  const size_t first = std::min(count, capacity_ - offset);
+  memcpy(out, data_ + offset, first);
+  memcpy(out + first, data_, count - first);
+
+  head_.store(head + count, std::memory_order_release);
+  return count;
+}
+
+size_t RingBuffer::Peek(const uint8_t** data) const {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  const size_t count = static_cast<size_t>(tail - head);
+  if (count == 0) {
+    *data = nullptr;
+    return 0;
+  }
+
+  const size_t offset = head % capacity_;
+  *data = data_ + offset;
+  return std::min(count, capacity_ - offset);
+}
+
+void RingBuffer::Consume(size_t length) {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  head_.store(head + length, std::memory_order_release);
+}
+
+uint64_t RingBuffer::WritePosition() const {
+  return tail_.load(std::memory_order_relaxed);
+}
+
+size_t RingBuffer::DiscardTo(uint64_t position) {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  if (position <= head) {
+    return 0;
+  }
+  const uint64_t new_head = std::min(position, tail);
+  head_.store(new_head, std::memory_order_release);
+  return static_cast<size_t>(new_head - head);
+}
+
+size_t RingBuffer::ReadableBytes() const {
+  // Load head first: tail only moves forward, so tail >= head is guaranteed.
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  return static_cast<size_t>(tail - head);
+}
+
+size_t RingBuffer::WritableBytes() const {
+  return capacity_ - ReadableBytes();
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,71 @@
+#ifndef FLUTTER_PLUGIN_PCM_RING_BUFFER_H_
+#define FLUTTER_PLUGIN_PCM_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace flutter_pcm_sound {
+
+// Fixed-capacity single-producer/single-consumer byte queue.
+//
+// One thread (the platform thread, via `feed`) calls Write, and one thread
+// (the audio playback thread) calls Read. Neither side takes a lock or moves
+// existing data; head and tail are free-running counters published with
+// acquire/release ordering.
+//
+// Reset and Clear are not thread safe and must only be called while the
+// playback thread is stopped. To empty the queue while it runs, the
+// producer notes WritePosition and the consumer calls DiscardTo with it.
+class RingBuffer {
+ public:
+  RingBuffer() = default;
+  ~RingBuffer();
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  // (Re)allocates storage for `capacity` bytes and empties the queue.
+  bool Reset(size_t capacity);
+
+  // Drops all queued bytes, keeping the storage.
+  void Clear();
+
+  // Producer side. Copies up to `length` bytes and returns how many fit.
+  size_t Write(const uint8_t* data, size_t length);
+
+  // Consumer side. Copies up to `length` bytes out and returns how many.
+  size_t Read(uint8_t* out, size_t length);
+
+  // Consumer side, zero-copy. Points `data` at the oldest queued bytes and
+  // returns how many are contiguous in storage (the rest, if any, wrap to
+  // the start). The bytes stay queued until Consume is called.
+  size_t Peek(const uint8_t** data) const;
+
+  // Consumer side. Drops `length` bytes previously returned by Peek.
+  void Consume(size_t length);
+
+  // Producer side. Bytes written since the last Reset or Clear.
+  uint64_t WritePosition() const;
+
+  // Consumer side. Drops every queued byte written before `position`, a
+  // value WritePosition returned. Later bytes stay queued. Returns how many
+  // bytes were dropped.
+  size_t DiscardTo(uint64_t position);
+
+  size_t ReadableBytes() const;
+  size_t WritableBytes() const;
+  size_t capacity() const { return capacity_; }
+
+ private:
+  uint8_t* data_ = nullptr;
+  size_t capacity_ = 0;
+
+  // Kept on separate cache lines so the two threads don't false-share.
+  alignas(64) std::atomic<uint64_t> head_{0};  // next byte to read
+  alignas(64) std::atomic<uint64_t> tail_{0};  // next byte to write
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_RING_BUFFER_H_
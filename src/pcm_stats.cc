@@ -0,0 +1,160 @@
+#include "pcm_stats.h"
+
+#include <chrono>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+constexpr std::memory_order kRelaxed = std::memory_order_relaxed;
+
+void StoreMax(std::atomic<uint64_t>& value, uint64_t candidate) {
+  uint64_t current = value.load(kRelaxed);
+  while (candidate > current && !value.compare_exchange_weak(current, candidate, kRelaxed)) {
+  }
+}
+
+int LatencyBucket(int64_t latency_ns) {
+  int64_t ms = latency_ns / 1000000;
+  int bucket = 0;
+  while (bucket < kLatencyBuckets - 1 && ms >= (int64_t{1} << bucket)) {
+    bucket++;
+  }
+  return bucket;
+}
+
+}  // namespace
+
+void PlaybackStats::Reset() {
+  underruns_.store(0, kRelaxed);
+  device_errors_.store(0, kRelaxed);
+  recoveries_.store(0, kRelaxed);
+  recovery_ns_total_.store(0, kRelaxed);
+  recovery_ns_max_.store(0, kRelaxed);
+  queue_high_frames_.store(0, kRelaxed);
+  queue_low_frames_.store(SIZE_MAX, kRelaxed);
+  device_callbacks_.store(0, kRelaxed);
+  feed_callbacks_.store(0, kRelaxed);
+  bytes_fed_.store(0, kRelaxed);
+  bytes_played_.store(0, kRelaxed);
+  for (auto& bucket : latency_histogram_) {
+    bucket.store(0, kRelaxed);
+  }
+  underrun_since_ns_ = 0;
+  consumed_ = 0;
+  mark_head_.store(0, kRelaxed);
+  mark_tail_.store(0, kRelaxed);
+}
+
+void PlaybackStats::RecordFeed(size_t bytes, int64_t now_ns) {
+  if (bytes == 0) {
+    return;
+  }
+  // Only the feeder writes bytes_fed_, so it can read its own value back
+  uint64_t offset = bytes_fed_.load(kRelaxed);
+  bytes_fed_.store(offset + bytes, kRelaxed);
+
+  const uint64_t tail = mark_tail_.load(kRelaxed);
+  if (tail - mark_head_.load(std::memory_order_acquire) < kMaxMarks) {
+    marks_[tail % kMaxMarks] = {offset, now_ns};
+    mark_tail_.store(tail + 1, std::memory_order_release);
+  }
+}
+
+void PlaybackStats::RecordFeedCallback() {
+  feed_callbacks_.fetch_add(1, kRelaxed);
+}
+
+void PlaybackStats::RecordDeviceCallback(size_t queued_frames) {
+  device_callbacks_.fetch_add(1, kRelaxed);
+  // Watermarks only move on this thread; Reset is the only other writer
+  if (queued_frames > queue_high_frames_.load(kRelaxed)) {
+    queue_high_frames_.store(queued_frames, kRelaxed);
+  }
+  if (queued_frames < queue_low_frames_.load(kRelaxed)) {
+    queue_low_frames_.store(queued_frames, kRelaxed);
+  }
+}
+
+void PlaybackStats::RecordPlayed(size_t bytes, int64_t now_ns) {
+  if (bytes == 0) {
+    return;
+  }
+  bytes_played_.store(bytes_played_.load(kRelaxed) + bytes, kRelaxed);
+  consumed_ += bytes;
+
+  // Retire every feed whose first byte has now gone to the device
+  uint64_t head = mark_head_.load(kRelaxed);
+  const uint64_t tail = mark_tail_.load(std::memory_order_acquire);
+  while (head != tail && marks_[head % kMaxMarks].offset < consumed_) {
+    int64_t latency_ns = now_ns - marks_[head % kMaxMarks].time_ns;
+    latency_histogram_[LatencyBucket(latency_ns)].fetch_add(1, kRelaxed);
+    head++;
+  }
+  mark_head_.store(head, std::memory_order_release);
+}
+
+void PlaybackStats::RecordDiscarded(size_t bytes) {
+  if (bytes == 0) {
+    return;
+  }
+  consumed_ += bytes;
+
+  // Feeds that started in the dropped bytes never reach the device
+  uint64_t head = mark_head_.load(kRelaxed);
+  const uint64_t tail = mark_tail_.load(std::memory_order_acquire);
+  while (head != tail && marks_[head % kMaxMarks].offset < consumed_) {
+    head++;
+  }
+  mark_head_.store(head, std::memory_order_release);
+}
+
+void PlaybackStats::RecordUnderrun(int64_t now_ns) {
+  underruns_.fetch_add(1, kRelaxed);
+  if (underrun_since_ns_ == 0) {
+    underrun_since_ns_ = now_ns;
+  }
+}
+
+void PlaybackStats::RecordRecovered(int64_t now_ns) {
+  if (underrun_since_ns_ == 0) {
+    return;
+  }
+  uint64_t duration = static_cast<uint64_t>(now_ns - underrun_since_ns_);
+  underrun_since_ns_ = 0;
+  recoveries_.fetch_add(1, kRelaxed);
+  recovery_ns_total_.fetch_add(duration, kRelaxed);
+  StoreMax(recovery_ns_max_, duration);
+}
+
+void PlaybackStats::RecordDeviceError() {
+  device_errors_.fetch_add(1, kRelaxed);
+}
+
+void PlaybackStats::Snapshot(StatsSnapshot* out) const {
+  out->underruns = underruns_.load(kRelaxed);
+  out->device_errors = device_errors_.load(kRelaxed);
+  out->recoveries = recoveries_.load(kRelaxed);
+  out->recovery_ns_total = recovery_ns_total_.load(kRelaxed);
+  out->recovery_ns_max = recovery_ns_max_.load(kRelaxed);
+  out->queue_high_frames = queue_high_frames_.load(kRelaxed);
+  size_t low = queue_low_frames_.load(kRelaxed);
+  out->has_queue_low = low != SIZE_MAX;
+  out->queue_low_frames = out->has_queue_low ? low : 0;
+  out->device_callbacks = device_callbacks_.load(kRelaxed);
+  out->feed_callbacks = feed_callbacks_.load(kRelaxed);
+  out->bytes_fed = bytes_fed_.load(kRelaxed);
+  out->bytes_played = bytes_played_.load(kRelaxed);
+  for (int i = 0; i < kLatencyBuckets; i++) {
+    out->latency_histogram[i] = latency_histogram_[i].load(kRelaxed);
+  }
+}
+
+// static
+int64_t PlaybackStats::NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace flutter_pcm_sound
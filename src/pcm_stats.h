@@ -0,0 +1,131 @@
+#ifndef FLUTTER_PLUGIN_PCM_STATS_H_
+#define FLUTTER_PLUGIN_PCM_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace flutter_pcm_sound {
+
+// Feed latency histogram: bucket i counts feeds whose first sample reached
+// the device in under 2^i ms; the last bucket counts everything slower.
+constexpr int kLatencyBuckets = 12;
+
+// A copy of the counters, for reporting.
+struct StatsSnapshot {
+  uint64_t underruns = 0;
+  uint64_t device_errors = 0;
+  // Underruns the device has come back from, and how long that took
+  uint64_t recoveries = 0;
+  uint64_t recovery_ns_total = 0;
+  uint64_t recovery_ns_max = 0;
+  // Sample queue fill level, in frames, whenever the device took samples.
+  // has_queue_low is false until it has.
+  size_t queue_high_frames = 0;
+  size_t queue_low_frames = 0;
+  bool has_queue_low = false;
+  // Times the device asked for samples, and feed requests sent to Dart
+  uint64_t device_callbacks = 0;
+  uint64_t feed_callbacks = 0;
+  // Primary stream bytes accepted by feed, and handed to the device
+  uint64_t bytes_fed = 0;
+  uint64_t bytes_played = 0;
+  uint64_t latency_histogram[kLatencyBuckets] = {};
+};
+
+// Playback telemetry for one stream.
+//
+// The audio thread updates the counters with relaxed atomics, so recording
+// costs a few uncontended adds; readers on other threads accept that a
+// snapshot can be a few samples out of step with itself. The feeder (the
+// platform thread, serialized with FFI feeds) calls RecordFeed and the
+// audio thread the other Record* methods, except RecordFeedCallback and
+// RecordDeviceError, which any thread may call. Snapshot is safe from any
+// thread.
+//
+// Feed latency is measured from the feed call to the moment the audio
+// thread hands the feed's first sample to the device. Feeds are timestamped
+// in a small lock-free queue; when it is full, feeds go unmeasured rather
+// than blocking.
+//
+// Reset is not thread safe and must only be called while the audio thread
+// is stopped.
+class PlaybackStats {
+ public:
+  PlaybackStats() = default;
+
+  PlaybackStats(const PlaybackStats&) = delete;
+  PlaybackStats& operator=(const PlaybackStats&) = delete;
+
+  void Reset();
+
+  // Feeder. `bytes` were queued at `now_ns`.
+  void RecordFeed(size_t bytes, int64_t now_ns);
+
+  // Platform thread. A feed request went out to Dart.
+  void RecordFeedCallback();
+
+  // Audio thread. The device asked for samples and the queue held
+  // `queued_frames`.
+  void RecordDeviceCallback(size_t queued_frames);
+
+  // Audio thread. `bytes` of the primary stream were handed to the device.
+  void RecordPlayed(size_t bytes, int64_t now_ns);
+
+  // Audio thread, or whichever thread empties the queue while the audio
+  // thread is stopped. Flush dropped `bytes` of the primary stream unplayed.
+  // Feeds that began in them go unmeasured, and later feeds are timed from
+  // the byte that follows them.
+  void RecordDiscarded(size_t bytes);
+
+  // Audio thread. The device ran out of samples. Repeated calls before
+  // RecordRecovered count as separate underruns but one recovery.
+  void RecordUnderrun(int64_t now_ns);
+
+  // Audio thread. The device is playing fed samples again after an
+  // underrun. Does nothing when there wasn't one.
+  void RecordRecovered(int64_t now_ns);
+
+  // A device call failed other than by underrunning.
+  void RecordDeviceError();
+
+  void Snapshot(StatsSnapshot* out) const;
+
+  // Monotonic clock used for every timestamp passed in.
+  static int64_t NowNs();
+
+ private:
+  struct FeedMark {
+    uint64_t offset;  // bytes_fed before the feed
+    int64_t time_ns;
+  };
+  static constexpr size_t kMaxMarks = 256;
+
+  std::atomic<uint64_t> underruns_{0};
+  std::atomic<uint64_t> device_errors_{0};
+  std::atomic<uint64_t> recoveries_{0};
+  std::atomic<uint64_t> recovery_ns_total_{0};
+  std::atomic<uint64_t> recovery_ns_max_{0};
+  std::atomic<size_t> queue_high_frames_{0};
+  std::atomic<size_t> queue_low_frames_{SIZE_MAX};
+  std::atomic<uint64_t> device_callbacks_{0};
+  std::atomic<uint64_t> feed_callbacks_{0};
+  std::atomic<uint64_t> bytes_fed_{0};
+  std::atomic<uint64_t> bytes_played_{0};
+  std::atomic<uint64_t> latency_histogram_[kLatencyBuckets] = {};
+
+  // Audio thread only. consumed_ is bytes_played_ plus everything flush
+  // dropped: the feed offset the next byte to play was fed at.
+  int64_t underrun_since_ns_ = 0;
+  uint64_t consumed_ = 0;
+
+  // Feed timestamps: the feeder appends at mark_tail_, the audio thread
+  // retires from mark_head_.
+  FeedMark marks_[kMaxMarks] = {};
+  alignas(64) std::atomic<uint64_t> mark_head_{0};
+  alignas(64) std::atomic<uint64_t> mark_tail_{0};
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_STATS_H_
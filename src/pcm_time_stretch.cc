@@ -0,0 +1,195 @@
+#include "pcm_time_stretch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// The search first scores every kCoarseStep-th start on every
+// kCoarseStep-th frame, then every start around the best of those
+constexpr size_t kCoarseStep = 4;
+
+}  // namespace
+
+bool TimeStretcher::Configure(int rate, int channels, size_t max_write_frames) {
+  if (rate <= 0 || channels <= 0) {
+    return false;
+  }
+  channels_ = channels;
+  hop_ = std::max<size_t>(static_cast<size_t>(rate) * kSegmentMs / 2000, 1);
+  search_ = std::max<size_t>(static_cast<size_t>(rate) * kSearchMs / 1000, 1);
+
+  // Raised cosine: with the falling half it sums to 1
+  fade_.resize(hop_);
+  for (size_t i = 0; i < hop_; i++) {
+    fade_[i] = static_cast<float>(0.5 - 0.5 * std::cos(M_PI * (i + 0.5) / hop_));
+  }
+
+  // A step needs at most 4 hops and 2 searches past the oldest frame it
+  // keeps, so a full write always leaves room for it
+  input_capacity_ = max_write_frames + 4 * hop_ + 4 * search_ + 2;
+  input_.assign(input_capacity_ * channels_, 0.0f);
+  pending_.assign(input_capacity_ * channels_, 0.0f);
+  Reset();
+  return true;
+}
+
+void TimeStretcher::Reset() {
+  input_frames_ = 0;
+  previous_ = 0;
+  position_ = 0.0;
+  primed_ = false;
+  pending_offset_ = 0;
+  pending_frames_ = 0;
+}
+
+void TimeStretcher::set_speed(float speed) {
+  speed_ = std::min(std::max(speed, kMinSpeed), kMaxSpeed);
+}
+
+size_t TimeStretcher::WritableFrames() const {
+  return input_capacity_ - input_frames_;
+}
+
+size_t TimeStretcher::Write(const float* in, size_t frames) {
+  frames = std::min(frames, WritableFrames());
+  memcpy(input_.data() + input_frames_ * channels_, in, frames * channels_ * sizeof(float));
+  input_frames_ += frames;
+  return frames;
+}
+
+size_t TimeStretcher::Read(float* out, size_t frames, bool drain) {
+  size_t done = 0;
+  while (done < frames) {
+    if (pending_frames_ == 0) {
+      pending_offset_ = 0;
+      if (!Step()) {
+        if (!drain || input_frames_ == 0) {
+          break;
+        }
+        // Play the rest as it is, carrying on from the last segment
+        size_t from = std::min(primed_ ? previous_ + hop_ : 0, input_frames_);
+        pending_frames_ = input_frames_ - from;
+        memcpy(pending_.data(), input_.data() + from * channels_, pending_frames_ * channels_ * sizeof(float));
+        input_frames_ = 0;
+        previous_ = 0;
+        position_ = 0.0;
+        primed_ = false;
+        if (pending_frames_ == 0) {
+          break;
+        }
+      }
+    }
+    size_t take = std::min(frames - done, pending_frames_);
+    memcpy(out + done * channels_, pending_.data() + pending_offset_ * channels_, take * channels_ * sizeof(float));
+    pending_offset_ += take;
+    pending_frames_ -= take;
+    done += take;
+  }
+  return done;
+}
+
+size_t TimeStretcher::buffered_frames() const {
+  size_t played = primed_ ? std::min(previous_ + hop_, input_frames_) : 0;
+  return pending_frames_ + input_frames_ - played;
+}
+
+bool TimeStretcher::Step() {
+  const size_t channels = channels_;
+  if (!primed_) {
+    // The first hop plays as it is
+    if (input_frames_ < hop_ + latency_frames()) {
+      return false;
+    }
+    memcpy(pending_.data(), input_.data(), hop_ * channels * sizeof(float));
+    pending_frames_ = hop_;
+    previous_ = 0;
+    position_ = 0.0;
+    primed_ = true;
+    return true;
+  }
+
+  const double ideal = position_ + hop_ * static_cast<double>(speed_);
+  const size_t center = static_cast<size_t>(ideal);
+  const size_t lo = center > search_ ? center - search_ : 0;
+  const size_t hi = center + search_;
+  // Where the last segment carries on by itself
+  const size_t target = previous_ + hop_;
+  if (std::max(hi, target) + 2 * hop_ > input_frames_) {
+    return false;
+  }
+
+  size_t start = target;
+  if (target >= lo && target <= hi) {
+    memcpy(pending_.data(), input_.data() + target * channels, hop_ * channels * sizeof(float));
+  } else {
+    double best_score = -std::numeric_limits<double>::infinity();
+    for (size_t candidate = lo; candidate <= hi; candidate += kCoarseStep) {
+      double score = Similarity(candidate, target, kCoarseStep);
+      if (score > best_score) {
+        best_score = score;
+        start = candidate;
+      }
+    }
+    const size_t coarse = start;
+    const size_t from = coarse > lo + kCoarseStep - 1 ? coarse - (kCoarseStep - 1) : lo;
+    const size_t to = std::min(coarse + kCoarseStep - 1, hi);
+    best_score = -std::numeric_limits<double>::infinity();
+    for (size_t candidate = from; candidate <= to; candidate++) {
+      double score = Similarity(candidate, target, 1);
+      if (score > best_score) {
+        best_score = score;
+        start = candidate;
+      }
+    }
+
+    const float* fading = input_.data() + target * channels;
+    const float* rising = input_.data() + start * channels;
+    float* out = pending_.data();
+    for (size_t i = 0; i < hop_; i++) {
+      const float in = fade_[i];
+      const float out_gain = 1.0f - in;
+      for (size_t c = 0; c < channels; c++) {
+        out[i * channels + c] = fading[i * channels + c] * out_gain + rising[i * channels + c] * in;
+      }
+    }
+  }
+  pending_frames_ = hop_;
+  previous_ = start;
+  position_ = ideal;
+
+  // Drop the input no later step can reach back to
+  const size_t floor_position = static_cast<size_t>(position_);
+  const size_t keep_from = std::min(previous_, floor_position > search_ ? floor_position - search_ : 0);
+  if (keep_from > 0) {
+    memmove(input_.data(), input_.data() + keep_from * channels,
+            (input_frames_ - keep_from) * channels * sizeof(float));
+    input_frames_ -= keep_from;
+    previous_ -= keep_from;
+    position_ -= keep_from;
+  }
+  return true;
+}
+
+double TimeStretcher::Similarity(size_t candidate, size_t target, size_t step) const {
+  const size_t channels = channels_;
+  const float* a = input_.data() + target * channels;
+  const float* b = input_.data() + candidate * channels;
+  double cross = 0.0;
+  double energy = 0.0;
+  for (size_t i = 0; i < hop_; i += step) {
+    for (size_t c = 0; c < channels; c++) {
+      const double x = a[i * channels + c];
+      const double y = b[i * channels + c];
+      cross += x * y;
+      energy += y * y;
+    }
+  }
+  return energy > 0.0 ? cross / std::sqrt(energy) : 0.0;
+}
+
+}  // namespace flutter_pcm_sound
@@ -0,0 +1,97 @@
+#ifndef FLUTTER_PLUGIN_PCM_TIME_STRETCH_H_
+#define FLUTTER_PLUGIN_PCM_TIME_STRETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flutter_pcm_sound {
+
+// WSOLA (waveform similarity overlap-add) time stretcher for interleaved
+// float frames: plays its input slightly faster or slower without
+// changing the pitch.
+//
+// Output is built from kSegmentMs segments of input at 50% overlap. Each
+// segment is taken near where the speed says it should start, at the
+// offset within kSearchMs where it best continues the last one, and
+// crossfaded over it. Wherever the natural continuation is within reach
+// it is taken as is, so at speed 1 the output is the input, delayed, and
+// stretching happens in jumps of about a pitch period.
+//
+// All storage is allocated by Configure; Write and Read never allocate,
+// so they are safe to call from the playback thread.
+class TimeStretcher {
+ public:
+  static constexpr int kSegmentMs = 20;
+  static constexpr int kSearchMs = 5;
+  static constexpr float kMinSpeed = 0.5f;
+  static constexpr float kMaxSpeed = 2.0f;
+
+  TimeStretcher() = default;
+
+  TimeStretcher(const TimeStretcher&) = delete;
+  TimeStretcher& operator=(const TimeStretcher&) = delete;
+
+  // Sizes the buffers for Writes of at most `max_write_frames`. Returns
+  // false for non-positive rates or channel counts.
+  bool Configure(int rate, int channels, size_t max_write_frames);
+
+  // Forgets buffered input, as if freshly configured. Keeps the speed.
+  void Reset();
+
+  // Input frames played per output frame, clamped to kMinSpeed..kMaxSpeed
+  void set_speed(float speed);
+  float speed() const { return speed_; }
+
+  // How many frames Write takes right now
+  size_t WritableFrames() const;
+
+  // Appends up to WritableFrames() frames and returns how many it took.
+  size_t Write(const float* in, size_t frames);
+
+  // Writes up to `frames` output frames to `out` and returns how many.
+  // Output waits for latency_frames() of input after the segment before
+  // it; with `drain` set, whatever is buffered plays out instead, and
+  // stretching starts over with the next Write.
+  size_t Read(float* out, size_t frames, bool drain);
+
+  // Input frames written but not played yet
+  size_t buffered_frames() const;
+
+  // Input held back before a segment can be placed
+  size_t latency_frames() const { return 2 * hop_ + search_; }
+
+ private:
+  // Places the next segment and crossfades it into pending_. False when
+  // the input doesn't reach far enough yet.
+  bool Step();
+  // How well the segment at `candidate` continues the one at `target`,
+  // looking at every `step`th frame
+  double Similarity(size_t candidate, size_t target, size_t step) const;
+
+  int channels_ = 0;
+  size_t hop_ = 0;     // frames output per segment
+  size_t search_ = 0;  // frames either side of the ideal start searched
+  float speed_ = 1.0f;
+
+  // Rising half of the crossfade, hop_ long
+  std::vector<float> fade_;
+
+  // Input not played yet, interleaved. previous_ is where the last
+  // segment placed starts, and position_ where it ideally would have.
+  std::vector<float> input_;
+  size_t input_frames_ = 0;
+  size_t input_capacity_ = 0;
+  size_t previous_ = 0;
+  double position_ = 0.0;
+  bool primed_ = false;
+
+  // Output made by Step that Read hasn't taken yet
+  std::vector<float> pending_;
+  size_t pending_offset_ = 0;
+  size_t pending_frames_ = 0;
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_PCM_TIME_STRETCH_H_
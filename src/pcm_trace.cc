@@ -0,0 +1,163 @@
+#include "pcm_trace.h"
+
+#if defined(FLUTTER_PCM_SOUND_TRACE) && !defined(_WIN32)
+
+#if defined(__APPLE__)
+
+namespace flutter_pcm_sound {
+
+os_log_t TraceLog() {
+  static os_log_t log = os_log_create("flutter_pcm_sound", OS_LOG_CATEGORY_POINTS_OF_INTEREST);
+  return log;
+}
+
+}  // namespace flutter_pcm_sound
+
+#elif defined(__ANDROID__)
+
+#include <dlfcn.h>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// ATrace's entry points, resolved from libandroid.so. Sections need API 23
+// and counters API 29, and this library loads on older devices too.
+struct ATraceApi {
+  bool (*isEnabled)();
+  void (*beginSection)(const char* name);
+  void (*endSection)();
+  void (*setCounter)(const char* name, int64_t value);
+};
+
+// Loaded once; the library stays open for the life of the process.
+const ATraceApi& Api() {
+  static const ATraceApi api = [] {
+    ATraceApi a = {};
+    void* library = dlopen("libandroid.so", RTLD_NOW);
+    if (!library) {
+      return a;
+    }
+    a.isEnabled = reinterpret_cast<bool (*)()>(dlsym(library, "ATrace_isEnabled"));
+    a.beginSection = reinterpret_cast<void (*)(const char*)>(dlsym(library, "ATrace_beginSection"));
+    a.endSection = reinterpret_cast<void (*)()>(dlsym(library, "ATrace_endSection"));
+    a.setCounter = reinterpret_cast<void (*)(const char*, int64_t)>(dlsym(library, "ATrace_setCounter"));
+    if (!a.isEnabled || !a.beginSection || !a.endSection) {
+      a = {};
+    }
+    return a;
+  }();
+  return api;
+}
+
+// A section is always ended once begun, even if tracing stopped in between
+thread_local int open_sections = 0;
+
+}  // namespace
+
+void TraceBegin(const char* name) {
+  const ATraceApi& api = Api();
+  if (api.isEnabled && api.isEnabled()) {
+    api.beginSection(name);
+    open_sections++;
+  }
+}
+
+void TraceEnd() {
+  if (open_sections > 0) {
+    Api().endSection();
+    open_sections--;
+  }
+}
+
+void TraceInstant(const char* name) {
+  const ATraceApi& api = Api();
+  if (api.isEnabled && api.isEnabled()) {
+    api.beginSection(name);
+    api.endSection();
+  }
+}
+
+void TraceCounter(const char* name, int64_t value) {
+  const ATraceApi& api = Api();
+  if (api.setCounter && api.isEnabled()) {
+    api.setCounter(name, value);
+  }
+}
+
+}  // namespace flutter_pcm_sound
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+// The ftrace marker, opened once. Writing to it is cheap and doesn't
+// block, and the kernel drops the write while tracing is off. Without
+// access to tracefs, nothing is traced.
+int MarkerFd() {
+  static const int fd = [] {
+    int marker = open("/sys/kernel/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
+    if (marker < 0) {
+      marker = open("/sys/kernel/debug/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
+    }
+    return marker;
+  }();
+  return fd;
+}
+
+// One marker write per event, formatted on the stack
+void Mark(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+void Mark(const char* format, ...) {
+  int fd = MarkerFd();
+  if (fd < 0) {
+    return;
+  }
+  char line[128];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (length > 0) {
+    ssize_t ignored = write(fd, line, std::min<size_t>(length, sizeof(line) - 1));
+    (void)ignored;
+  }
+}
+
+}  // namespace
+
+// atrace's text format, which Perfetto and systrace parse into slices and
+// counters on the writing thread's track
+
+void TraceBegin(const char* name) {
+  Mark("B|%d|%s", getpid(), name);
+}
+
+void TraceEnd() {
+  Mark("E|%d", getpid());
+}
+
+void TraceInstant(const char* name) {
+  Mark("B|%d|%s", getpid(), name);
+  Mark("E|%d", getpid());
+}
+
+void TraceCounter(const char* name, int64_t value) {
+  Mark("C|%d|%s|%" PRId64, getpid(), name, value);
+}
+
+}  // namespace flutter_pcm_sound
+
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef FLUTTER_PLUGIN_PCM_TRACE_H_
+#define FLUTTER_PLUGIN_PCM_TRACE_H_
+
+// Trace points for the audio threads, so a dropout can be lined up with
+// the Flutter frame timeline in a system trace. They are compiled in only
+// when FLUTTER_PCM_SOUND_TRACE is defined, and expand to nothing
+// otherwise.
+//
+//   Linux    atrace-style events on the ftrace trace_marker, which Perfetto
+//            records with the linux.ftrace data source ("ftrace/print").
+//   Android  ATrace sections and counters, recorded by Perfetto's
+//            linux.ftrace data source with atrace_apps set to the app.
+//   Apple    os_signpost intervals and events under the "flutter_pcm_sound"
+//            subsystem, shown by Instruments' os_signpost instrument.
+//
+// Names must be string literals; os_signpost needs them at compile time.
+// Slice begin and end pair up per thread, so a slice must end on the
+// thread it began on.
+//
+//   PCM_TRACE_BEGIN(name) / PCM_TRACE_END(name)  a slice
+//   PCM_TRACE_SCOPE(name)                        a slice to the end of scope
+//   PCM_TRACE_INSTANT(name)                      a point in time
+//   PCM_TRACE_COUNTER(name, value)               a value over time
+
+#if defined(FLUTTER_PCM_SOUND_TRACE) && !defined(_WIN32)
+
+#if defined(__APPLE__)
+
+#include <os/availability.h>
+#include <os/log.h>
+#include <os/signpost.h>
+
+namespace flutter_pcm_sound {
+
+os_log_t TraceLog() API_AVAILABLE(ios(12.0), macos(10.14));
+
+}  // namespace flutter_pcm_sound
+
+// os_signpost needs iOS 12 and macOS 10.14; older systems trace nothing
+#define PCM_TRACE_SIGNPOST_(emit)                                \
+  do {                                                           \
+    if (__builtin_available(iOS 12.0, macOS 10.14, *)) {         \
+      os_log_t pcm_trace_log_ = flutter_pcm_sound::TraceLog();   \
+      if (os_signpost_enabled(pcm_trace_log_)) {                 \
+        emit;                                                    \
+      }                                                          \
+    }                                                            \
+  } while (0)
+
+#define PCM_TRACE_BEGIN(name) \
+  PCM_TRACE_SIGNPOST_(os_signpost_interval_begin(pcm_trace_log_, OS_SIGNPOST_ID_EXCLUSIVE, name))
+#define PCM_TRACE_END(name) \
+  PCM_TRACE_SIGNPOST_(os_signpost_interval_end(pcm_trace_log_, OS_SIGNPOST_ID_EXCLUSIVE, name))
+#define PCM_TRACE_INSTANT(name) \
+  PCM_TRACE_SIGNPOST_(os_signpost_event_emit(pcm_trace_log_, OS_SIGNPOST_ID_EXCLUSIVE, name))
+#define PCM_TRACE_COUNTER(name, value)                                                              \
+  PCM_TRACE_SIGNPOST_(os_signpost_event_emit(pcm_trace_log_, OS_SIGNPOST_ID_EXCLUSIVE, name, "%lld", \
+                                             static_cast<long long>(value)))
+
+#else
+
+#include <cstdint>
+
+namespace flutter_pcm_sound {
+
+// Cheap enough for the real-time threads: one write() to the trace
+// marker, or one ATrace call, and nothing at all while no trace is being
+// recorded.
+void TraceBegin(const char* name);
+void TraceEnd();
+void TraceInstant(const char* name);
+void TraceCounter(const char* name, int64_t value);
+
+}  // namespace flutter_pcm_sound
+
+#define PCM_TRACE_BEGIN(name) flutter_pcm_sound::TraceBegin(name)
+#define PCM_TRACE_END(name) flutter_pcm_sound::TraceEnd()
+#define PCM_TRACE_INSTANT(name) flutter_pcm_sound::TraceInstant(name)
+#define PCM_TRACE_COUNTER(name, value) flutter_pcm_sound::TraceCounter(name, static_cast<int64_t>(value))
+
+#endif
+
+#define PCM_TRACE_CONCAT_(a, b) a##b
+#define PCM_TRACE_CONCAT(a, b) PCM_TRACE_CONCAT_(a, b)
+
+// Ends the slice from a destructor, so early returns and continues end it
+// too
+#define PCM_TRACE_SCOPE(name)                                   \
+  PCM_TRACE_BEGIN(name);                                        \
+  struct PCM_TRACE_CONCAT(PcmTraceScope, __LINE__) {            \
+    ~PCM_TRACE_CONCAT(PcmTraceScope, __LINE__)() {              \
+      PCM_TRACE_END(name);                                      \
+    }                                                           \
+  } PCM_TRACE_CONCAT(pcm_trace_scope_, __LINE__)
+
+#else
+
+#define PCM_TRACE_BEGIN(name) \
+  do {                        \
+  } while (0)
+#define PCM_TRACE_END(name) \
+  do {                      \
+  } while (0)
+#define PCM_TRACE_INSTANT(name) \
+  do {                          \
+  } while (0)
+#define PCM_TRACE_COUNTER(name, value) \
+  do {                                 \
+  } while (0)
+#define PCM_TRACE_SCOPE(name) \
+  do {                        \
+  } while (0)
+
+#endif
+
+#endif  // FLUTTER_PLUGIN_PCM_TRACE_H_
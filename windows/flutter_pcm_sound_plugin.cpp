@@ -0,0 +1,552 @@
+#include "flutter_pcm_sound_plugin.h"
+
+// This must be included before many other Windows headers.
+#include <windows.h>
+
+#include <flutter/method_channel.h>
+#include <flutter/plugin_registrar_windows.h>
+#include <flutter/standard_method_codec.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "include/flutter_pcm_sound/flutter_pcm_sound_plugin_c_api.h"
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+
+// The registered instance, for the FFI feed entry point, and how many FFI
+// feeds are running on it, both guarded by ffi_mutex. The registrar owns
+// the instance, so instead of holding a reference a feed is counted, and
+// the destructor waits for the count to reach zero before anything goes.
+std::mutex ffi_mutex;
+std::condition_variable ffi_idle;
+FlutterPcmSoundPlugin* ffi_plugin = nullptr;
+int ffi_feeds = 0;
+
+// SetTimer id of the periodic OnStats push, on the top-level window
+constexpr UINT_PTR kStatsTimerId = 0x50434D53;
+
+const EncodableValue* Lookup(const EncodableMap* args, const char* key) {
+  if (!args) return nullptr;
+  auto it = args->find(EncodableValue(key));
+  return it == args->end() ? nullptr : &it->second;
+}
+
+// Reads an optional integer argument, falling back to `fallback`.
+int64_t LookupInt(const EncodableMap* args, const char* key, int64_t fallback) {
+  const EncodableValue* value = Lookup(args, key);
+  if (!value) return fallback;
+  if (const int32_t* i = std::get_if<int32_t>(value)) return *i;
+  if (const int64_t* l = std::get_if<int64_t>(value)) return *l;
+  return fallback;
+}
+
+bool LookupBool(const EncodableMap* args, const char* key, bool fallback) {
+  const EncodableValue* value = Lookup(args, key);
+  const bool* b = value ? std::get_if<bool>(value) : nullptr;
+  return b ? *b : fallback;
+}
+
+std::string LookupString(const EncodableMap* args, const char* key) {
+  const EncodableValue* value = Lookup(args, key);
+  const std::string* s = value ? std::get_if<std::string>(value) : nullptr;
+  return s ? *s : std::string();
+}
+
+// Maps the Dart `PcmFormat` name to the core's sample format.
+bool LookupFormat(const EncodableMap* args, SampleFormat* format) {
+  std::string name = LookupString(args, "sample_format");
+  if (name.empty() || name == "s16le") {
+    *format = SampleFormat::kS16;
+  } else if (name == "s24le") {
+    *format = SampleFormat::kS24;
+  } else if (name == "s32le") {
+    *format = SampleFormat::kS32;
+  } else if (name == "f32le") {
+    *format = SampleFormat::kF32;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* FormatName(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::kS24: return "s24le";
+    case SampleFormat::kS32: return "s32le";
+    case SampleFormat::kF32: return "f32le";
+    default: return "s16le";
+  }
+}
+
+ResampleQuality LookupResampleQuality(const EncodableMap* args) {
+  std::string name = LookupString(args, "resample_quality");
+  if (name == "low") return ResampleQuality::kLow;
+  if (name == "high") return ResampleQuality::kHigh;
+  return ResampleQuality::kMedium;
+}
+
+const char* ResampleQualityName(ResampleQuality quality) {
+  switch (quality) {
+    case ResampleQuality::kLow: return "low";
+    case ResampleQuality::kHigh: return "high";
+    default: return "medium";
+  }
+}
+
+EncodableValue StatsToValue(const PlaybackStats& stats) {
+  StatsSnapshot snapshot;
+  stats.Snapshot(&snapshot);
+  std::vector<int64_t> histogram(snapshot.latency_histogram, snapshot.latency_histogram + kLatencyBuckets);
+  EncodableMap map = {
+      {EncodableValue("underruns"), EncodableValue(static_cast<int64_t>(snapshot.underruns))},
+      {EncodableValue("device_errors"), EncodableValue(static_cast<int64_t>(snapshot.device_errors))},
+      {EncodableValue("recoveries"), EncodableValue(static_cast<int64_t>(snapshot.recoveries))},
+      {EncodableValue("recovery_us_total"), EncodableValue(static_cast<int64_t>(snapshot.recovery_ns_total / 1000))},
+      {EncodableValue("recovery_us_max"), EncodableValue(static_cast<int64_t>(snapshot.recovery_ns_max / 1000))},
+      {EncodableValue("queue_high_frames"), EncodableValue(static_cast<int64_t>(snapshot.queue_high_frames))},
+      {EncodableValue("device_callbacks"), EncodableValue(static_cast<int64_t>(snapshot.device_callbacks))},
+      {EncodableValue("feed_callbacks"), EncodableValue(static_cast<int64_t>(snapshot.feed_callbacks))},
+      {EncodableValue("bytes_fed"), EncodableValue(static_cast<int64_t>(snapshot.bytes_fed))},
+      {EncodableValue("bytes_played"), EncodableValue(static_cast<int64_t>(snapshot.bytes_played))},
+      {EncodableValue("latency_histogram"), EncodableValue(histogram)},
+  };
+  if (snapshot.has_queue_low) {
+    map[EncodableValue("queue_low_frames")] = EncodableValue(static_cast<int64_t>(snapshot.queue_low_frames));
+  }
+  return EncodableValue(map);
+}
+
+}  // namespace
+
+// static
+void FlutterPcmSoundPlugin::RegisterWithRegistrar(flutter::PluginRegistrarWindows* registrar) {
+  auto channel = std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
+      registrar->messenger(), "flutter_pcm_sound/methods", &flutter::StandardMethodCodec::GetInstance());
+
+  auto plugin = std::make_unique<FlutterPcmSoundPlugin>(registrar, std::move(channel));
+  {
+    std::lock_guard<std::mutex> lock(ffi_mutex);
+    ffi_plugin = plugin.get();
+  }
+  registrar->AddPlugin(std::move(plugin));
+}
+
+FlutterPcmSoundPlugin::FlutterPcmSoundPlugin(
+    flutter::PluginRegistrarWindows* registrar,
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel)
+    : registrar_(registrar), channel_(std::move(channel)), platform_thread_id_(GetCurrentThreadId()) {
+  channel_->SetMethodCallHandler([this](const auto& call, auto result) { HandleMethodCall(call, std::move(result)); });
+
+  // The render thread can't call into Flutter, so it posts this message to
+  // the top-level window and the platform thread answers it
+  feed_message_ = RegisterWindowMessageW(L"FlutterPcmSoundFeedRequest");
+  window_proc_id_ = registrar_->RegisterTopLevelWindowProcDelegate(
+      [this](HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+        return HandleWindowProc(hwnd, message, wparam, lparam);
+      });
+
+  player_ = std::make_unique<WasapiPlayer>([this]() { return PostFeedRequest(); });
+  file_done_message_ = RegisterWindowMessageW(L"FlutterPcmSoundFileDone");
+  file_player_ = std::make_unique<FilePlayer>(
+      [this](const uint8_t* data, size_t length) { return QueueFileSamples(data, length); },
+      [this](const std::string& error) { PostFileDone(error); });
+}
+
+FlutterPcmSoundPlugin::~FlutterPcmSoundPlugin() {
+  {
+    std::lock_guard<std::mutex> lock(ffi_mutex);
+    if (ffi_plugin == this) {
+      ffi_plugin = nullptr;
+    }
+  }
+  if (window_) {
+    KillTimer(window_, kStatsTimerId);
+  }
+  registrar_->UnregisterTopLevelWindowProcDelegate(window_proc_id_);
+  // Joins the file thread, which may be waiting for room in the queue
+  file_player_.reset();
+  // A feed that already found this instance may be blocked for room, or
+  // about to be. Closing the player ends the wait, and a feed that gets
+  // call_mutex_ after that finds it closed; then wait for them all.
+  {
+    std::lock_guard<std::mutex> lock(call_mutex_);
+    player_->Close();
+  }
+  {
+    std::unique_lock<std::mutex> lock(ffi_mutex);
+    ffi_idle.wait(lock, [] { return ffi_feeds == 0; });
+  }
+  player_.reset();
+}
+
+void FlutterPcmSoundPlugin::HandleMethodCall(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  const auto* args = std::get_if<EncodableMap>(method_call.arguments());
+  const std::string& method = method_call.method_name();
+  std::lock_guard<std::mutex> lock(call_mutex_);
+
+  if (method == "setLogLevel") {
+    result->Success(EncodableValue(true));
+  } else if (method == "setFeedThreshold") {
+    int64_t threshold = LookupInt(args, "feed_threshold", -1);
+    if (threshold < 0) {
+      result->Error("INVALID_ARGS", "feed_threshold required");
+      return;
+    }
+    player_->set_feed_threshold(static_cast<size_t>(threshold));
+    result->Success(EncodableValue(true));
+  } else if (method == "setup") {
+    Setup(args, result);
+  } else if (method == "feed") {
+    if (!player_->is_open()) {
+      result->Error("NOT_INITIALIZED", "WASAPI not initialized");
+      return;
+    }
+    const EncodableValue* buffer = Lookup(args, "buffer");
+    const auto* bytes = buffer ? std::get_if<std::vector<uint8_t>>(buffer) : nullptr;
+    if (!bytes) {
+      result->Error("INVALID_ARGS", "buffer required");
+      return;
+    }
+    if (LookupInt(args, "stream_id", 0) != 0) {
+      result->Error("INVALID_ARGS", "unknown stream_id");
+      return;
+    }
+    // How many frames were accepted, so producers can back off. Never
+    // blocks: this is the platform thread.
+    int64_t written = QueueSamples(bytes->data(), bytes->size(), nullptr);
+    result->Success(EncodableValue(written / static_cast<int64_t>(bytes_per_frame_)));
+  } else if (method == "prime") {
+    if (!player_->is_open()) {
+      result->Error("NOT_INITIALIZED", "WASAPI not initialized");
+      return;
+    }
+    player_->Prime();
+    result->Success(EncodableValue(true));
+  } else if (method == "startAt") {
+    if (!player_->primed()) {
+      result->Error("NOT_PRIMED", "call prime before startAt");
+      return;
+    }
+    player_->StartAt(LookupInt(args, "host_time_ns", 0));
+    result->Success(EncodableValue(true));
+  } else if (method == "flush" || method == "pause" || method == "resume") {
+    if (!player_->is_open()) {
+      result->Error("NOT_INITIALIZED", "WASAPI not initialized");
+      return;
+    }
+    if (method == "flush") {
+      // A file still being queued is cut off along with what it queued
+      file_player_->Stop();
+      player_->Flush();
+    } else if (method == "pause") {
+      player_->Pause();
+    } else {
+      player_->Resume();
+    }
+    result->Success(EncodableValue(true));
+  } else if (method == "getPlaybackPosition") {
+    uint64_t frames = 0;
+    int64_t host_time_ns = 0;
+    player_->GetPosition(&frames, &host_time_ns);
+    bool running = player_->is_open() && !player_->primed() && !player_->paused();
+    result->Success(EncodableValue(EncodableMap{
+        {EncodableValue("frames"), EncodableValue(static_cast<int64_t>(frames))},
+        {EncodableValue("host_time_ns"), EncodableValue(host_time_ns)},
+        {EncodableValue("running"), EncodableValue(running)},
+    }));
+  } else if (method == "playFile") {
+    PlayFile(args, result);
+  } else if (method == "stopFile") {
+    file_player_->Stop();
+    result->Success(EncodableValue(true));
+  } else if (method == "getStats") {
+    result->Success(StatsToValue(player_->stats()));
+  } else if (method == "setStatsInterval") {
+    // Pushes OnStats every interval_ms; 0 stops it
+    int64_t interval_ms = LookupInt(args, "interval_ms", 0);
+    HWND window = Window();
+    if (!window) {
+      result->Error("WASAPI_ERROR", "no window to run the stats timer on");
+      return;
+    }
+    KillTimer(window, kStatsTimerId);
+    if (interval_ms > 0) {
+      SetTimer(window, kStatsTimerId, static_cast<UINT>(interval_ms), nullptr);
+    }
+    result->Success(EncodableValue(true));
+  } else if (method == "release") {
+    file_player_->Stop();
+    player_->Close();
+    result->Success(EncodableValue(true));
+  } else {
+    result->NotImplemented();
+  }
+}
+
+void FlutterPcmSoundPlugin::Setup(const EncodableMap* args,
+                                  std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>>& result) {
+  WasapiConfig config;
+  config.sample_rate = static_cast<int>(LookupInt(args, "sample_rate", 0));
+  config.channels = static_cast<int>(LookupInt(args, "num_channels", 0));
+  if (!LookupFormat(args, &config.format)) {
+    result->Error("INVALID_ARGS", "unsupported sample_format");
+    return;
+  }
+  config.low_latency = LookupString(args, "latency_profile") == "lowLatency";
+  config.buffer_frames = static_cast<int>(LookupInt(args, "buffer_frames", 0));
+  config.exclusive = LookupBool(args, "exclusive_mode", false);
+  config.resample_quality = LookupResampleQuality(args);
+  config.max_queue_us = LookupInt(args, "max_queue_us", kDefaultMaxQueueMicros);
+  FeedPolicy feed_policy;
+  std::string feed_policy_name = LookupString(args, "feed_policy");
+  if (!ParseFeedPolicy(feed_policy_name.empty() ? nullptr : feed_policy_name.c_str(), &feed_policy)) {
+    result->Error("INVALID_ARGS", "unknown feed_policy");
+    return;
+  }
+
+  // Feed requests need somewhere to go before the render thread starts
+  Window();
+
+  // Opening again empties the queue under the file thread
+  file_player_->Stop();
+  WasapiStreamInfo info;
+  std::string error;
+  if (!player_->Open(config, &info, &error)) {
+    result->Error("WASAPI_ERROR", error);
+    return;
+  }
+  sample_rate_ = config.sample_rate;
+  bytes_per_frame_ = BytesPerSample(config.format) * config.channels;
+  config_ = config;
+  feed_policy_ = feed_policy;
+
+  EncodableMap response = {
+      {EncodableValue("stream_id"), EncodableValue(0)},
+      {EncodableValue("sample_rate"), EncodableValue(config.sample_rate)},
+      {EncodableValue("device_sample_rate"), EncodableValue(info.device_rate)},
+      {EncodableValue("num_channels"), EncodableValue(config.channels)},
+      {EncodableValue("sample_format"), EncodableValue(FormatName(config.format))},
+      {EncodableValue("device_sample_format"), EncodableValue(FormatName(info.device_format))},
+      {EncodableValue("device_channels"), EncodableValue(info.device_channels)},
+      {EncodableValue("buffer_frames"), EncodableValue(static_cast<int64_t>(info.buffer_frames))},
+      {EncodableValue("period_frames"), EncodableValue(static_cast<int64_t>(info.period_frames))},
+      {EncodableValue("max_queue_frames"),
+       EncodableValue(static_cast<int64_t>(QueueBytesFor(config.max_queue_us, config.sample_rate, bytes_per_frame_) /
+                                           bytes_per_frame_))},
+      {EncodableValue("feed_policy"), EncodableValue(FeedPolicyName(feed_policy))},
+      {EncodableValue("latency_profile"), EncodableValue(config.low_latency ? "lowLatency" : "standard")},
+      {EncodableValue("exclusive_mode"), EncodableValue(info.exclusive)},
+      {EncodableValue("realtime_granted"), EncodableValue(info.mmcss_granted)},
+      {EncodableValue("realtime_method"), EncodableValue(info.mmcss_granted ? "mmcss" : "none")},
+  };
+  if (info.resampling) {
+    response[EncodableValue("resample_quality")] = EncodableValue(ResampleQualityName(config.resample_quality));
+  }
+  result->Success(EncodableValue(response));
+}
+
+// Plays a WAV or raw PCM file, queued behind whatever was fed before it.
+// The file is mapped and fed into the sample queue by the file player's
+// thread, converted to the setup format; Dart hears OnFileDone once all of
+// it is queued.
+void FlutterPcmSoundPlugin::PlayFile(const EncodableMap* args,
+                                     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>>& result) {
+  if (!player_->is_open()) {
+    result->Error("NOT_INITIALIZED", "WASAPI not initialized");
+    return;
+  }
+  std::string path = LookupString(args, "path");
+  if (path.empty()) {
+    result->Error("INVALID_ARGS", "path required");
+    return;
+  }
+  file_player_->Stop();
+
+  std::string error;
+  auto file = std::make_unique<MappedFile>();
+  if (!file->Open(path, &error)) {
+    result->Error("FILE_ERROR", error);
+    return;
+  }
+  std::unique_ptr<PcmSource> source;
+  const EncodableValue* raw_value = Lookup(args, "raw");
+  const auto* raw = raw_value ? std::get_if<EncodableMap>(raw_value) : nullptr;
+  if (raw) {
+    SampleFormat raw_format;
+    if (!LookupFormat(raw, &raw_format)) {
+      result->Error("INVALID_ARGS", "unknown raw sample_format");
+      return;
+    }
+    source = OpenRawSource(std::move(file), raw_format, static_cast<int>(LookupInt(raw, "sample_rate", 0)),
+                           static_cast<int>(LookupInt(raw, "num_channels", 0)), &error);
+  } else if (IsWav(file->data(), file->size())) {
+    source = OpenWavSource(std::move(file), &error);
+  } else {
+    error = "only WAV and raw PCM files can be played on Windows";
+  }
+  if (!source) {
+    result->Error("UNSUPPORTED_FORMAT", error);
+    return;
+  }
+
+  file_path_ = path;
+  SourceInfo info = source->info();
+  if (!file_player_->Start(std::move(source), config_.sample_rate, config_.channels, config_.format,
+                           config_.resample_quality, &error)) {
+    result->Error("UNSUPPORTED_FORMAT", error);
+    return;
+  }
+  EncodableMap response = {
+      {EncodableValue("sample_rate"), EncodableValue(info.sample_rate)},
+      {EncodableValue("num_channels"), EncodableValue(info.channels)},
+  };
+  if (info.frames >= 0) {
+    response[EncodableValue("duration_us")] = EncodableValue(info.frames * 1000000 / info.sample_rate);
+  }
+  result->Success(EncodableValue(response));
+}
+
+size_t FlutterPcmSoundPlugin::QueueFileSamples(const uint8_t* data, size_t length) {
+  std::unique_lock<std::mutex> lock(call_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !player_->is_open()) {
+    return 0;
+  }
+  return player_->Write(data, length, FeedPolicy::kPartial, nullptr);
+}
+
+void FlutterPcmSoundPlugin::PostFileDone(const std::string& error) {
+  {
+    std::lock_guard<std::mutex> lock(file_done_mutex_);
+    files_done_.emplace_back(file_path_, error);
+  }
+  if (window_) {
+    PostMessageW(window_, file_done_message_, 0, 0);
+  }
+}
+
+int64_t FlutterPcmSoundPlugin::FeedFromFfi(const uint8_t* data, size_t length) {
+  std::unique_lock<std::mutex> lock(call_mutex_);
+  // A blocked feed on the platform thread would hold off the calls that
+  // end it
+  bool can_block = GetCurrentThreadId() != platform_thread_id_;
+  return QueueSamples(data, length, can_block ? &lock : nullptr);
+}
+
+int64_t FlutterPcmSoundPlugin::QueueSamples(const uint8_t* data, size_t length, std::unique_lock<std::mutex>* lock) {
+  if (!player_->is_open()) {
+    return -1;
+  }
+  size_t written = player_->Write(data, length, feed_policy_, lock);
+  if (written < length) {
+    const char* what = feed_policy_ == FeedPolicy::kPartial ? "dropped " : "rejected ";
+    OutputDebugStringA(("Sample queue full - " + std::string(what) + std::to_string(length - written) + " bytes\n").c_str());
+  }
+  return static_cast<int64_t>(written);
+}
+
+HWND FlutterPcmSoundPlugin::Window() {
+  // The view is only parented to the top-level window after plugins
+  // register, so look it up on first use
+  if (!window_) {
+    if (flutter::FlutterView* view = registrar_->GetView()) {
+      window_ = GetAncestor(view->GetNativeWindow(), GA_ROOT);
+    }
+  }
+  return window_;
+}
+
+bool FlutterPcmSoundPlugin::PostFeedRequest() {
+  if (!window_) {
+    return false;
+  }
+  // A message already on its way carries this request too
+  if (feed_message_pending_.exchange(true)) {
+    return true;
+  }
+  if (!PostMessageW(window_, feed_message_, 0, 0)) {
+    feed_message_pending_ = false;
+    return false;
+  }
+  return true;
+}
+
+std::optional<LRESULT> FlutterPcmSoundPlugin::HandleWindowProc(HWND hwnd, UINT message, WPARAM wparam,
+                                                               LPARAM lparam) {
+  if (message == WM_TIMER && wparam == kStatsTimerId) {
+    channel_->InvokeMethod("OnStats", std::make_unique<EncodableValue>(StatsToValue(player_->stats())));
+    return 0;
+  }
+  if (message == file_done_message_) {
+    std::vector<std::pair<std::string, std::string>> done;
+    {
+      std::lock_guard<std::mutex> lock(file_done_mutex_);
+      done.swap(files_done_);
+    }
+    for (const auto& file : done) {
+      EncodableMap arguments = {{EncodableValue("path"), EncodableValue(file.first)}};
+      if (!file.second.empty()) {
+        arguments[EncodableValue("error")] = EncodableValue(file.second);
+      }
+      channel_->InvokeMethod("OnFileDone", std::make_unique<EncodableValue>(arguments));
+    }
+    return 0;
+  }
+  if (message != feed_message_) {
+    return std::nullopt;
+  }
+  feed_message_pending_ = false;
+  player_->stats().RecordFeedCallback();
+
+  // remaining: frames (at the Dart sample rate) left to play before the
+  // endpoint runs dry, counting both the sample queue and the endpoint
+  // buffer. requested: how many more would keep one period beyond the
+  // threshold.
+  size_t remaining_frames = player_->pending_remaining_frames();
+  size_t requested_frames = player_->pending_requested_frames();
+  int64_t remaining_us = sample_rate_ > 0 ? static_cast<int64_t>(remaining_frames) * 1000000 / sample_rate_ : 0;
+  auto arguments = std::make_unique<EncodableValue>(EncodableMap{
+      {EncodableValue("remaining_frames"), EncodableValue(static_cast<int64_t>(remaining_frames))},
+      {EncodableValue("remaining_us"), EncodableValue(remaining_us)},
+      {EncodableValue("requested_frames"), EncodableValue(static_cast<int64_t>(requested_frames))},
+      {EncodableValue("requested_bytes"), EncodableValue(static_cast<int64_t>(requested_frames * bytes_per_frame_))},
+  });
+  channel_->InvokeMethod("OnFeedSamples", std::move(arguments));
+  return 0;
+}
+
+}  // namespace flutter_pcm_sound
+
+int64_t flutter_pcm_sound_ffi_feed(const uint8_t* data, int64_t length) {
+  if (length < 0) {
+    return -1;
+  }
+  flutter_pcm_sound::FlutterPcmSoundPlugin* plugin;
+  {
+    std::lock_guard<std::mutex> lock(flutter_pcm_sound::ffi_mutex);
+    plugin = flutter_pcm_sound::ffi_plugin;
+    if (!plugin) {
+      return -1;
+    }
+    flutter_pcm_sound::ffi_feeds++;
+  }
+  int64_t written = plugin->FeedFromFfi(data, static_cast<size_t>(length));
+  {
+    std::lock_guard<std::mutex> lock(flutter_pcm_sound::ffi_mutex);
+    if (--flutter_pcm_sound::ffi_feeds == 0) {
+      flutter_pcm_sound::ffi_idle.notify_all();
+    }
+  }
+  return written;
+}
@@ -0,0 +1,104 @@
+#ifndef FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_H_
+#define FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_H_
+
+#include <flutter/method_channel.h>
+#include <flutter/plugin_registrar_windows.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pcm_file_player.h"
+#include "wasapi_player.h"
+
+namespace flutter_pcm_sound {
+
+class FlutterPcmSoundPlugin : public flutter::Plugin {
+ public:
+  static void RegisterWithRegistrar(flutter::PluginRegistrarWindows* registrar);
+
+  FlutterPcmSoundPlugin(flutter::PluginRegistrarWindows* registrar,
+                        std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel);
+
+  virtual ~FlutterPcmSoundPlugin();
+
+  // Disallow copy and assign.
+  FlutterPcmSoundPlugin(const FlutterPcmSoundPlugin&) = delete;
+  FlutterPcmSoundPlugin& operator=(const FlutterPcmSoundPlugin&) = delete;
+
+  // flutter_pcm_sound_ffi_feed, on whatever thread Dart calls it from.
+  int64_t FeedFromFfi(const uint8_t* data, size_t length);
+
+ private:
+  // Queues samples for the render thread under the setup's feed policy and
+  // returns how many bytes it took, or -1 before setup. Shared by `feed`
+  // and the FFI entry point. Only a caller passing the call_mutex_ `lock`
+  // it holds can block, and it lets go of it while it waits.
+  int64_t QueueSamples(const uint8_t* data, size_t length, std::unique_lock<std::mutex>* lock);
+
+  // Called when a message is sent from Flutter.
+  void HandleMethodCall(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                        std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  void Setup(const flutter::EncodableMap* args,
+             std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>>& result);
+
+  void PlayFile(const flutter::EncodableMap* args,
+                std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>>& result);
+
+  // File thread. The file player's writer: queues what fits without
+  // waiting for call_mutex_, which Stop is called with.
+  size_t QueueFileSamples(const uint8_t* data, size_t length);
+
+  // File thread. Hands the result to the platform thread.
+  void PostFileDone(const std::string& error);
+
+  // Platform thread. The top-level window, once there is one.
+  HWND Window();
+
+  // Render thread. Coalesces feed requests into one posted message.
+  // Returns false when there is no window to post to or the post failed.
+  bool PostFeedRequest();
+
+  // Platform thread. Receives the posted feed request message and the
+  // stats timer.
+  std::optional<LRESULT> HandleWindowProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam);
+
+  flutter::PluginRegistrarWindows* registrar_;
+  std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel_;
+  // Registration runs on the platform thread; FFI feeds from it never block
+  DWORD platform_thread_id_;
+  int window_proc_id_ = -1;
+  HWND window_ = nullptr;
+  UINT feed_message_ = 0;
+  std::atomic<bool> feed_message_pending_{false};
+
+  std::unique_ptr<WasapiPlayer> player_;
+  int sample_rate_ = 0;
+  size_t bytes_per_frame_ = 0;
+  // What setup opened the stream with, for converting files to it
+  WasapiConfig config_;
+  // What feed does with samples that don't fit in the queue
+  FeedPolicy feed_policy_ = FeedPolicy::kPartial;
+
+  // playFile: queues a file into the sample queue from its own thread.
+  // file_path_ is what it is playing; only changed while it is stopped.
+  std::unique_ptr<FilePlayer> file_player_;
+  std::string file_path_;
+  // Finished files (path, error) waiting for file_done_message_
+  UINT file_done_message_ = 0;
+  std::mutex file_done_mutex_;
+  std::vector<std::pair<std::string, std::string>> files_done_;
+
+  // Serializes method calls with flutter_pcm_sound_ffi_feed, which Dart
+  // calls on its own thread. The render thread never takes it.
+  std::mutex call_mutex_;
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_H_
@@ -0,0 +1,12 @@
+#include "include/flutter_pcm_sound/flutter_pcm_sound_plugin_c_api.h"
+
+#include <flutter/plugin_registrar_windows.h>
+
+#include "flutter_pcm_sound_plugin.h"
+
+void FlutterPcmSoundPluginCApiRegisterWithRegistrar(
+    FlutterDesktopPluginRegistrarRef registrar) {
+  flutter_pcm_sound::FlutterPcmSoundPlugin::RegisterWithRegistrar(
+      flutter::PluginRegistrarManager::GetInstance()
+          ->GetRegistrar<flutter::PluginRegistrarWindows>(registrar));
+}
@@ -0,0 +1,29 @@
+#ifndef FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_C_API_H_
+#define FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_C_API_H_
+
+#include <flutter_plugin_registrar.h>
+#include <stdint.h>
+
+#ifdef FLUTTER_PLUGIN_IMPL
+#define FLUTTER_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define FLUTTER_PLUGIN_EXPORT __declspec(dllimport)
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+FLUTTER_PLUGIN_EXPORT void FlutterPcmSoundPluginCApiRegisterWithRegistrar(
+    FlutterDesktopPluginRegistrarRef registrar);
+
+// Queues `length` bytes of samples, in the format passed to setup,
+// without going through the method channel. Called from Dart via FFI.
+// Returns the number of bytes queued, or -1 if setup hasn't been called.
+FLUTTER_PLUGIN_EXPORT int64_t flutter_pcm_sound_ffi_feed(const uint8_t* data, int64_t length);
+
+#if defined(__cplusplus)
+}  // extern "C"
+#endif
+
+#endif  // FLUTTER_PLUGIN_FLUTTER_PCM_SOUND_PLUGIN_C_API_H_
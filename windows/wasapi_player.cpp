@@ -0,0 +1,694 @@
+#include "wasapi_player.h"
+
+#include <avrt.h>
+#include <mmreg.h>
+#include <ksmedia.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+using Microsoft::WRL::ComPtr;
+
+namespace flutter_pcm_sound {
+
+namespace {
+
+constexpr REFERENCE_TIME kHnsPerSecond = 10000000;
+
+// Shared mode buffer for the standard profile
+constexpr REFERENCE_TIME kDefaultSharedBuffer = kHnsPerSecond / 10;
+
+std::string HrError(const char* operation, HRESULT hr) {
+  char message[128];
+  snprintf(message, sizeof(message), "%s failed (0x%08lx)", operation, static_cast<unsigned long>(hr));
+  return message;
+}
+
+REFERENCE_TIME FramesToHns(size_t frames, int rate) {
+  return static_cast<REFERENCE_TIME>(static_cast<double>(kHnsPerSecond) * frames / rate + 0.5);
+}
+
+size_t HnsToFrames(REFERENCE_TIME hns, int rate) {
+  return static_cast<size_t>(static_cast<double>(hns) * rate / kHnsPerSecond + 0.5);
+}
+
+// Maps an endpoint format onto the core's layouts. 24-bit audio in a
+// 32-bit container is left-justified on Windows, unlike kS24, so it is
+// written as full 32-bit samples.
+bool ToSampleFormat(const WAVEFORMATEX* wfx, SampleFormat* format) {
+  WORD tag = wfx->wFormatTag;
+  if (tag == WAVE_FORMAT_EXTENSIBLE) {
+    const auto* extensible = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(wfx);
+    if (IsEqualGUID(extensible->SubFormat, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT)) {
+      tag = WAVE_FORMAT_IEEE_FLOAT;
+    } else if (IsEqualGUID(extensible->SubFormat, KSDATAFORMAT_SUBTYPE_PCM)) {
+      tag = WAVE_FORMAT_PCM;
+    }
+  }
+  if (tag == WAVE_FORMAT_IEEE_FLOAT && wfx->wBitsPerSample == 32) {
+    *format = SampleFormat::kF32;
+  } else if (tag == WAVE_FORMAT_PCM && wfx->wBitsPerSample == 16) {
+    *format = SampleFormat::kS16;
+  } else if (tag == WAVE_FORMAT_PCM && wfx->wBitsPerSample == 32) {
+    *format = SampleFormat::kS32;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+WAVEFORMATEXTENSIBLE MakeFormat(SampleFormat format, int rate, int channels) {
+  WAVEFORMATEXTENSIBLE wfx = {};
+  WORD bits = static_cast<WORD>(BytesPerSample(format) * 8);
+  wfx.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+  wfx.Format.nChannels = static_cast<WORD>(channels);
+  wfx.Format.nSamplesPerSec = static_cast<DWORD>(rate);
+  wfx.Format.wBitsPerSample = bits;
+  wfx.Format.nBlockAlign = static_cast<WORD>(channels * bits / 8);
+  wfx.Format.nAvgBytesPerSec = wfx.Format.nSamplesPerSec * wfx.Format.nBlockAlign;
+  wfx.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+  wfx.Samples.wValidBitsPerSample = bits;
+  wfx.dwChannelMask = channels == 1 ? SPEAKER_FRONT_CENTER : channels == 2 ? KSAUDIO_SPEAKER_STEREO : 0;
+  wfx.SubFormat = format == SampleFormat::kF32 ? KSDATAFORMAT_SUBTYPE_IEEE_FLOAT : KSDATAFORMAT_SUBTYPE_PCM;
+  return wfx;
+}
+
+struct CoTaskMemDeleter {
+  void operator()(void* p) const { CoTaskMemFree(p); }
+};
+
+}  // namespace
+
+WasapiPlayer::WasapiPlayer(FeedRequestCallback on_feed_request) : on_feed_request_(std::move(on_feed_request)) {}
+
+WasapiPlayer::~WasapiPlayer() {
+  Close();
+}
+
+HRESULT WasapiPlayer::Activate() {
+  audio_client_.Reset();
+  return device_->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr,
+                           reinterpret_cast<void**>(audio_client_.GetAddressOf()));
+}
+
+bool WasapiPlayer::Open(const WasapiConfig& config, WasapiStreamInfo* info, std::string* error) {
+  Close();
+
+  sample_rate_ = config.sample_rate;
+  channels_ = config.channels;
+  format_ = config.format;
+  bytes_per_frame_ = BytesPerSample(format_) * channels_;
+  if (sample_rate_ <= 0 || channels_ <= 0) {
+    *error = "sample_rate and num_channels must be positive";
+    return false;
+  }
+
+  ComPtr<IMMDeviceEnumerator> enumerator;
+  HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumerator));
+  if (FAILED(hr)) {
+    *error = HrError("CoCreateInstance(MMDeviceEnumerator)", hr);
+    return false;
+  }
+  hr = enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device_);
+  if (FAILED(hr)) {
+    *error = HrError("GetDefaultAudioEndpoint", hr);
+    Close();
+    return false;
+  }
+  hr = Activate();
+  if (FAILED(hr)) {
+    *error = HrError("IMMDevice::Activate", hr);
+    Close();
+    return false;
+  }
+
+  exclusive_ = config.exclusive;
+  hr = exclusive_ ? InitializeExclusive(config, error) : InitializeShared(config, error);
+  if (FAILED(hr)) {
+    Close();
+    return false;
+  }
+  if (channels_ != device_channels_ && channels_ > 2) {
+    *error = "can't map " + std::to_string(channels_) + " channels onto a " + std::to_string(device_channels_) +
+             " channel endpoint";
+    Close();
+    return false;
+  }
+
+  hr = audio_client_->GetBufferSize(&device_buffer_frames_);
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::GetBufferSize", hr);
+    Close();
+    return false;
+  }
+  audio_event_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+  stop_event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  control_event_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+  if (!audio_event_ || !stop_event_ || !control_event_) {
+    *error = HrError("CreateEvent", HRESULT_FROM_WIN32(GetLastError()));
+    Close();
+    return false;
+  }
+  hr = audio_client_->SetEventHandle(audio_event_);
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::SetEventHandle", hr);
+    Close();
+    return false;
+  }
+  hr = audio_client_->GetService(IID_PPV_ARGS(&render_client_));
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::GetService(IAudioRenderClient)", hr);
+    Close();
+    return false;
+  }
+
+  // Queue and render thread scratch. Each event converts at most one
+  // endpoint buffer's worth of input at a time.
+  if (!samples_.Reset(QueueBytesFor(config.max_queue_us, sample_rate_, bytes_per_frame_))) {
+    *error = "Failed to allocate sample queue";
+    Close();
+    return false;
+  }
+  resampling_ = device_rate_ != sample_rate_;
+  chunk_frames_ = static_cast<size_t>(device_buffer_frames_) * sample_rate_ / device_rate_ + 1;
+  size_t chunk_out_frames = chunk_frames_;
+  if (resampling_) {
+    if (!resampler_.Configure(sample_rate_, device_rate_, channels_, config.resample_quality, chunk_frames_)) {
+      *error = "can't resample from " + std::to_string(sample_rate_) + " Hz to " + std::to_string(device_rate_) + " Hz";
+      Close();
+      return false;
+    }
+    chunk_out_frames = resampler_.MaxOutputFrames(chunk_frames_);
+  }
+  chunk_bytes_.assign(chunk_frames_ * bytes_per_frame_, 0);
+  chunk_float_.assign(chunk_frames_ * channels_, 0.0f);
+  resampled_.assign(chunk_out_frames * channels_, 0.0f);
+  fifo_.assign((device_buffer_frames_ + chunk_out_frames) * device_channels_, 0.0f);
+  fifo_frames_ = 0;
+  did_request_feed_ = false;
+  // Nothing has played yet, so the empty endpoint isn't an underrun
+  was_starved_ = true;
+  stats_.Reset();
+  start_held_ = false;
+  start_at_ns_ = 0;
+  frames_handed_ = 0;
+  position_seq_ = 0;
+  position_frames_ = 0;
+  position_time_ns_ = 0;
+  flush_to_ = 0;
+  flush_requests_ = 0;
+  flushes_done_ = 0;
+  paused_ = false;
+  stream_stopped_ = false;
+
+  WriteSilentBuffer();
+  hr = audio_client_->Start();
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::Start", hr);
+    Close();
+    return false;
+  }
+
+  HANDLE started = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  bool mmcss_granted = false;
+  render_thread_ = std::thread(&WasapiPlayer::RenderThread, this, started, &mmcss_granted);
+  WaitForSingleObject(started, INFINITE);
+  CloseHandle(started);
+
+  info->device_format = device_format_;
+  info->device_channels = device_channels_;
+  info->device_rate = device_rate_;
+  info->resampling = resampling_;
+  info->exclusive = exclusive_;
+  info->buffer_frames = static_cast<size_t>(device_buffer_frames_) * sample_rate_ / device_rate_;
+  info->period_frames = static_cast<size_t>(device_period_frames_) * sample_rate_ / device_rate_;
+  info->mmcss_granted = mmcss_granted;
+  return true;
+}
+
+HRESULT WasapiPlayer::InitializeExclusive(const WasapiConfig& config, std::string* error) {
+  std::unique_ptr<WAVEFORMATEX, CoTaskMemDeleter> mix;
+  WAVEFORMATEX* mix_format = nullptr;
+  HRESULT hr = audio_client_->GetMixFormat(&mix_format);
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::GetMixFormat", hr);
+    return hr;
+  }
+  mix.reset(mix_format);
+
+  // Prefer the fed layout, which needs no conversion at all, then the
+  // engine's rate and channels in the widest sample format the device
+  // takes. kS24 is low-justified, so it never passes straight through.
+  struct Candidate {
+    SampleFormat format;
+    int rate;
+    int channels;
+  };
+  std::vector<Candidate> candidates;
+  if (config.format != SampleFormat::kS24) {
+    candidates.push_back({config.format, config.sample_rate, config.channels});
+  }
+  for (int rate : {config.sample_rate, static_cast<int>(mix->nSamplesPerSec)}) {
+    for (int channels : {config.channels, static_cast<int>(mix->nChannels)}) {
+      for (SampleFormat format : {SampleFormat::kF32, SampleFormat::kS32, SampleFormat::kS16}) {
+        candidates.push_back({format, rate, channels});
+      }
+    }
+  }
+
+  WAVEFORMATEXTENSIBLE wfx = {};
+  bool found = false;
+  for (const Candidate& candidate : candidates) {
+    wfx = MakeFormat(candidate.format, candidate.rate, candidate.channels);
+    if (audio_client_->IsFormatSupported(AUDCLNT_SHAREMODE_EXCLUSIVE, &wfx.Format, nullptr) == S_OK) {
+      device_format_ = candidate.format;
+      device_rate_ = candidate.rate;
+      device_channels_ = candidate.channels;
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    *error = "the endpoint doesn't accept a PCM format in exclusive mode";
+    return AUDCLNT_E_UNSUPPORTED_FORMAT;
+  }
+
+  REFERENCE_TIME default_period = 0;
+  REFERENCE_TIME min_period = 0;
+  hr = audio_client_->GetDevicePeriod(&default_period, &min_period);
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::GetDevicePeriod", hr);
+    return hr;
+  }
+  REFERENCE_TIME period = config.low_latency ? min_period : default_period;
+  hr = audio_client_->Initialize(AUDCLNT_SHAREMODE_EXCLUSIVE, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, period, period,
+                                 &wfx.Format, nullptr);
+  if (hr == AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED) {
+    // The device wants a whole number of its own blocks per period;
+    // retry with the aligned size it reports, on a fresh client
+    UINT32 aligned_frames = 0;
+    hr = audio_client_->GetBufferSize(&aligned_frames);
+    if (SUCCEEDED(hr)) {
+      period = FramesToHns(aligned_frames, device_rate_);
+      hr = Activate();
+    }
+    if (SUCCEEDED(hr)) {
+      hr = audio_client_->Initialize(AUDCLNT_SHAREMODE_EXCLUSIVE, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, period, period,
+                                     &wfx.Format, nullptr);
+    }
+  }
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::Initialize(exclusive)", hr);
+    return hr;
+  }
+
+  // One event per buffer: the device plays one while we fill the other
+  device_period_frames_ = static_cast<UINT32>(HnsToFrames(period, device_rate_));
+  return S_OK;
+}
+
+HRESULT WasapiPlayer::InitializeShared(const WasapiConfig& config, std::string* error) {
+  std::unique_ptr<WAVEFORMATEX, CoTaskMemDeleter> mix;
+  WAVEFORMATEX* mix_format = nullptr;
+  HRESULT hr = audio_client_->GetMixFormat(&mix_format);
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::GetMixFormat", hr);
+    return hr;
+  }
+  mix.reset(mix_format);
+
+  // Run in the engine's own format, converting with the core rather than
+  // AUTOCONVERTPCM, so the engine never resamples behind our back
+  if (!ToSampleFormat(mix.get(), &device_format_)) {
+    *error = "unsupported engine mix format";
+    return AUDCLNT_E_UNSUPPORTED_FORMAT;
+  }
+  device_rate_ = static_cast<int>(mix->nSamplesPerSec);
+  device_channels_ = mix->nChannels;
+
+  REFERENCE_TIME default_period = 0;
+  REFERENCE_TIME min_period = 0;
+  hr = audio_client_->GetDevicePeriod(&default_period, &min_period);
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::GetDevicePeriod", hr);
+    return hr;
+  }
+  device_period_frames_ = static_cast<UINT32>(HnsToFrames(default_period, device_rate_));
+
+  if (config.low_latency) {
+    // Windows 10 engines can run shorter periods than the default 10ms
+    ComPtr<IAudioClient3> client3;
+    UINT32 default_frames = 0, fundamental_frames = 0, min_frames = 0, max_frames = 0;
+    if (SUCCEEDED(audio_client_.As(&client3)) &&
+        SUCCEEDED(client3->GetSharedModeEnginePeriod(mix.get(), &default_frames, &fundamental_frames, &min_frames,
+                                                     &max_frames)) &&
+        SUCCEEDED(client3->InitializeSharedAudioStream(AUDCLNT_STREAMFLAGS_EVENTCALLBACK, min_frames, mix.get(),
+                                                       nullptr))) {
+      device_period_frames_ = min_frames;
+      return S_OK;
+    }
+    // Older engines: the smallest buffer the engine allows, on a fresh
+    // client in case the attempt above got partway
+    hr = Activate();
+    if (FAILED(hr)) {
+      *error = HrError("IMMDevice::Activate", hr);
+      return hr;
+    }
+    hr = audio_client_->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 0, 0, mix.get(),
+                                   nullptr);
+  } else {
+    REFERENCE_TIME duration =
+        config.buffer_frames > 0 ? FramesToHns(config.buffer_frames, config.sample_rate) : kDefaultSharedBuffer;
+    hr = audio_client_->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, duration, 0,
+                                   mix.get(), nullptr);
+  }
+  if (FAILED(hr)) {
+    *error = HrError("IAudioClient::Initialize(shared)", hr);
+    return hr;
+  }
+  return S_OK;
+}
+
+void WasapiPlayer::Close() {
+  feed_waiter_.Cancel();
+  if (render_thread_.joinable()) {
+    SetEvent(stop_event_);
+    render_thread_.join();
+  }
+  if (audio_client_) {
+    audio_client_->Stop();
+  }
+  render_client_.Reset();
+  audio_client_.Reset();
+  device_.Reset();
+  if (audio_event_) {
+    CloseHandle(audio_event_);
+    audio_event_ = nullptr;
+  }
+  if (stop_event_) {
+    CloseHandle(stop_event_);
+    stop_event_ = nullptr;
+  }
+  if (control_event_) {
+    CloseHandle(control_event_);
+    control_event_ = nullptr;
+  }
+  samples_.Clear();
+  resampler_.Reset();
+  fifo_frames_ = 0;
+}
+
+size_t WasapiPlayer::Write(const uint8_t* data, size_t length, FeedPolicy policy, std::unique_lock<std::mutex>* lock) {
+  // Only whole frames are queued, so the reader never sees a torn frame.
+  // The render thread runs off the endpoint's event, so a blocked write
+  // only has to wait.
+  if (policy != FeedPolicy::kBlock || !lock) {
+    size_t written = FeedQueue(samples_, data, length, bytes_per_frame_, policy);
+    stats_.RecordFeed(written, PlaybackStats::NowNs());
+    did_request_feed_ = false;
+    return written;
+  }
+  size_t whole = length / bytes_per_frame_ * bytes_per_frame_;
+  int64_t timeout_ns = static_cast<int64_t>(whole / bytes_per_frame_) * 1000000000 / sample_rate_;
+  return feed_waiter_.Block(*lock, whole, timeout_ns, [this, data, whole](size_t* written) {
+    // Close can run while the lock is let go
+    if (!is_open()) {
+      return false;
+    }
+    size_t queued = FeedQueue(samples_, data + *written, whole - *written, bytes_per_frame_, FeedPolicy::kPartial);
+    stats_.RecordFeed(queued, PlaybackStats::NowNs());
+    did_request_feed_ = false;
+    *written += queued;
+    return !start_held_ && !paused_;
+  });
+}
+
+void WasapiPlayer::Prime() {
+  start_at_ns_ = 0;
+  start_held_ = true;
+  feed_waiter_.Cancel();
+}
+
+void WasapiPlayer::StartAt(int64_t host_time_ns) {
+  start_at_ns_ = std::max<int64_t>(host_time_ns, 1);
+}
+
+void WasapiPlayer::GetPosition(uint64_t* frames, int64_t* host_time_ns) const {
+  uint32_t seq;
+  do {
+    seq = position_seq_.load(std::memory_order_acquire);
+    *frames = position_frames_.load(std::memory_order_relaxed);
+    *host_time_ns = position_time_ns_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((seq & 1) != 0 || seq != position_seq_.load(std::memory_order_relaxed));
+  if (*host_time_ns == 0) {
+    *host_time_ns = PlaybackStats::NowNs();
+  }
+}
+
+void WasapiPlayer::Flush() {
+  flush_to_ = samples_.WritePosition();
+  flush_requests_++;
+  feed_waiter_.Cancel();
+  SetEvent(control_event_);
+}
+
+void WasapiPlayer::Pause() {
+  paused_ = true;
+  feed_waiter_.Cancel();
+  SetEvent(control_event_);
+}
+
+void WasapiPlayer::Resume() {
+  paused_ = false;
+  SetEvent(control_event_);
+}
+
+void WasapiPlayer::WriteSilentBuffer() {
+  if (exclusive_) {
+    BYTE* data = nullptr;
+    if (SUCCEEDED(render_client_->GetBuffer(device_buffer_frames_, &data))) {
+      render_client_->ReleaseBuffer(device_buffer_frames_, AUDCLNT_BUFFERFLAGS_SILENT);
+    }
+  }
+}
+
+void WasapiPlayer::RenderThread(HANDLE started, bool* mmcss_granted) {
+  HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  DWORD task_index = 0;
+  HANDLE mmcss = AvSetMmThreadCharacteristicsW(L"Pro Audio", &task_index);
+  *mmcss_granted = mmcss != nullptr;
+  SetEvent(started);
+
+  HANDLE events[] = {stop_event_, audio_event_, control_event_};
+  for (;;) {
+    DWORD wait = WaitForMultipleObjects(3, events, FALSE, INFINITE);
+    if (wait == WAIT_OBJECT_0 + 1) {
+      Render();
+    } else if (wait == WAIT_OBJECT_0 + 2) {
+      ApplyControl();
+    } else {
+      break;
+    }
+  }
+
+  if (mmcss) {
+    AvRevertMmThreadCharacteristics(mmcss);
+  }
+  if (SUCCEEDED(com)) {
+    CoUninitialize();
+  }
+}
+
+void WasapiPlayer::ApplyControl() {
+  uint32_t requests = flush_requests_;
+  bool flush = requests != flushes_done_;
+  bool pause = paused_;
+  if ((flush || pause) && !stream_stopped_) {
+    audio_client_->Stop();
+    stream_stopped_ = true;
+  }
+
+  if (flush) {
+    // Reset empties the endpoint buffer; it only works on a stopped stream
+    if (FAILED(audio_client_->Reset())) {
+      stats_.RecordDeviceError();
+    }
+    stats_.RecordDiscarded(samples_.DiscardTo(flush_to_));
+    fifo_frames_ = 0;
+    if (resampling_) {
+      resampler_.Reset();
+    }
+    // Only what had reached the speaker counts as played
+    frames_handed_ = position_frames_;
+    flushes_done_ = requests;
+  }
+
+  if (!pause && stream_stopped_) {
+    if (flush) {
+      WriteSilentBuffer();
+    }
+    if (FAILED(audio_client_->Start())) {
+      stats_.RecordDeviceError();
+      return;
+    }
+    stream_stopped_ = false;
+  }
+}
+
+void WasapiPlayer::Render() {
+  // An event can still be pending from before the stream stopped
+  if (stream_stopped_) {
+    return;
+  }
+  // Exclusive event mode hands over one whole buffer per event; shared
+  // mode fills whatever the engine has already consumed
+  UINT32 frames = device_buffer_frames_;
+  UINT32 padding = 0;
+  if (!exclusive_) {
+    if (FAILED(audio_client_->GetCurrentPadding(&padding))) {
+      stats_.RecordDeviceError();
+      return;
+    }
+    frames -= std::min(padding, frames);
+  }
+  int64_t now = PlaybackStats::NowNs();
+
+  // Pre-roll: silence only, until a scheduled start falls inside what is
+  // written now. Frames written here play after what the endpoint already
+  // holds (a whole buffer in exclusive mode).
+  size_t lead_frames = 0;
+  bool held = start_held_;
+  if (held) {
+    int64_t start_at = start_at_ns_;
+    lead_frames = frames;
+    if (start_at != 0) {
+      UINT32 ahead = exclusive_ ? device_buffer_frames_ : padding;
+      int64_t plays_at = now + static_cast<int64_t>(ahead) * 1000000000 / device_rate_;
+      if (start_at <= plays_at) {
+        lead_frames = 0;
+      } else {
+        lead_frames = std::min<size_t>(frames, (start_at - plays_at) * device_rate_ / 1000000000);
+      }
+      if (lead_frames < frames) {
+        start_at_ns_.compare_exchange_strong(start_at, 0);
+        start_held_ = false;
+        held = false;
+      }
+    }
+  }
+  if (!held) {
+    stats_.RecordDeviceCallback(samples_.ReadableBytes() / bytes_per_frame_);
+    FillFifo(frames - lead_frames);
+    feed_waiter_.Notify();
+  }
+
+  // Shared mode never writes silence, so a late feed isn't queued behind
+  // it, except to line up a scheduled start
+  UINT32 write_frames = frames;
+  if (!exclusive_) {
+    bool scheduled = held ? start_at_ns_ != 0 : lead_frames > 0;
+    write_frames = static_cast<UINT32>(scheduled ? frames : std::min<size_t>(frames, lead_frames + fifo_frames_));
+    if (held && !scheduled) {
+      write_frames = 0;
+    }
+  }
+  size_t played_frames = 0;
+  if (write_frames > 0) {
+    BYTE* data = nullptr;
+    if (FAILED(render_client_->GetBuffer(write_frames, &data))) {
+      stats_.RecordDeviceError();
+    } else {
+      size_t device_bytes_per_frame = BytesPerSample(device_format_) * device_channels_;
+      size_t lead = std::min<size_t>(lead_frames, write_frames);
+      played_frames = std::min<size_t>(write_frames - lead, fifo_frames_);
+      memset(data, 0, lead * device_bytes_per_frame);
+      FromFloat(device_format_, fifo_.data(), data + lead * device_bytes_per_frame, played_frames * device_channels_);
+      memset(data + (lead + played_frames) * device_bytes_per_frame, 0,
+             (write_frames - lead - played_frames) * device_bytes_per_frame);
+      render_client_->ReleaseBuffer(write_frames, played_frames == 0 ? AUDCLNT_BUFFERFLAGS_SILENT : 0);
+
+      // Leftovers are at most one converted chunk
+      fifo_frames_ -= played_frames;
+      memmove(fifo_.data(), fifo_.data() + played_frames * device_channels_,
+              fifo_frames_ * device_channels_ * sizeof(float));
+    }
+  }
+
+  if (held) {
+    return;
+  }
+
+  // Shared mode has underrun once the engine drained the endpoint buffer;
+  // exclusive mode when this event's buffer had to be padded. Only the
+  // first starved event counts, and recovery ends when audio flows again.
+  // The event that starts a scheduled stream doesn't count.
+  bool starved = exclusive_ ? played_frames + lead_frames < write_frames : padding == 0;
+  if (lead_frames > 0) {
+    starved = false;
+  }
+  if (starved && !was_starved_) {
+    stats_.RecordUnderrun(now);
+  } else if (!starved) {
+    stats_.RecordRecovered(now);
+  }
+  was_starved_ = starved;
+
+  // Audio still ahead of the speaker: what is queued in the endpoint
+  // (silence excluded) plus what hasn't reached it yet
+  size_t device_frames = exclusive_ ? played_frames : padding + write_frames;
+  size_t remaining = RemainingFrames(device_frames);
+
+  // Position: whatever was handed over minus what is still on its way
+  size_t in_flight = remaining - std::min(remaining, samples_.ReadableBytes() / bytes_per_frame_);
+  uint64_t position = frames_handed_ - std::min<uint64_t>(frames_handed_, in_flight);
+  uint32_t seq = position_seq_.load(std::memory_order_relaxed);
+  position_seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  position_frames_.store(position, std::memory_order_relaxed);
+  position_time_ns_.store(now, std::memory_order_relaxed);
+  position_seq_.store(seq + 2, std::memory_order_release);
+
+  size_t threshold = feed_threshold_;
+  if (remaining <= threshold && !did_request_feed_.exchange(true)) {
+    size_t period = std::max<size_t>(static_cast<size_t>(device_period_frames_) * sample_rate_ / device_rate_, 1);
+    size_t target = threshold + period;
+    pending_remaining_frames_ = remaining;
+    pending_requested_frames_ = remaining < target ? target - remaining : period;
+    if (!on_feed_request_()) {
+      did_request_feed_ = false;
+    }
+  }
+}
+
+void WasapiPlayer::FillFifo(size_t frames) {
+  while (fifo_frames_ < frames) {
+    size_t read = samples_.Read(chunk_bytes_.data(), chunk_frames_ * bytes_per_frame_) / bytes_per_frame_;
+    if (read == 0) {
+      return;
+    }
+    stats_.RecordPlayed(read * bytes_per_frame_, PlaybackStats::NowNs());
+    frames_handed_ += read;
+    ToFloat(format_, chunk_bytes_.data(), chunk_float_.data(), read * channels_);
+    const float* in = chunk_float_.data();
+    if (resampling_) {
+      read = resampler_.Process(in, read, resampled_.data());
+      in = resampled_.data();
+    }
+    RemapChannels(in, channels_, fifo_.data() + fifo_frames_ * device_channels_, device_channels_, read);
+    fifo_frames_ += read;
+  }
+}
+
+size_t WasapiPlayer::RemainingFrames(size_t device_frames) const {
+  size_t queued = samples_.ReadableBytes() / bytes_per_frame_;
+  size_t converted = device_frames + fifo_frames_;
+  if (resampling_) {
+    return queued + converted * sample_rate_ / device_rate_ + resampler_.latency_frames();
+  }
+  return queued + converted;
+}
+
+}  // namespace flutter_pcm_sound
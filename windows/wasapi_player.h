@@ -0,0 +1,224 @@
+#ifndef FLUTTER_PLUGIN_WASAPI_PLAYER_H_
+#define FLUTTER_PLUGIN_WASAPI_PLAYER_H_
+
+#include <windows.h>
+
+#include <audioclient.h>
+#include <mmdeviceapi.h>
+#include <wrl/client.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pcm_convert.h"
+#include "pcm_feed_policy.h"
+#include "pcm_resampler.h"
+#include "pcm_ring_buffer.h"
+#include "pcm_stats.h"
+
+namespace flutter_pcm_sound {
+
+struct WasapiConfig {
+  int sample_rate = 0;
+  int channels = 0;
+  SampleFormat format = SampleFormat::kS16;
+  // Smallest period the engine (shared) or device (exclusive) allows
+  bool low_latency = false;
+  // Shared mode buffer size, in frames at sample_rate. 0 picks a default.
+  int buffer_frames = 0;
+  // Own the device: no mixing, no system effects, shortest periods
+  bool exclusive = false;
+  ResampleQuality resample_quality = ResampleQuality::kMedium;
+  // The sample queue holds this much audio, allocated by Open
+  int64_t max_queue_us = kDefaultMaxQueueMicros;
+};
+
+// What Open negotiated.
+struct WasapiStreamInfo {
+  SampleFormat device_format = SampleFormat::kF32;
+  int device_channels = 0;
+  int device_rate = 0;
+  bool resampling = false;
+  bool exclusive = false;
+  // Device buffer and period, in frames at the configured sample_rate
+  size_t buffer_frames = 0;
+  size_t period_frames = 0;
+  bool mmcss_granted = false;
+};
+
+// Plays the default render endpoint through WASAPI in event-driven mode.
+//
+// A dedicated render thread, registered with MMCSS as "Pro Audio", waits
+// on the audio client's event and refills the endpoint buffer from the
+// sample queue. Samples are converted, resampled and remapped to whatever
+// format the endpoint runs in with the shared core, so any rate, channel
+// count and sample format can be fed. The render thread never locks or
+// allocates.
+//
+// Open, Close and Write are called from one thread (the platform thread,
+// serialized with FFI feeds by the plugin).
+class WasapiPlayer {
+ public:
+  // Called on the render thread when the queue drops to the feed
+  // threshold. It must be cheap: the plugin only posts a window message.
+  // Returns false when the request went nowhere, so the next render asks
+  // again instead of waiting on a feed that will never come.
+  using FeedRequestCallback = std::function<bool()>;
+
+  explicit WasapiPlayer(FeedRequestCallback on_feed_request);
+  ~WasapiPlayer();
+
+  WasapiPlayer(const WasapiPlayer&) = delete;
+  WasapiPlayer& operator=(const WasapiPlayer&) = delete;
+
+  // Opens the default endpoint and starts the render thread. On failure
+  // returns false with `error` describing the call that failed.
+  bool Open(const WasapiConfig& config, WasapiStreamInfo* info, std::string* error);
+
+  // Stops the render thread and releases the endpoint. Safe to call twice.
+  void Close();
+
+  bool is_open() const { return render_thread_.joinable(); }
+
+  // Queues whole frames in the configured format under `policy` and
+  // returns how many bytes it took. kBlock waits at most as long as the
+  // samples take to play, and not at all while primed or paused; it waits
+  // with the caller's `lock` released, and only when there is one, so the
+  // platform thread passes none and never blocks.
+  size_t Write(const uint8_t* data, size_t length, FeedPolicy policy, std::unique_lock<std::mutex>* lock);
+
+  void set_feed_threshold(size_t frames) { feed_threshold_ = frames; }
+
+  // The numbers behind the latest feed request, in frames at the
+  // configured sample rate. See the Linux plugin's feed_source_dispatch.
+  size_t pending_remaining_frames() const { return pending_remaining_frames_; }
+  size_t pending_requested_frames() const { return pending_requested_frames_; }
+
+  // Pre-roll: holds the queue back until StartAt, so feeds can fill it
+  // first.
+  void Prime();
+  bool primed() const { return start_held_; }
+
+  // Starts a primed stream so its first sample reaches the endpoint at
+  // `host_time_ns` (PlaybackStats::NowNs, i.e. QueryPerformanceCounter),
+  // padding with silence up to that frame.
+  void StartAt(int64_t host_time_ns);
+
+  // Frames fed that have reached the endpoint, at the configured sample
+  // rate, and the host time that was true at.
+  void GetPosition(uint64_t* frames, int64_t* host_time_ns) const;
+
+  // Drops everything queued so far and what the endpoint holds, keeping
+  // the stream open. The render thread carries it out as soon as it wakes;
+  // later writes play as usual.
+  void Flush();
+
+  // Stops the endpoint where it is, keeping everything queued, until
+  // Resume.
+  void Pause();
+  void Resume();
+  bool paused() const { return paused_; }
+
+  // Primary stream telemetry. Open resets it.
+  PlaybackStats& stats() { return stats_; }
+
+ private:
+  HRESULT Activate();
+  HRESULT InitializeExclusive(const WasapiConfig& config, std::string* error);
+  HRESULT InitializeShared(const WasapiConfig& config, std::string* error);
+  // Registers with MMCSS, reports whether that worked through
+  // `mmcss_granted` and `started`, then renders until stop_event_.
+  void RenderThread(HANDLE started, bool* mmcss_granted);
+  void Render();
+  // Render thread. Carries out Flush, Pause and Resume.
+  void ApplyControl();
+  // Exclusive streams must be primed before Start, or the first period
+  // glitches. Silence keeps the start immediate.
+  void WriteSilentBuffer();
+  // Converts queued samples into fifo_ until it holds `frames` frames or
+  // the queue runs dry.
+  void FillFifo(size_t frames);
+  size_t RemainingFrames(size_t device_frames) const;
+
+  FeedRequestCallback on_feed_request_;
+
+  Microsoft::WRL::ComPtr<IMMDevice> device_;
+  Microsoft::WRL::ComPtr<IAudioClient> audio_client_;
+  Microsoft::WRL::ComPtr<IAudioRenderClient> render_client_;
+  HANDLE audio_event_ = nullptr;
+  HANDLE stop_event_ = nullptr;
+  // Wakes the render thread for Flush, Pause and Resume
+  HANDLE control_event_ = nullptr;
+  std::thread render_thread_;
+
+  // What Dart feeds
+  int sample_rate_ = 0;
+  int channels_ = 0;
+  SampleFormat format_ = SampleFormat::kS16;
+  size_t bytes_per_frame_ = 0;
+
+  // What the endpoint runs
+  bool exclusive_ = false;
+  SampleFormat device_format_ = SampleFormat::kF32;
+  int device_channels_ = 0;
+  int device_rate_ = 0;
+  UINT32 device_buffer_frames_ = 0;
+  UINT32 device_period_frames_ = 0;
+
+  RingBuffer samples_;
+  Resampler resampler_;
+  bool resampling_ = false;
+
+  // Render thread scratch, sized by Open. fifo_ holds converted frames
+  // that didn't fit the endpoint buffer yet, in the device layout.
+  size_t chunk_frames_ = 0;
+  std::vector<uint8_t> chunk_bytes_;
+  std::vector<float> chunk_float_;
+  std::vector<float> resampled_;
+  std::vector<float> fifo_;
+  size_t fifo_frames_ = 0;
+  // The last event came up short (render thread only)
+  bool was_starved_ = false;
+
+  // See Prime and StartAt. start_at_ns_ is 0 when no start is scheduled.
+  std::atomic<bool> start_held_{false};
+  std::atomic<int64_t> start_at_ns_{0};
+
+  // Frames read from the queue (render thread only), and the playback
+  // position published from it under a sequence count that is odd while
+  // being written
+  uint64_t frames_handed_ = 0;
+  std::atomic<uint32_t> position_seq_{0};
+  std::atomic<uint64_t> position_frames_{0};
+  std::atomic<int64_t> position_time_ns_{0};
+
+  // Flush notes how far the queue reaches in flush_to_ and bumps
+  // flush_requests_; the render thread counts flushes_done_. While
+  // stream_stopped_ (render thread only) the endpoint is stopped for a
+  // pause or a flush.
+  std::atomic<uint64_t> flush_to_{0};
+  std::atomic<uint32_t> flush_requests_{0};
+  uint32_t flushes_done_ = 0;
+  std::atomic<bool> paused_{false};
+  bool stream_stopped_ = false;
+
+  PlaybackStats stats_;
+  // A blocked Write sleeps here until Render has taken samples out, or
+  // Prime, Flush, Pause or Close ends the wait
+  FeedWaiter feed_waiter_;
+
+  std::atomic<size_t> feed_threshold_{1024};
+  std::atomic<bool> did_request_feed_{false};
+  std::atomic<size_t> pending_remaining_frames_{0};
+  std::atomic<size_t> pending_requested_frames_{0};
+};
+
+}  // namespace flutter_pcm_sound
+
+#endif  // FLUTTER_PLUGIN_WASAPI_PLAYER_H_